@@ -0,0 +1,210 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * (C) Copyright 2022
+ * F&S Elektronik Systeme GmbH
+ *
+ * Run a function on several CPU cores in parallel. The secondary cores of the
+ * boot cluster are started with PSCI CPU_ON, use the translation tables of
+ * the boot CPU and switch themselves off again with PSCI CPU_OFF when done.
+ */
+
+#include <common.h>
+#include <cpu_func.h>
+#include <malloc.h>
+#include <time.h>
+#include <watchdog.h>
+#include <asm/cache.h>
+#include <asm/global_data.h>
+#include <asm/psci.h>
+#include <asm/system.h>
+#include <linux/compiler.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Time to wait for a secondary CPU to come up or go down (ms) */
+#define CPU_PARALLEL_TIMEOUT	1000
+
+enum cpu_parallel_state {
+	CPU_PARALLEL_OFF,
+	CPU_PARALLEL_STARTING,
+	CPU_PARALLEL_RUNNING,
+	CPU_PARALLEL_DONE,
+	CPU_PARALLEL_LOST,
+};
+
+/* The first seven entries are used by cpu_parallel_entry.S */
+struct cpu_parallel_ctx {
+	u64 sp;
+	u64 gd;
+	u64 ttbr;
+	u64 tcr;
+	u64 mair;
+	u64 vbar;
+	u64 sctlr;
+	cpu_parallel_fn func;
+	void *arg;
+	int cpu;
+	int count;
+	int state;
+} __aligned(ARCH_DMA_MINALIGN);
+
+static struct cpu_parallel_ctx cpu_parallel_ctx[CONFIG_CPU_PARALLEL_MAX];
+
+void cpu_parallel_save_regs(struct cpu_parallel_ctx *ctx);
+void cpu_parallel_entry(void);
+
+static ulong cpu_parallel_psci(ulong fn, ulong arg1, ulong arg2, ulong arg3)
+{
+	struct pt_regs regs;
+
+	regs.regs[0] = fn;
+	regs.regs[1] = arg1;
+	regs.regs[2] = arg2;
+	regs.regs[3] = arg3;
+	smc_call(&regs);
+
+	return regs.regs[0];
+}
+
+/* MPIDR of the given CPU; the other cores of the cluster are numbered from 1
+   in ascending order, skipping the boot CPU */
+static ulong cpu_parallel_mpidr(int cpu)
+{
+	ulong mpidr = read_mpidr() & 0xff00ffffffUL;
+	ulong aff0 = mpidr & 0xff;
+
+	return (mpidr & ~0xffUL) | (cpu - 1 + (cpu > aff0));
+}
+
+/*
+ * Atomically change the state from old to new; return false if the state was
+ * not old. The boot CPU and the secondary CPU both leave STARTING this way,
+ * so a late CPU can not start running after it was considered lost.
+ */
+static bool cpu_parallel_set_state(struct cpu_parallel_ctx *ctx, int old,
+				   int new)
+{
+	return __atomic_compare_exchange_n(&ctx->state, &old, new, false,
+					   __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static int cpu_parallel_is_off(int cpu)
+{
+	return cpu_parallel_psci(ARM_PSCI_0_2_FN64_AFFINITY_INFO,
+				 cpu_parallel_mpidr(cpu), 0, 0)
+		== PSCI_AFFINITY_LEVEL_OFF;
+}
+
+/* Called from cpu_parallel_entry with MMU and caches on */
+void __noreturn cpu_parallel_secondary(struct cpu_parallel_ctx *ctx)
+{
+	if (cpu_parallel_set_state(ctx, CPU_PARALLEL_STARTING,
+				   CPU_PARALLEL_RUNNING)) {
+		ctx->func(ctx->cpu, ctx->count, ctx->arg);
+		dmb();
+		WRITE_ONCE(ctx->state, CPU_PARALLEL_DONE);
+	}
+
+	cpu_parallel_psci(ARM_PSCI_0_2_FN_CPU_OFF, 0, 0, 0);
+	for (;;)
+		wfi();
+}
+
+int cpu_parallel_count(void)
+{
+	int count = 1;
+
+	while ((count < CONFIG_CPU_PARALLEL_MAX) && cpu_parallel_is_off(count))
+		count++;
+
+	return count;
+}
+
+int cpu_parallel_run(int count, cpu_parallel_fn func, void *arg)
+{
+	struct cpu_parallel_ctx *ctx;
+	size_t size = CONFIG_CPU_PARALLEL_STACK_SIZE;
+	void *stacks = NULL;
+	ulong start, ret;
+	int cpu, running = 1;
+
+	if (count > CONFIG_CPU_PARALLEL_MAX)
+		count = CONFIG_CPU_PARALLEL_MAX;
+	if (count > 1)
+		stacks = memalign(16, (count - 1) * size);
+
+	for (cpu = 1; cpu < count; cpu++) {
+		ctx = &cpu_parallel_ctx[cpu];
+		ctx->state = CPU_PARALLEL_OFF;
+		if (!stacks)
+			continue;
+		cpu_parallel_save_regs(ctx);
+		ctx->sp = (ulong)stacks + cpu * size;
+		ctx->gd = (ulong)gd;
+		ctx->func = func;
+		ctx->arg = arg;
+		ctx->cpu = cpu;
+		ctx->count = count;
+		ctx->state = CPU_PARALLEL_STARTING;
+
+		/* The CPU reads the context before its caches are on */
+		flush_dcache_range((ulong)ctx, (ulong)(ctx + 1));
+		ret = cpu_parallel_psci(ARM_PSCI_0_2_FN64_CPU_ON,
+					cpu_parallel_mpidr(cpu),
+					(ulong)cpu_parallel_entry, (ulong)ctx);
+		if (ret != ARM_PSCI_RET_SUCCESS) {
+			debug("%s: CPU_ON for CPU %d failed (%ld)\n", __func__,
+			      cpu, (long)ret);
+			ctx->state = CPU_PARALLEL_OFF;
+		}
+	}
+
+	func(0, count, arg);
+
+	/*
+	 * Wait for the secondary CPUs. A CPU that was accepted by PSCI but
+	 * does not show up in time is considered lost; if it starts late, it
+	 * will see this and switch off again without calling func.
+	 */
+	for (cpu = 1; cpu < count; cpu++) {
+		ctx = &cpu_parallel_ctx[cpu];
+		start = get_timer(0);
+		while (READ_ONCE(ctx->state) == CPU_PARALLEL_STARTING) {
+			if ((get_timer(start) > CPU_PARALLEL_TIMEOUT)
+			    && cpu_parallel_set_state(ctx,
+						      CPU_PARALLEL_STARTING,
+						      CPU_PARALLEL_LOST))
+				break;
+		}
+		while (READ_ONCE(ctx->state) == CPU_PARALLEL_RUNNING)
+			WATCHDOG_RESET();
+		dmb();
+
+		if (ctx->state == CPU_PARALLEL_DONE) {
+			running++;
+		} else {
+			/* Do the work of this CPU on the boot CPU */
+			printf("CPU %d did not start, doing its work on CPU 0\n",
+			       cpu);
+			func(cpu, count, arg);
+		}
+	}
+
+	/* The stacks are in use until the CPUs are really off */
+	for (cpu = 1; cpu < count; cpu++) {
+		if (cpu_parallel_ctx[cpu].state == CPU_PARALLEL_OFF)
+			continue;
+		start = get_timer(0);
+		while (!cpu_parallel_is_off(cpu)) {
+			if (get_timer(start) > CPU_PARALLEL_TIMEOUT) {
+				/* Better leak the stacks than corrupt memory */
+				printf("CPU %d does not switch off\n", cpu);
+				stacks = NULL;
+				break;
+			}
+		}
+	}
+	free(stacks);
+
+	return running;
+}
@@ -12,6 +12,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <bootstage.h>
 #include <command.h>
 #include <cpu_func.h>
@@ -116,6 +117,10 @@ static void announce_and_cleanup(int fake)
 	video_link_shut_down();
 #endif
 
+	/* Write blocks that are still held back by the block cache */
+	if (blkcache_flush())
+		printf("Warning: block cache could not be written\n");
+
 	board_quiesce_devices();
 
 	printf("\nStarting kernel ...%s\n\n", fake ?
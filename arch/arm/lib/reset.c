@@ -21,6 +21,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <command.h>
 #include <cpu_func.h>
 #include <irq_func.h>
@@ -32,6 +33,9 @@ __weak void reset_misc(void)
 
 int do_reset(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 {
+	/* Write blocks that are still held back by the block cache */
+	blkcache_flush();
+
 	puts ("resetting ...\n");
 
 	mdelay(50);				/* wait 50 ms */
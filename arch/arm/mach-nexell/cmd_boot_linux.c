@@ -65,6 +65,8 @@ static void boot_start_lmb(bootm_headers_t *images)
 	ulong		mem_start;
 	phys_size_t	mem_size;
 
+	/* Free the regions of a previous boot_linux that did not boot */
+	lmb_release(&images->lmb);
 	lmb_init(&images->lmb);
 
 	mem_start = getenv_bootm_low();
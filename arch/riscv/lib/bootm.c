@@ -7,6 +7,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <bootstage.h>
 #include <command.h>
 #include <dm.h>
@@ -50,6 +51,10 @@ static void announce_and_cleanup(int fake)
 	udc_disconnect();
 #endif
 
+	/* Write blocks that are still held back by the block cache */
+	if (blkcache_flush())
+		printf("Warning: block cache could not be written\n");
+
 	board_quiesce_devices();
 
 	/*
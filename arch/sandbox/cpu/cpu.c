@@ -287,6 +287,22 @@ void sandbox_set_enable_pci_map(int enable)
 	enable_pci_map = enable;
 }
 
+#if CONFIG_IS_ENABLED(CPU_PARALLEL)
+/* Simulate the CPUs with host threads */
+int cpu_parallel_count(void)
+{
+	return CONFIG_CPU_PARALLEL_MAX;
+}
+
+int cpu_parallel_run(int count, cpu_parallel_fn func, void *arg)
+{
+	if (count > CONFIG_CPU_PARALLEL_MAX)
+		count = CONFIG_CPU_PARALLEL_MAX;
+
+	return os_run_threads(count, func, arg);
+}
+#endif
+
 void flush_dcache_range(unsigned long start, unsigned long stop)
 {
 }
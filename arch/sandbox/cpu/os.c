@@ -9,6 +9,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <stdio.h>
@@ -898,3 +899,55 @@ void os_relaunch(char *argv[])
 	execv(argv[0], argv);
 	os_exit(1);
 }
+
+struct os_thread {
+	pthread_t thread;
+	void (*func)(int cpu, int count, void *arg);
+	void *arg;
+	int cpu;
+	int count;
+};
+
+static void *os_thread_start(void *data)
+{
+	struct os_thread *t = data;
+
+	t->func(t->cpu, t->count, t->arg);
+
+	return NULL;
+}
+
+int os_run_threads(int count, void (*func)(int cpu, int count, void *arg),
+		   void *arg)
+{
+	struct os_thread *threads;
+	int started[count];
+	int i, running = 1;
+
+	threads = calloc(count, sizeof(*threads));
+	if (!threads)
+		count = 1;
+
+	for (i = 1; i < count; i++) {
+		threads[i].func = func;
+		threads[i].arg = arg;
+		threads[i].cpu = i;
+		threads[i].count = count;
+		started[i] = !pthread_create(&threads[i].thread, NULL,
+					     os_thread_start, &threads[i]);
+	}
+
+	func(0, count, arg);
+
+	for (i = 1; i < count; i++) {
+		if (started[i]) {
+			pthread_join(threads[i].thread, NULL);
+			running++;
+		} else {
+			func(i, count, arg);
+		}
+	}
+	free(threads);
+
+	return running;
+}
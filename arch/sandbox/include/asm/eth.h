@@ -71,6 +71,13 @@ int sandbox_eth_recv_ping_req(struct udevice *dev);
 typedef int sandbox_eth_tx_hand_f(struct udevice *dev, void *pkt,
 				   unsigned int len);
 
+/**
+ * A receive handler, called whenever no received packet is waiting
+ *
+ * dev - device pointer
+ */
+typedef int sandbox_eth_rx_hand_f(struct udevice *dev);
+
 /**
  * struct eth_sandbox_priv - memory for sandbox mock driver
  *
@@ -81,6 +88,7 @@ typedef int sandbox_eth_tx_hand_f(struct udevice *dev, void *pkt,
  * recv_packet_length - lengths of the packet returned as received
  * recv_packets - number of packets returned
  * tx_handler - function to generate responses to sent packets
+ * rx_handler - function to generate packets without a packet being sent
  * priv - a pointer to some structure a test may want to keep track of
  */
 struct eth_sandbox_priv {
@@ -91,6 +99,7 @@ struct eth_sandbox_priv {
 	int recv_packet_length[PKTBUFSRX];
 	int recv_packets;
 	sandbox_eth_tx_hand_f *tx_handler;
+	sandbox_eth_rx_hand_f *rx_handler;
 	void *priv;
 };
 
@@ -101,6 +110,13 @@ struct eth_sandbox_priv {
  */
 void sandbox_eth_set_tx_handler(int index, sandbox_eth_tx_hand_f *handler);
 
+/*
+ * Set receive handler
+ *
+ * handler - The func ptr to call when no packet is waiting; NULL for none
+ */
+void sandbox_eth_set_rx_handler(int index, sandbox_eth_rx_hand_f *handler);
+
 /*
  * Set priv ptr
  *
@@ -8,6 +8,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <bootstage.h>
 #include <command.h>
 #include <hang.h>
@@ -43,6 +44,10 @@ void bootm_announce_and_cleanup(void)
 	bootstage_report();
 #endif
 
+	/* Write blocks that are still held back by the block cache */
+	if (blkcache_flush())
+		printf("Warning: block cache could not be written\n");
+
 	/*
 	 * Call remove function of all devices with a removal flag set.
 	 * This may be useful for last-stage operations, like cancelling
@@ -182,12 +182,6 @@ const char *fs_image_get_arch(void)
 	return CONFIG_SYS_BOARD;
 }
 
-/* Check if this is an F&S image */
-bool fs_image_is_fs_image(const struct fs_header_v1_0 *fsh)
-{
-	return !strncmp(fsh->info.magic, "FSLX", sizeof(fsh->info.magic));
-}
-
 /* Return the intended address of the board configuration in OCRAM */
 void *fs_image_get_regular_cfg_addr(void)
 {
@@ -248,37 +242,6 @@ const char *fs_image_get_nboot_version(void *fdt)
 	return fdt_getprop(fdt, offs, "version", NULL);
 }
 
-/* Read the image size (incl. padding) from an F&S header */
-unsigned int fs_image_get_size(const struct fs_header_v1_0 *fsh,
-			       bool with_fs_header)
-{
-	/* We ignore the high word, boot images are definitely < 4GB */
-	return fsh->info.file_size_low + (with_fs_header ? FSH_SIZE : 0);
-}
-
-/* Check image magic, type and descr; return true on match */
-bool fs_image_match(const struct fs_header_v1_0 *fsh,
-		    const char *type, const char *descr)
-{
-	if (!type)
-		return false;
-
-	if (!fs_image_is_fs_image(fsh))
-		return false;
-
-	if (strncmp(fsh->type, type, MAX_TYPE_LEN))
-		return false;
-
-	if (descr) {
-		if (!(fsh->info.flags & FSH_FLAGS_DESCR))
-			return false;
-		if (strncmp(fsh->param.descr, descr, MAX_DESCR_LEN))
-			return false;
-	}
-
-	return true;
-}
-
 static void fs_image_get_board_name_rev(const char id[MAX_DESCR_LEN],
 					struct bnr *bnr)
 {
@@ -6,542 +6,449 @@
  *
  * Common memory test based on memtester by Charles Cazabon.
  *
+ * The original memtester writes each pattern to two buffers and then compares
+ * them, i.e. every pattern needs two write passes and a compare pass over
+ * both halves of the RAM. Here, each pattern can be computed for every word,
+ * so the expected value is generated on the fly instead of being read from a
+ * second buffer. The variants of a test are chained: each pass verifies the
+ * previous pattern and writes the next one in the same cache line, so a test
+ * with n variants needs n+1 passes over the RAM instead of about 3n. All of
+ * the RAM is tested, not only half of it.
+ *
+ * If cpu_parallel_run() can start the secondary CPUs, each CPU handles its
+ * own slice of the RAM in every pass. The passes themselves stay in lockstep,
+ * so a pattern is only verified after all CPUs have completely written it.
+ *
  * SPDX-License-Identifier:	GPL-2.0+
  */
 
 #include <common.h>
-#include <errno.h>
+#include <cpu_func.h>
 #include <rand.h>
+#include <time.h>
+#include <watchdog.h>
 #include <asm/io.h>
-#include <asm/arch/ddr.h>
-#include <asm/arch/clock.h>
-#include <asm/arch/ddr.h>
-#include <asm/arch/sys_proto.h>
 #include "fs_memtest_common.h"
 
-typedef unsigned long ul;
-typedef unsigned long long ull;
-typedef unsigned long volatile ulv;
-typedef unsigned char volatile u8v;
-typedef unsigned short volatile u16v;
-
-struct test {
-    char *name;
-    int (*fp)();
-};
+#define MT_BITS		64		/* Bits per tested word */
+#define MT_CHUNK	128		/* Words generated in one go */
 
-#define rand32() ((unsigned int) rand() | ( (unsigned int) rand() << 16))
-//#define rand32() ranval(&ctx)
+/*
+ * i.MX8MM and i.MX8MP have up to four Cortex-A53 cores. The per CPU data
+ * below is in BSS, which is only 8 KiB in SPL, so only reserve space for
+ * more than one CPU if they can actually be used.
+ */
+#if CONFIG_IS_ENABLED(CPU_PARALLEL)
+#define MT_MAX_CPUS	4
+#else
+#define MT_MAX_CPUS	1
+#endif
 
-#define rand_ul() rand32()
-#define UL_ONEBITS 0xffffffff
-#define UL_LEN 32
-#define CHECKERBOARD1 0x55555555
-#define CHECKERBOARD2 0xaaaaaaaa
-#define UL_BYTE(x) ((x | x << 8 | x << 16 | x << 24))
+/* Tests with more variants only use about this many in quick mode */
+#define MT_QUICK_VARIANTS 8
 
-#define EXIT_FAIL_NONSTARTER    0x01
-#define EXIT_FAIL_ADDRESSLINES  0x02
-#define EXIT_FAIL_OTHERTEST     0x04
+#define CHECKERBOARD1	0x5555555555555555ULL
+#define CHECKERBOARD2	0xaaaaaaaaaaaaaaaaULL
+#define UL_BYTE(x)	((x) * 0x0101010101010101ULL)
 
+/* Pattern types */
+enum mt_type {
+	MT_ALT,				/* Alternating words a and b */
+	MT_SEQ,				/* Sequence a + index */
+	MT_ADDR,			/* Address, inverted on odd words (a=0) */
+	MT_RAND,			/* Random value, then nops ALU operations */
+};
 
-#define ONE 0x00000001L
+/* ALU operations applied to random values */
+enum mt_op {
+	MT_OP_XOR,
+	MT_OP_SUB,
+	MT_OP_MUL,
+	MT_OP_DIV,
+	MT_OP_OR,
+	MT_OP_AND,
+	MT_OP_COUNT
+};
 
-union {
-    unsigned char bytes[UL_LEN/8];
-    ul val;
-} mword8;
+struct mt_pattern {
+	enum mt_type type;
+	u64 a;
+	u64 b;
+	unsigned int nops;		/* MT_RAND: number of operations */
+};
 
-union {
-    unsigned short u16s[UL_LEN/16];
-    ul val;
-} mword16;
+struct mt_test {
+	const char *name;
+	unsigned int variants;
+	void (*get)(struct mt_pattern *pat, unsigned int v);
+};
 
-/* Function definitions. */
-static int show_progress = 1;
-static int wheel_pos;
+/* Operands for the ALU operations and seed for the random values */
+static u64 mt_q[MT_OP_COUNT];
+static u64 mt_seed;
+
+/* Per CPU data: expected and new values of the current chunk, first error */
+struct mt_cpu {
+	u64 exp[MT_CHUNK];
+	u64 val[MT_CHUNK];
+	u64 *start;			/* Slice of this CPU */
+	size_t first;			/* Word index of start */
+	size_t count;			/* Number of words */
+	u64 *fail;			/* Address of first error or NULL */
+	u64 fail_exp;
+} __aligned(64);
+
+static struct mt_cpu mt_cpu[MT_MAX_CPUS];
+
+/* Arguments of the current pass for all CPUs */
+struct mt_job {
+	const struct mt_pattern *check;
+	const struct mt_pattern *fill;
+};
 
-static void out_test_start(void)
+/* Random value for word index i; must be reproducible for every index */
+static inline u64 mt_hash(u64 x)
 {
-    if (show_progress) {
-        printf("           ");
-    }
-}
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
 
-static void out_test_setting(unsigned int j)
-{
-    if (show_progress) {
-        printf("\b\b\b\b\b\b\b\b\b\b\b");
-        printf("setting %3u", j);
-    }
+	return x ^ (x >> 31);
 }
 
-static void out_test_testing(unsigned int j)
+static inline u64 mt_apply(enum mt_op op, u64 v)
 {
-    if (show_progress) {
-        printf("\b\b\b\b\b\b\b\b\b\b\b");
-        printf("testing %3u", j);
-    }
+	switch (op) {
+	case MT_OP_XOR:
+		return v ^ mt_q[op];
+	case MT_OP_SUB:
+		return v - mt_q[op];
+	case MT_OP_MUL:
+		return v * mt_q[op];
+	case MT_OP_DIV:
+		return v / mt_q[op];
+	case MT_OP_OR:
+		return v | mt_q[op];
+	case MT_OP_AND:
+	default:
+		return v & mt_q[op];
+	}
 }
 
-static void out_test_end(void)
+/* Compute pattern for n words at p; i is the word index of p (even) */
+static void mt_generate(const struct mt_pattern *pat, u64 *buf, u64 *p,
+			size_t i, size_t n)
 {
-    if (show_progress) {
-        printf("\b\b\b\b\b\b\b\b\b\b\b           \b\b\b\b\b\b\b\b\b\b\b");
-    }
+	size_t j;
+	u64 v;
+	enum mt_op op;
+
+	switch (pat->type) {
+	case MT_ALT:
+		for (j = 0; j < n; j += 2) {
+			buf[j] = pat->a;
+			buf[j + 1] = pat->b;
+		}
+		break;
+
+	case MT_SEQ:
+		for (j = 0; j < n; j++)
+			buf[j] = pat->a + i + j;
+		break;
+
+	case MT_ADDR:
+		for (j = 0; j < n; j += 2) {
+			v = (u64)(uintptr_t)(p + j);
+			buf[j] = v ^ pat->a;
+			buf[j + 1] = ~(v + sizeof(u64)) ^ pat->a;
+		}
+		break;
+
+	case MT_RAND:
+		for (j = 0; j < n; j++) {
+			v = mt_hash(mt_seed + i + j);
+			for (op = 0; op < pat->nops; op++)
+				v = mt_apply(op, v);
+			buf[j] = v;
+		}
+		break;
+	}
 }
 
-static void out_wheel_start(void)
+/* Store two words bypassing the caches if possible */
+static inline void mt_store_pair(u64 *p, u64 a, u64 b)
 {
-    if (show_progress) {
-        printf(" ");
-        wheel_pos = 0;
-    }
+#ifdef CONFIG_ARM64
+	asm volatile("stnp %1, %2, [%0]" : : "r" (p), "r" (a), "r" (b)
+		     : "memory");
+#else
+	p[0] = a;
+	p[1] = b;
+#endif
 }
 
-static void out_wheel_advance(unsigned int i)
+static int mt_fail(const char *name, unsigned int v, u64 *p, u64 exp)
 {
-    static const unsigned int wheel_often = 2500;
-    static const unsigned int n_chars = 4;
-    char wheel_char[4] = {'-', '\\', '|', '/'};
-
-    if (show_progress) {
-        if (!(i % wheel_often)) {
-            printf("\b");
-            printf("%c", wheel_char[++wheel_pos % n_chars]);
-        }
-    }
+	printf("FAILURE: %s #%u at 0x%08lx: expected 0x%016llx, read 0x%016llx\n",
+	       name, v, (ulong)p, exp, readq(p));
+
+	return -1;
 }
 
-static void out_wheel_end(void)
+/* Verify pattern check and write pattern fill in the slice of one CPU */
+static void mt_pass_cpu(int cpu, int count, void *arg)
 {
-    if (show_progress) {
-        printf("\b \b");
-    }
+	const struct mt_job *job = arg;
+	const struct mt_pattern *check = job->check;
+	const struct mt_pattern *fill = job->fill;
+	struct mt_cpu *c = &mt_cpu[cpu];
+	size_t i, j, n;
+	u64 *p = c->start;
+
+	c->fail = NULL;
+	for (i = 0; i < c->count; i += n, p += n) {
+		n = min_t(size_t, c->count - i, MT_CHUNK);
+		if (check)
+			mt_generate(check, c->exp, p, c->first + i, n);
+		if (fill)
+			mt_generate(fill, c->val, p, c->first + i, n);
+
+		if (check && fill) {
+			for (j = 0; j < n; j += 2) {
+				if ((p[j] != c->exp[j])
+				    || (p[j + 1] != c->exp[j + 1]))
+					break;
+				mt_store_pair(p + j, c->val[j], c->val[j + 1]);
+			}
+		} else if (check) {
+			for (j = 0; j < n; j += 2) {
+				if ((p[j] != c->exp[j])
+				    || (p[j + 1] != c->exp[j + 1]))
+					break;
+			}
+		} else {
+			for (j = 0; j < n; j += 2)
+				mt_store_pair(p + j, c->val[j], c->val[j + 1]);
+		}
+		if (j < n) {
+			if (p[j] == c->exp[j])
+				j++;
+			c->fail = p + j;
+			c->fail_exp = c->exp[j];
+			return;
+		}
+
+		if (!cpu && !(i & 0xfffff))
+			WATCHDOG_RESET();
+	}
 }
 
-
-/* Function definitions. */
-
-int compare_regions(ulv *bufa, ulv *bufb, size_t count) {
-    int r = 0;
-    size_t i;
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-
-    for (i = 0; i < count; i++, p1++, p2++) {
-        if (*p1 != *p2) {
-                printf( "FAILURE: 0x%08lx != 0x%08lx at offset 0x%08lx.\n",
-                        (ul) *p1, (ul) *p2, (ul) (i * sizeof(ul)));
-            /* printf("Skipping to next test..."); */
-            r = -1;
-			return r;
-        }
-    }
-    return r;
+/* Split the RAM into one slice per CPU; keep the slices chunk aligned */
+static void mt_split(u64 *start, size_t count, int cpus)
+{
+	size_t first = 0;
+	size_t n = (count / cpus) & ~(size_t)(MT_CHUNK - 1);
+	int cpu;
+
+	for (cpu = 0; cpu < cpus; cpu++) {
+		mt_cpu[cpu].start = start + first;
+		mt_cpu[cpu].first = first;
+		mt_cpu[cpu].count = (cpu == cpus - 1) ? count - first : n;
+		first += mt_cpu[cpu].count;
+	}
 }
 
-int test_stuck_address(ulv *bufa, size_t count) {
-    ulv *p1 = bufa;
-    unsigned int j;
-    size_t i;
-
-    out_test_start();
-    for (j = 0; j < 16; j++) {
-        p1 = (ulv *) bufa;
-        out_test_setting(j);
-        for (i = 0; i < count; i++) {
-            *p1 = ((j + i) % 2) == 0 ? (ul) p1 : ~((ul) p1);
-            *p1++;
-        }
-        out_test_testing(j);
-        p1 = (ulv *) bufa;
-        for (i = 0; i < count; i++, p1++) {
-            if (*p1 != (((j + i) % 2) == 0 ? (ul) p1 : ~((ul) p1))) {
-                printf("FAILURE: possible bad address line at offset "
-                        "0x%08lx.\n",
-                        (ul) (i * sizeof(ul)));
-                printf("Skipping to next test...\n");
-                return -1;
-            }
-        }
-    }
-    out_test_end();
-    return 0;
-}
+/*
+ * One pass over the RAM: verify the pattern check (if not NULL) and write the
+ * pattern fill (if not NULL). The data caches are flushed before, so that the
+ * verification really reads back from the RAM and not from a cache line.
+ */
+static int mt_pass(int cpus, const struct mt_pattern *check,
+		   const struct mt_pattern *fill, const char *name,
+		   unsigned int v)
+{
+	struct mt_job job = { check, fill };
+	int cpu, err = 0;
 
-int test_random_value(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    size_t i;
-
-    out_wheel_start();
-    for (i = 0; i < count; i++) {
-        *p1++ = *p2++ = rand_ul();
-        out_wheel_advance(i);
-    }
-    out_wheel_end();
-    return compare_regions(bufa, bufb, count);
-}
+	flush_dcache_all();
+	cpu_parallel_run(cpus, mt_pass_cpu, &job);
 
-int test_xor_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    size_t i;
-    ul q = rand_ul();
-
-    for (i = 0; i < count; i++) {
-        *p1++ ^= q;
-        *p2++ ^= q;
-    }
-    return compare_regions(bufa, bufb, count);
-}
+	for (cpu = 0; cpu < cpus; cpu++) {
+		if (mt_cpu[cpu].fail)
+			err = mt_fail(name, v, mt_cpu[cpu].fail,
+				      mt_cpu[cpu].fail_exp);
+	}
 
-int test_sub_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    size_t i;
-    ul q = rand_ul();
-
-    for (i = 0; i < count; i++) {
-        *p1++ -= q;
-        *p2++ -= q;
-    }
-    return compare_regions(bufa, bufb, count);
+	return err;
 }
 
-int test_mul_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    size_t i;
-    ul q = rand_ul();
-
-    for (i = 0; i < count; i++) {
-        *p1++ *= q;
-        *p2++ *= q;
-    }
-    return compare_regions(bufa, bufb, count);
+/* Pattern generators for the individual tests */
+static void mt_get_stuck_address(struct mt_pattern *pat, unsigned int v)
+{
+	pat->type = MT_ADDR;
+	pat->a = (v & 1) ? ~0ULL : 0;
 }
 
-int test_div_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    size_t i;
-    ul q = rand_ul();
-
-    for (i = 0; i < count; i++) {
-        if (!q) {
-            q++;
-        }
-        *p1++ /= q;
-        *p2++ /= q;
-    }
-    return compare_regions(bufa, bufb, count);
+static void mt_get_random(struct mt_pattern *pat, unsigned int v)
+{
+	pat->type = MT_RAND;
+	pat->nops = v;
 }
 
-int test_or_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    size_t i;
-    ul q = rand_ul();
-
-    for (i = 0; i < count; i++) {
-        *p1++ |= q;
-        *p2++ |= q;
-    }
-    return compare_regions(bufa, bufb, count);
+static void mt_get_seqinc(struct mt_pattern *pat, unsigned int v)
+{
+	pat->type = MT_SEQ;
+	pat->a = mt_seed + v;
 }
 
-int test_and_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    size_t i;
-    ul q = rand_ul();
-
-    for (i = 0; i < count; i++) {
-        *p1++ &= q;
-        *p2++ &= q;
-    }
-    return compare_regions(bufa, bufb, count);
+static void mt_get_solidbits(struct mt_pattern *pat, unsigned int v)
+{
+	pat->type = MT_ALT;
+	pat->a = (v & 1) ? 0 : ~0ULL;
+	pat->b = ~pat->a;
 }
 
-int test_seqinc_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    size_t i;
-    ul q = rand_ul();
-
-    for (i = 0; i < count; i++) {
-        *p1++ = *p2++ = (i + q);
-    }
-    return compare_regions(bufa, bufb, count);
+static void mt_get_checkerboard(struct mt_pattern *pat, unsigned int v)
+{
+	pat->type = MT_ALT;
+	pat->a = (v & 1) ? CHECKERBOARD2 : CHECKERBOARD1;
+	pat->b = ~pat->a;
 }
 
-int test_solidbits_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    unsigned int j;
-    ul q;
-    size_t i;
-
-    out_test_start();
-    for (j = 0; j < 64; j++) {
-        q = (j % 2) == 0 ? UL_ONEBITS : 0;
-        out_test_setting(j);
-        p1 = (ulv *) bufa;
-        p2 = (ulv *) bufb;
-        for (i = 0; i < count; i++) {
-            *p1++ = *p2++ = (i % 2) == 0 ? q : ~q;
-        }
-        out_test_testing(j);
-        if (compare_regions(bufa, bufb, count)) {
-            return -1;
-        }
-    }
-    out_test_end();
-    return 0;
+static void mt_get_blockseq(struct mt_pattern *pat, unsigned int v)
+{
+	pat->type = MT_ALT;
+	pat->a = UL_BYTE((u64)v);
+	pat->b = pat->a;
 }
 
-int test_checkerboard_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    unsigned int j;
-    ul q;
-    size_t i;
-
-    out_test_start();
-    for (j = 0; j < 64; j++) {
-        q = (j % 2) == 0 ? CHECKERBOARD1 : CHECKERBOARD2;
-        out_test_setting(j);
-        p1 = (ulv *) bufa;
-        p2 = (ulv *) bufb;
-        for (i = 0; i < count; i++) {
-            *p1++ = *p2++ = (i % 2) == 0 ? q : ~q;
-        }
-        out_test_testing(j);
-        if (compare_regions(bufa, bufb, count)) {
-            return -1;
-        }
-    }
-    out_test_end();
-    return 0;
+/* Walk a bit up and back down again */
+static unsigned int mt_walk(unsigned int v)
+{
+	return (v < MT_BITS) ? v : 2 * MT_BITS - v - 1;
 }
 
-int test_blockseq_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    unsigned int j;
-    size_t i;
-
-    out_test_start();
-    for (j = 0; j < 256; j++) {
-        p1 = (ulv *) bufa;
-        p2 = (ulv *) bufb;
-        out_test_setting(j);
-        for (i = 0; i < count; i++) {
-            *p1++ = *p2++ = (ul) UL_BYTE(j);
-        }
-        out_test_testing(j);
-        if (compare_regions(bufa, bufb, count)) {
-            return -1;
-        }
-    }
-    out_test_end();
-    return 0;
+static void mt_get_walkbits1(struct mt_pattern *pat, unsigned int v)
+{
+	pat->type = MT_ALT;
+	pat->a = ~(1ULL << mt_walk(v));
+	pat->b = pat->a;
 }
 
-int test_walkbits0_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    unsigned int j;
-    size_t i;
-
-    out_test_start();
-    for (j = 0; j < UL_LEN * 2; j++) {
-        p1 = (ulv *) bufa;
-        p2 = (ulv *) bufb;
-        out_test_setting(j);
-        for (i = 0; i < count; i++) {
-            if (j < UL_LEN) { /* Walk it up. */
-                *p1++ = *p2++ = ONE << j;
-            } else { /* Walk it back down. */
-                *p1++ = *p2++ = ONE << (UL_LEN * 2 - j - 1);
-            }
-        }
-        out_test_testing(j);
-        if (compare_regions(bufa, bufb, count)) {
-            return -1;
-        }
-    }
-    out_test_end();
-    return 0;
+static void mt_get_walkbits0(struct mt_pattern *pat, unsigned int v)
+{
+	pat->type = MT_ALT;
+	pat->a = 1ULL << mt_walk(v);
+	pat->b = pat->a;
 }
 
-int test_walkbits1_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    unsigned int j;
-    size_t i;
-
-    out_test_start();
-    for (j = 0; j < UL_LEN * 2; j++) {
-        p1 = (ulv *) bufa;
-        p2 = (ulv *) bufb;
-        out_test_setting(j);
-        for (i = 0; i < count; i++) {
-            if (j < UL_LEN) { /* Walk it up. */
-                *p1++ = *p2++ = UL_ONEBITS ^ (ONE << j);
-            } else { /* Walk it back down. */
-                *p1++ = *p2++ = UL_ONEBITS ^ (ONE << (UL_LEN * 2 - j - 1));
-            }
-        }
-        out_test_testing(j);
-        if (compare_regions(bufa, bufb, count)) {
-            return -1;
-        }
-    }
-    out_test_end();
-    return 0;
-}
+static void mt_get_bitspread(struct mt_pattern *pat, unsigned int v)
+{
+	unsigned int bit = mt_walk(v);
 
-int test_bitspread_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    unsigned int j;
-    size_t i;
-
-    out_test_start();
-    for (j = 0; j < UL_LEN * 2; j++) {
-        p1 = (ulv *) bufa;
-        p2 = (ulv *) bufb;
-        out_test_setting(j);
-        for (i = 0; i < count; i++) {
-            if (j < UL_LEN) { /* Walk it up. */
-                *p1++ = *p2++ = (i % 2 == 0)
-                    ? (ONE << j) | (ONE << (j + 2))
-                    : UL_ONEBITS ^ ((ONE << j)
-                                    | (ONE << (j + 2)));
-            } else { /* Walk it back down. */
-                *p1++ = *p2++ = (i % 2 == 0)
-                    ? (ONE << (UL_LEN * 2 - 1 - j)) | (ONE << (UL_LEN * 2 + 1 - j))
-                    : UL_ONEBITS ^ (ONE << (UL_LEN * 2 - 1 - j)
-                                    | (ONE << (UL_LEN * 2 + 1 - j)));
-            }
-        }
-        out_test_testing(j);
-        if (compare_regions(bufa, bufb, count)) {
-            return -1;
-        }
-    }
-    out_test_end();
-    return 0;
+	pat->type = MT_ALT;
+	pat->a = (1ULL << bit) | ((bit + 2 < MT_BITS) ? 1ULL << (bit + 2) : 0);
+	pat->b = ~pat->a;
 }
 
-int test_bitflip_comparison(ulv *bufa, ulv *bufb, size_t count) {
-    ulv *p1 = bufa;
-    ulv *p2 = bufb;
-    unsigned int j, k;
-    ul q;
-    size_t i;
-
-    out_test_start();
-    for (k = 0; k < UL_LEN; k++) {
-        q = ONE << k;
-        for (j = 0; j < 8; j++) {
-            q = ~q;
-            out_test_setting(k * 8 + j);
-            p1 = (ulv *) bufa;
-            p2 = (ulv *) bufb;
-            for (i = 0; i < count; i++) {
-                *p1++ = *p2++ = (i % 2) == 0 ? q : ~q;
-            }
-            out_test_testing(k * 8 + j);
-            if (compare_regions(bufa, bufb, count)) {
-                return -1;
-            }
-        }
-    }
-    out_test_end();
-    return 0;
+static void mt_get_bitflip(struct mt_pattern *pat, unsigned int v)
+{
+	pat->type = MT_ALT;
+	pat->a = 1ULL << (v / 8);
+	if (!(v & 1))
+		pat->a = ~pat->a;
+	pat->b = ~pat->a;
 }
 
-
-struct test tests[] = {
-
-   // { "Ones", test_ones_comparison },
-    { "Random Value", test_random_value },
-    { "Compare XOR", test_xor_comparison },
-    { "Compare SUB", test_sub_comparison },
-    { "Compare MUL", test_mul_comparison },
-    { "Compare DIV",test_div_comparison },
-    { "Compare OR", test_or_comparison },
-    { "Compare AND", test_and_comparison },
-    { "Sequential Increment", test_seqinc_comparison },
-    { "Solid Bits", test_solidbits_comparison },
-    { "Block Sequential", test_blockseq_comparison },
-    { "Checkerboard", test_checkerboard_comparison },
-    { "Bit Spread", test_bitspread_comparison },
-    { "Bit Flip", test_bitflip_comparison },
-    { "Walking Ones", test_walkbits1_comparison },
-    { "Walking Zeroes", test_walkbits0_comparison },
-#ifdef TEST_NARROW_WRITES
-    { "8-bit Writes", test_8bit_wide_random },
-    { "16-bit Writes", test_16bit_wide_random },
-#endif
-    { NULL, NULL }
+static const struct mt_test mt_tests[] = {
+	{ "Stuck Address", 2, mt_get_stuck_address },
+	{ "Random + ALU Ops", MT_OP_COUNT + 1, mt_get_random },
+	{ "Sequential Increment", 1, mt_get_seqinc },
+	{ "Solid Bits", 2, mt_get_solidbits },
+	{ "Checkerboard", 2, mt_get_checkerboard },
+	{ "Block Sequential", 256, mt_get_blockseq },
+	{ "Walking Ones", 2 * MT_BITS, mt_get_walkbits1 },
+	{ "Walking Zeroes", 2 * MT_BITS, mt_get_walkbits0 },
+	{ "Bit Spread", 2 * MT_BITS, mt_get_bitspread },
+	{ "Bit Flip", 8 * MT_BITS, mt_get_bitflip },
 };
 
-void memtester(size_t dramStartAddress, size_t memsize)
+/*
+ * Run all tests on the given RAM region. If CONFIG_FS_SPL_MEMTEST_TIME is not
+ * 0, run in quick mode for factory testing: tests with many variants only
+ * use a few of them, spread over the whole range, and no further test is
+ * started after the given number of seconds.
+ */
+void memtester(size_t dramStartAddress, unsigned long memsize)
 {
-    ul i;
-    size_t halflen, count;
-    ulv *bufa, *bufb;
-    ul testmask = 0;
-	int exit_code = 0;
+	const struct mt_test *test;
+	struct mt_pattern prev, cur;
+	unsigned long limit = CONFIG_FS_SPL_MEMTEST_TIME * 1000UL;
+	unsigned long start, ms, total;
+	unsigned int v, step, passes;
+	u64 *base = (u64 *)dramStartAddress;
+	size_t count = (memsize / sizeof(u64)) & ~1UL;
+	u64 bytes;
+	int i, err = 0;
+	int cpus = min(cpu_parallel_count(), MT_MAX_CPUS);
 
 	srand(memsize);
-
-    printf("testing %ld bytes of memory\n", memsize);
-
-    halflen = memsize / 2;
-    count = halflen / sizeof(ul);
-    bufa = (ulv *)(dramStartAddress);
-    bufb = (ulv *)((size_t) dramStartAddress + halflen);
-
-    printf("bufa = %08lx, bufb = %08lx, count = %lx\n", (ul)bufa, (ul)bufb, count);
-
-    printf("\n  %-20s: ", "Stuck Address");
-    if (!test_stuck_address((ulv *)dramStartAddress, memsize / sizeof(ul))) {
-        printf("ok\r\n");
-    } else {
-        exit_code |= EXIT_FAIL_ADDRESSLINES;
-    }
-
-    for (i=0;;i++) {
-		if (exit_code || !tests[i].name)
+	mt_seed = ((u64)rand() << 32) | rand();
+	for (i = 0; i < MT_OP_COUNT; i++)
+		mt_q[i] = ((u64)rand() << 32) | rand();
+	if (!mt_q[MT_OP_DIV])
+		mt_q[MT_OP_DIV]++;
+
+	mt_split(base, count, cpus);
+
+	printf("testing %lu bytes of memory at 0x%08lx%s", memsize,
+	       (ulong)dramStartAddress, limit ? " (quick mode)" : "");
+	if (cpus > 1)
+		printf(" on %d CPUs", cpus);
+	puts("\n");
+
+	total = get_timer(0);
+	for (test = mt_tests; test < mt_tests + ARRAY_SIZE(mt_tests); test++) {
+		if (limit && (get_timer(total) >= limit)) {
+			printf("  Time limit reached, skipping remaining tests\n");
+			break;
+		}
+
+		step = 1;
+		if (limit && (test->variants > MT_QUICK_VARIANTS))
+			step = test->variants / MT_QUICK_VARIANTS;
+
+		printf("  %-20s: ", test->name);
+		start = get_timer(0);
+		bytes = 0;
+		passes = 0;
+		for (v = 0; v < test->variants; v += step) {
+			test->get(&cur, v);
+			err = mt_pass(cpus, passes ? &prev : NULL, &cur,
+				      test->name, v - step);
+			if (err)
+				break;
+			bytes += (passes ? 2 : 1) * count * sizeof(u64);
+			passes++;
+			prev = cur;
+		}
+		if (!err) {
+			/* Verify the last variant */
+			err = mt_pass(cpus, &prev, NULL, test->name, v - step);
+			bytes += count * sizeof(u64);
+			passes++;
+		}
+		if (err)
 			break;
-        /* clear buffer */
-        memset((void *) bufa, 255, memsize);
-        /* If using a custom testmask, only run this test if the
-        bit corresponding to this test was set by the user.
-        */
-        if (testmask && (!((1 << i) & testmask))) {
-            continue;
-        }
-        printf("  %-20s: ", tests[i].name);
-        if (!tests[i].fp(bufa, bufb, count))
-        {
-            printf("ok\n");
-        }
-        else
-        {
-            exit_code |= EXIT_FAIL_OTHERTEST;
-        }
-    }
-	if (exit_code)
-   		printf("\nDram Test FAILED.\n\n");
-	else 
-		printf("\nDram Test OK.\n\n");
-}
 
+		ms = get_timer(start);
+		printf("ok, %u passes, %llu MB/s\n", passes,
+		       ms ? bytes / 1000 / ms : 0);
+	}
 
+	ms = get_timer(total);
+	if (err)
+		printf("\nDram Test FAILED.\n\n");
+	else
+		printf("\nDram Test OK (%lu.%03lu s).\n\n", ms / 1000, ms % 1000);
+}
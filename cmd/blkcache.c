@@ -10,6 +10,12 @@
 #include <malloc.h>
 #include <part.h>
 
+/* Return part of all as percentage, or 0 if all is 0 */
+static unsigned blkc_percent(unsigned part, unsigned all)
+{
+	return all ? (unsigned)((u64)part * 100 / all) : 0;
+}
+
 static int blkc_show(struct cmd_tbl *cmdtp, int flag,
 		     int argc, char *const argv[])
 {
@@ -19,31 +25,73 @@ static int blkc_show(struct cmd_tbl *cmdtp, int flag,
 	printf("hits: %u\n"
 	       "misses: %u\n"
 	       "entries: %u\n"
-	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
-	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       "max cache entries: %u\n"
+	       "size: %u KiB\n"
+	       "read-ahead blocks: %u\n"
+	       "write-behind: %s\n",
+	       stats.hits, stats.misses, stats.entries, stats.max_entries,
+	       stats.size_kb, stats.readahead,
+	       stats.write_behind ? "on" : "off");
+	return 0;
+}
+
+static int blkc_stats(struct cmd_tbl *cmdtp, int flag,
+		      int argc, char *const argv[])
+{
+	struct block_cache_stats stats;
+	blkcache_stats(&stats);
+
+	printf("hits: %u (%u%%)\n"
+	       "misses: %u\n"
+	       "entries: %u of %u\n"
+	       "read-ahead: %u blocks, %u used (%u%%)\n"
+	       "evictions: %u\n"
+	       "dirty: %u\n"
+	       "write-backs: %u\n",
+	       stats.hits, blkc_percent(stats.hits, stats.hits + stats.misses),
+	       stats.misses, stats.entries, stats.max_entries,
+	       stats.ra_blocks, stats.ra_hits,
+	       blkc_percent(stats.ra_hits, stats.ra_blocks),
+	       stats.evictions, stats.dirty, stats.writebacks);
 	return 0;
 }
 
 static int blkc_configure(struct cmd_tbl *cmdtp, int flag,
 			  int argc, char *const argv[])
 {
-	unsigned blocks_per_entry, max_entries;
-	if (argc != 3)
+	struct block_cache_stats stats;
+	unsigned size_kb, readahead;
+	bool write_behind;
+
+	if (argc < 2 || argc > 4)
 		return CMD_RET_USAGE;
 
-	blocks_per_entry = simple_strtoul(argv[1], 0, 0);
-	max_entries = simple_strtoul(argv[2], 0, 0);
-	blkcache_configure(blocks_per_entry, max_entries);
-	printf("changed to max of %u entries of %u blocks each\n",
-	       max_entries, blocks_per_entry);
+	blkcache_stats(&stats);
+	size_kb = simple_strtoul(argv[1], 0, 0);
+	readahead = stats.readahead;
+	write_behind = stats.write_behind;
+	if (argc > 2)
+		readahead = simple_strtoul(argv[2], 0, 0);
+	if (argc > 3)
+		write_behind = simple_strtoul(argv[3], 0, 0) != 0;
+	if (blkcache_configure(size_kb, readahead, write_behind))
+		return CMD_RET_FAILURE;
+	printf("changed to %u KiB, %u blocks read-ahead, write-behind %s\n",
+	       size_kb, readahead, write_behind ? "on" : "off");
 	return 0;
 }
 
+static int blkc_flush(struct cmd_tbl *cmdtp, int flag,
+		      int argc, char *const argv[])
+{
+	return blkcache_flush() ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
+
 static struct cmd_tbl cmd_blkc_sub[] = {
 	U_BOOT_CMD_MKENT(show, 0, 0, blkc_show, "", ""),
-	U_BOOT_CMD_MKENT(configure, 3, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(stats, 0, 0, blkc_stats, "", ""),
+	U_BOOT_CMD_MKENT(configure, 4, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(flush, 0, 0, blkc_flush, "", ""),
 };
 
 static __maybe_unused void blkc_reloc(void)
@@ -80,8 +128,10 @@ static int do_blkcache(struct cmd_tbl *cmdtp, int flag,
 }
 
 U_BOOT_CMD(
-	blkcache, 4, 0, do_blkcache,
+	blkcache, 5, 0, do_blkcache,
 	"block cache diagnostics and control",
-	"show - show and reset statistics\n"
-	"blkcache configure blocks entries\n"
+	"show - show configuration, show and reset statistics\n"
+	"blkcache stats - show and reset hit rate and other statistics\n"
+	"blkcache configure size-KiB [readahead-blocks [write-behind]]\n"
+	"blkcache flush - write all delayed blocks to their devices\n"
 );
@@ -14,6 +14,7 @@
 #include <stdio_dev.h>			  /* stdio_dev, stdio_register(), ... */
 #include <linux/ctype.h>		  /* isdigit(), toupper() */
 #include <watchdog.h>			  /* WATCHDOG_RESET */
+#include <time.h>			  /* timer_get_us() */
 
 #if defined(CONFIG_XLCD_PNG) \
 	|| defined(CONFIG_XLCD_BMP) \
@@ -64,6 +65,7 @@ enum DRAW_INDEX {
 #endif
 #if CONFIG_XLCD_DRAW & XLCD_DRAW_BITMAP
 	DI_BITMAP,
+	DI_BMBENCH,
 #endif
 #if CONFIG_XLCD_DRAW & XLCD_DRAW_TURTLE
 	DI_TURTLE,
@@ -125,6 +127,7 @@ static kwinfo_t const draw_kw[] = {
 #endif
 #if CONFIG_XLCD_DRAW & XLCD_DRAW_BITMAP
 	[DI_BITMAP] = {3, 5, 1, 9, "bm"},     /* x1 y1 addr [n [attr]] */
+	[DI_BMBENCH] = {3, 5, 1, 9, "bmbench"}, /* x1 y1 addr [n [attr]] */
 #endif
 #if CONFIG_XLCD_DRAW & XLCD_DRAW_TURTLE
 	[DI_TURTLE] = {3, 4, 1, 3, "turtle"}, /* x1 y1 s [rgba] */
@@ -1132,10 +1135,40 @@ void lcd_fill(const wininfo_t *pwi, const colinfo_t *pci)
 
 
 #if CONFIG_XLCD_DRAW & XLCD_DRAW_PROG
-/* Draw progress bar; pwi->attr is either 0 or ATTR_ALPHA */
+/* Redraw the columns xa..xb of the progress bar, left of x in FG color and
+   from x on in BG color */
+static void lcd_progbar_span(wininfo_t *pwi, XYPOS xa, XYPOS xb, XYPOS x)
+{
+	XYPOS y1 = pwi->pbi.y1;
+	XYPOS y2 = pwi->pbi.y2;
+
+	if (xa < pwi->pbi.x1)
+		xa = pwi->pbi.x1;
+	if (xb > pwi->pbi.x2)
+		xb = pwi->pbi.x2;
+	if (xa > xb)
+		return;
+
+	if (xa < x) {
+		/* Draw progress bar in FG color */
+		lcd_rect(pwi, xa, y1, (xb < x) ? xb : x-1, y2,
+			 &pwi->pbi.rect_fg);
+	}
+	if (xb >= x) {
+		/* Draw remaining part of rectangle with BG color */
+		lcd_rect(pwi, (xa > x) ? xa : x, y1, xb, y2,
+			 &pwi->pbi.rect_bg);
+	}
+	lcd_dirty(pwi, xa, y1, xb, y2);
+}
+
+/* Draw progress bar; pwi->attr is either 0 or ATTR_ALPHA. If the bar was
+   drawn before, only the part between the old and the new end of the bar and
+   the area of the old percentage text are redrawn. */
 static void lcd_progbar(wininfo_t *pwi)
 {
-	XYPOS x1, y1, x2, y2, x;
+	XYPOS x1, y1, x2, y2, x, xlast;
+	XYPOS width, height;
 	u_int attr;
 
 	x1 = pwi->pbi.x1;
@@ -1143,17 +1176,48 @@ static void lcd_progbar(wininfo_t *pwi)
 	x2 = pwi->pbi.x2;
 	y2 = pwi->pbi.y2;
 	x = ((x2 - x1 + 1) * pwi->pbi.prog + 50) / 100 + x1;
-	if (x > x1) {
-		/* Draw progress bar in FG color */
-		lcd_rect(pwi, x1, y1, x-1, y2, &pwi->pbi.rect_fg);
-	}
-	if (x <= x2) {
-		/* Draw remaining part of rectangle with BG color */
-		lcd_rect(pwi, x, y1, x2, y2, &pwi->pbi.rect_bg);
+	attr = pwi->pbi.attr;
+
+	/* Size of the percentage text, at most four characters ("100%") */
+	width = VIDEO_FONT_WIDTH * (((attr & ATTR_HS_MASK) >> 4) + 1);
+	height = VIDEO_FONT_HEIGHT * (((attr & ATTR_VS_MASK) >> 6) + 1);
+
+	xlast = pwi->pbi.xlast;
+	if (xlast < 0) {
+		/* Draw the whole bar */
+		lcd_progbar_span(pwi, x1, x2, x);
+	} else {
+		/* Draw only the part that changed */
+		if (x < xlast)
+			lcd_progbar_span(pwi, x, xlast - 1, x);
+		else if (x > xlast)
+			lcd_progbar_span(pwi, xlast, x - 1, x);
+
+		/* Remove old text; it may be drawn without background */
+		if ((attr & ATTR_VMASK) != ATTR_NO_TEXT) {
+			switch (attr & ATTR_HMASK) {
+			case ATTR_HLEFT:
+				lcd_progbar_span(pwi, x1, x1 + 4*width - 1, x);
+				break;
+
+			case ATTR_HCENTER:
+				lcd_progbar_span(pwi, (x1 + x2)/2 - 2*width,
+						 (x1 + x2)/2 + 2*width, x);
+				break;
+
+			case ATTR_HRIGHT:
+				lcd_progbar_span(pwi, x2 - 4*width + 1, x2, x);
+				break;
+
+			case ATTR_HFOLLOW:
+				lcd_progbar_span(pwi, xlast + 2,
+						 xlast + 1 + 4*width, x);
+				break;
+			}
+		}
 	}
 
 	/* Draw percentage unless attribute ATTR_NO_TEXT is set */
-	attr = pwi->pbi.attr;
 	if ((attr & ATTR_VMASK) != ATTR_NO_TEXT) {
 		char s[5];		  /* "0%" .. "100%" */
 
@@ -1190,10 +1254,15 @@ static void lcd_progbar(wininfo_t *pwi)
 		}
 		pwi->attr |= attr;	  /* Add text attributes */
 
-		/* Draw percentage text */
+		/* Draw percentage text; the text may reach beyond the bar */
 		sprintf(s, "%d%%", pwi->pbi.prog);
 		lcd_text(pwi, x1, y1, s, &pwi->pbi.text_fg, &pwi->pbi.text_bg);
+		lcd_dirty(pwi, x1 - 4*width, y1 - height, x1 + 4*width,
+			  y1 + height);
 	}
+
+	/* Remember end of bar; lcd_dirty() has reset it as we drew over it */
+	pwi->pbi.xlast = x;
 }
 #endif /* CONFIG_XLCD_DRAW & XLCD_DRAW_PROG */
 
@@ -1346,7 +1415,7 @@ const char *lcd_bitmap(const wininfo_t *pwi, XYPOS x, XYPOS y, u_long addr)
 	ymax = pwi->clip_bottom + 1;
 
 	/* Return if image is completely outside of framebuffer */
-	if ((x >= xmax) || (x+hres <= xmin) || (y >= xmax) || (y+vres <= xmin))
+	if ((x >= xmax) || (x+hres <= xmin) || (y >= ymax) || (y+vres <= ymin))
 		return NULL;
 
 	/* Compute end pixel in this row */
@@ -1911,6 +1980,7 @@ static int do_draw(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 	case DI_PIXEL:			  /* Draw pixel */
 		lcd_set_fg(pwi, rgba1);
 		lcd_pixel(pwi, x1, y1, &pwi->fg);
+		lcd_dirty(pwi, x1, y1, x1, y1);
 		break;
 #endif
 
@@ -1918,6 +1988,8 @@ static int do_draw(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 	case DI_LINE:			  /* Draw line */
 		lcd_set_fg(pwi, rgba1);
 		lcd_line(pwi, x1, y1, x2, y2, &pwi->fg);
+		lcd_dirty(pwi, (x1 < x2) ? x1 : x2, (y1 < y2) ? y1 : y2,
+			  (x1 < x2) ? x2 : x1, (y1 < y2) ? y2 : y1);
 		break;
 #endif
 
@@ -1925,6 +1997,7 @@ static int do_draw(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 	case DI_RECT:			  /* Draw filled rectangle */
 	case DI_FRAME:			  /* Draw rectangle outline */
 		lcd_set_fg(pwi, rgba1);
+		lcd_dirty(pwi, x1, y1, x2, y2);
 		if (sc == DI_RECT) {
 			lcd_rect(pwi, x1, y1, x2, y2, &pwi->fg);
 			if ((argc < 8) || (rgba1 == rgba2))
@@ -1942,6 +2015,7 @@ static int do_draw(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 
 		r = (XYPOS)simple_strtol(argv[6], NULL, 0); /* Parse radius */
 		lcd_set_fg(pwi, rgba1);
+		lcd_dirty(pwi, x1, y1, x2, y2);
 		if (sc == DI_RRECT) {
 			lcd_rrect(pwi, x1, y1, x2, y2, r, &pwi->fg);
 			if ((argc < 9) || (rgba1 == rgba2))
@@ -1958,6 +2032,7 @@ static int do_draw(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 
 		r = (XYPOS)simple_strtol(argv[4], NULL, 0); /* Parse radius */
 		lcd_set_fg(pwi, rgba1);
+		lcd_dirty(pwi, x1-r, y1-r, x1+r, y1+r);
 		if (sc == DI_DISC) {
 			lcd_rrect(pwi, x1-r, y1-r, x1+r, y1+r, r, &pwi->fg);
 			if ((argc < 7) || (rgba1 == rgba2))
@@ -1972,6 +2047,7 @@ static int do_draw(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 #if CONFIG_XLCD_DRAW & XLCD_DRAW_TEXT
 	case DI_TEXT: {			  /* Draw text */
 		u_int a;
+		XYPOS w, h;
 
 		lcd_set_fg(pwi, rgba1);
 		lcd_set_bg(pwi, rgba2);
@@ -1984,6 +2060,12 @@ static int do_draw(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 			a = pwi->text_attr;
 		pwi->attr |= a;
 		lcd_text(pwi, x1, y1, argv[4], &pwi->fg, &pwi->bg);
+
+		/* Mark the area for any alignment as dirty */
+		w = (XYPOS)strlen(argv[4]) * VIDEO_FONT_WIDTH
+			* (((a & ATTR_HS_MASK) >> 4) + 1);
+		h = VIDEO_FONT_HEIGHT * (((a & ATTR_VS_MASK) >> 6) + 1);
+		lcd_dirty(pwi, x1 - w, y1 - h, x1 + w, y1 + h);
 		break;
 	}
 #endif
@@ -2018,12 +2100,49 @@ static int do_draw(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 		a = (argc > 6) ? simple_strtoul(argv[6], NULL, 0) : 0;
 		pwi->attr |= a;
 		errmsg = lcd_bitmap(pwi, x1, y1, addr);
+		lcd_dirty(pwi, pwi->clip_left, pwi->clip_top,
+			  pwi->clip_right, pwi->clip_bottom);
 		if (errmsg) {
 			puts(errmsg);
 			return 1;
 		}
 		break;
 	}
+
+	case DI_BMBENCH: {		  /* Measure bitmap drawing time */
+		u_int addr;
+		u_int count;
+		u_int i;
+		u_long us;
+		const char *errmsg = NULL;
+
+		/* Argument 3: address */
+		addr = simple_strtoul(argv[4], NULL, 16);
+
+		/* Optional argument 4: number of frames to draw */
+		count = (argc > 5) ? simple_strtoul(argv[5], NULL, 0) : 10;
+		if (!count)
+			count = 1;
+
+		/* Optional argument 5: attribute */
+		if (argc > 6)
+			pwi->attr |= simple_strtoul(argv[6], NULL, 0);
+
+		us = timer_get_us();
+		for (i = 0; (i < count) && !errmsg; i++)
+			errmsg = lcd_bitmap(pwi, x1, y1, addr);
+		us = timer_get_us() - us;
+		lcd_dirty(pwi, pwi->clip_left, pwi->clip_top,
+			  pwi->clip_right, pwi->clip_bottom);
+		if (errmsg) {
+			puts(errmsg);
+			return 1;
+		}
+		us /= count;
+		printf("%u frames, %lu.%03lu ms per frame\n", count,
+		       us / 1000, us % 1000);
+		break;
+	}
 #endif
 
 #if CONFIG_XLCD_DRAW & XLCD_DRAW_TURTLE
@@ -2031,6 +2150,8 @@ static int do_draw(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 		lcd_set_fg(pwi, rgba1);
 		if (lcd_turtle(pwi, &x1, &y1, argv[4], 0) < 0)
 			puts(" in argument string\n");
+		lcd_dirty(pwi, pwi->clip_left, pwi->clip_top,
+			  pwi->clip_right, pwi->clip_bottom);
 		break;
 #endif
 
@@ -2038,6 +2159,8 @@ static int do_draw(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 	case DI_FILL:			  /* Fill window with FG color */
 		lcd_set_fg(pwi, rgba1);
 		lcd_fill(pwi, &pwi->fg);
+		lcd_dirty(pwi, pwi->clip_left, pwi->clip_top,
+			  pwi->clip_right, pwi->clip_bottom);
 		break;
 
 	case DI_CLEAR:			  /* Fill window with BG color */
@@ -2045,6 +2168,8 @@ static int do_draw(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 		    return 1;
 		lcd_set_bg(pwi, rgba2);
 		lcd_fill(pwi, &pwi->bg);
+		lcd_dirty(pwi, pwi->clip_left, pwi->clip_top,
+			  pwi->clip_right, pwi->clip_bottom);
 		break;
 #endif
 
@@ -2056,6 +2181,7 @@ static int do_draw(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 		pwi->pbi.y2 = y2;
 		lcd_set_col(pwi, rgba1, &pwi->pbi.rect_fg);
 		lcd_set_col(pwi, rgba2, &pwi->pbi.rect_bg);
+		pwi->pbi.xlast = -1;
 		break;
 
 	case DI_PBT: {			  /* Define progress bar text params */
@@ -2066,6 +2192,7 @@ static int do_draw(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 		pwi->pbi.attr = a;
 		lcd_set_col(pwi, rgba1, &pwi->pbi.text_fg);
 		lcd_set_col(pwi, rgba2, &pwi->pbi.text_bg);
+		pwi->pbi.xlast = -1;
 		break;
 	}
 
@@ -2106,6 +2233,8 @@ static int do_draw(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 			printf("Window too small\n");
 			return 1;
 		}
+		lcd_dirty(pwi, pwi->clip_left, pwi->clip_top,
+			  pwi->clip_right, pwi->clip_bottom);
 		break;
 	}
 #endif
@@ -2135,6 +2264,10 @@ static int do_draw(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 		return 1;
 	}
 
+	/* Copy the drawn region to the shown buffer if requested */
+	if (pwi->fbflush)
+		lcd_flush(pwi);
+
 	return 0;
 }
 
@@ -2176,6 +2309,8 @@ U_BOOT_CMD(
 #if CONFIG_XLCD_DRAW & XLCD_DRAW_BITMAP
 	"draw bitmap x y addr [n [a]]\n"
 	"    - draw bitmap n from addr at (x, y) with attribute a\n"
+	"draw bmbench x y addr [count [a]]\n"
+	"    - draw bitmap count times and show time per frame\n"
 #endif
 #if CONFIG_XLCD_DRAW & XLCD_DRAW_TURTLE
 	"draw turtle x y string [#rgba]\n"
@@ -52,14 +52,38 @@ U_BOOT_CMD(
 static int do_fat_ls(struct cmd_tbl *cmdtp, int flag, int argc,
 		     char *const argv[])
 {
+#ifdef CONFIG_FAT_FUS
+	/* Option -v also shows the number of extents (fragments) per file */
+	if ((argc > 1) && !strcmp(argv[1], "-v")) {
+		int ret;
+
+		argc--;
+		argv++;
+		if ((argc < 2) || (argc > 4))
+			return CMD_RET_USAGE;
+		if (fs_set_blk_dev(argv[1], (argc >= 3) ? argv[2] : NULL,
+				   FS_TYPE_FAT))
+			return 1;
+		ret = file_fat_ls_verbose((argc >= 4) ? argv[3] : "/", 1);
+		fs_close();
+
+		return ret ? 1 : 0;
+	}
+#endif
 	return do_ls(cmdtp, flag, argc, argv, FS_TYPE_FAT);
 }
 
 U_BOOT_CMD(
-	fatls,	4,	1,	do_fat_ls,
+	fatls,	5,	1,	do_fat_ls,
 	"list files in a directory (default /)",
+#ifdef CONFIG_FAT_FUS
+	"[-v] <interface> [<dev[:part]>] [directory]\n"
+	"    - list files from 'dev' on 'interface' in a 'directory'\n"
+	"      -v: also show number of extents (fragments) of each file"
+#else
 	"<interface> [<dev[:part]>] [directory]\n"
 	"    - list files from 'dev' on 'interface' in a 'directory'"
+#endif
 );
 
 static int do_fat_fsinfo(struct cmd_tbl *cmdtp, int flag, int argc,
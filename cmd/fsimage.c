@@ -145,25 +145,17 @@
 #include <jffs2/jffs2.h>		/* struct mtd_device + part_info */
 #include <fuse.h>			/* fuse_read() */
 #include <image.h>			/* parse_loadaddr() */
+#include <memalign.h>			/* malloc_cache_aligned() */
 #include <u-boot/crc.h>			/* crc32() */
 
 #include "../board/F+S/common/fs_board_common.h"	/* fs_board_*() */
 #include "../board/F+S/common/fs_image_common.h"	/* fs_image_*() */
+#include "fsimage_load.h"				/* fs_image_load_*() */
 
 #include <asm/mach-imx/hab.h>
 #include <asm/mach-imx/checkboot.h>
 #include <asm/mach-imx/imx-nandbcb.h>
 
-/* Structure to hold regions in NAND/eMMC for an image, taken from nboot-info */
-struct storage_info {
-	unsigned int start[2];			/* *-start entries */
-	unsigned int size;		/* *-size entry */
-#ifdef CONFIG_CMD_MMC
-	u8 hwpart[2];			/* hwpart (in case of eMMC) */
-#endif
-	const char *type;		/* Name of storage region */
-};
-
 /* Storage info from the nboot-info of a BOARD-CFG in binary form */
 #define NI_SUPPORT_CRC32       BIT(0)	/* Support CRC32 in F&S headers */
 #define NI_SAVE_BOARD_ID       BIT(1)	/* Save the board-rev. in BOARD-CFG */
@@ -182,83 +174,12 @@ struct nboot_info {
 	struct storage_info env;
 };
 
-#define SUB_SYNC          BIT(0)	/* After writing image, flush temp */
-#define SUB_HAS_FS_HEADER BIT(1)	/* Image has an F&S header in flash */
-#define SUB_IS_SPL        BIT(2)	/* SPL: has IVT, may beed offset */
-#define SUB_IS_ENV        BIT(3)	/* Environment data */
-#ifdef CONFIG_NAND_MXS
-#define SUB_IS_FCB        BIT(4)	/* FCB: needs other ECC */
-#define SUB_IS_DBBT       BIT(5)
-#define SUB_IS_DBBT_DATA  BIT(6)
-#endif
-struct sub_info {
-	void *img;			/* Pointer to image */
-	const char *type;		/* "BOARD-CFG", "FIRMWARE", "SPL" */
-	const char *descr;		/* e.g. board architecture */
-	unsigned int size;		/* Size of image */
-	unsigned int offset;		/* Offset of image within si */
-	unsigned int flags;		/* See SUB_* above */
-};
-
 struct region_info {
 	struct storage_info *si;	/* Region information */
 	struct sub_info *sub;		/* Pointer to subimages */
 	int count;			/* Number of subimages */
 };
 
-/* Access functions that differ between NAND and MMC */
-struct flash_info;
-struct flash_ops {
-	bool (*check_for_uboot)(struct storage_info *si, bool force);
-	bool (*check_for_nboot)(struct flash_info *fi, struct storage_info *si,
-				bool force);
-	int (*get_nboot_info)(struct flash_info *fi, void *fdt, int offs,
-			      struct nboot_info *ni, int hwpart, bool show);
-	bool (*si_differs)(const struct storage_info *si1,
-			   const struct storage_info *si2);
-	int (*read)(struct flash_info *fi, uint offs, uint size, uint lim,
-		    uint flags, u8 *buf);
-	int (*load_image)(struct flash_info *fi, int copy,
-			  const struct storage_info *si, struct sub_info *sub);
-	int (*load_extra)(struct flash_info *fi, struct storage_info *spl,
-			  void *tempaddr);
-	int (*invalidate)(struct flash_info *fi, int copy,
-			  const struct storage_info *si);
-	int (*write)(struct flash_info *fi, uint offs, uint size, uint lim,
-		     uint flags, u8 *buf);
-	int (*prepare_region)(struct flash_info *fi, int copy,
-			      struct storage_info *si);
-	int (*save_nboot)(struct flash_info *fi, struct region_info *nboot_ri,
-			  struct region_info *spl_ri);
-	int (*set_boot_hwpart)(struct flash_info *fi, int boot_hwpart);
-	void (*get_flash)(struct flash_info *fi);
-	void (*put_flash)(struct flash_info *fi);
-};
-
-struct flash_info {
-#ifdef CONFIG_NAND_MXS
-	struct mtd_info *mtd;		/* Handle to NAND */
-	unsigned int env_used;		/* From env-size entry, region size
-					   is from env-range */
-#endif
-#ifdef CONFIG_CMD_MMC
-	struct mmc *mmc;		/* Handle to MMC device */
-	struct blk_desc *blk_desc;	/* Handle to MMC block device */
-	u8 boot_hwpart;			/* HW partition we boot from (0..2) */
-	u8 old_hwpart;			/* Previous partition before command */
-#endif
-	char devname[6];		/* Name of device (NAND, mmc<n>) */
-	u8 *temp;			/* Buffer for one NAND page/MMC block */
-	unsigned int temp_size;		/* Size of temp buffer */
-	unsigned int base_offs;		/* Offset where temp will be written */
-	unsigned int write_pos;		/* temp contains data up to this pos */
-	unsigned int bb_extra_offs;	/* Extra offset due to bad blocks */
-	u8 temp_fill;			/* Default value for temp buffer */
-	enum boot_device boot_dev;	/* Device to boot from */
-	const char *boot_dev_name;	/* Boot device as string */
-	struct flash_ops *ops;		/* Access functions for NAND/MMC */
-};
-
 /* Info table for secondary SPL (MMC) */
 struct info_table {
 	u32 chip_num;			/* unused, set to 0 */
@@ -268,16 +189,18 @@ struct info_table {
 	u32 sector_count;		/* unused, set to 0 */
 };
 
-/* Struct that is big enough for all headers that we may want to load */
-union any_header {
-	struct fs_header_v1_0 fsh;
-	u8 ivt[HAB_HEADER];
-	struct fdt_header fdt;
-};
-
 /* Argument of option -e in fsimage save */
 static unsigned int early_support_index;
 
+/* Option -v in fsimage save: read back and compare each copy after writing */
+static bool save_verify;
+
+/* Option -t in fsimage load: show timing and statistics for each copy */
+static bool load_stats;
+
+/* Size of the read-back buffer when verifying; multiple of any page/block */
+#define VERIFY_CHUNK_SIZE 0x10000
+
 /* ------------- Common helper function ------------------------------------ */
 
 /* Build lowercase nboot-info property name from upper-case region name */
@@ -600,6 +523,29 @@ static void fs_image_show_sub_status(int err)
 	}
 }
 
+/* Show the number of bytes handled in given time and the resulting rate */
+static void fs_image_show_rate(const char *action, unsigned int size,
+			       ulong time)
+{
+	printf("  %s 0x%x bytes in %lu ms", action, size, time);
+	if (time > 0) {
+		puts(", ");
+		print_size((u64)(size / time) * 1000, "/s");
+	}
+	puts("\n");
+}
+
+/* Show timing and read statistics after loading a copy of a sub-image */
+static void fs_image_show_load_stats(struct flash_info *fi, ulong time)
+{
+	if (!load_stats)
+		return;
+
+	fs_image_show_rate("Read", fi->stat_read, time);
+	printf("  Copied 0x%x bytes from temp buffer, %u refills\n",
+	       fi->stat_copied, fi->stat_fills);
+}
+
 /* Show status after saving an image and return CMD_RET code */
 static int fs_image_show_save_status(int failed, const char *type)
 {
@@ -842,78 +788,6 @@ static int fs_image_validate(struct fs_header_v1_0 *fsh, const char *type,
 	return 0;
 }
 
-/* Get the full size of a FIT image, including all external images */
-static int fs_image_get_size_from_fit(struct sub_info *sub, uint *size)
-{
-	void *fit = sub->img;
-	unsigned int fit_size = ALIGN(fit_get_size(fit), 4);
-	int images;
-	int node;
-	int offs;
-	int img_size;
-	unsigned int maxsize = fit_size;
-	const void *dummy_data;
-	size_t dummy_size;
-	int err;
-
-	images = fdt_path_offset(fit, FIT_IMAGES_PATH);
-	if (images < 0)
-		return -ENOENT;
-
-	/* Parse all images to find the last one (with highest offset) */
-	fdt_for_each_subnode(node, fit, images) {
-		/* If image data is embedded, this will not increase size */
-		if (!fit_image_get_data(fit, node, &dummy_data, &dummy_size))
-			continue;
-		/*
-		 * If image data is external (given by data_position or
-		 * data_offset, look for end of image data and keep highest
-		 * value.
-		 */
-		if (fit_image_get_data_position(fit, node, &offs)) {
-			if (fit_image_get_data_offset(fit, node, &offs))
-				return -ENOENT;
-			offs += fit_size;
-		}
-		err =  fit_image_get_data_size(fit, node, &img_size);
-		if (err < 0)
-			return -ENOENT;
-		img_size = ALIGN(img_size, 4);
-		offs += img_size;
-		if ((unsigned int)offs > maxsize)
-			maxsize = (unsigned int)offs;
-	}
-
-	*size = maxsize;
-
-	return 0;
-}
-
-/* Get image length from F&S header or IVT (SPL, signed U-Boot) */
-static int fs_image_get_size_from_fsh_or_ivt(struct sub_info *sub, uint *size)
-{
-	if (fs_image_is_fs_image(sub->img)) {
-		struct fs_header_v1_0 *fsh = sub->img;
-
-		/* Check image type and get image size from F&S header */
-		if (!fs_image_match(fsh, sub->type, sub->descr))
-			return -ENOENT;
-		*size = fs_image_get_size(fsh, true);
-	} else {
-		struct ivt *ivt = sub->img;
-		struct boot_data *boot_data;
-
-		/* Get image size from IVT/boot_data */
-		if ((ivt->hdr.magic != IVT_HEADER_MAGIC)
-		    || (ivt->boot != ivt->self + IVT_TOTAL_LENGTH))
-			return -ENOENT;
-		boot_data = (struct boot_data *)(ivt + 1);
-		*size = boot_data->length;
-	}
-
-	return 0;
-}
-
 /*
  * Get pointer to BOARD-CFG image that is to be used and to NBOOT part
  * Returns: <0: error; 0: aborted by user; 1: same ID; 2: new ID
@@ -1055,105 +929,6 @@ static unsigned long fs_image_get_loadaddr(int argc, char * const argv[],
 	return 0;
 }
 
-/* Invalidate the temp buffer read cache */
-static void fs_image_drop_temp(struct flash_info *fi)
-{
-	fi->write_pos = 0;
-	fi->bb_extra_offs = 0;
-	memset(fi->temp, fi->temp_fill, fi->temp_size);
-}
-
-static int fs_image_fill_temp(struct flash_info *fi, uint base_offs, uint lim,
-			      uint flags)
-{
-	int err;
-
-	fi->write_pos = 0;
-
-	debug("  - Fill temp from offs 0x%x\n", base_offs);
-	err = fi->ops->read(fi, base_offs, fi->temp_size, lim, flags, fi->temp);
-	if (err)
-		return err;
-
-	fi->base_offs = base_offs;
-	fi->write_pos = fi->temp_size;
-
-	return 0;
-}
-
-static int fs_image_load_sub(struct flash_info *fi, uint offs, uint size,
-			     uint lim, uint flags, u8 *buf)
-{
-	int err;
-	unsigned int read_pos;
-	unsigned int base_offs;
-	unsigned int chunk_size;
-	unsigned int chunk_mask = fi->temp_size - 1;
-	unsigned int remaining = size;
-
-	/*
-	 * Step 1: If reading starts in the middle of a page/block and we do
-	 * not have this page/block cached in the temp buffer yet, load the
-	 * page/block to the temp buffer.
-	 */
-	base_offs = offs & ~chunk_mask;
-	read_pos = offs & chunk_mask;
-	if ((read_pos) && (!fi->write_pos || (base_offs != fi->base_offs))) {
-		err = fs_image_fill_temp(fi, base_offs, lim, flags);
-		if (err)
-			return err;
-	}
-
-	/*
-	 * Step 2: If the start of the data is already cached in the
-	 * temp/buffer, take it from there.
-	 */
-	if (fi->write_pos && (base_offs == fi->base_offs)) {
-		chunk_size = fi->temp_size - read_pos;
-		if (chunk_size > remaining)
-			chunk_size = remaining;
-		debug("  - Copy leading bytes from temp pos 0x%x size 0x%x"
-		      " to 0x%lx\n", read_pos, chunk_size, (ulong)buf);
-		memcpy(buf, fi->temp + read_pos, chunk_size);
-		buf += chunk_size;
-		offs += chunk_size;
-		remaining -= chunk_size;
-	}
-
-	/*
-	 * Step 3: Read the middle part consisting of full pages/blocks.
-	 */
-	chunk_size = remaining & ~chunk_mask;
-	if (chunk_size) {
-		debug("  - Read from offs 0x%x lim 0x%x size 0x%x to 0x%lx\n",
-		      offs, lim, chunk_size, (ulong)buf);
-		err = fi->ops->read(fi, offs, chunk_size, lim, flags, buf);
-		if (err)
-			return err;
-		buf += chunk_size;
-		offs += chunk_size;
-		remaining -= chunk_size;
-	}
-
-	/*
-	 * Step 4: Read the last page/block, from which we only need a part
-	 * of, to the temp buffer and take the remaining bytes from there.
-	 */
-	if (remaining) {
-		base_offs = offs & ~chunk_mask;
-		err = fs_image_fill_temp(fi, base_offs, lim, flags);
-		if (err)
-			return err;
-
-		read_pos = offs & chunk_mask;
-		debug("  - Copy trailing bytes from temp pos 0x%x size 0x%x to"
-		      " 0x%lx\n", read_pos, remaining, (ulong)buf);
-		memcpy(buf, fi->temp + read_pos, remaining);
-	}
-
-	return 0;
-}
-
 static int fs_image_load_image(struct flash_info *fi,
 			       const struct storage_info *si,
 			       struct sub_info *sub)
@@ -1162,6 +937,7 @@ static int fs_image_load_image(struct flash_info *fi,
 	void *copy0, *copy1;
 	unsigned int size0 = 0;
 	int err;
+	ulong start;
 
 	printf("Loading %s from %s\n", sub->type, fi->devname);
 
@@ -1172,15 +948,21 @@ static int fs_image_load_image(struct flash_info *fi,
 
 	/* Load first copy; on error, sub->size is 0, i.e. copy1 == copy0 */
 	copy0 = sub->img;
+	fs_image_clear_stats(fi);
+	start = get_timer(0);
 	err = fi->ops->load_image(fi, 0, si, sub);
 	fs_image_show_sub_status(err);
+	fs_image_show_load_stats(fi, get_timer(start));
 	size0 = sub->size;
 	sub->img += size0;
 
 	/* Load second copy; this overwrites first copy if it had an error */
 	copy1 = sub->img;
+	fs_image_clear_stats(fi);
+	start = get_timer(0);
 	err = fi->ops->load_image(fi, 1, si, sub);
 	fs_image_show_sub_status(err);
+	fs_image_show_load_stats(fi, get_timer(start));
 	if (err && (copy0 == copy1)) {
 		printf("  Error, cannot load %s\n", sub->type);
 		return -ENOENT;
@@ -1400,6 +1182,84 @@ static int fs_image_save_sub(struct flash_info *fi, uint offs, uint size,
 	return 0;
 }
 
+/* Read back one sub-image from flash and compare it with the data in RAM */
+static int fs_image_verify_sub(struct flash_info *fi, uint offs, uint size,
+			       uint lim, uint flags, u8 *buf, u8 *vbuf)
+{
+	int err;
+	unsigned int read_pos;
+	unsigned int base_offs;
+	unsigned int chunk_size;
+	unsigned int read_size;
+	unsigned int chunk_mask = fi->temp_size - 1;
+
+	base_offs = offs & ~chunk_mask;
+	read_pos = offs & chunk_mask;
+	while (size) {
+		chunk_size = VERIFY_CHUNK_SIZE - read_pos;
+		if (chunk_size > size)
+			chunk_size = size;
+		read_size = ALIGN(read_pos + chunk_size, fi->temp_size);
+		if (read_size > lim - base_offs)
+			read_size = lim - base_offs;
+
+		debug("  - Verify offs 0x%x size 0x%x against 0x%lx\n",
+		      base_offs + read_pos, chunk_size, (ulong)buf);
+		err = fi->ops->read(fi, base_offs, read_size, lim, flags, vbuf);
+		if (err)
+			return err;
+		if (memcmp(vbuf + read_pos, buf, chunk_size)) {
+			printf(" MISMATCH near offset 0x%x",
+			       base_offs + read_pos);
+			return -EILSEQ;
+		}
+		buf += chunk_size;
+		size -= chunk_size;
+		base_offs += read_pos + chunk_size;
+		read_pos = 0;
+	}
+
+	return 0;
+}
+
+/* Read back a complete region copy and compare it with the data in RAM */
+static int fs_image_verify_region(struct flash_info *fi, int copy,
+				  struct region_info *ri)
+{
+	u8 *vbuf;
+	int err = 0;
+	struct sub_info *s;
+	struct storage_info *si = ri->si;
+	unsigned int lim = si->start[copy] + si->size;
+	unsigned int total = 0;
+	ulong start;
+
+	vbuf = malloc_cache_aligned(VERIFY_CHUNK_SIZE);
+	if (!vbuf) {
+		puts("  Cannot allocate verify buffer\n");
+		return -ENOMEM;
+	}
+
+	start = get_timer(0);
+	fi->bb_extra_offs = 0;
+	for (s = ri->sub; s < ri->sub + ri->count; s++) {
+		printf("  Verifying %s at offset 0x%08x size 0x%x...", s->type,
+		       si->start[copy] + s->offset, s->size);
+		err = fs_image_verify_sub(fi, si->start[copy] + s->offset,
+					  s->size, lim, s->flags, s->img, vbuf);
+		fs_image_show_sub_status(err);
+		if (err)
+			break;
+		total += s->size;
+	}
+	if (!err)
+		fs_image_show_rate("Verified", total, get_timer(start));
+
+	free(vbuf);
+
+	return err;
+}
+
 /* Save the given region to flash */
 static int fs_image_save_region(struct flash_info *fi, int copy,
 				struct region_info *ri)
@@ -1411,15 +1271,20 @@ static int fs_image_save_region(struct flash_info *fi, int copy,
 	unsigned int lim = si->start[copy] + si->size;
 	unsigned int offset;
 	unsigned int size;
+	unsigned int total;
 	unsigned int temp_size = fi->temp_size;
 	bool pass2;
 	const char *action;
+	ulong start;
 
 	err = fi->ops->prepare_region(fi, copy, si);
 	if (err)
 		return err;
 
 repeat:
+	start = get_timer(0);
+	total = 0;
+
 	/* Clear the temp buffer (write cache) */
 	fs_image_drop_temp(fi);
 
@@ -1490,10 +1355,16 @@ repeat:
 			}
 			if (err)
 				return err;
+			total += size;
 		}
 		pass2 = !pass2;
 	} while (pass2);
 
+	fs_image_show_rate("Wrote", total, get_timer(start));
+
+	if (save_verify)
+		return fs_image_verify_region(fi, copy, ri);
+
 	return 0;
 }
 
@@ -1757,6 +1628,7 @@ static int fs_image_load_image_nand(struct flash_info *fi, int copy,
 	unsigned int size;
 	unsigned int offs = si->start[copy] + sub->offset;
 	unsigned int lim = si->start[copy] + si->size;
+	unsigned int loaded = 0;
 	size_t cs_size;
 
 	sub->size = 0;
@@ -1785,37 +1657,22 @@ static int fs_image_load_image_nand(struct flash_info *fi, int copy,
 #endif
 	} else {
 		/* Load header (IVT, FIT or FS_HEADER) and get size from it */
-		size = sizeof(union any_header);
-		err = fs_image_load_sub(fi, offs, size, lim, 0, sub->img);
-		if (err)
-			return err;
-
-		if (fdt_magic(sub->img) == FDT_MAGIC) {
-			/* Read the FDT part of the FIT image to get size */
-			size = fdt_totalsize(sub->img);
-			err = fs_image_load_sub(fi, offs, size, lim, 0,
-						sub->img);
-			if (!err)
-				err = fs_image_get_size_from_fit(sub, &size);
-		} else {
-			err = fs_image_get_size_from_fsh_or_ivt(sub, &size);
-#ifdef CONFIG_IMX8MM
-			/* Remove offset */
-			if (sub->flags & SUB_IS_SPL)
-				size -= 0x400;
-#endif
-		}
-		if (err)
+		err = fs_image_load_header(fi, offs, lim, sub, &size);
+		if (err < 0)
 			return err;
+		loaded = err;
 	}
 
 	printf(" size 0x%x...", size);
 	debug("\n");
 
-	/* Load image itself */
-	err = fs_image_load_sub(fi, offs, size, lim, sub->flags, sub->img);
-	if (err)
-		return err;
+	/* Load image itself, continue behind the already loaded header */
+	if (size > loaded) {
+		err = fs_image_load_sub(fi, offs + loaded, size - loaded, lim,
+					sub->flags, sub->img + loaded);
+		if (err)
+			return err;
+	}
 
 	/* Check if image is corrupted */
 	if (sub->flags & SUB_IS_FCB) {
@@ -2546,6 +2403,7 @@ static int fs_image_load_image_mmc(struct flash_info *fi, int copy,
 	unsigned int offs = si->start[copy] + sub->offset;
 	unsigned int lim = si->start[copy] + si->size;
 	unsigned int hwpart = si->hwpart[copy];
+	unsigned int loaded = 0;
 	int err;
 
 	sub->size = 0;
@@ -2564,39 +2422,23 @@ static int fs_image_load_image_mmc(struct flash_info *fi, int copy,
 	if (sub->flags & SUB_IS_ENV) {
 		size = si->size;
 	} else {
-		/* Read F&S header, IVT or FIT header */
-		size = sizeof(union any_header);
-		err = fs_image_load_sub(fi, offs, size, lim, 0, sub->img);
-		if (err)
-			return err;
-
-		/* Get image size */
-		if (fdt_magic(sub->img) == FDT_MAGIC) {
-			/* Read the FDT part of the FIT image to get size */
-			size = fdt_totalsize(sub->img);
-			err = fs_image_load_sub(fi, offs, size, lim, 0,
-						sub->img);
-			if (!err)
-				err = fs_image_get_size_from_fit(sub, &size);
-		} else {
-			err = fs_image_get_size_from_fsh_or_ivt(sub, &size);
-#ifdef CONFIG_IMX8MM
-			/* Remove virtual IVT offset */
-			if (sub->flags & SUB_IS_SPL)
-				size -= 0x400;
-#endif
-		}
-		if (err)
+		/* Read F&S header, IVT or FIT header and get size from it */
+		err = fs_image_load_header(fi, offs, lim, sub, &size);
+		if (err < 0)
 			return err;
+		loaded = err;
 	}
 
 	printf(" size 0x%x...", size);
 	debug("\n");
 
-	/* Load whole image incl. header */
-	err = fs_image_load_sub(fi, offs, size, lim, sub->flags, sub->img);
-	if (err)
-		return err;
+	/* Load rest of image, continue behind the already loaded header */
+	if (size > loaded) {
+		err = fs_image_load_sub(fi, offs + loaded, size - loaded, lim,
+					sub->flags, sub->img + loaded);
+		if (err)
+			return err;
+	}
 
 	if (sub->flags & SUB_IS_ENV) {
 		err = fs_image_check_env_crc32(sub->img, size);
@@ -3173,17 +3015,21 @@ static int do_fsimage_load(struct cmd_tbl *cmdtp, int flag, int argc,
 	void *fdt;
 	struct sub_info sub;
 	unsigned long addr;
-	bool force;
+	bool force = false;
 	bool load_uboot = false;
 	struct fs_header_v1_0 *nboot_fsh, *board_info_fsh, *board_cfg_fsh;
 	struct flash_info fi;
 	struct nboot_info ni;
 
 	early_support_index = 0;
-	if ((argc > 1) && (argv[1][0] == '-')) {
-		if (strcmp(argv[1], "-f"))
+	load_stats = false;
+	while ((argc > 1) && (argv[1][0] == '-')) {
+		if (!strcmp(argv[1], "-f"))
+			force = true;
+		else if (!strcmp(argv[1], "-t"))
+			load_stats = true;
+		else
 			return CMD_RET_USAGE;
-		force = true;
 		argv++;
 		argc--;
 	}
@@ -3330,6 +3176,7 @@ static int do_fsimage_save(struct cmd_tbl *cmdtp, int flag, int argc,
 	unsigned int woffset;
 
 	early_support_index = 0;
+	save_verify = false;
 	while ((argc > 1) && (argv[1][0] == '-')) {
 		if (!strcmp(argv[1], "-e")) {
 			if (argc <= 2) {
@@ -3356,6 +3203,10 @@ static int do_fsimage_save(struct cmd_tbl *cmdtp, int flag, int argc,
 			force = true;
 			argv++;
 			argc--;
+		} else if (!strcmp(argv[1], "-v")) {
+			save_verify = true;
+			argv++;
+			argc--;
 		} else
 			return CMD_RET_USAGE;
 	}
@@ -3757,8 +3608,8 @@ static struct cmd_tbl cmd_fsimage_sub[] = {
 #endif
 	U_BOOT_CMD_MKENT(boot, 1, 1, do_fsimage_boot, "", ""),
 	U_BOOT_CMD_MKENT(list, 1, 1, do_fsimage_list, "", ""),
-	U_BOOT_CMD_MKENT(load, 2, 1, do_fsimage_load, "", ""),
-	U_BOOT_CMD_MKENT(save, 4, 0, do_fsimage_save, "", ""),
+	U_BOOT_CMD_MKENT(load, 5, 1, do_fsimage_load, "", ""),
+	U_BOOT_CMD_MKENT(save, 8, 0, do_fsimage_save, "", ""),
 	U_BOOT_CMD_MKENT(fuse, 2, 0, do_fsimage_fuse, "", ""),
 };
 
@@ -3812,7 +3663,7 @@ static int do_fsimage(struct cmd_tbl *cmdtp, int flag, int argc,
 	return cp->cmd(cmdtp, flag, argc, argv);
 }
 
-U_BOOT_CMD(fsimage, 4, 1, do_fsimage,
+U_BOOT_CMD(fsimage, 9, 1, do_fsimage,
 	   "Handle F&S board configuration and F&S images, e.g. U-Boot, NBOOT",
 	   "arch\n"
 	   "    - Show F&S architecture\n"
@@ -3826,9 +3677,9 @@ U_BOOT_CMD(fsimage, 4, 1, do_fsimage,
 	   "    - Show the current boot settings\n"
 	   "fsimage list [<addr>]\n"
 	   "    - List the content of the F&S image at <addr>\n"
-	   "fsimage load [-f] [uboot | nboot] [<addr>]\n"
+	   "fsimage load [-f] [-t] [uboot | nboot] [<addr>]\n"
 	   "    - Verify the current NBoot or U-Boot and load to <addr>\n"
-	   "fsimage save [-f] [-e <n>] [-b <n>] [<addr>]\n"
+	   "fsimage save [-f] [-v] [-e <n>] [-b <n>] [<addr>]\n"
 	   "    - Save the F&S image at the right place (NBoot, U-Boot)\n"
 	   "fsimage fuse [-f] [<addr> | stored]\n"
 	   "    - Program fuses according to the current BOARD-CFG.\n"
@@ -3836,11 +3687,14 @@ U_BOOT_CMD(fsimage, 4, 1, do_fsimage,
 	   "\n"
 	   "If no addr is given, use loadaddr. Using -f forces the command to\n"
 	   "continue without showing any confirmation queries. This is meant\n"
-	   "for non-interactive installation procedures. Option -b also sets\n"
-	   "the eMMC hwpart to boot from: 0: User, 1: Boot1, 2: Boot2. This\n"
-	   "option is ignored on NAND. Option -e supports handling early\n"
-	   "NBoot versions. If the environment is not found when updating\n"
-	   "from a pre 2023.08 NBoot version, try increasing <n> until it\n"
-	   "works. Be careful when storing such an old NBoot, you need to\n"
-	   "know the right <n> or you will lose the environment.\n"
+	   "for non-interactive installation procedures. Option -t shows the\n"
+	   "load time, the read rate and the temp buffer usage of each copy.\n"
+	   "Option -b sets the eMMC hwpart to boot from: 0: User, 1: Boot1,\n"
+	   "2: Boot2. This option is ignored on NAND. Option -v reads back\n"
+	   "each copy after writing and compares it with the image in RAM.\n"
+	   "Option -e supports handling early NBoot versions. If the\n"
+	   "environment is not found when updating from a pre 2023.08 NBoot\n"
+	   "version, try increasing <n> until it works. Be careful when\n"
+	   "storing such an old NBoot, you need to know the right <n> or you\n"
+	   "will lose the environment.\n"
 );
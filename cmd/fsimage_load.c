@@ -0,0 +1,255 @@
+// SPDX-License-Identifier:	GPL-2.0+
+/*
+ * (C) Copyright 2021 F&S Elektronik Systeme GmbH
+ *
+ * Flash independent part of loading F&S images: read through a temp buffer
+ * of one NAND page/MMC block and find the image size from its header. The
+ * flash specific access is done by fi->ops->read().
+ */
+
+#include <common.h>
+#include <image.h>			/* fit_get_size(), ... */
+#include <linux/libfdt.h>		/* fdt_magic(), fdt_totalsize() */
+#ifdef CONFIG_FS_IMAGE_COMMON
+#include <asm/mach-imx/hab.h>		/* struct ivt, struct boot_data */
+#include <asm/mach-imx/checkboot.h>	/* HAB_HEADER */
+#endif
+
+#include "../board/F+S/common/fs_image_common.h"	/* fs_image_*() */
+#include "fsimage_load.h"
+
+/* Struct that is big enough for all headers that we may want to load */
+union any_header {
+	struct fs_header_v1_0 fsh;
+#ifdef CONFIG_FS_IMAGE_COMMON
+	u8 ivt[HAB_HEADER];
+#endif
+	struct fdt_header fdt;
+};
+
+/* Invalidate the temp buffer read cache */
+void fs_image_drop_temp(struct flash_info *fi)
+{
+	fi->write_pos = 0;
+	fi->bb_extra_offs = 0;
+	memset(fi->temp, fi->temp_fill, fi->temp_size);
+}
+
+/* Reset the read statistics */
+void fs_image_clear_stats(struct flash_info *fi)
+{
+	fi->stat_read = 0;
+	fi->stat_copied = 0;
+	fi->stat_fills = 0;
+}
+
+int fs_image_fill_temp(struct flash_info *fi, uint base_offs, uint lim,
+		       uint flags)
+{
+	int err;
+
+	fi->write_pos = 0;
+
+	debug("  - Fill temp from offs 0x%x\n", base_offs);
+	err = fi->ops->read(fi, base_offs, fi->temp_size, lim, flags, fi->temp);
+	if (err)
+		return err;
+
+	fi->stat_read += fi->temp_size;
+	fi->stat_fills++;
+
+	fi->base_offs = base_offs;
+	fi->write_pos = fi->temp_size;
+
+	return 0;
+}
+
+int fs_image_load_sub(struct flash_info *fi, uint offs, uint size,
+		      uint lim, uint flags, u8 *buf)
+{
+	int err;
+	unsigned int read_pos;
+	unsigned int base_offs;
+	unsigned int chunk_size;
+	unsigned int chunk_mask = fi->temp_size - 1;
+	unsigned int remaining = size;
+
+	/*
+	 * Step 1: If reading starts in the middle of a page/block and we do
+	 * not have this page/block cached in the temp buffer yet, load the
+	 * page/block to the temp buffer.
+	 */
+	base_offs = offs & ~chunk_mask;
+	read_pos = offs & chunk_mask;
+	if ((read_pos) && (!fi->write_pos || (base_offs != fi->base_offs))) {
+		err = fs_image_fill_temp(fi, base_offs, lim, flags);
+		if (err)
+			return err;
+	}
+
+	/*
+	 * Step 2: If the start of the data is already cached in the
+	 * temp/buffer, take it from there.
+	 */
+	if (fi->write_pos && (base_offs == fi->base_offs)) {
+		chunk_size = fi->temp_size - read_pos;
+		if (chunk_size > remaining)
+			chunk_size = remaining;
+		debug("  - Copy leading bytes from temp pos 0x%x size 0x%x"
+		      " to 0x%lx\n", read_pos, chunk_size, (ulong)buf);
+		memcpy(buf, fi->temp + read_pos, chunk_size);
+		fi->stat_copied += chunk_size;
+		buf += chunk_size;
+		offs += chunk_size;
+		remaining -= chunk_size;
+	}
+
+	/*
+	 * Step 3: Read the middle part consisting of full pages/blocks.
+	 */
+	chunk_size = remaining & ~chunk_mask;
+	if (chunk_size) {
+		debug("  - Read from offs 0x%x lim 0x%x size 0x%x to 0x%lx\n",
+		      offs, lim, chunk_size, (ulong)buf);
+		err = fi->ops->read(fi, offs, chunk_size, lim, flags, buf);
+		if (err)
+			return err;
+		fi->stat_read += chunk_size;
+		buf += chunk_size;
+		offs += chunk_size;
+		remaining -= chunk_size;
+	}
+
+	/*
+	 * Step 4: Read the last page/block, from which we only need a part
+	 * of, to the temp buffer and take the remaining bytes from there.
+	 */
+	if (remaining) {
+		base_offs = offs & ~chunk_mask;
+		err = fs_image_fill_temp(fi, base_offs, lim, flags);
+		if (err)
+			return err;
+
+		read_pos = offs & chunk_mask;
+		debug("  - Copy trailing bytes from temp pos 0x%x size 0x%x to"
+		      " 0x%lx\n", read_pos, remaining, (ulong)buf);
+		memcpy(buf, fi->temp + read_pos, remaining);
+		fi->stat_copied += remaining;
+	}
+
+	return 0;
+}
+
+/* Get the full size of a FIT image, including all external images */
+int fs_image_get_size_from_fit(struct sub_info *sub, uint *size)
+{
+	void *fit = sub->img;
+	unsigned int fit_size = ALIGN(fit_get_size(fit), 4);
+	int images;
+	int node;
+	int offs;
+	int img_size;
+	unsigned int maxsize = fit_size;
+	const void *dummy_data;
+	size_t dummy_size;
+	int err;
+
+	images = fdt_path_offset(fit, FIT_IMAGES_PATH);
+	if (images < 0)
+		return -ENOENT;
+
+	/* Parse all images to find the last one (with highest offset) */
+	fdt_for_each_subnode(node, fit, images) {
+		/* If image data is embedded, this will not increase size */
+		if (!fit_image_get_data(fit, node, &dummy_data, &dummy_size))
+			continue;
+		/*
+		 * If image data is external (given by data_position or
+		 * data_offset, look for end of image data and keep highest
+		 * value.
+		 */
+		if (fit_image_get_data_position(fit, node, &offs)) {
+			if (fit_image_get_data_offset(fit, node, &offs))
+				return -ENOENT;
+			offs += fit_size;
+		}
+		err =  fit_image_get_data_size(fit, node, &img_size);
+		if (err < 0)
+			return -ENOENT;
+		img_size = ALIGN(img_size, 4);
+		offs += img_size;
+		if ((unsigned int)offs > maxsize)
+			maxsize = (unsigned int)offs;
+	}
+
+	*size = maxsize;
+
+	return 0;
+}
+
+/* Get image length from F&S header or IVT (SPL, signed U-Boot) */
+int fs_image_get_size_from_fsh_or_ivt(struct sub_info *sub, uint *size)
+{
+	if (fs_image_is_fs_image(sub->img)) {
+		struct fs_header_v1_0 *fsh = sub->img;
+
+		/* Check image type and get image size from F&S header */
+		if (!fs_image_match(fsh, sub->type, sub->descr))
+			return -ENOENT;
+		*size = fs_image_get_size(fsh, true);
+	} else {
+#ifdef CONFIG_FS_IMAGE_COMMON
+		struct ivt *ivt = sub->img;
+		struct boot_data *boot_data;
+
+		/* Get image size from IVT/boot_data */
+		if ((ivt->hdr.magic != IVT_HEADER_MAGIC)
+		    || (ivt->boot != ivt->self + IVT_TOTAL_LENGTH))
+			return -ENOENT;
+		boot_data = (struct boot_data *)(ivt + 1);
+		*size = boot_data->length;
+#else
+		return -ENOENT;
+#endif
+	}
+
+	return 0;
+}
+
+int fs_image_load_header(struct flash_info *fi, uint offs, uint lim,
+			 struct sub_info *sub, uint *size)
+{
+	unsigned int loaded;
+	int err;
+
+	/* Read F&S header, IVT or FIT header */
+	loaded = sizeof(union any_header);
+	err = fs_image_load_sub(fi, offs, loaded, lim, 0, sub->img);
+	if (err)
+		return err;
+
+	/* Get image size */
+	if (fdt_magic(sub->img) == FDT_MAGIC) {
+		/* Read remaining FDT part of FIT image to get size */
+		*size = fdt_totalsize(sub->img);
+		if (*size < loaded)
+			return -EINVAL;
+		err = fs_image_load_sub(fi, offs + loaded, *size - loaded,
+					lim, 0, sub->img + loaded);
+		if (err)
+			return err;
+		loaded = *size;
+		err = fs_image_get_size_from_fit(sub, size);
+	} else {
+		err = fs_image_get_size_from_fsh_or_ivt(sub, size);
+#ifdef CONFIG_IMX8MM
+		/* Remove virtual IVT offset */
+		if (sub->flags & SUB_IS_SPL)
+			*size -= 0x400;
+#endif
+	}
+	if (err)
+		return err;
+
+	return loaded;
+}
@@ -0,0 +1,133 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * (C) Copyright 2021 F&S Elektronik Systeme GmbH
+ *
+ * Flash independent part of loading F&S images (fsimage load), shared with
+ * the unit tests. See cmd/fsimage.c for a description of the structures.
+ */
+
+#ifndef __FSIMAGE_LOAD_H
+#define __FSIMAGE_LOAD_H
+
+#include <linux/types.h>
+#ifdef CONFIG_FS_IMAGE_COMMON
+#include <asm/mach-imx/boot_mode.h>	/* enum boot_device */
+#endif
+
+/* Structure to hold regions in NAND/eMMC for an image, taken from nboot-info */
+struct storage_info {
+	unsigned int start[2];			/* *-start entries */
+	unsigned int size;		/* *-size entry */
+#ifdef CONFIG_CMD_MMC
+	u8 hwpart[2];			/* hwpart (in case of eMMC) */
+#endif
+	const char *type;		/* Name of storage region */
+};
+
+#define SUB_SYNC          BIT(0)	/* After writing image, flush temp */
+#define SUB_HAS_FS_HEADER BIT(1)	/* Image has an F&S header in flash */
+#define SUB_IS_SPL        BIT(2)	/* SPL: has IVT, may beed offset */
+#define SUB_IS_ENV        BIT(3)	/* Environment data */
+#ifdef CONFIG_NAND_MXS
+#define SUB_IS_FCB        BIT(4)	/* FCB: needs other ECC */
+#define SUB_IS_DBBT       BIT(5)
+#define SUB_IS_DBBT_DATA  BIT(6)
+#endif
+struct sub_info {
+	void *img;			/* Pointer to image */
+	const char *type;		/* "BOARD-CFG", "FIRMWARE", "SPL" */
+	const char *descr;		/* e.g. board architecture */
+	unsigned int size;		/* Size of image */
+	unsigned int offset;		/* Offset of image within si */
+	unsigned int flags;		/* See SUB_* above */
+};
+
+/* Access functions that differ between NAND and MMC */
+struct flash_info;
+struct nboot_info;
+struct region_info;
+struct flash_ops {
+	bool (*check_for_uboot)(struct storage_info *si, bool force);
+	bool (*check_for_nboot)(struct flash_info *fi, struct storage_info *si,
+				bool force);
+	int (*get_nboot_info)(struct flash_info *fi, void *fdt, int offs,
+			      struct nboot_info *ni, int hwpart, bool show);
+	bool (*si_differs)(const struct storage_info *si1,
+			   const struct storage_info *si2);
+	int (*read)(struct flash_info *fi, uint offs, uint size, uint lim,
+		    uint flags, u8 *buf);
+	int (*load_image)(struct flash_info *fi, int copy,
+			  const struct storage_info *si, struct sub_info *sub);
+	int (*load_extra)(struct flash_info *fi, struct storage_info *spl,
+			  void *tempaddr);
+	int (*invalidate)(struct flash_info *fi, int copy,
+			  const struct storage_info *si);
+	int (*write)(struct flash_info *fi, uint offs, uint size, uint lim,
+		     uint flags, u8 *buf);
+	int (*prepare_region)(struct flash_info *fi, int copy,
+			      struct storage_info *si);
+	int (*save_nboot)(struct flash_info *fi, struct region_info *nboot_ri,
+			  struct region_info *spl_ri);
+	int (*set_boot_hwpart)(struct flash_info *fi, int boot_hwpart);
+	void (*get_flash)(struct flash_info *fi);
+	void (*put_flash)(struct flash_info *fi);
+};
+
+struct flash_info {
+#ifdef CONFIG_NAND_MXS
+	struct mtd_info *mtd;		/* Handle to NAND */
+	unsigned int env_used;		/* From env-size entry, region size
+					   is from env-range */
+#endif
+#ifdef CONFIG_CMD_MMC
+	struct mmc *mmc;		/* Handle to MMC device */
+	struct blk_desc *blk_desc;	/* Handle to MMC block device */
+	u8 boot_hwpart;			/* HW partition we boot from (0..2) */
+	u8 old_hwpart;			/* Previous partition before command */
+#endif
+	char devname[6];		/* Name of device (NAND, mmc<n>) */
+	u8 *temp;			/* Buffer for one NAND page/MMC block */
+	unsigned int temp_size;		/* Size of temp buffer */
+	unsigned int base_offs;		/* Offset where temp will be written */
+	unsigned int write_pos;		/* temp contains data up to this pos */
+	unsigned int bb_extra_offs;	/* Extra offset due to bad blocks */
+	u8 temp_fill;			/* Default value for temp buffer */
+	unsigned int stat_read;		/* Statistics: bytes read from flash */
+	unsigned int stat_copied;	/* Statistics: bytes copied from temp */
+	unsigned int stat_fills;	/* Statistics: number of temp refills */
+#ifdef CONFIG_FS_IMAGE_COMMON
+	enum boot_device boot_dev;	/* Device to boot from */
+#endif
+	const char *boot_dev_name;	/* Boot device as string */
+	struct flash_ops *ops;		/* Access functions for NAND/MMC */
+};
+
+/* Invalidate the temp buffer read cache */
+void fs_image_drop_temp(struct flash_info *fi);
+
+/* Reset the read statistics */
+void fs_image_clear_stats(struct flash_info *fi);
+
+/* Read the page/block at base_offs to the temp buffer */
+int fs_image_fill_temp(struct flash_info *fi, uint base_offs, uint lim,
+		       uint flags);
+
+/* Load size bytes from offs to buf, going through temp for partial pages */
+int fs_image_load_sub(struct flash_info *fi, uint offs, uint size,
+		      uint lim, uint flags, u8 *buf);
+
+/* Get the full size of a FIT image, including all external images */
+int fs_image_get_size_from_fit(struct sub_info *sub, uint *size);
+
+/* Get image length from F&S header or IVT (SPL, signed U-Boot) */
+int fs_image_get_size_from_fsh_or_ivt(struct sub_info *sub, uint *size);
+
+/*
+ * Load the header of the image at offs (F&S header, IVT or FIT) to sub->img
+ * and get the image size from it. Returns the number of bytes already loaded
+ * or a negative error code.
+ */
+int fs_image_load_header(struct flash_info *fi, uint offs, uint lim,
+			 struct sub_info *sub, uint *size);
+
+#endif /* __FSIMAGE_LOAD_H */
@@ -132,6 +132,8 @@
 #include <serial.h>			  /* serial_putc(), serial_puts() */
 #include <linux/ctype.h>		  /* isdigit() */
 #include <video_font.h>			  /* Get font data, width and height */
+#include <cpu_func.h>			  /* flush_dcache_range() */
+#include <asm/cache.h>			  /* ARCH_DMA_MINALIGN */
 
 #if defined(CONFIG_S3C64XX)
 #include <s3c64xx_xlcd.h>		  /* s3c64xx_xlcd_init() */
@@ -383,6 +385,9 @@ static void set_vidinfo(vidinfo_t *pvi);
 /* Draw character to console */
 static void console_putc(wininfo_t *pwi, coninfo_t *pci, char c);
 
+/* Add rectangle to the dirty region without clipping */
+static void add_dirty(wininfo_t *pwi, XYPOS x1, XYPOS y1, XYPOS x2, XYPOS y2);
+
 /* Relocate all windows to newaddr, starting at given window (via pwi) */
 static void relocbuffers(wininfo_t *pwi, u_long newaddr);
 
@@ -670,6 +675,8 @@ static void console_putc(wininfo_t *pwi, coninfo_t *pci, char c)
 			draw_ll_char(pwi, x, y, ' ', fg, bg);
 			x += VIDEO_FONT_WIDTH;
 		};
+		if (x > pci->x)
+			add_dirty(pwi, pci->x, y, x - 1, y + VIDEO_FONT_HEIGHT - 1);
 		goto CHECKNEWLINE;
 
 	case '\b':			  /* Backspace */
@@ -680,10 +687,14 @@ static void console_putc(wininfo_t *pwi, coninfo_t *pci, char c)
 			x = (fbhres/VIDEO_FONT_WIDTH-1) * VIDEO_FONT_WIDTH;
 		}
 		draw_ll_char(pwi, x, y, ' ', fg, bg);
+		add_dirty(pwi, x, y, x + VIDEO_FONT_WIDTH - 1,
+			  y + VIDEO_FONT_HEIGHT - 1);
 		break;
 
 	default:			  /* Character */
 		draw_ll_char(pwi, x, y, c, fg, bg);
+		add_dirty(pwi, x, y, x + VIDEO_FONT_WIDTH - 1,
+			  y + VIDEO_FONT_HEIGHT - 1);
 		x += VIDEO_FONT_WIDTH;
 	CHECKNEWLINE:
 		/* Check if there is room on the row for another character */
@@ -707,6 +718,9 @@ static void console_putc(wininfo_t *pwi, coninfo_t *pci, char c)
 			   background color */
 			memset32((unsigned *)(fbuf + y*linelen), bg,
 				 (fbvres - y)*linelen/4);
+
+			/* The whole buffer has changed */
+			add_dirty(pwi, 0, 0, fbhres - 1, fbvres - 1);
 		}
 		/* Fall through to case '\r' */
 
@@ -728,9 +742,11 @@ void lcd_putc(const struct stdio_dev *pdev, const char c)
 	wininfo_t *pwi = (wininfo_t *)pdev->priv;
 	vidinfo_t *pvi = pwi->pvi;
 
-	if (pvi->is_enabled && pwi->active)
+	if (pvi->is_enabled && pwi->active) {
 		console_putc(pwi, &pwi->ci, c);
-	else
+		if (pwi->fbflush)
+			lcd_flush(pwi);
+	} else
 		serial_putc(NULL, c);
 }
 #else
@@ -739,9 +755,11 @@ void lcd_putc(const struct stdio_dev *pdev, const char c)
 	wininfo_t *pwi = console_pwi;
 	vidinfo_t *pvi = pwi->pvi;
 
-	if (pvi->is_enabled && pwi->active)
+	if (pvi->is_enabled && pwi->active) {
 		console_putc(pwi, &coninfo, c);
-	else
+		if (pwi->fbflush)
+			lcd_flush(pwi);
+	} else
 		serial_putc(NULL, c);
 }
 #endif /*CONFIG_XLCD_CONSOLE_MULTI*/
@@ -764,6 +782,8 @@ void lcd_puts(const struct stdio_dev *pdev, const char *s)
 				break;
 			console_putc(pwi, pci, c);
 		}
+		if (pwi->fbflush)
+			lcd_flush(pwi);
 	} else
 		serial_puts(NULL, s);
 }
@@ -783,6 +803,8 @@ void lcd_puts(const struct stdio_dev *pdev, const char *s)
 				break;
 			console_putc(pwi, pci, c);
 		}
+		if (pwi->fbflush)
+			lcd_flush(pwi);
 	} else
 		serial_puts(NULL, s);
 }
@@ -1461,6 +1483,8 @@ int setfbuf(wininfo_t *pwi, XYPOS hres, XYPOS vres,
 	pwi->fbsize = fbsize;
 	pwi->fbdraw = 0;
 	pwi->fbshow = 0;
+	lcd_clear_dirty(pwi);
+	pwi->pbi.xlast = -1;
 	if (pwi->pix != pix) {
 		/* New pixel format: set default bg + fg */
 		pwi->pix = pix;
@@ -1527,6 +1551,107 @@ int setfbuf(wininfo_t *pwi, XYPOS hres, XYPOS vres,
 }
 
 
+/* Add rectangle to the region that has to be copied on the next flush; the
+   region is clipped to the current clipping region, because nothing is drawn
+   outside of it anyway */
+void lcd_dirty(wininfo_t *pwi, XYPOS x1, XYPOS y1, XYPOS x2, XYPOS y2)
+{
+	if (x1 < pwi->clip_left)
+		x1 = pwi->clip_left;
+	if (y1 < pwi->clip_top)
+		y1 = pwi->clip_top;
+	if (x2 > pwi->clip_right)
+		x2 = pwi->clip_right;
+	if (y2 > pwi->clip_bottom)
+		y2 = pwi->clip_bottom;
+	if ((x1 > x2) || (y1 > y2))
+		return;
+
+	add_dirty(pwi, x1, y1, x2, y2);
+}
+
+
+/* Add rectangle to the dirty region without clipping; used by the console,
+   which does not care about the clipping region */
+static void add_dirty(wininfo_t *pwi, XYPOS x1, XYPOS y1, XYPOS x2, XYPOS y2)
+{
+	/* Anything drawn over the progress bar requires a full redraw of the
+	   bar next time */
+	if ((x1 <= pwi->pbi.x2) && (x2 >= pwi->pbi.x1)
+	    && (y1 <= pwi->pbi.y2) && (y2 >= pwi->pbi.y1))
+		pwi->pbi.xlast = -1;
+
+	if (pwi->dirty_left > pwi->dirty_right) {
+		/* Region was empty, just take the new rectangle */
+		pwi->dirty_left = x1;
+		pwi->dirty_top = y1;
+		pwi->dirty_right = x2;
+		pwi->dirty_bottom = y2;
+		return;
+	}
+
+	/* Extend region to the bounding box of both rectangles */
+	if (x1 < pwi->dirty_left)
+		pwi->dirty_left = x1;
+	if (y1 < pwi->dirty_top)
+		pwi->dirty_top = y1;
+	if (x2 > pwi->dirty_right)
+		pwi->dirty_right = x2;
+	if (y2 > pwi->dirty_bottom)
+		pwi->dirty_bottom = y2;
+}
+
+
+/* Copy the dirty region from the draw buffer to the shown buffer. The
+   columns are extended to full cache lines; if this covers the larger part
+   of the lines anyway, all lines are copied as one contiguous block. Outside
+   of the dirty region both buffers have the same content, so copying a bit
+   more does not harm. */
+void lcd_flush(wininfo_t *pwi)
+{
+	u_long linelen = pwi->linelen;
+	u_long start, end, src, dst;
+	XYPOS lines;
+
+	if (pwi->active && (pwi->fbdraw != pwi->fbshow)
+	    && (pwi->dirty_left <= pwi->dirty_right)) {
+		u_int shift = pwi->ppi->bpp_shift;
+
+		/* Get byte range within line, rounded to cache lines */
+		start = ((u_long)pwi->dirty_left << shift) >> 3;
+		end = (((u_long)(pwi->dirty_right + 1) << shift) + 7) >> 3;
+		start &= ~(u_long)(ARCH_DMA_MINALIGN - 1);
+		end = ALIGN(end, ARCH_DMA_MINALIGN);
+		if (end > linelen)
+			end = linelen;
+		if (2 * (end - start) >= linelen) {
+			start = 0;
+			end = linelen;
+		}
+
+		lines = pwi->dirty_bottom - pwi->dirty_top + 1;
+		src = pwi->pfbuf[pwi->fbdraw] + pwi->dirty_top * linelen;
+		dst = pwi->pfbuf[pwi->fbshow] + pwi->dirty_top * linelen;
+		if (end - start == linelen) {
+			/* Full lines, copy in one burst */
+			end = lines * linelen;
+			lines = 1;
+		}
+		do {
+			memcpy((void *)(dst + start), (void *)(src + start),
+			       end - start);
+			flush_dcache_range(
+				(dst + start) & ~(u_long)(ARCH_DMA_MINALIGN - 1),
+				ALIGN(dst + end, ARCH_DMA_MINALIGN));
+			src += linelen;
+			dst += linelen;
+		} while (--lines);
+	}
+
+	lcd_clear_dirty(pwi);
+}
+
+
 /* If not locked, update window hardware and set environment variable */
 void set_wininfo(const wininfo_t *pwi)
 {
@@ -1810,10 +1935,12 @@ void drv_lcd_init(void)
 			pwi->fbcount = 0;
 			pwi->fbdraw = 0;
 			pwi->fbshow = 0;
+			pwi->fbflush = 0;
 			pwi->fbhres = 0;
 			pwi->fbvres = 0;
 			pwi->hoffs = 0;
 			pwi->voffs = 0;
+			lcd_clear_dirty(pwi);
 
 			/* Drawing information */
 			pwi->text_attr = 0;
@@ -1835,6 +1962,7 @@ void drv_lcd_init(void)
 			lcd_set_col(pwi, DEFAULT_BG, &pwi->pbi.text_bg);
 			pwi->pbi.attr = ATTR_HFOLLOW | ATTR_VCENTER;
 			pwi->pbi.prog = 0;
+			pwi->pbi.xlast = -1;
 
 			/* Alpha and color keying information */
 			pwi->ai[0].alpha = DEFAULT_ALPHA0;
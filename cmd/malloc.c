@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * (C) Copyright 2022
+ * F&S Elektronik Systeme GmbH
+ *
+ * Show usage and statistics of the malloc() heap
+ */
+
+#include <common.h>
+#include <command.h>
+#include <display_options.h>
+#include <malloc.h>
+
+static int do_malloc_info(struct cmd_tbl *cmdtp, int flag, int argc,
+			  char *const argv[])
+{
+	struct malloc_info info;
+
+	malloc_get_info(&info);
+
+	print_size(info.heap_size, " heap, ");
+	print_size(info.sys_bytes, " used, ");
+	print_size(info.max_sys_bytes, " peak\n");
+	print_size(info.in_use, " in use, ");
+	print_size(info.free, " free, ");
+	print_size(info.cached, " cached\n");
+	printf("malloc:   %lu (%lu from cache)\n", info.malloc_count,
+	       info.cache_hits);
+	printf("memalign: %lu (%lu from pool)\n", info.memalign_count,
+	       info.pool_hits);
+	printf("realloc:  %lu\n", info.realloc_count);
+	printf("free:     %lu\n", info.free_count);
+	printf("failed:   %lu\n", info.fail_count);
+
+	return 0;
+}
+
+#ifdef CONFIG_SYS_LONGHELP
+static char malloc_help_text[] =
+	"info   - show usage and statistics of the malloc() heap";
+#endif
+
+U_BOOT_CMD_WITH_SUBCMDS(malloc, "malloc heap", malloc_help_text,
+	U_BOOT_SUBCMD_MKENT(info, 1, 1, do_malloc_info));
@@ -16,6 +16,7 @@
 #include <cli.h>
 #include <command.h>
 #include <console.h>
+#include <cpu_func.h>
 #include <flash.h>
 #include <hash.h>
 #include <image.h>			/* parse_loadaddr(), ... */
@@ -1000,6 +1001,15 @@ static ulong mem_test_bitflip(vu_long *buf, ulong start, ulong end)
 	return test_bitflip_comparison(buf, buf + half_size, half_size);
 }
 
+static void mem_test_error(ulong start_addr, ulong offset, ulong readback,
+			   ulong val)
+{
+	printf("\nMem error @ 0x%08X: "
+		"found %08lX, expected %08lX\n",
+		(uint)(uintptr_t)(start_addr + offset*sizeof(vu_long)),
+		readback, val);
+}
+
 static ulong mem_test_quick(vu_long *buf, ulong start_addr, ulong end_addr,
 			    vu_long pattern, int iteration)
 {
@@ -1045,10 +1055,7 @@ static ulong mem_test_quick(vu_long *buf, ulong start_addr, ulong end_addr,
 		if (readback != val) {
 			ulong offset = addr - buf;
 
-			printf("\nMem error @ 0x%08X: "
-				"found %08lX, expected %08lX\n",
-				(uint)(uintptr_t)(start_addr + offset*sizeof(vu_long)),
-				readback, val);
+			mem_test_error(start_addr, offset, readback, val);
 			errs++;
 			if (ctrlc())
 				return -1;
@@ -1059,6 +1066,140 @@ static ulong mem_test_quick(vu_long *buf, ulong start_addr, ulong end_addr,
 	return errs;
 }
 
+#if CONFIG_IS_ENABLED(CPU_PARALLEL)
+#define MTEST_CPUS	CONFIG_CPU_PARALLEL_MAX
+#else
+#define MTEST_CPUS	1
+#endif
+
+/* Number of errors that each CPU records for the report */
+#define MTEST_REPORTS	4
+
+struct mtest_report {
+	ulong offset;
+	ulong readback;
+	ulong val;
+};
+
+/* Part of the RAM that is tested by one CPU */
+struct mtest_slice {
+	ulong first;			/* Index of the first word */
+	ulong length;			/* Number of words */
+	ulong errs;
+	struct mtest_report report[MTEST_REPORTS];
+};
+
+struct mtest_parallel {
+	vu_long *buf;
+	ulong pattern;
+	ulong incr;
+	int verify;			/* 0: write pattern, 1: read back */
+	volatile int abort;
+	struct mtest_slice slice[MTEST_CPUS];
+};
+
+/*
+ * Write or verify the slice of one CPU. Only CPU 0 may check for ctrl-c, the
+ * other CPUs only record the errors; they are reported when all are done.
+ */
+static void mem_test_slice(int cpu, int count, void *arg)
+{
+	struct mtest_parallel *mp = arg;
+	struct mtest_slice *s = &mp->slice[cpu];
+	vu_long *addr = mp->buf + s->first;
+	ulong val = mp->pattern + s->first * mp->incr;
+	ulong i, readback;
+
+	for (i = 0; i < s->length; i++, addr++, val += mp->incr) {
+		if (!(i & 0xffff)) {
+			if (!cpu) {
+				WATCHDOG_RESET();
+				if (ctrlc())
+					mp->abort = 1;
+			}
+			if (mp->abort)
+				return;
+		}
+		if (!mp->verify) {
+			*addr = val;
+			continue;
+		}
+		readback = *addr;
+		if (readback != val) {
+			if (s->errs < MTEST_REPORTS) {
+				s->report[s->errs].offset = s->first + i;
+				s->report[s->errs].readback = readback;
+				s->report[s->errs].val = val;
+			}
+			s->errs++;
+		}
+	}
+}
+
+/*
+ * Same as mem_test_quick(), but each CPU writes and verifies a part of the
+ * RAM. All CPUs finish writing before the first one starts reading back.
+ */
+static ulong mem_test_quick_parallel(vu_long *buf, ulong start_addr,
+				     ulong end_addr, vu_long pattern,
+				     int iteration, int count)
+{
+	struct mtest_parallel mp;
+	struct mtest_slice *s;
+	ulong length, first = 0;
+	ulong errs = 0, i;
+	int cpu;
+
+	mp.incr = 1;
+	if (iteration & 1) {
+		mp.incr = -mp.incr;
+		if (pattern & 0x80000000)
+			pattern = -pattern;	/* complement & increment */
+		else
+			pattern = ~pattern;
+	}
+	mp.buf = buf;
+	mp.pattern = pattern;
+	mp.abort = 0;
+
+	length = (end_addr - start_addr) / sizeof(ulong);
+	for (cpu = 0; cpu < count; cpu++) {
+		s = &mp.slice[cpu];
+		s->first = first;
+		s->length = length / count;
+		if (cpu == count - 1)
+			s->length = length - first;
+		s->errs = 0;
+		first += s->length;
+	}
+
+	printf("\rPattern %08lX  Writing..."
+		"%12s"
+		"\b\b\b\b\b\b\b\b\b\b",
+		pattern, "");
+	mp.verify = 0;
+	cpu_parallel_run(count, mem_test_slice, &mp);
+	if (mp.abort)
+		return -1;
+
+	puts("Reading...");
+	mp.verify = 1;
+	cpu_parallel_run(count, mem_test_slice, &mp);
+
+	for (cpu = 0; cpu < count; cpu++) {
+		s = &mp.slice[cpu];
+		for (i = 0; (i < s->errs) && (i < MTEST_REPORTS); i++)
+			mem_test_error(start_addr, s->report[i].offset,
+				       s->report[i].readback, s->report[i].val);
+		if (s->errs > MTEST_REPORTS)
+			printf("CPU %d: %lu more errors\n", cpu,
+			       s->errs - MTEST_REPORTS);
+		errs += s->errs;
+	}
+
+	return mp.abort ? -1 : errs;
+}
+
 /*
  * Perform a memory test. A more complete alternative test can be
  * configured using CONFIG_SYS_ALT_MEMTEST. The complete test loops until
@@ -1075,6 +1216,7 @@ static int do_mem_mtest(struct cmd_tbl *cmdtp, int flag, int argc,
 	ulong errs = 0;	/* number of errors, or -1 if interrupted */
 	ulong pattern = 0;
 	int iteration;
+	int cpus = 1;
 
 #ifdef CONFIG_SYS_MEMTEST_START
 	start = CONFIG_SYS_MEMTEST_START;
@@ -1114,7 +1256,14 @@ static int do_mem_mtest(struct cmd_tbl *cmdtp, int flag, int argc,
 		return -1;
 	}
 
-	printf("Testing %08lx ... %08lx:\n", start, end);
+	if (!IS_ENABLED(CONFIG_SYS_ALT_MEMTEST))
+		cpus = min(cpu_parallel_count(), MTEST_CPUS);
+
+	if (cpus > 1)
+		printf("Testing %08lx ... %08lx on %d CPUs:\n", start, end,
+		       cpus);
+	else
+		printf("Testing %08lx ... %08lx:\n", start, end);
 	debug("%s:%d: start %#08lx end %#08lx\n", __func__, __LINE__,
 	      start, end);
 
@@ -1137,6 +1286,9 @@ static int do_mem_mtest(struct cmd_tbl *cmdtp, int flag, int argc,
 				count += errs;
 				errs = mem_test_bitflip(buf, start, end);
 			}
+		} else if (cpus > 1) {
+			errs = mem_test_quick_parallel(buf, start, end, pattern,
+						       iteration, cpus);
 		} else {
 			errs = mem_test_quick(buf, start, end, pattern,
 					      iteration);
@@ -133,16 +133,17 @@ static struct mmc *init_mmc_device(int dev, bool force_init)
 	if (!mmc_getcd(mmc))
 		force_init = true;
 
-	if (force_init)
-		mmc->has_init = 0;
-	if (mmc_init(mmc))
-		return NULL;
-
 #ifdef CONFIG_BLOCK_CACHE
+	/* Write delayed blocks before the card is re-initialized */
 	struct blk_desc *bd = mmc_get_blk_desc(mmc);
 	blkcache_invalidate(bd->if_type, bd->devnum);
 #endif
 
+	if (force_init)
+		mmc->has_init = 0;
+	if (mmc_init(mmc))
+		return NULL;
+
 	return mmc;
 }
 
@@ -470,6 +470,20 @@ static int do_nand(struct cmd_tbl *cmdtp, int flag, int argc,
 		return 0;
 	}
 
+#ifdef CONFIG_NAND_REFRESH
+	if (strcmp(cmd, "refresh") == 0) {
+		if (argc > 2) {
+			if (strcmp(argv[2], "stats"))
+				goto usage;
+			printf("\nDevice %d refresh statistics:\n", dev);
+			nand_refresh_show_stats(mtd);
+			return 0;
+		}
+
+		return nand_refresh_drain() ? 1 : 0;
+	}
+#endif
+
 	/*
 	 * Syntax is:
 	 *   0    1     2       3    4
@@ -917,6 +931,10 @@ static char nand_help_text[] =
 	"nand protect - set software write protection\n"
 	"nand unprotect - clear software write protection\n"
 	"nand bad - show bad blocks\n"
+#ifdef CONFIG_NAND_REFRESH
+	"nand refresh - refresh all blocks queued because of many bitflips\n"
+	"nand refresh stats - show bitflips, refreshs and backup block usage\n"
+#endif
 	"nand dump[.oob] off - dump page\n"
 #ifdef CONFIG_CMD_NAND_TORTURE
 	"nand torture off - torture one block at offset\n"
@@ -17,6 +17,7 @@
 #include <usb.h>
 #include <usb_mass_storage.h>
 #include <watchdog.h>
+#include <wildcard.h>
 #include <linux/delay.h>
 
 static int ums_read_sector(struct ums *ums_dev,
@@ -48,6 +49,9 @@ static void ums_fini(void)
 		free((void *)ums[i].name);
 	free(ums);
 	ums = NULL;
+
+	/* The host may have modified any filesystem on the exported media */
+	wildcard_cache_invalidate();
 	ums_count = 0;
 }
 
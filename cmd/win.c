@@ -37,6 +37,7 @@
 enum WIN_INDEX {
 	WI_FBRES,
 	WI_SHOW,
+	WI_FLUSH,
 	WI_RES,
 	WI_OFFS,
 	WI_POS,
@@ -67,6 +68,7 @@ enum WIN_INDEX {
 static kwinfo_t const win_kw[] = {
 	[WI_FBRES] =  {1, 4, 0, 0, "fbres"}, /* fbhres fbvres [pix [fbcount]] */
 	[WI_SHOW] =   {1, 2, 0, 0, "show"},  /* fbshow [fbdraw] */
+	[WI_FLUSH] =  {0, 1, 0, 0, "flush"}, /* [auto] */
 	[WI_RES] =    {2, 2, 0, 0, "res"},   /* hres vres */
 	[WI_OFFS] =   {2, 2, 0, 0, "offs"},  /* hoffs voffs */
 	[WI_POS] =    {2, 2, 0, 0, "pos"},   /* hpos vpos */
@@ -157,6 +159,8 @@ static void show_wininfo(const wininfo_t *pwi)
 	printf("\t\t%u buffer(s) available", pwi->fbmaxcount);
 	if (pwi->fbcount) {
 		printf(", draw to #%u, show #%u", pwi->fbdraw, pwi->fbshow);
+		if (pwi->fbflush)
+			puts(", auto flush");
 		for (buf=0; buf<pwi->fbcount; buf++) {
 			printf("\n\t\timage buffer %u: 0x%08lx - 0x%08lx", buf,
 			       pwi->pfbuf[buf], pwi->pfbuf[buf]+pwi->fbsize-1);
@@ -347,15 +351,37 @@ static int do_win(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 				printf("Bad image buffer '%u'\n", fbdraw);
 				return 1;
 			}
+			/* The progress bar is not in the new buffer yet */
+			if (fbdraw != pwi->fbdraw)
+				pwi->pbi.xlast = -1;
 			pwi->fbdraw = fbdraw;
 		}
 
 		/* Set new values */
 		pwi->fbshow = fbshow;
+		lcd_clear_dirty(pwi);
 		set_wininfo(pwi);
 		break;
 	}
 
+	case WI_FLUSH:
+		/* Without argument: copy dirty region to shown buffer now */
+		if (argc < 3) {
+			lcd_flush(pwi);
+			break;
+		}
+
+		/* Argument 1: automatically copy after each draw command */
+		pwi->fbflush = (simple_strtoul(argv[2], NULL, 0) != 0);
+		if (pwi->fbflush && (pwi->fbdraw != pwi->fbshow)) {
+			/* Start with the content that is currently shown */
+			memcpy((void *)pwi->pfbuf[pwi->fbdraw],
+			       (void *)pwi->pfbuf[pwi->fbshow], pwi->fbsize);
+		}
+		lcd_clear_dirty(pwi);
+		set_wininfo(pwi);
+		break;
+
 	case WI_RES: {
 		XYPOS hres, vres;
 
@@ -488,6 +514,8 @@ U_BOOT_CMD(
 	"    - Select window n\n"
 	"show fbshow [fbdraw]\n"
 	"    - Set the buffer to show and to draw to\n"
+	"win flush [auto]\n"
+	"    - Copy drawn region to shown buffer; auto=1: after each draw\n"
 	"win fbres [fbhres fbvres [pix [fbcount]]]\n"
 	"    - Set virtual framebuffer resolution, pixel format, buffer count\n"
 	"win res [hres vres]\n"
@@ -541,6 +569,8 @@ void win_setenv(const wininfo_t *pwi)
 		s += sprintf(s, "; %s %s %u %u", cmd, win_kw[WI_SHOW].keyword,
 			     pwi->fbshow, pwi->fbdraw);
 	}
+	if (pwi->fbflush)
+		s += sprintf(s, "; %s %s 1", cmd, win_kw[WI_FLUSH].keyword);
 	if (pwi->hoffs || pwi->voffs) {
 		s += sprintf(s, "; %s %s %u %u", cmd, win_kw[WI_OFFS].keyword,
 			     pwi->hoffs, pwi->voffs);
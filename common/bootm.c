@@ -25,6 +25,9 @@
 #if defined(CONFIG_CMD_USB)
 #include <usb.h>
 #endif
+#ifdef CONFIG_NAND_REFRESH
+#include <nand.h>
+#endif
 #else
 #include "mkimage.h"
 #endif
@@ -80,6 +83,10 @@ static inline void boot_start_lmb(bootm_headers_t *images) { }
 static int bootm_start(struct cmd_tbl *cmdtp, int flag, int argc,
 		       char *const argv[])
 {
+#ifdef CONFIG_LMB
+	/* Free the regions of a previous bootm that did not boot */
+	lmb_release(&images.lmb);
+#endif
 	memset((void *)&images, 0, sizeof(images));
 	images.verify = env_get_yesno("verify");
 
@@ -697,6 +704,12 @@ int do_bootm_states(struct cmd_tbl *cmdtp, int flag, int argc,
 
 	images->state |= states;
 
+#ifdef CONFIG_NAND_REFRESH
+	/* All boot-critical NAND reads are done, refresh weak blocks now */
+	if (states & BOOTM_STATE_START)
+		nand_refresh_drain();
+#endif
+
 	/*
 	 * Work through the states and see how far we get. We stop on
 	 * any error.
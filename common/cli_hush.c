@@ -76,6 +76,7 @@
 #define __U_BOOT__
 #ifdef __U_BOOT__
 #include <common.h>         /* readline */
+#include <bootstage.h>
 #include <env.h>
 #include <malloc.h>         /* malloc, free, realloc*/
 #include <linux/ctype.h>    /* isalpha, isdigit */
@@ -265,6 +266,28 @@ struct close_me {
 	int fd;
 	struct close_me *next;
 };
+#else
+/*
+ * A script that was parsed once. The parse trees do not depend on the values
+ * of variables (a command with variables is parsed again after substitution),
+ * so the lists can be run again whenever exactly the same text is to be
+ * executed. Changing a variable with setenv changes the text and therefore
+ * implicitly invalidates the entry. The command lines that are parsed again
+ * after substitution are not cached, they mostly differ every time.
+ */
+struct hush_cache {
+	char *text;			/* copy of the script, NULL if unused */
+	unsigned int hash;		/* hash of text */
+	int flag;			/* FLAG_... the text was parsed with */
+	int busy;			/* entry is running, do not touch */
+	int ready;			/* lists are complete and can be run */
+	int failed;			/* syntax error or exit while parsing */
+	unsigned long stamp;		/* time of last use, for replacement */
+	int count;			/* number of lists */
+	struct pipe **lists;		/* lists as returned by parse_stream() */
+};
+
+#define HUSH_CACHE_SLOTS 16
 #endif
 
 struct variables {
@@ -306,6 +329,9 @@ struct variables *top_vars = &shell_ver;
 static int flag_repeat = 0;
 static int do_repeat = 0;
 static struct variables *top_vars = NULL ;
+static int run_depth;
+static struct hush_cache hush_cache[HUSH_CACHE_SLOTS];
+static unsigned long hush_cache_stamp;
 #endif /*__U_BOOT__ */
 
 #define B_CHUNK (100)
@@ -477,7 +503,12 @@ static int parse_string(o_string *dest, struct p_context *ctx, const char *src);
 #endif
 static int parse_stream(o_string *dest, struct p_context *ctx, struct in_str *input0, int end_trigger);
 /*   setup: */
+#ifndef __U_BOOT__
 static int parse_stream_outer(struct in_str *inp, int flag);
+#else
+static int parse_stream_outer(struct in_str *inp, int flag,
+			      struct hush_cache *hc);
+#endif
 #ifndef __U_BOOT__
 static int parse_string_outer(const char *s, int flag);
 static int parse_file_outer(FILE *f);
@@ -1539,6 +1570,7 @@ static int run_pipe_real(struct pipe *pi)
 	struct child_prog *child;
 	struct built_in_command *x;
 	char *p;
+	int sp;
 # if __GNUC__
 	/* Avoid longjmp clobbering */
 	(void) &i;
@@ -1551,6 +1583,7 @@ static int run_pipe_real(struct pipe *pi)
 	int flag = do_repeat ? CMD_FLAG_REPEAT : 0;
 	struct child_prog *child;
 	char *p;
+	int sp;
 # if __GNUC__
 	/* Avoid longjmp clobbering */
 	(void) &i;
@@ -1617,6 +1650,8 @@ static int run_pipe_real(struct pipe *pi)
 			}
 			return EXIT_SUCCESS;   /* don't worry about errors in set_local_var() yet */
 		}
+		/* The pipe may be run again, so do not modify child->sp */
+		sp = child->sp;
 		for (i = 0; is_assignment(child->argv[i]); i++) {
 			p = insert_var_value(child->argv[i]);
 #ifndef __U_BOOT__
@@ -1625,11 +1660,11 @@ static int run_pipe_real(struct pipe *pi)
 			set_local_var(p, 0);
 #endif
 			if (p != child->argv[i]) {
-				child->sp--;
+				sp--;
 				free(p);
 			}
 		}
-		if (child->sp) {
+		if (sp) {
 			char * str = NULL;
 
 			str = make_string(child->argv + i,
@@ -1757,11 +1792,29 @@ static int run_pipe_real(struct pipe *pi)
 	return -1;
 }
 
+/* Give back the loop variable of a "for" that did not run to its end, the
+ * pipe may be run again */
+static void restore_for_list(struct pipe *pi, char **list, char **save_list,
+			     char *save_name)
+{
+	if (!save_list)
+		return;
+	free(pi->progs->argv[0]);
+	while (*list)
+		free(*list++);
+	free(save_list);
+	pi->progs->argv[0] = save_name;
+#ifndef __U_BOOT__
+	pi->progs->glob_result.gl_pathv[0] = pi->progs->argv[0];
+#endif
+}
+
 static int run_list_real(struct pipe *pi)
 {
 	char *save_name = NULL;
 	char **list = NULL;
 	char **save_list = NULL;
+	struct pipe *for_pipe = NULL;
 	struct pipe *rpipe;
 	int flag_rep = 0;
 #ifndef __U_BOOT__
@@ -1801,6 +1854,8 @@ static int run_list_real(struct pipe *pi)
 				/* check Ctrl-C */
 				ctrlc();
 				if ((had_ctrlc())) {
+					restore_for_list(for_pipe, list,
+							 save_list, save_name);
 					return 1;
 				}
 #endif
@@ -1831,12 +1886,14 @@ static int run_list_real(struct pipe *pi)
 					pi->progs->argv[0]);
 				save_list = list;
 				save_name = pi->progs->argv[0];
+				for_pipe = pi;
 				pi->progs->argv[0] = NULL;
 				flag_rep = 1;
 			}
 			if (!(*list)) {
 				free(pi->progs->argv[0]);
 				free(save_list);
+				save_list = NULL;
 				list = NULL;
 				flag_rep = 0;
 				pi->progs->argv[0] = save_name;
@@ -1900,6 +1957,7 @@ static int run_list_real(struct pipe *pi)
 #else
 		if (rcode < -1) {
 			last_return_code = -rcode - 2;
+			restore_for_list(for_pipe, list, save_list, save_name);
 			return rcode;	/* exit */
 		}
 		last_return_code=(rcode == 0) ? 0 : 1;
@@ -1920,6 +1978,7 @@ static int run_list_real(struct pipe *pi)
 		checkjobs(NULL);
 #endif
 	}
+	restore_for_list(for_pipe, list, save_list, save_name);
 	return rcode;
 }
 
@@ -2012,16 +2071,32 @@ static int free_pipe_list(struct pipe *head, int indent)
 	return rcode;
 }
 
+#ifdef __U_BOOT__
+/* Run a list, the outermost level accounts the time in bootstage */
+static int run_list_outer(struct pipe *pi)
+{
+	int rcode;
+
+	if (!run_depth++)
+		bootstage_start(BOOTSTAGE_ID_ACCUM_HUSH_RUN, "hush_run");
+	rcode = run_list_real(pi);
+	if (!--run_depth)
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_HUSH_RUN);
+
+	return rcode;
+}
+#endif
+
 /* Select which version we will use */
 static int run_list(struct pipe *pi)
 {
 	int rcode=0;
 #ifndef __U_BOOT__
 	if (fake_mode==0) {
-#endif
 		rcode = run_list_real(pi);
-#ifndef __U_BOOT__
 	}
+#else
+	rcode = run_list_outer(pi);
 #endif
 	/* free_pipe_list has the side effect of clearing memory
 	 * In the long run that function can be merged with run_list_real,
@@ -3186,9 +3261,135 @@ static void update_ifs_map(void)
 	mapset(ifs, 2);            /* also flow through if quoted */
 }
 
+#ifdef __U_BOOT__
+static unsigned int hush_cache_hash(const char *s)
+{
+	unsigned int hash = 2166136261U;
+
+	while (*s)
+		hash = (hash ^ (unsigned char)*s++) * 16777619U;
+
+	return hash;
+}
+
+static void hush_cache_free(struct hush_cache *hc)
+{
+	int i;
+
+	for (i = 0; i < hc->count; i++)
+		free_pipe_list(hc->lists[i], 0);
+	free(hc->lists);
+	free(hc->text);
+	memset(hc, 0, sizeof(*hc));
+}
+
+/*
+ * Look up the parse trees for script s. Return the entry with ready set if the
+ * script was already parsed, a new entry that parse_stream_outer() fills in
+ * or NULL if the script must be parsed without caching.
+ */
+static struct hush_cache *hush_cache_get(const char *s, int flag)
+{
+	struct hush_cache *hc, *victim = NULL;
+	unsigned int hash;
+
+	/*
+	 * IFS changes the way the text is split into words. Substituted
+	 * command lines would only push the scripts out of the cache.
+	 */
+	if (!IS_ENABLED(CONFIG_HUSH_PARSE_CACHE) || (flag & FLAG_REPARSING)
+	    || env_get("IFS"))
+		return NULL;
+
+	hash = hush_cache_hash(s);
+	for (hc = hush_cache; hc < hush_cache + HUSH_CACHE_SLOTS; hc++) {
+		if (hc->text && hc->hash == hash && hc->flag == flag
+		    && !strcmp(hc->text, s)) {
+			/* Running recursively: parse again */
+			if (hc->busy)
+				return NULL;
+			hc->busy = 1;
+			return hc;
+		}
+		if (hc->busy)
+			continue;
+		if (!victim || !hc->text
+		    || (victim->text && hc->stamp < victim->stamp))
+			victim = hc;
+	}
+	if (!victim)
+		return NULL;
+
+	hush_cache_free(victim);
+	victim->text = strdup(s);
+	if (!victim->text)
+		return NULL;
+	victim->hash = hash;
+	victim->flag = flag;
+	victim->busy = 1;
+
+	return victim;
+}
+
+/* Release an entry from hush_cache_get(); drop it if it is incomplete */
+static void hush_cache_put(struct hush_cache *hc)
+{
+	if (!hc)
+		return;
+	hc->busy = 0;
+	hc->stamp = ++hush_cache_stamp;
+	if (hc->ready)
+		return;
+	if (hc->failed)
+		hush_cache_free(hc);
+	else
+		hc->ready = 1;
+}
+
+/* Append a list that was run while parsing hc */
+static void hush_cache_add(struct hush_cache *hc, struct pipe *pi)
+{
+	struct pipe **lists;
+
+	lists = realloc(hc->lists, (hc->count + 1) * sizeof(*lists));
+	if (!lists) {
+		free_pipe_list(pi, 0);
+		hc->failed = 1;
+		return;
+	}
+	lists[hc->count++] = pi;
+	hc->lists = lists;
+}
+
+/* Same as parse_stream_outer(), but with the lists parsed before */
+static int hush_cache_run(struct hush_cache *hc)
+{
+	int code = 1;
+	int i;
+
+	for (i = 0; i < hc->count; i++) {
+		code = run_list_outer(hc->lists[i]);
+		if (code <= -2) {	/* exit */
+			code = last_return_code;
+			break;
+		}
+		if (code == -1)
+			flag_repeat = 0;
+	}
+	hush_cache_put(hc);
+
+	return (code != 0) ? 1 : 0;
+}
+#endif
+
 /* most recursion does not come through here, the exeception is
  * from builtin_source() */
+#ifndef __U_BOOT__
 static int parse_stream_outer(struct in_str *inp, int flag)
+#else
+static int parse_stream_outer(struct in_str *inp, int flag,
+			      struct hush_cache *hc)
+#endif
 {
 
 	struct p_context ctx;
@@ -3203,9 +3404,17 @@ static int parse_stream_outer(struct in_str *inp, int flag)
 		update_ifs_map();
 		if (!(flag & FLAG_PARSE_SEMICOLON) || (flag & FLAG_REPARSING)) mapset((uchar *)";$&|", 0);
 		inp->promptmode=1;
+#ifdef __U_BOOT__
+		/* Reading from the console would account the typing time */
+		if (inp->peek == static_peek)
+			bootstage_start(BOOTSTAGE_ID_ACCUM_HUSH_PARSE,
+					"hush_parse");
+#endif
 		rcode = parse_stream(&temp, &ctx, inp,
 				     flag & FLAG_CONT_ON_NEWLINE ? -1 : '\n');
 #ifdef __U_BOOT__
+		if (inp->peek == static_peek)
+			bootstage_accum(BOOTSTAGE_ID_ACCUM_HUSH_PARSE);
 		if (rcode == 1) flag_repeat = 0;
 #endif
 		if (rcode != 1 && ctx.old_flag != 0) {
@@ -3220,8 +3429,16 @@ static int parse_stream_outer(struct in_str *inp, int flag)
 #ifndef __U_BOOT__
 			run_list(ctx.list_head);
 #else
-			code = run_list(ctx.list_head);
+			if (hc) {
+				/* Keep the list to run it again next time */
+				code = run_list_outer(ctx.list_head);
+				hush_cache_add(hc, ctx.list_head);
+			} else {
+				code = run_list(ctx.list_head);
+			}
 			if (code <= -2) {	/* exit */
+				if (hc)
+					hc->failed = 1;
 				b_free(&temp);
 				code = last_return_code;
 				/* XXX hackish way to not allow exit from main loop */
@@ -3242,6 +3459,8 @@ static int parse_stream_outer(struct in_str *inp, int flag)
 #ifdef __U_BOOT__
 			if (inp->__promptme == 0) printf("<INTERRUPT>\n");
 			inp->__promptme = 1;
+			if (hc)
+				hc->failed = 1;
 #endif
 			temp.nonnull = 0;
 			temp.quote = 0;
@@ -3267,26 +3486,32 @@ int parse_string_outer(const char *s, int flag)
 {
 	struct in_str input;
 #ifdef __U_BOOT__
+	struct hush_cache *hc;
 	char *p = NULL;
 	int rcode;
 	if (!s)
 		return 1;
 	if (!*s)
 		return 0;
+	hc = hush_cache_get(s, flag);
+	if (hc && hc->ready)
+		return hush_cache_run(hc);
 	if (!(p = strchr(s, '\n')) || *++p) {
 		p = xmalloc(strlen(s) + 2);
 		strcpy(p, s);
 		strcat(p, "\n");
 		setup_string_in_str(&input, p);
-		rcode = parse_stream_outer(&input, flag);
+		rcode = parse_stream_outer(&input, flag, hc);
 		free(p);
-		return rcode;
 	} else {
-#endif
+		setup_string_in_str(&input, s);
+		rcode = parse_stream_outer(&input, flag, hc);
+	}
+	hush_cache_put(hc);
+	return rcode;
+#else
 	setup_string_in_str(&input, s);
 	return parse_stream_outer(&input, flag);
-#ifdef __U_BOOT__
-	}
 #endif
 }
 
@@ -3303,7 +3528,11 @@ int parse_file_outer(void)
 #else
 	setup_file_in_str(&input);
 #endif
+#ifndef __U_BOOT__
 	rcode = parse_stream_outer(&input, FLAG_PARSE_SEMICOLON);
+#else
+	rcode = parse_stream_outer(&input, FLAG_PARSE_SEMICOLON, NULL);
+#endif
 	return rcode;
 }
 
@@ -580,6 +580,7 @@ static inline void malloc_bin_reloc(void) {}
 #ifdef CONFIG_SYS_MALLOC_DEFAULT_TO_INIT
 static void malloc_init(void);
 #endif
+static void malloc_cache_reset(void);
 
 ulong mem_malloc_start = 0;
 ulong mem_malloc_end = 0;
@@ -615,6 +616,8 @@ void mem_malloc_init(ulong start, ulong size)
 	malloc_init();
 #endif
 
+	malloc_cache_reset();
+
 	debug("using memory %#lx-%#lx for malloc()\n", mem_malloc_start,
 	      mem_malloc_end);
 #ifdef CONFIG_SYS_MALLOC_CLEAR_ON_INIT
@@ -750,6 +753,243 @@ static void malloc_init(void)
 }
 #endif
 
+/*
+  Statistics for the malloc command
+*/
+
+#if CONFIG_IS_ENABLED(CMD_MALLOC)
+static struct malloc_info malloc_counts;
+#define MALLOC_COUNT(field)	(malloc_counts.field++)
+#else
+#define MALLOC_COUNT(field)	do { } while (0)
+#endif
+
+#if __STD_C
+static void free_chunk(Void_t* mem);
+#else
+static void free_chunk();
+#endif
+
+/*
+  Size-class cache
+
+    In U-Boot proper, freed chunks of up to CACHE_MAX_SIZE bytes are not
+    consolidated but kept in a LIFO list per chunk size. malloc() takes
+    a chunk of exactly the requested size from there without searching
+    the bins. This serves the many small and short-lived allocations of
+    file systems and drivers in constant time for both malloc() and free().
+
+    Freed chunks of up to POOL_MAX_SIZE bytes that came from memalign()
+    are kept in a small pool that is searched by memalign(), so that
+    bounce buffers and malloc_cache_aligned() tables do not need to be cut
+    out of a larger chunk each time. To know which chunks came from
+    memalign(), the last POOL_TRACK of them are remembered; a chunk that
+    is not found there any more is simply freed.
+
+    The chunks in the cache still look allocated to the rest of malloc.
+    Only chunks without free neighbours are kept, as the others would be
+    merged by free(). Pool chunks may have small free neighbours, because
+    memalign() cuts them out of a larger chunk and gives back the rest.
+    A neighbour that is freed later can not merge with a cached chunk
+    either until the cache is flushed. So the cache and the pool together
+    hold at most CACHE_MAX_BYTES, and all of it is given back before the
+    heap is extended.
+*/
+
+#if CONFIG_IS_ENABLED(SYS_MALLOC_CACHE)
+#define CACHE_MAX_SIZE    request2size(256)
+#define CACHE_CLASSES     (CACHE_MAX_SIZE / MALLOC_ALIGNMENT + 1)
+#define CACHE_MAX_BYTES   (64 << 10)  /* for size classes and pool */
+#define POOL_SLOTS        8
+#define POOL_MAX_SIZE     (32 << 10)
+#define POOL_TRACK        16
+
+static mchunkptr cache_class[CACHE_CLASSES];
+static unsigned long cache_bytes;
+static mchunkptr pool[POOL_SLOTS];
+static unsigned long pool_bytes;
+static int pool_next;
+static mchunkptr pool_track[POOL_TRACK];
+static int pool_track_next;
+
+#define malloc_cached_bytes() (cache_bytes + pool_bytes)
+
+/* Remember a chunk returned by memalign(), only these go to the pool */
+static void malloc_pool_track(mchunkptr p)
+{
+  if (chunksize(p) > POOL_MAX_SIZE)
+    return;
+  pool_track[pool_track_next] = p;
+  pool_track_next = (pool_track_next + 1) % POOL_TRACK;
+}
+
+/* Forget a chunk, return 1 if it was returned by memalign() */
+static int malloc_pool_untrack(mchunkptr p)
+{
+  int i;
+
+  /* memalign() chunks have more than MALLOC_ALIGNMENT */
+  if ((unsigned long)chunk2mem(p) & (2 * MALLOC_ALIGNMENT - 1))
+    return 0;
+
+  for (i = 0; i < POOL_TRACK; i++)
+  {
+    if (pool_track[i] == p)
+    {
+      pool_track[i] = NULL;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* Keep a freed chunk, return 0 if it is to be freed for real */
+static int malloc_cache_put(mchunkptr p)
+{
+  INTERNAL_SIZE_T sz = chunksize(p);
+  mchunkptr next = chunk_at_offset(p, sz);
+  mchunkptr old;
+  int aligned = malloc_pool_untrack(p);
+
+  /* A chunk that can be merged with a free neighbour is better freed, this
+     keeps the heap from fragmenting */
+  if (next == top)
+    return 0;
+
+  if (sz <= CACHE_MAX_SIZE)
+  {
+    if (!prev_inuse(p) || !inuse(next))
+      return 0;
+    if (malloc_cached_bytes() + sz > CACHE_MAX_BYTES)
+      return 0;
+    p->fd = cache_class[sz / MALLOC_ALIGNMENT];
+    cache_class[sz / MALLOC_ALIGNMENT] = p;
+    cache_bytes += sz;
+    return 1;
+  }
+
+  /* memalign() gives back the space before and after the aligned chunk,
+     so small free neighbours are accepted here */
+  if (!aligned || (!prev_inuse(p) && p->prev_size > CACHE_MAX_SIZE) ||
+      (!inuse(next) && chunksize(next) > CACHE_MAX_SIZE))
+    return 0;
+
+  /* Replace the oldest entry */
+  old = pool[pool_next];
+  if (malloc_cached_bytes() - (old ? chunksize(old) : 0) + sz
+      > CACHE_MAX_BYTES)
+    return 0;
+  pool[pool_next] = p;
+  pool_next = (pool_next + 1) % POOL_SLOTS;
+  pool_bytes += sz;
+  if (old)
+  {
+    pool_bytes -= chunksize(old);
+    free_chunk(chunk2mem(old));
+  }
+
+  return 1;
+}
+
+/* Get a chunk of exactly nb bytes from the size classes */
+static mchunkptr malloc_cache_get(INTERNAL_SIZE_T nb)
+{
+  mchunkptr p;
+
+  if (nb > CACHE_MAX_SIZE)
+    return NULL;
+  p = cache_class[nb / MALLOC_ALIGNMENT];
+  if (p)
+  {
+    cache_class[nb / MALLOC_ALIGNMENT] = p->fd;
+    cache_bytes -= nb;
+  }
+
+  return p;
+}
+
+/* Get the best fitting chunk of at least nb bytes with this alignment */
+static mchunkptr malloc_pool_get(INTERNAL_SIZE_T nb, size_t alignment)
+{
+  mchunkptr p, remainder;
+  long remainder_size;
+  int i, best = -1;
+
+  for (i = 0; i < POOL_SLOTS; i++)
+  {
+    p = pool[i];
+    if (p && chunksize(p) >= nb &&
+	!((unsigned long)chunk2mem(p) & (alignment - 1)) &&
+	(best < 0 || chunksize(p) < chunksize(pool[best])))
+      best = i;
+  }
+  if (best < 0)
+    return NULL;
+
+  p = pool[best];
+  pool[best] = NULL;
+  pool_bytes -= chunksize(p);
+
+  /* Give back spare room at the end */
+  remainder_size = chunksize(p) - nb;
+  if (remainder_size >= (long)MINSIZE)
+  {
+    remainder = chunk_at_offset(p, nb);
+    set_head(remainder, remainder_size | PREV_INUSE);
+    set_head_size(p, nb);
+    free_chunk(chunk2mem(remainder));
+  }
+
+  return p;
+}
+
+/* Free all cached chunks, return 1 if there were any */
+static int malloc_cache_flush(void)
+{
+  mchunkptr p;
+  int i, found = cache_bytes || pool_bytes;
+
+  for (i = 0; i < CACHE_CLASSES; i++)
+  {
+    while ((p = cache_class[i]))
+    {
+      cache_class[i] = p->fd;
+      free_chunk(chunk2mem(p));
+    }
+  }
+  for (i = 0; i < POOL_SLOTS; i++)
+  {
+    if (pool[i])
+      free_chunk(chunk2mem(pool[i]));
+    pool[i] = NULL;
+  }
+  cache_bytes = 0;
+  pool_bytes = 0;
+
+  return found;
+}
+
+static void malloc_cache_reset(void)
+{
+  memset(cache_class, 0, sizeof(cache_class));
+  memset(pool, 0, sizeof(pool));
+  memset(pool_track, 0, sizeof(pool_track));
+  cache_bytes = 0;
+  pool_bytes = 0;
+}
+#else
+static inline void malloc_pool_track(mchunkptr p) {}
+static inline int malloc_pool_untrack(mchunkptr p) { return 0; }
+static inline int malloc_cache_put(mchunkptr p) { return 0; }
+static inline mchunkptr malloc_cache_get(INTERNAL_SIZE_T nb) { return NULL; }
+static inline mchunkptr malloc_pool_get(INTERNAL_SIZE_T nb,
+					size_t alignment) { return NULL; }
+static inline int malloc_cache_flush(void) { return 0; }
+static inline void malloc_cache_reset(void) {}
+#define malloc_cached_bytes() 0
+#endif
+
 /*
   Debugging support
 */
@@ -1192,7 +1432,7 @@ static void malloc_extend_top(nb) INTERNAL_SIZE_T nb;
 	SIZE_SZ|PREV_INUSE;
       /* If possible, release the rest. */
       if (old_top_size >= MINSIZE)
-	fREe(chunk2mem(old_top));
+	free_chunk(chunk2mem(old_top));
     }
   }
 
@@ -1304,8 +1544,22 @@ Void_t* mALLOc(bytes) size_t bytes;
 
   if ((long)bytes < 0) return NULL;
 
+  MALLOC_COUNT(malloc_count);
+
   nb = request2size(bytes);  /* padded request size; */
 
+  /* Reuse a cached chunk of the same size */
+
+  victim = malloc_cache_get(nb);
+  if (victim)
+  {
+    MALLOC_COUNT(cache_hits);
+    check_inuse_chunk(victim);
+    return chunk2mem(victim);
+  }
+
+retry:
+
   /* Check for exact match in a bin */
 
   if (is_small_request(nb))  /* Faster version for small requests */
@@ -1502,10 +1756,18 @@ Void_t* mALLOc(bytes) size_t bytes;
       return chunk2mem(victim);
 #endif
 
+    /* Give back the cached chunks before growing the heap, merged with
+       their neighbours they may be large enough */
+    if (malloc_cache_flush())
+      goto retry;
+
     /* Try to extend */
     malloc_extend_top(nb);
     if ( (remainder_size = chunksize(top) - nb) < (long)MINSIZE)
+    {
+      MALLOC_COUNT(fail_count);
       return NULL; /* propagate failure */
+    }
   }
 
   victim = top;
@@ -1543,9 +1805,9 @@ Void_t* mALLOc(bytes) size_t bytes;
 
 
 #if __STD_C
-void fREe(Void_t* mem)
+static void free_chunk(Void_t* mem)
 #else
-void fREe(mem) Void_t* mem;
+static void free_chunk(mem) Void_t* mem;
 #endif
 {
   mchunkptr p;         /* chunk corresponding to mem */
@@ -1640,6 +1902,28 @@ void fREe(mem) Void_t* mem;
     frontlink(p, sz, idx, bck, fwd);
 }
 
+#if __STD_C
+void fREe(Void_t* mem)
+#else
+void fREe(mem) Void_t* mem;
+#endif
+{
+#if CONFIG_VAL(SYS_MALLOC_F_LEN)
+	/* free() is a no-op - all the memory will be freed on relocation */
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		return;
+#endif
+
+  if (mem == NULL)                              /* free(0) has no effect */
+    return;
+
+  MALLOC_COUNT(free_count);
+
+  check_inuse_chunk(mem2chunk(mem));
+  if (!malloc_cache_put(mem2chunk(mem)))
+    free_chunk(mem);
+}
+
 
 
 
@@ -1719,6 +2003,8 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
   /* realloc of null is supposed to be same as malloc */
   if (oldmem == NULL) return mALLOc(bytes);
 
+  MALLOC_COUNT(realloc_count);
+
 #if CONFIG_VAL(SYS_MALLOC_F_LEN)
 	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT)) {
 		/* This is harder to support and should not be needed */
@@ -1729,6 +2015,9 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
   newp    = oldp    = mem2chunk(oldmem);
   newsize = oldsize = chunksize(oldp);
 
+  /* The result is no memalign() buffer anymore */
+  malloc_pool_untrack(oldp);
+
 
   nb = request2size(bytes);
 
@@ -1876,7 +2165,7 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
     set_head_size(newp, nb);
     set_head(remainder, remainder_size | PREV_INUSE);
     set_inuse_bit_at_offset(remainder, remainder_size);
-    fREe(chunk2mem(remainder)); /* let free() deal with it */
+    free_chunk(chunk2mem(remainder)); /* let free() deal with it */
   }
   else
   {
@@ -1943,13 +2232,27 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
 
   if (alignment <= MALLOC_ALIGNMENT) return mALLOc(bytes);
 
+  MALLOC_COUNT(memalign_count);
+
+  nb = request2size(bytes);
+
+  /* Try a freed memalign() buffer first */
+
+  p = malloc_pool_get(nb, alignment);
+  if (p)
+  {
+    MALLOC_COUNT(pool_hits);
+    check_inuse_chunk(p);
+    malloc_pool_track(p);
+    return chunk2mem(p);
+  }
+
   /* Otherwise, ensure that it is at least a minimum chunk size */
 
   if (alignment <  MINSIZE) alignment = MINSIZE;
 
   /* Call malloc with worst case padding to hit alignment. */
 
-  nb = request2size(bytes);
   m  = (char*)(mALLOc(nb + alignment + MINSIZE));
 
   /*
@@ -1969,24 +2272,36 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
     m  = (char*)(mALLOc(bytes));
     /* Aligned -> return it */
     if ((((unsigned long)(m)) % alignment) == 0)
+    {
+      if (m)
+        malloc_pool_track(mem2chunk(m));
       return m;
+    }
     /*
      * Otherwise, try again, requesting enough extra space to be able to
-     * acquire alignment.
+     * acquire alignment. Bypass the cache, so that the chunk is merged
+     * and m is likely to be returned again.
+     */
+    free_chunk(m);
+    /*
+     * Add in extra bytes to match misalignment of unexpanded allocation. The
+     * leader that is given back must be a chunk of its own, so if it would
+     * be smaller than MINSIZE, the next aligned spot is used below.
      */
-    fREe(m);
-    /* Add in extra bytes to match misalignment of unexpanded allocation */
     extra = alignment - (((unsigned long)(m)) % alignment);
+    if (extra < MINSIZE)
+      extra += alignment;
     m  = (char*)(mALLOc(bytes + extra));
     /*
      * m might not be the same as before. Validate that the previous value of
      * extra still works for the current value of m.
-     * If (!m), extra2=alignment so 
      */
     if (m) {
-      extra2 = alignment - (((unsigned long)(m)) % alignment);
+      extra2 = (alignment - (((unsigned long)(m)) % alignment)) % alignment;
+      if (extra2 && extra2 < MINSIZE)
+        extra2 += alignment;
       if (extra2 > extra) {
-        fREe(m);
+        free_chunk(m);
         m = NULL;
       }
     }
@@ -2036,7 +2351,7 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
     set_head(newp, newsize | PREV_INUSE);
     set_inuse_bit_at_offset(newp, newsize);
     set_head_size(p, leadsize);
-    fREe(chunk2mem(p));
+    free_chunk(chunk2mem(p));
     p = newp;
 
     assert (newsize >= nb && (((unsigned long)(chunk2mem(p))) % alignment) == 0);
@@ -2051,10 +2366,11 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
     remainder = chunk_at_offset(p, nb);
     set_head(remainder, remainder_size | PREV_INUSE);
     set_head_size(p, nb);
-    fREe(chunk2mem(remainder));
+    free_chunk(chunk2mem(remainder));
   }
 
   check_inuse_chunk(p);
+  malloc_pool_track(p);
   return chunk2mem(p);
 
 }
@@ -2297,7 +2613,7 @@ size_t malloc_usable_size(mem) Void_t* mem;
 
 /* Utility to update current_mallinfo for malloc_stats and mallinfo() */
 
-#ifdef DEBUG
+#if defined(DEBUG) || CONFIG_IS_ENABLED(CMD_MALLOC)
 static void malloc_update_mallinfo()
 {
   int i;
@@ -2327,15 +2643,20 @@ static void malloc_update_mallinfo()
     }
   }
 
+  /* Cached chunks are free for the user of malloc */
+  avail += malloc_cached_bytes();
+
   current_mallinfo.ordblks = navail;
   current_mallinfo.uordblks = sbrked_mem - avail;
   current_mallinfo.fordblks = avail;
+#ifdef DEBUG
   current_mallinfo.hblks = n_mmaps;
+#endif
   current_mallinfo.hblkhd = mmapped_mem;
   current_mallinfo.keepcost = chunksize(top);
 
 }
-#endif	/* DEBUG */
+#endif	/* DEBUG || CMD_MALLOC */
 
 
 
@@ -2383,6 +2704,20 @@ struct mallinfo mALLINFo()
 }
 #endif	/* DEBUG */
 
+#if CONFIG_IS_ENABLED(CMD_MALLOC)
+void malloc_get_info(struct malloc_info *info)
+{
+  malloc_update_mallinfo();
+  *info = malloc_counts;
+  info->heap_size = mem_malloc_end - mem_malloc_start;
+  info->sys_bytes = sbrked_mem;
+  info->max_sys_bytes = max_sbrked_mem;
+  info->in_use = current_mallinfo.uordblks;
+  info->free = current_mallinfo.fordblks;
+  info->cached = malloc_cached_bytes();
+}
+#endif
+
 
 
 
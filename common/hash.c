@@ -17,6 +17,7 @@
 #include <malloc.h>
 #include <mapmem.h>
 #include <hw_sha.h>
+#include <watchdog.h>
 #include <asm/cache.h>
 #include <asm/global_data.h>
 #include <asm/io.h>
@@ -362,6 +363,96 @@ int hash_progressive_lookup_algo(const char *algo_name,
 	return -EPROTONOSUPPORT;
 }
 
+int hash_finish_block(struct hash_algo *algo, void *ctx, uint8_t *output)
+{
+	int ret;
+
+	ret = algo->hash_finish(algo, ctx, output, algo->digest_size);
+	if (ret)
+		return ret;
+
+	/* Store checksums in big endian like hash_block() does */
+	if (!strcmp(algo->name, "crc32")) {
+		uint32_t crc = *(uint32_t *)output;
+
+		crc = cpu_to_be32(crc);
+		memcpy(output, &crc, sizeof(crc));
+	} else if (!strcmp(algo->name, "crc16-ccitt")) {
+		uint16_t crc = *(uint16_t *)output;
+
+		crc = cpu_to_be16(crc);
+		memcpy(output, &crc, sizeof(crc));
+	}
+
+	return 0;
+}
+
+/*
+ * Block size for hash_multi_block(). Each block is passed to all algorithms
+ * in turn, so it should fit well into the L1 data cache. Then the data is
+ * only read once from RAM, no matter how many algorithms are used.
+ */
+#define HASH_MULTI_BLOCK_SIZE	(4 * 1024)
+
+int hash_multi_block(struct hash_algo *const algos[], int count,
+		     const void *data, unsigned int len,
+		     uint8_t *const outputs[])
+{
+	void *ctx[HASH_MULTI_MAX];
+	uint8_t dummy[HASH_MAX_DIGEST_SIZE];
+	const uint8_t *buf = data;
+	unsigned int size;
+	int is_last;
+	int ret = 0;
+	int i;
+
+	if ((count < 1) || (count > HASH_MULTI_MAX))
+		return -EINVAL;
+
+	for (i = 0; i < count; i++) {
+		ret = algos[i]->hash_init(algos[i], &ctx[i]);
+		if (ret) {
+			count = i;
+			goto out;
+		}
+	}
+
+	do {
+		size = (len < HASH_MULTI_BLOCK_SIZE) ? len : HASH_MULTI_BLOCK_SIZE;
+		len -= size;
+		is_last = !len;
+		for (i = 0; i < count; i++) {
+			ret = algos[i]->hash_update(algos[i], ctx[i], buf,
+						    size, is_last);
+			if (ret) {
+				/* The context of algos[i] is already freed */
+				ctx[i] = NULL;
+				goto out;
+			}
+		}
+		buf += size;
+#if !defined(USE_HOSTCC) && \
+	(defined(CONFIG_HW_WATCHDOG) || defined(CONFIG_WATCHDOG))
+		WATCHDOG_RESET();
+#endif
+	} while (len);
+
+out:
+	/* Always finish all contexts, this also frees them */
+	for (i = 0; i < count; i++) {
+		uint8_t *output = ret ? dummy : outputs[i];
+		int err;
+
+		if (!ctx[i])
+			continue;
+		err = hash_finish_block(algos[i], ctx[i], output);
+		if (err && !ret)
+			ret = err;
+	}
+
+	return ret;
+}
+
 #ifndef USE_HOSTCC
 int hash_parse_string(const char *algo_name, const char *str, uint8_t *result)
 {
@@ -527,6 +618,60 @@ static void hash_show(struct hash_algo *algo, ulong addr, ulong len, uint8_t *ou
 		printf("%02x", output[i]);
 }
 
+/*
+ * Compute several message digests in a single pass over the data; the
+ * algorithm names are separated by commas, e.g. "crc32,sha256"
+ */
+static int hash_command_multi(const char *algo_names, ulong addr, ulong len)
+{
+	struct hash_algo *algos[HASH_MULTI_MAX];
+	uint8_t *outputs[HASH_MULTI_MAX];
+	char names[64];
+	char *s = names;
+	char *name;
+	u8 *output;
+	void *buf;
+	int count = 0;
+	int ret, i;
+
+	strlcpy(names, algo_names, sizeof(names));
+	while ((name = strsep(&s, ","))) {
+		if (count >= HASH_MULTI_MAX) {
+			printf("Too many hash algorithms, max. %d\n",
+			       HASH_MULTI_MAX);
+			return CMD_RET_USAGE;
+		}
+		if (hash_progressive_lookup_algo(name, &algos[count])) {
+			printf("Unknown hash algorithm '%s'\n", name);
+			return CMD_RET_USAGE;
+		}
+		count++;
+	}
+
+	output = memalign(ARCH_DMA_MINALIGN,
+			  HASH_MULTI_MAX * HASH_MAX_DIGEST_SIZE);
+	if (!output)
+		return CMD_RET_FAILURE;
+	for (i = 0; i < count; i++)
+		outputs[i] = output + i * HASH_MAX_DIGEST_SIZE;
+
+	buf = map_sysmem(addr, len);
+	ret = hash_multi_block(algos, count, buf, len, outputs);
+	unmap_sysmem(buf);
+
+	if (ret) {
+		printf("Error %d computing hashes\n", ret);
+	} else {
+		for (i = 0; i < count; i++) {
+			hash_show(algos[i], addr, len, outputs[i]);
+			printf("\n");
+		}
+	}
+	free(output);
+
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
+
 int hash_command(const char *algo_name, int flags, struct cmd_tbl *cmdtp,
 		 int flag, int argc, char *const argv[])
 {
@@ -544,6 +689,13 @@ int hash_command(const char *algo_name, int flags, struct cmd_tbl *cmdtp,
 		uint8_t vsum[HASH_MAX_DIGEST_SIZE];
 		void *buf;
 
+		if (strchr(algo_name, ',')) {
+			/* Verifying or storing needs a single algorithm */
+			if ((flags & HASH_FLAG_VERIFY) || (argc > 2))
+				return CMD_RET_USAGE;
+			return hash_command_multi(algo_name, addr, len);
+		}
+
 		if (hash_lookup_algo(algo_name, &algo)) {
 			printf("Unknown hash algorithm '%s'\n", algo_name);
 			return CMD_RET_USAGE;
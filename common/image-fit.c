@@ -1244,15 +1244,99 @@ int calculate_hash(const void *data, int data_len, const char *algo,
 	return 0;
 }
 
+/* Hash values of an image that were computed in a single pass */
+struct fit_hash_values {
+	int count;
+	int noffset[HASH_MULTI_MAX];
+	uint8_t value[HASH_MULTI_MAX][FIT_MAX_HASH_LEN];
+	int value_len[HASH_MULTI_MAX];
+};
+
+/*
+ * The common hash API is always available in the host tools, but on the
+ * target only if CONFIG_HASH is set
+ */
+#if defined(USE_HOSTCC) || (defined(CONFIG_HASH) && !defined(CONFIG_SPL_BUILD))
+#define FIT_MULTI_HASH	1
+#else
+#define FIT_MULTI_HASH	0
+#endif
+
+/**
+ * fit_image_calc_hashes - calculate all hashes of an image in one pass
+ * @fit: pointer to the FIT format image header
+ * @image_noffset: component image node offset
+ * @data: pointer to the image data
+ * @size: image data length
+ * @hv: pointer to the structure that receives the hash values
+ *
+ * Images usually have more than one hash node, e.g. crc32 and sha256.
+ * Instead of reading the image data once for each hash node, compute all
+ * hashes at once with hash_multi_block(). Hash nodes that are ignored or
+ * whose algorithm does not support progressive hashing are not included,
+ * fit_image_check_hash() calls calculate_hash() for them as before.
+ */
+static void fit_image_calc_hashes(const void *fit, int image_noffset,
+				  const void *data, size_t size,
+				  struct fit_hash_values *hv)
+{
+	struct hash_algo *algos[HASH_MULTI_MAX];
+	uint8_t *outputs[HASH_MULTI_MAX];
+	int noffset;
+	char *algo;
+	int ignore;
+	int i;
+
+	hv->count = 0;
+	if (!FIT_MULTI_HASH)
+		return;
+
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+
+		if (strncmp(name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (hv->count >= HASH_MULTI_MAX)
+			break;
+		if (fit_image_hash_get_algo(fit, noffset, &algo))
+			continue;
+		if (IMAGE_ENABLE_IGNORE) {
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+			if (ignore)
+				continue;
+		}
+		if (hash_progressive_lookup_algo(algo, &algos[hv->count]))
+			continue;
+		hv->noffset[hv->count] = noffset;
+		hv->value_len[hv->count] = algos[hv->count]->digest_size;
+		hv->count++;
+	}
+
+	/* A single hash is computed faster by calculate_hash() */
+	if (hv->count < 2) {
+		hv->count = 0;
+		return;
+	}
+
+	for (i = 0; i < hv->count; i++)
+		outputs[i] = hv->value[i];
+	if (hash_multi_block(algos, hv->count, data, size, outputs))
+		hv->count = 0;
+}
+
 static int fit_image_check_hash(const void *fit, int noffset, const void *data,
-				size_t size, char **err_msgp)
+				size_t size, const struct fit_hash_values *hv,
+				char **err_msgp)
 {
-	uint8_t value[FIT_MAX_HASH_LEN];
+	uint8_t value_buf[FIT_MAX_HASH_LEN];
+	const uint8_t *value = value_buf;
 	int value_len;
 	char *algo;
 	uint8_t *fit_value;
 	int fit_value_len;
 	int ignore;
+	int i;
 
 	*err_msgp = NULL;
 
@@ -1276,7 +1360,15 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
+	/* Use the value from the single pass if available */
+	for (i = 0; i < hv->count; i++) {
+		if (hv->noffset[i] == noffset)
+			break;
+	}
+	if (i < hv->count) {
+		value = hv->value[i];
+		value_len = hv->value_len[i];
+	} else if (calculate_hash(data, size, algo, value_buf, &value_len)) {
 		*err_msgp = "Unsupported hash algorithm";
 		return -1;
 	}
@@ -1298,6 +1390,7 @@ int fit_image_verify_with_data(const void *fit, int image_noffset,
 	int		noffset = 0;
 	char		*err_msg = "";
 	int verify_all = 1;
+	struct fit_hash_values hv;
 	int ret;
 
 	/* Verify all required signatures */
@@ -1308,6 +1401,9 @@ int fit_image_verify_with_data(const void *fit, int image_noffset,
 		goto error;
 	}
 
+	/* Compute the values of all hash subnodes in one pass */
+	fit_image_calc_hashes(fit, image_noffset, data, size, &hv);
+
 	/* Process all hash subnodes of the component image node */
 	fdt_for_each_subnode(noffset, fit, image_noffset) {
 		const char *name = fit_get_name(fit, noffset, NULL);
@@ -1320,7 +1416,7 @@ int fit_image_verify_with_data(const void *fit, int image_noffset,
 		if (!strncmp(name, FIT_HASH_NODENAME,
 			     strlen(FIT_HASH_NODENAME))) {
 			if (fit_image_check_hash(fit, noffset, data, size,
-						 &err_msg))
+						 &hv, &err_msg))
 				goto error;
 			puts("+ ");
 		} else if (FIT_IMAGE_ENABLE_VERIFY && verify_all &&
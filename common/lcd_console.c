@@ -44,6 +44,31 @@ int lcd_get_screen_columns(void)
 	return cons.cols;
 }
 
+#if LCD_BPP != LCD_MONOCHROME
+/*
+ * Pre-rendered character rows: for every possible byte of font data, the
+ * pixels of one character row in the current colors. Drawing a character is
+ * then just a copy of one table entry per row.
+ */
+static fbptr_t glyph_rows[256][VIDEO_FONT_WIDTH];
+static int glyph_fg, glyph_bg;
+static bool glyph_valid;
+
+static void lcd_init_glyph_rows(int fg_color, int bg_color)
+{
+	int bits, i;
+
+	for (bits = 0; bits < 256; bits++) {
+		for (i = 0; i < VIDEO_FONT_WIDTH; i++)
+			glyph_rows[bits][i] =
+				(bits & (0x80 >> i)) ? fg_color : bg_color;
+	}
+	glyph_fg = fg_color;
+	glyph_bg = bg_color;
+	glyph_valid = true;
+}
+#endif
+
 static void lcd_putc_xy0(struct console_t *pcons, ushort x, ushort y, char c)
 {
 	int fg_color = lcd_getfgcolor();
@@ -51,14 +76,17 @@ static void lcd_putc_xy0(struct console_t *pcons, ushort x, ushort y, char c)
 	int row;
 #if LCD_BPP == LCD_MONOCHROME
 	ushort off  = x * (1 << LCD_BPP) % 8;
-#else
-	int i;
 #endif
 
 	fbptr_t *dst = (fbptr_t *)pcons->fbbase +
 				  y * pcons->lcdsizex +
 				  x;
 
+#if LCD_BPP != LCD_MONOCHROME
+	if (!glyph_valid || fg_color != glyph_fg || bg_color != glyph_bg)
+		lcd_init_glyph_rows(fg_color, bg_color);
+#endif
+
 	for (row = 0; row < VIDEO_FONT_HEIGHT; row++) {
 		uchar bits = video_fontdata[c * VIDEO_FONT_HEIGHT + row];
 #if LCD_BPP == LCD_MONOCHROME
@@ -70,13 +98,11 @@ static void lcd_putc_xy0(struct console_t *pcons, ushort x, ushort y, char c)
 		*dst++ = rest | (sym >> off);
 		rest = sym << (8 - off);
 		*dst  = rest | (*dst & ((1 << (8 - off)) - 1));
+		dst += (pcons->lcdsizex - VIDEO_FONT_WIDTH);
 #else /* LCD_BPP == LCD_COLOR8 or LCD_COLOR16 or LCD_COLOR32 */
-		for (i = 0; i < VIDEO_FONT_WIDTH; ++i) {
-			*dst++ = (bits & 0x80) ? fg_color : bg_color;
-			bits <<= 1;
-		}
+		memcpy(dst, glyph_rows[bits], sizeof(glyph_rows[0]));
+		dst += pcons->lcdsizex;
 #endif
-		dst += (pcons->lcdsizex - VIDEO_FONT_WIDTH);
 	}
 }
 
@@ -94,7 +120,6 @@ static inline void console_setrow0(struct console_t *pcons, u32 row, int clr)
 static inline void console_moverow0(struct console_t *pcons,
 				    u32 rowdst, u32 rowsrc)
 {
-	int i;
 	fbptr_t *dst = (fbptr_t *)pcons->fbbase +
 				  rowdst * VIDEO_FONT_HEIGHT *
 				  pcons->lcdsizex;
@@ -103,8 +128,9 @@ static inline void console_moverow0(struct console_t *pcons,
 				  rowsrc * VIDEO_FONT_HEIGHT *
 				  pcons->lcdsizex;
 
-	for (i = 0; i < (VIDEO_FONT_HEIGHT * pcons->lcdsizex); i++)
-		*dst++ = *src++;
+	/* A text row is one contiguous block of full framebuffer lines */
+	memmove(dst, src,
+		VIDEO_FONT_HEIGHT * pcons->lcdsizex * sizeof(fbptr_t));
 }
 
 static inline void console_back(void)
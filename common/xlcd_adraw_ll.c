@@ -14,6 +14,7 @@
 #include <config.h>
 #include <common.h>
 #include <xlcd_adraw_ll.h>		 /* Own interface */
+#include <xlcd_draw_ll.h>		 /* draw_ll_char() */
 #include <cmd_lcd.h>			 /* wininfo_t */
 #include <video_font.h>			 /* Get font data, width and height */
 
@@ -121,6 +122,16 @@ void adraw_ll_char(const wininfo_t *pwi, XYPOS x, XYPOS y, char c,
 	COLOR32 mask = (1 << bpp) - 1;	  /* This also works for bpp==32! */
 	u_int shift = 32 - (xpos & 31);
 
+	/* Opaque colors on a true color format without alpha simply replace
+	   the pixels, so we can use the faster draw_ll_char() with its glyph
+	   cache */
+	if (!(pwi->ppi->flags & (PIF_CMAP | PIF_ALPHA))
+	    && ((pci_fg->rgba & 0xFF) == 0xFF)
+	    && ((attr & ATTR_NO_BG) || ((pci_bg->rgba & 0xFF) == 0xFF))) {
+		draw_ll_char(pwi, x, y, c, pci_fg->col, pci_bg->col);
+		return;
+	}
+
 	/* Compute framebuffer address of the pixel */
 	fbuf = linelen * y + ((xpos >> 5) << 2) + pwi->pfbuf[pwi->fbdraw];
 
@@ -207,6 +218,62 @@ void adraw_ll_char(const wininfo_t *pwi, XYPOS x, XYPOS y, char c,
 /* DRAWING BITMAP ROWS							*/
 /************************************************************************/
 
+#if defined(CONFIG_XLCD_PNG) || defined(CONFIG_XLCD_BMP) \
+	|| defined(CONFIG_XLCD_JPG)
+/* Fast version for true color rows on 32bpp framebuffers without horizontal
+   scaling; every pixel is exactly one word, so there is no shifting and
+   masking. Fully transparent pixels are skipped right away. ri, gi and bi
+   are the byte offsets of R, G and B in the bitmap pixel; if the pixel size
+   is 4, alpha is at offset 3. */
+static inline void adraw_ll_row_32bpp(imginfo_t *pii, COLOR32 *p, u_int ri,
+				      u_int gi, u_int bi, u_int psize)
+{
+	const wininfo_t *pwi = pii->pwi;
+	u_char *prow = pii->prow;
+	RGBA hash_rgba = pii->hash_rgba;
+	COLOR32 hash_col = pii->hash_col;
+	int count = pii->xend - pii->xpix;
+
+	do {
+		if (psize == 4) {
+			RGBA alpha1 = prow[3];
+
+			if (alpha1) {
+				colinfo_t ci;
+
+				ci.A256 = 256 - alpha1;
+				alpha1++;
+				ci.RA1 = prow[ri] * alpha1;
+				ci.GA1 = prow[gi] * alpha1;
+				ci.BA1 = prow[bi] * alpha1;
+				*p = pwi->ppi->apply_alpha(pwi, &ci, *p);
+			}
+		} else {
+			RGBA rgba;
+
+			rgba = prow[ri] << 24;
+			rgba |= prow[gi] << 16;
+			rgba |= prow[bi] << 8;
+			if (rgba != pii->trans_rgba) {
+				rgba |= 0xFF;
+				if (rgba != hash_rgba) {
+					hash_rgba = rgba;
+					hash_col = pwi->ppi->rgba2col(pwi,
+								      rgba);
+				}
+				*p = hash_col;
+			}
+		}
+		p++;
+		prow += psize;
+	} while (--count > 0);
+
+	pii->hash_rgba = hash_rgba;
+	pii->hash_col = hash_col;
+}
+#endif
+
+
 #if defined(CONFIG_XLCD_PNG) || defined(CONFIG_XLCD_BMP)
 /* Normal version for 1bpp, 2bpp, 4bpp */
 void adraw_ll_row_PAL(imginfo_t *pii, COLOR32 *p)
@@ -354,8 +421,10 @@ void adraw_ll_row_GA(imginfo_t *pii, COLOR32 *p)
 DONE:
 	*p = val;			  /* Store final value */
 }
+#endif /* CONFIG_XLCD_PNG */
 
 
+#if defined(CONFIG_XLCD_PNG) || defined(CONFIG_XLCD_JPG)
 void adraw_ll_row_RGB(imginfo_t *pii, COLOR32 *p)
 {
 	int xpix = pii->xpix;
@@ -364,6 +433,11 @@ void adraw_ll_row_RGB(imginfo_t *pii, COLOR32 *p)
 	const wininfo_t *pwi = pii->pwi;
 	u_char *prow = pii->prow;
 
+	if ((pii->bpp == 32) && (pii->multiwidth == 1)) {
+		adraw_ll_row_32bpp(pii, p, 0, 1, 2, 3);
+		return;
+	}
+
 	val = *p;
 	for (;;) {
 		RGBA rgba;
@@ -395,8 +469,10 @@ void adraw_ll_row_RGB(imginfo_t *pii, COLOR32 *p)
 DONE:
 	*p = val;			  /* Store final value */
 }
+#endif /* CONFIG_XLCD_PNG || CONFIG_XLCD_JPG */
 
 
+#ifdef CONFIG_XLCD_PNG
 void adraw_ll_row_RGBA(imginfo_t *pii, COLOR32 *p)
 {
 	int xpix = pii->xpix;
@@ -405,6 +481,11 @@ void adraw_ll_row_RGBA(imginfo_t *pii, COLOR32 *p)
 	const wininfo_t *pwi = pii->pwi;
 	u_char *prow = pii->prow;
 
+	if ((pii->bpp == 32) && (pii->multiwidth == 1)) {
+		adraw_ll_row_32bpp(pii, p, 0, 1, 2, 4);
+		return;
+	}
+
 	val = *p;
 	for (;;) {
 		RGBA alpha1;
@@ -451,6 +532,11 @@ void adraw_ll_row_BGR(imginfo_t *pii, COLOR32 *p)
 	const wininfo_t *pwi = pii->pwi;
 	u_char *prow = pii->prow;
 
+	if ((pii->bpp == 32) && (pii->multiwidth == 1)) {
+		adraw_ll_row_32bpp(pii, p, 2, 1, 0, 3);
+		return;
+	}
+
 	val = *p;
 	for (;;) {
 		RGBA rgba;
@@ -492,6 +578,11 @@ void adraw_ll_row_BGRA(imginfo_t *pii, COLOR32 *p)
 	const wininfo_t *pwi = pii->pwi;
 	u_char *prow = pii->prow;
 
+	if ((pii->bpp == 32) && (pii->multiwidth == 1)) {
+		adraw_ll_row_32bpp(pii, p, 2, 1, 0, 4);
+		return;
+	}
+
 	val = *p;
 	for (;;) {
 		RGBA alpha1;
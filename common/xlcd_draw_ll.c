@@ -114,6 +114,46 @@ void draw_ll_rect(const wininfo_t *pwi, XYPOS x1, XYPOS y1,
 /* DRAWING BITMAP ROWS							*/
 /************************************************************************/
 
+#if defined(CONFIG_XLCD_PNG) || defined(CONFIG_XLCD_BMP) \
+	|| defined(CONFIG_XLCD_JPG)
+/* Fast version for true color rows on 32bpp framebuffers without horizontal
+   scaling; every pixel is exactly one word, so there is no shifting and
+   masking. Runs of equal pixels, which are common in splash screens, reuse
+   the last conversion. ri, gi and bi are the byte offsets of R, G and B in
+   the bitmap pixel; if the pixel size is 4, alpha is at offset 3. */
+static inline void draw_ll_row_32bpp(imginfo_t *pii, COLOR32 *p, u_int ri,
+				     u_int gi, u_int bi, u_int psize)
+{
+	const wininfo_t *pwi = pii->pwi;
+	u_char *prow = pii->prow;
+	RGBA hash_rgba = pii->hash_rgba;
+	COLOR32 hash_col = pii->hash_col;
+	int count = pii->xend - pii->xpix;
+
+	do {
+		RGBA rgba;
+
+		rgba = prow[ri] << 24;
+		rgba |= prow[gi] << 16;
+		rgba |= prow[bi] << 8;
+		if (psize == 4)
+			rgba |= prow[3];
+		else if (rgba != pii->trans_rgba)
+			rgba |= 0xFF;
+		if (rgba != hash_rgba) {
+			hash_rgba = rgba;
+			hash_col = pwi->ppi->rgba2col(pwi, rgba);
+		}
+		*p++ = hash_col;
+		prow += psize;
+	} while (--count > 0);
+
+	pii->hash_rgba = hash_rgba;
+	pii->hash_col = hash_col;
+}
+#endif
+
+
 #if defined(CONFIG_XLCD_PNG) || defined(CONFIG_XLCD_BMP)
 /* Version for 1bpp, 2bpp and 4bpp */
 void draw_ll_row_PAL(imginfo_t *pii, COLOR32 *p)
@@ -233,8 +273,10 @@ DONE:
 	*p = val; /* Store final value */
 
 }
+#endif /* CONFIG_XLCD_PNG */
 
 
+#if defined(CONFIG_XLCD_PNG) || defined(CONFIG_XLCD_JPG)
 void draw_ll_row_RGB(imginfo_t *pii, COLOR32 *p)
 {
 	int xpix = pii->xpix;
@@ -243,6 +285,11 @@ void draw_ll_row_RGB(imginfo_t *pii, COLOR32 *p)
 	const wininfo_t *pwi = pii->pwi;
 	u_char *prow = pii->prow;
 
+	if ((pii->bpp == 32) && (pii->multiwidth == 1)) {
+		draw_ll_row_32bpp(pii, p, 0, 1, 2, 3);
+		return;
+	}
+
 	val = *p;
 	for (;;) {
 		RGBA rgba;
@@ -271,8 +318,10 @@ void draw_ll_row_RGB(imginfo_t *pii, COLOR32 *p)
 DONE:
 	*p = val; /* Store final value */
 }
+#endif /* CONFIG_XLCD_PNG || CONFIG_XLCD_JPG */
 
 
+#ifdef CONFIG_XLCD_PNG
 void draw_ll_row_RGBA(imginfo_t *pii, COLOR32 *p)
 {
 	int xpix = pii->xpix;
@@ -281,6 +330,11 @@ void draw_ll_row_RGBA(imginfo_t *pii, COLOR32 *p)
 	const wininfo_t *pwi = pii->pwi;
 	u_char *prow = pii->prow;
 
+	if ((pii->bpp == 32) && (pii->multiwidth == 1)) {
+		draw_ll_row_32bpp(pii, p, 0, 1, 2, 4);
+		return;
+	}
+
 	val = *p;
 	for (;;) {
 		RGBA rgba;
@@ -320,6 +374,11 @@ void draw_ll_row_BGR(imginfo_t *pii, COLOR32 *p)
 	const wininfo_t *pwi = pii->pwi;
 	u_char *prow = pii->prow;
 
+	if ((pii->bpp == 32) && (pii->multiwidth == 1)) {
+		draw_ll_row_32bpp(pii, p, 2, 1, 0, 3);
+		return;
+	}
+
 	val = *p;
 	for (;;) {
 		RGBA rgba;
@@ -358,6 +417,11 @@ void draw_ll_row_BGRA(imginfo_t *pii, COLOR32 *p)
 	const wininfo_t *pwi = pii->pwi;
 	u_char *prow = pii->prow;
 
+	if ((pii->bpp == 32) && (pii->multiwidth == 1)) {
+		draw_ll_row_32bpp(pii, p, 2, 1, 0, 4);
+		return;
+	}
+
 	val = *p;
 	for (;;) {
 		RGBA rgba;
@@ -17,9 +17,162 @@
 #include <cmd_lcd.h>			 /* wininfo_t */
 #include <video_font.h>			 /* Get font data, width and height */
 #include <video_font_data.h>		 /* video_fontdata */
+#include <malloc.h>			 /* malloc(), free() */
 
 #if defined(CONFIG_XLCD_CONSOLE) \
 	|| (CONFIG_XLCD_DRAW & (XLCD_DRAW_TEXT | XLCD_DRAW_PROG))
+
+/* Maximum size of the glyph cache in bytes; characters that would need a
+   larger cache (e.g. with multiple width at 32 bpp) are drawn directly */
+#ifndef CONFIG_XLCD_GLYPH_CACHE_SIZE
+#define CONFIG_XLCD_GLYPH_CACHE_SIZE 0x20000
+#endif
+
+/* Attributes that change the look of a character row */
+#define GLYPH_ATTR_MASK \
+	(ATTR_HS_MASK | ATTR_BOLD | ATTR_INVERSE | ATTR_UNDERL | ATTR_STRIKE)
+
+/* Characters are pre-rendered as complete framebuffer words, so drawing a
+   cached character is a simple copy of a few words per row. The cache holds
+   the characters for one combination of colors, attributes and pixel format
+   and is emptied if any of these changes. This is the typical case for the
+   console and for repeated progress bar and text output. */
+struct glyph_cache {
+	COLOR32 *data;			  /* Glyph data, wpr words per row */
+	u_int size;			  /* Allocated size of data (words) */
+	u_int wpr;			  /* Words per character row */
+	u_int bpp_shift;		  /* Pixel format of glyphs */
+	u_int attr;			  /* Attributes of glyphs */
+	COLOR32 fg;			  /* Colors of glyphs */
+	COLOR32 bg;
+	u_int valid[VIDEO_FONT_CHARS / 32]; /* One bit per cached character */
+};
+
+static struct glyph_cache gc;
+
+/* Get the pixel data of character row y, including attributes */
+static VIDEO_FONT_TYPE draw_ll_font_row(const VIDEO_FONT_TYPE *pfont, XYPOS y,
+					u_int attr)
+{
+	VIDEO_FONT_TYPE fd;
+
+	/* If underline or strike-through line is reached, use fully set
+	   pixel, otherwise get character pixel data and apply bold and
+	   inverse attributes */
+	if (((attr & ATTR_UNDERL) && (y == VIDEO_FONT_UNDERL))
+	    || ((attr & ATTR_STRIKE) && (y == VIDEO_FONT_STRIKE)))
+		fd = (VIDEO_FONT_TYPE)0xFFFFFFFF;
+	else {
+		fd = pfont[y];
+		if (attr & ATTR_BOLD)
+			fd |= fd>>1;
+	}
+	if (attr & ATTR_INVERSE)
+		fd = ~fd;
+
+	return fd;
+}
+
+/* Draw one character row with pixel data fd to the words at p, beginning at
+   bit position shift */
+static void draw_ll_char_row(COLOR32 *p, u_int shift, VIDEO_FONT_TYPE fd,
+			     u_int attr, u_int bpp, COLOR32 fg, COLOR32 bg)
+{
+	COLOR32 mask = (bpp < 32) ? (1 << bpp) - 1 : 0xFFFFFFFF;
+	u_int s = shift;
+	COLOR32 val;
+	VIDEO_FONT_TYPE fm = 1<<(VIDEO_FONT_WIDTH-1);
+
+	/* Load first word */
+	val = *p;
+	do {
+		/* Loop up to four times if multiple width */
+		unsigned col_count;
+
+		col_count = ((attr & ATTR_HS_MASK) >> 4) + 1;
+		do {
+			/* Blend FG or BG pixel (BG only if not transparent) */
+			s -= bpp;
+			if (fd & fm) {
+				val &= ~(mask << s);
+				val |= fg << s;
+			}
+			else if (!(attr & ATTR_NO_BG)) {
+				val &= ~(mask << s);
+				val |= bg << s;
+			}
+
+			/* Shift mask to next pixel */
+			if (!s) {
+				/* Store old word and load next word; reset
+				   mask to first pixel in word */
+				*p++ = val;
+				s = 32;
+				val = *p;
+			}
+		} while (--col_count);
+		fm >>= 1;
+	} while (fm);
+
+	/* Store back last word */
+	*p = val;
+}
+
+/* Get pre-rendered character from glyph cache, render it if not yet done;
+   return NULL if the cache can not be used */
+static const COLOR32 *draw_ll_get_glyph(u_int bpp_shift, u_int wpr,
+					u_int attr, COLOR32 fg, COLOR32 bg,
+					u_char c)
+{
+	COLOR32 *glyph;
+	XYPOS y;
+
+	attr &= GLYPH_ATTR_MASK;
+	if ((gc.wpr != wpr) || (gc.bpp_shift != bpp_shift)
+	    || (gc.attr != attr) || (gc.fg != fg) || (gc.bg != bg)) {
+		u_int size = VIDEO_FONT_CHARS * VIDEO_FONT_HEIGHT * wpr;
+
+		if (size * sizeof(COLOR32) > CONFIG_XLCD_GLYPH_CACHE_SIZE)
+			return NULL;
+
+		/* One additional word, draw_ll_char_row() reads and writes
+		   back the word behind the last pixel */
+		size++;
+		if (size > gc.size) {
+			free(gc.data);
+			gc.data = malloc(size * sizeof(COLOR32));
+			if (!gc.data) {
+				gc.size = 0;
+				gc.wpr = 0;
+				return NULL;
+			}
+			gc.size = size;
+		}
+		gc.wpr = wpr;
+		gc.bpp_shift = bpp_shift;
+		gc.attr = attr;
+		gc.fg = fg;
+		gc.bg = bg;
+		memset(gc.valid, 0, sizeof(gc.valid));
+	}
+
+	glyph = gc.data + c * VIDEO_FONT_HEIGHT * wpr;
+	if (!(gc.valid[c / 32] & (1 << (c % 32)))) {
+		const VIDEO_FONT_TYPE *pfont;
+
+		/* Render the character once */
+		pfont = video_fontdata + VIDEO_FONT_HEIGHT * c;
+		for (y = 0; y < VIDEO_FONT_HEIGHT; y++) {
+			draw_ll_char_row(glyph + y * wpr, 32,
+					 draw_ll_font_row(pfont, y, attr),
+					 attr, 1 << bpp_shift, fg, bg);
+		}
+		gc.valid[c / 32] |= 1 << (c % 32);
+	}
+
+	return glyph;
+}
+
 /* Draw a character, replacing pixels with new color; character area is
    definitely valid */
 void draw_ll_char(const wininfo_t *pwi, XYPOS x, XYPOS y, char c,
@@ -31,80 +184,55 @@ void draw_ll_char(const wininfo_t *pwi, XYPOS x, XYPOS y, char c,
 	u_long fbuf;
 	u_long linelen = pwi->linelen;
 	u_int attr = pwi->attr;
-	XYPOS underl = (attr & ATTR_UNDERL) ? VIDEO_FONT_UNDERL : -1;
-	XYPOS strike = (attr & ATTR_STRIKE) ? VIDEO_FONT_STRIKE : -1;
 	const VIDEO_FONT_TYPE *pfont;
-	COLOR32 mask = (1 << bpp) - 1;	  /* This also works for bpp==32! */
 	u_int shift = 32 - (xpos & 31);
+	u_int vscale = ((attr & ATTR_VS_MASK) >> 6) + 1;
+	u_int bits;
 
 	/* Compute framebuffer address of the pixel */
 	fbuf = linelen * y + ((xpos >> 5) << 2) + pwi->pfbuf[pwi->fbdraw];
 
+	/* If the character covers complete words, copy it from the glyph
+	   cache; this is the case for 4 bpp and more at aligned positions */
+	bits = (VIDEO_FONT_WIDTH * (((attr & ATTR_HS_MASK) >> 4) + 1))
+		<< bpp_shift;
+	if (!(xpos & 31) && !(bits & 31) && !(attr & ATTR_NO_BG)) {
+		const COLOR32 *glyph;
+		u_int wpr = bits / 32;
+
+		glyph = draw_ll_get_glyph(bpp_shift, wpr, attr, fg, bg, c);
+		if (glyph) {
+			for (y = 0; y < VIDEO_FONT_HEIGHT; y++) {
+				unsigned line_count = vscale;
+
+				do {
+					COLOR32 *p = (COLOR32 *)fbuf;
+					u_int i;
+
+					for (i = 0; i < wpr; i++)
+						p[i] = glyph[i];
+					fbuf += linelen;
+				} while (--line_count);
+				glyph += wpr;
+			}
+			return;
+		}
+	}
+
 	/* Compute start of character within font data */
-	pfont = video_fontdata;
-	pfont += sizeof(VIDEO_FONT_TYPE) * VIDEO_FONT_HEIGHT * c;
+	pfont = video_fontdata + VIDEO_FONT_HEIGHT * (u_char)c;
 
 	for (y = 0; y < VIDEO_FONT_HEIGHT; y++) {
 		VIDEO_FONT_TYPE fd;	  /* Font data (one character row) */
 		unsigned line_count;	  /* Loop twice if double height */
 
-		/* If underline or strike-through line is reached, use fully
-		   set pixel, otherwise get character pixel data and apply
-		   bold and inverse attributes */
-		if ((y == underl) || (y == strike))
-			fd = (VIDEO_FONT_TYPE)0xFFFFFFFF;
-		else {
-			fd = *pfont;
-			if (attr & ATTR_BOLD)
-				fd |= fd>>1;
-		}
-		if (attr & ATTR_INVERSE)
-			fd = ~fd;
-		pfont++;		  /* Next character row */
+		fd = draw_ll_font_row(pfont, y, attr);
 
 		/* Loop up to four times if multiple height */
-		line_count = ((attr & ATTR_VS_MASK) >> 6) + 1;
+		line_count = vscale;
 		do {
-			COLOR32 *p = (COLOR32 *)fbuf;
-			u_int s = shift;
-			COLOR32 val;
-			VIDEO_FONT_TYPE fm = 1<<(VIDEO_FONT_WIDTH-1);
-
-			/* Load first word */
-			val = *p;
-			do {
-				/* Loop up to four times if multiple width */
-				unsigned col_count;
-
-				col_count = ((attr & ATTR_HS_MASK) >> 4) + 1;
-				do {
-					/* Blend FG or BG pixel (BG only if not
-					   transparent) */
-					s -= bpp;
-					if (fd & fm) {
-						val &= ~(mask << s);
-						val |= fg << s;
-					}
-					else if (!(attr & ATTR_NO_BG)) {
-						val &= ~(mask << s);
-						val |= bg << s;
-					}
-
-					/* Shift mask to next pixel */
-					if (!s) {
-						/* Store old word and load
-						   next word; reset mask to
-						   first pixel in word */
-						*p++ = val;
-						s = 32;
-						val = *p;
-					}
-				} while (--col_count);
-				fm >>= 1;
-			} while (fm);
-
-			/* Store back last word */
-			*p = val;
+			draw_ll_char_row((COLOR32 *)fbuf, shift, fd, attr, bpp,
+					 fg, bg);
 
 			/* Go to next line */
 			fbuf += linelen;
@@ -1,5 +1,5 @@
 /*
- * Hardware independent LCD support for BMP files
+ * Hardware independent LCD support for JPG files
  *
  * (C) Copyright 2012
  * Hartmut Keller, F&S Elektronik Systeme GmbH, keller@fs-net.de
@@ -11,6 +11,7 @@
 #include <common.h>
 #include <cmd_lcd.h>			  /* wininfo_t, pixinfo_t */
 #include <xlcd_bitmap.h>		  /* bminfo_t, CT_*, ... */
+#include <malloc.h>			  /* malloc(), free() */
 #include <watchdog.h>			  /* WATCHDOG_RESET() */
 
 #ifdef CONFIG_CMD_DRAW
@@ -27,34 +28,816 @@
 /* DEFINITIONS								*/
 /************************************************************************/
 
+/* JPG markers (second byte after 0xFF) */
+#define M_SOF0	0xC0			  /* Start of frame, baseline */
+#define M_SOF1	0xC1			  /* Start of frame, extended seq. */
+#define M_SOF2	0xC2			  /* Start of frame, progressive */
+#define M_DHT	0xC4			  /* Define Huffman table */
+#define M_SOF15	0xCF			  /* Last start of frame marker */
+#define M_RST0	0xD0			  /* Restart marker 0 */
+#define M_RST7	0xD7			  /* Restart marker 7 */
+#define M_SOI	0xD8			  /* Start of image */
+#define M_EOI	0xD9			  /* End of image */
+#define M_SOS	0xDA			  /* Start of scan */
+#define M_DQT	0xDB			  /* Define quantization table */
+#define M_DRI	0xDD			  /* Define restart interval */
+#define M_TEM	0x01			  /* Temporary, has no length */
+
+/* SOF markers are 0xC0..0xCF, except DHT (0xC4), JPG (0xC8), DAC (0xCC) */
+#define IS_SOF(m) (((m) >= M_SOF0) && ((m) <= M_SOF15) && ((m) != M_DHT) \
+		   && ((m) != 0xC8) && ((m) != 0xCC))
+
+/* Markers without a length field */
+#define IS_RST(m) (((m) >= M_RST0) && ((m) <= M_RST7))
+
+#define JPG_MAX_COMPS	3		  /* Y, Cb, Cr */
+#define JPG_FAST_BITS	9		  /* Bits for Huffman lookup table */
+#define JPG_NO_FAST	0xFFFF		  /* Code not in lookup table */
+
+/* Fixed point constants for the integer IDCT; this is the same algorithm as
+   in jidctint.c of the Independent JPEG Group (Loeffler, Ligtenberg,
+   Moschytz), scaled by 2^13 */
+#define IDCT_CONST_BITS	13
+#define IDCT_PASS1_BITS	2
+#define FIX_0_298631336	2446
+#define FIX_0_390180644	3196
+#define FIX_0_541196100	4433
+#define FIX_0_765366865	6270
+#define FIX_0_899976223	7373
+#define FIX_1_175875602	9633
+#define FIX_1_501321110	12299
+#define FIX_1_847759065	15137
+#define FIX_1_961570560	16069
+#define FIX_2_053119869	16819
+#define FIX_2_562915447	20995
+#define FIX_3_072711026	25172
+
+/* Huffman table */
+struct jpg_huff {
+	u_short fast[1 << JPG_FAST_BITS]; /* Symbol index for short codes */
+	u_char size[257];		  /* Code length of each symbol */
+	u_char values[256];		  /* Symbol values */
+	u_short code[256];		  /* Code of each symbol */
+	u_int maxcode[18];		  /* Largest code + 1 of length k */
+	int delta[17];			  /* Symbol index = code + delta */
+};
+
+/* Image component (Y, Cb or Cr) */
+struct jpg_comp {
+	u_char id;			  /* Component ID from SOF */
+	u_char h, v;			  /* Sampling factors */
+	u_char hshift, vshift;		  /* Log2 of subsampling */
+	u_char tq;			  /* Quantization table */
+	u_char td, ta;			  /* DC and AC Huffman table */
+	int dc_pred;			  /* DC prediction */
+	u_int stride;			  /* Line length in pix */
+	u_char *pix;			  /* Samples of one MCU row */
+};
+
+/* Decoder state */
+struct jpg_dec {
+	const u_char *p;		  /* Next byte of entropy data */
+	u_int bitbuf;			  /* Bit buffer, left aligned */
+	int bitcnt;			  /* Valid bits in bitbuf */
+	int marker;			  /* Marker found in entropy data */
+	u_int restart;			  /* Restart interval (MCUs) */
+	u_int hres, vres;		  /* Image size */
+	u_int ncomps;			  /* Number of components */
+	u_int hmax, vmax;		  /* Maximum sampling factors */
+	u_char progressive;		  /* Progressive or arithmetic */
+	struct jpg_comp comp[JPG_MAX_COMPS];
+	u_short qt[4][64];		  /* Quantization tables (zigzag) */
+	struct jpg_huff dc[4];		  /* DC Huffman tables */
+	struct jpg_huff ac[4];		  /* AC Huffman tables */
+	int block[64];			  /* Coefficients of current block */
+};
+
+
 /************************************************************************/
 /* LOCAL VARIABLES							*/
 /************************************************************************/
 
+/* Position of the n-th zigzag coefficient in the 8x8 block */
+static const u_char jpg_zigzag[64] = {
+	 0,  1,  8, 16,  9,  2,  3, 10,
+	17, 24, 32, 25, 18, 11,  4,  5,
+	12, 19, 26, 33, 40, 48, 41, 34,
+	27, 20, 13,  6,  7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36,
+	29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46,
+	53, 60, 61, 54, 47, 55, 62, 63
+};
+
+
 /************************************************************************/
 /* Local Helper Functions						*/
 /************************************************************************/
 
+/* Get a big endian 16 bit number from address p (may be unaligned) */
+static u_int get_be16(const u_char *p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+/* Limit value to 0..255 */
+static inline u_char jpg_clamp(int x)
+{
+	if ((u_int)x > 255)
+		return (x < 0) ? 0 : 255;
+	return x;
+}
+
+/* Build the decoding tables of a Huffman table from the 16 code length counts
+   and the symbol values of a DHT segment; return 0 on success */
+static int jpg_build_huff(struct jpg_huff *ph, const u_char *counts,
+			  const u_char *values)
+{
+	u_int code = 0;
+	int i, j, k;
+
+	/* Code length of each symbol */
+	k = 0;
+	for (i = 0; i < 16; i++) {
+		for (j = 0; j < counts[i]; j++) {
+			if (k >= 256)
+				return 1;
+			ph->size[k++] = i + 1;
+		}
+	}
+	ph->size[k] = 0;
+	memcpy(ph->values, values, k);
+
+	/* Canonical codes; codes of the same length are consecutive */
+	k = 0;
+	for (j = 1; j <= 16; j++) {
+		ph->delta[j] = k - code;
+		while (ph->size[k] == j)
+			ph->code[k++] = code++;
+		if (code > (1U << j))
+			return 1;	  /* Too many codes of this length */
+		ph->maxcode[j] = code << (16 - j);
+		code <<= 1;
+	}
+	ph->maxcode[17] = 0xFFFFFFFF;	  /* Sentinel */
+
+	/* Lookup table for all codes up to JPG_FAST_BITS */
+	for (i = 0; i < (1 << JPG_FAST_BITS); i++)
+		ph->fast[i] = JPG_NO_FAST;
+	for (i = 0; i < k; i++) {
+		int s = ph->size[i];
+
+		if (s <= JPG_FAST_BITS) {
+			int c = ph->code[i] << (JPG_FAST_BITS - s);
+			int n = 1 << (JPG_FAST_BITS - s);
+
+			for (j = 0; j < n; j++)
+				ph->fast[c + j] = i;
+		}
+	}
+
+	return 0;
+}
+
+/* Fill bit buffer with at least 25 bits; when we hit a marker, we stop
+   reading and feed zeroes instead */
+static void jpg_fill(struct jpg_dec *pd)
+{
+	while (pd->bitcnt <= 24) {
+		u_int c = 0;
+
+		if (!pd->marker) {
+			c = *pd->p;
+			if (c == 0xFF) {
+				if (pd->p[1] == 0x00) {
+					pd->p += 2; /* Stuffed zero byte */
+				} else {
+					pd->marker = pd->p[1];
+					c = 0;
+				}
+			} else
+				pd->p++;
+		}
+		pd->bitbuf |= c << (24 - pd->bitcnt);
+		pd->bitcnt += 8;
+	}
+}
+
+/* Get n bits (n <= 16) from the bit stream */
+static inline u_int jpg_get_bits(struct jpg_dec *pd, int n)
+{
+	u_int x;
+
+	if (pd->bitcnt < n)
+		jpg_fill(pd);
+	x = pd->bitbuf >> (32 - n);
+	pd->bitbuf <<= n;
+	pd->bitcnt -= n;
+
+	return x;
+}
+
+/* Convert n bits of a coefficient to a signed value */
+static inline int jpg_extend(u_int x, int n)
+{
+	if (x < (1U << (n - 1)))
+		return (int)x - (1 << n) + 1;
+	return x;
+}
+
+/* Decode the next Huffman coded symbol; return -1 for an invalid code */
+static int jpg_decode_huff(struct jpg_dec *pd, const struct jpg_huff *ph)
+{
+	u_int fast;
+	int k;
+
+	if (pd->bitcnt < 16)
+		jpg_fill(pd);
+
+	/* Most codes are short and can be found in the lookup table */
+	fast = ph->fast[pd->bitbuf >> (32 - JPG_FAST_BITS)];
+	if (fast != JPG_NO_FAST) {
+		k = ph->size[fast];
+		pd->bitbuf <<= k;
+		pd->bitcnt -= k;
+		return ph->values[fast];
+	}
+
+	/* Search the code length for longer codes */
+	for (k = JPG_FAST_BITS + 1; k <= 16; k++) {
+		if ((pd->bitbuf >> 16) < ph->maxcode[k])
+			break;
+	}
+	if (k > 16)
+		return -1;
+	fast = (pd->bitbuf >> (32 - k)) + ph->delta[k];
+	pd->bitbuf <<= k;
+	pd->bitcnt -= k;
+
+	return ph->values[fast];
+}
+
+/* Decode and dequantize one 8x8 block of a component; return 0 on success */
+static int jpg_decode_block(struct jpg_dec *pd, struct jpg_comp *pc)
+{
+	const u_short *qt = pd->qt[pc->tq];
+	int *block = pd->block;
+	int s, k;
+
+	memset(block, 0, sizeof(pd->block));
+
+	/* DC coefficient: difference to the previous block */
+	s = jpg_decode_huff(pd, &pd->dc[pc->td]);
+	if ((s < 0) || (s > 11))
+		return 1;
+	if (s)
+		pc->dc_pred += jpg_extend(jpg_get_bits(pd, s), s);
+	block[0] = pc->dc_pred * qt[0];
+
+	/* AC coefficients: run length of zeroes and value */
+	for (k = 1; k < 64; k++) {
+		int rs = jpg_decode_huff(pd, &pd->ac[pc->ta]);
+
+		if (rs < 0)
+			return 1;
+		s = rs & 15;
+		k += rs >> 4;
+		if (!s) {
+			if (rs != 0xF0)
+				break;	  /* End of block */
+			continue;	  /* 16 zeroes */
+		}
+		if (k > 63)
+			return 1;
+		block[jpg_zigzag[k]] = jpg_extend(jpg_get_bits(pd, s), s)
+			* qt[k];
+	}
+
+	return 0;
+}
+
+/* Integer inverse DCT of one block, store result to out with line length
+   stride */
+static void jpg_idct(const int *in, u_char *out, u_int stride)
+{
+	int ws[64];
+	int *w;
+	int i;
+	int tmp0, tmp1, tmp2, tmp3;
+	int tmp10, tmp11, tmp12, tmp13;
+	int z1, z2, z3, z4, z5;
+
+	/* Pass 1: columns; results are scaled up by 2^IDCT_PASS1_BITS */
+	for (i = 0, w = ws; i < 8; i++, in++, w++) {
+		if (!(in[8] | in[16] | in[24] | in[32] | in[40] | in[48]
+		      | in[56])) {
+			/* AC terms all zero, which is very common */
+			int dc = in[0] << IDCT_PASS1_BITS;
+
+			w[0] = w[8] = w[16] = w[24] = dc;
+			w[32] = w[40] = w[48] = w[56] = dc;
+			continue;
+		}
+
+		/* Even part */
+		z2 = in[16];
+		z3 = in[48];
+		z1 = (z2 + z3) * FIX_0_541196100;
+		tmp2 = z1 - z3 * FIX_1_847759065;
+		tmp3 = z1 + z2 * FIX_0_765366865;
+		z2 = in[0];
+		z3 = in[32];
+		tmp0 = (z2 + z3) << IDCT_CONST_BITS;
+		tmp1 = (z2 - z3) << IDCT_CONST_BITS;
+		tmp10 = tmp0 + tmp3;
+		tmp13 = tmp0 - tmp3;
+		tmp11 = tmp1 + tmp2;
+		tmp12 = tmp1 - tmp2;
+
+		/* Odd part */
+		tmp0 = in[56];
+		tmp1 = in[40];
+		tmp2 = in[24];
+		tmp3 = in[8];
+		z1 = tmp0 + tmp3;
+		z2 = tmp1 + tmp2;
+		z3 = tmp0 + tmp2;
+		z4 = tmp1 + tmp3;
+		z5 = (z3 + z4) * FIX_1_175875602;
+		tmp0 *= FIX_0_298631336;
+		tmp1 *= FIX_2_053119869;
+		tmp2 *= FIX_3_072711026;
+		tmp3 *= FIX_1_501321110;
+		z1 *= -FIX_0_899976223;
+		z2 *= -FIX_2_562915447;
+		z3 = z3 * -FIX_1_961570560 + z5;
+		z4 = z4 * -FIX_0_390180644 + z5;
+		tmp0 += z1 + z3;
+		tmp1 += z2 + z4;
+		tmp2 += z2 + z3;
+		tmp3 += z1 + z4;
+
+#define DESCALE1(x) (((x) + (1 << (IDCT_CONST_BITS - IDCT_PASS1_BITS - 1))) \
+		     >> (IDCT_CONST_BITS - IDCT_PASS1_BITS))
+		w[0] = DESCALE1(tmp10 + tmp3);
+		w[56] = DESCALE1(tmp10 - tmp3);
+		w[8] = DESCALE1(tmp11 + tmp2);
+		w[48] = DESCALE1(tmp11 - tmp2);
+		w[16] = DESCALE1(tmp12 + tmp1);
+		w[40] = DESCALE1(tmp12 - tmp1);
+		w[24] = DESCALE1(tmp13 + tmp0);
+		w[32] = DESCALE1(tmp13 - tmp0);
+#undef DESCALE1
+	}
+
+	/* Pass 2: rows; remove scaling of pass 1 and the factor 8 of the
+	   2D-IDCT, then add the level shift of 128 */
+	for (i = 0, w = ws; i < 8; i++, w += 8, out += stride) {
+		/* Even part */
+		z2 = w[2];
+		z3 = w[6];
+		z1 = (z2 + z3) * FIX_0_541196100;
+		tmp2 = z1 - z3 * FIX_1_847759065;
+		tmp3 = z1 + z2 * FIX_0_765366865;
+		tmp0 = (w[0] + w[4]) << IDCT_CONST_BITS;
+		tmp1 = (w[0] - w[4]) << IDCT_CONST_BITS;
+		tmp10 = tmp0 + tmp3;
+		tmp13 = tmp0 - tmp3;
+		tmp11 = tmp1 + tmp2;
+		tmp12 = tmp1 - tmp2;
+
+		/* Odd part */
+		tmp0 = w[7];
+		tmp1 = w[5];
+		tmp2 = w[3];
+		tmp3 = w[1];
+		z1 = tmp0 + tmp3;
+		z2 = tmp1 + tmp2;
+		z3 = tmp0 + tmp2;
+		z4 = tmp1 + tmp3;
+		z5 = (z3 + z4) * FIX_1_175875602;
+		tmp0 *= FIX_0_298631336;
+		tmp1 *= FIX_2_053119869;
+		tmp2 *= FIX_3_072711026;
+		tmp3 *= FIX_1_501321110;
+		z1 *= -FIX_0_899976223;
+		z2 *= -FIX_2_562915447;
+		z3 = z3 * -FIX_1_961570560 + z5;
+		z4 = z4 * -FIX_0_390180644 + z5;
+		tmp0 += z1 + z3;
+		tmp1 += z2 + z4;
+		tmp2 += z2 + z3;
+		tmp3 += z1 + z4;
+
+#define DESCALE2(x) jpg_clamp(((x) + (1 << (IDCT_CONST_BITS		\
+					    + IDCT_PASS1_BITS + 2))	\
+			       + (128 << (IDCT_CONST_BITS		\
+					  + IDCT_PASS1_BITS + 3)))	\
+			      >> (IDCT_CONST_BITS + IDCT_PASS1_BITS + 3))
+		out[0] = DESCALE2(tmp10 + tmp3);
+		out[7] = DESCALE2(tmp10 - tmp3);
+		out[1] = DESCALE2(tmp11 + tmp2);
+		out[6] = DESCALE2(tmp11 - tmp2);
+		out[2] = DESCALE2(tmp12 + tmp1);
+		out[5] = DESCALE2(tmp12 - tmp1);
+		out[3] = DESCALE2(tmp13 + tmp0);
+		out[4] = DESCALE2(tmp13 - tmp0);
+#undef DESCALE2
+	}
+}
+
+/* Handle a restart marker: discard remaining bits, skip the RSTn marker and
+   reset the DC predictions */
+static void jpg_restart(struct jpg_dec *pd)
+{
+	int i;
+
+	pd->bitbuf = 0;
+	pd->bitcnt = 0;
+	pd->marker = 0;
+	while (!((pd->p[0] == 0xFF) && IS_RST(pd->p[1]))) {
+		if ((pd->p[0] == 0xFF) && pd->p[1] && (pd->p[1] != 0xFF)) {
+			pd->marker = pd->p[1];
+			return;		  /* Other marker, stop decoding */
+		}
+		pd->p++;
+	}
+	pd->p += 2;
+	for (i = 0; i < pd->ncomps; i++)
+		pd->comp[i].dc_pred = 0;
+}
+
+/* Parse all segments up to and including SOS and set pd->p to the entropy
+   coded data; return NULL on success, error message on failure */
+static const char *jpg_parse_header(struct jpg_dec *pd, const u_char *p)
+{
+	u_int i, len;
+
+	if ((p[0] != 0xFF) || (p[1] != M_SOI))
+		return "No JPG image\n";
+	p += 2;
+
+	for (;;) {
+		u_char marker;
+
+		if (p[0] != 0xFF)
+			return "Invalid JPG segment\n";
+		marker = p[1];
+		if (marker == 0xFF) {
+			p++;		  /* Fill byte */
+			continue;
+		}
+		p += 2;
+		if (IS_RST(marker) || (marker == M_TEM))
+			continue;	  /* No length */
+		if ((marker == M_EOI) || (marker == M_SOI))
+			return "No image data in JPG\n";
+
+		len = get_be16(p);
+		if (len < 2)
+			return "Invalid JPG segment\n";
+
+		if (IS_SOF(marker)) {
+			u_int ncomps = p[7];
+
+			if ((marker != M_SOF0) && (marker != M_SOF1))
+				pd->progressive = 1;
+			if (p[2] != 8)
+				pd->progressive = 1;
+			pd->vres = get_be16(p + 3);
+			pd->hres = get_be16(p + 5);
+			if ((ncomps != 1) && (ncomps != 3))
+				return "Unsupported number of JPG components\n";
+			pd->ncomps = ncomps;
+			pd->hmax = 1;
+			pd->vmax = 1;
+			for (i = 0; i < ncomps; i++) {
+				struct jpg_comp *pc = &pd->comp[i];
+				const u_char *pi = p + 8 + 3*i;
+
+				pc->id = pi[0];
+				pc->h = pi[1] >> 4;
+				pc->v = pi[1] & 15;
+				pc->tq = pi[2] & 3;
+				if ((pc->h < 1) || (pc->h > 2)
+				    || (pc->v < 1) || (pc->v > 2))
+					return "Unsupported JPG subsampling\n";
+				if (ncomps == 1)
+					pc->h = pc->v = 1;
+				if (pc->h > pd->hmax)
+					pd->hmax = pc->h;
+				if (pc->v > pd->vmax)
+					pd->vmax = pc->v;
+			}
+			for (i = 0; i < ncomps; i++) {
+				struct jpg_comp *pc = &pd->comp[i];
+
+				pc->hshift = (pc->h < pd->hmax);
+				pc->vshift = (pc->v < pd->vmax);
+			}
+		} else if (marker == M_DQT) {
+			const u_char *q = p + 2;
+
+			while (q < p + len) {
+				u_short *qt = pd->qt[*q & 3];
+				int prec16 = *q++ >> 4;
+
+				for (i = 0; i < 64; i++) {
+					if (prec16) {
+						qt[i] = get_be16(q);
+						q += 2;
+					} else
+						qt[i] = *q++;
+				}
+			}
+		} else if (marker == M_DHT) {
+			const u_char *q = p + 2;
+
+			while (q < p + len) {
+				u_int tc = q[0] >> 4;
+				u_int th = q[0] & 3;
+				u_int count = 0;
+				struct jpg_huff *ph;
+
+				for (i = 0; i < 16; i++)
+					count += q[1 + i];
+				ph = tc ? &pd->ac[th] : &pd->dc[th];
+				if (jpg_build_huff(ph, q + 1, q + 17))
+					return "Invalid JPG Huffman table\n";
+				q += 17 + count;
+			}
+		} else if (marker == M_DRI) {
+			pd->restart = get_be16(p + 2);
+		} else if (marker == M_SOS) {
+			u_int ns = p[2];
+
+			if (!pd->ncomps)
+				return "Missing JPG frame header\n";
+			if (pd->progressive)
+				return "Only baseline JPG images supported\n";
+			if (ns != pd->ncomps)
+				return "Unsupported JPG scan\n";
+			for (i = 0; i < ns; i++) {
+				struct jpg_comp *pc = &pd->comp[i];
+				const u_char *ps = p + 3 + 2*i;
+
+				/* Components must be in frame order */
+				if (ps[0] != pc->id)
+					return "Unsupported JPG scan\n";
+				pc->td = (ps[1] >> 4) & 3;
+				pc->ta = ps[1] & 3;
+				pc->dc_pred = 0;
+			}
+			pd->p = p + len;  /* Entropy coded data */
+			return NULL;
+		}
+
+		/* Skip all other segments */
+		p += len;
+	}
+}
+
+/* Convert one row of the current MCU row to RGB triplets; x0 and x1 are the
+   first and last visible bitmap columns */
+static void jpg_convert_row(struct jpg_dec *pd, u_char *rgb, u_int row,
+			    u_int x0, u_int x1)
+{
+	struct jpg_comp *pc = pd->comp;
+	const u_char *py = pc[0].pix + (row >> pc[0].vshift) * pc[0].stride;
+	u_int x;
+
+	if (pd->ncomps == 1) {
+		/* Gray scale */
+		for (x = x0; x <= x1; x++) {
+			rgb[0] = rgb[1] = rgb[2] = py[x];
+			rgb += 3;
+		}
+	} else {
+		/* YCbCr to RGB, as defined in JFIF, scaled by 2^16 */
+		const u_char *pcb, *pcr;
+		u_int ys = pc[0].hshift;
+		u_int cs = pc[1].hshift;
+
+		pcb = pc[1].pix + (row >> pc[1].vshift) * pc[1].stride;
+		pcr = pc[2].pix + (row >> pc[2].vshift) * pc[2].stride;
+		for (x = x0; x <= x1; x++) {
+			int y = py[x >> ys] << 16;
+			int cb = pcb[x >> cs] - 128;
+			int cr = pcr[x >> cs] - 128;
+
+			rgb[0] = jpg_clamp((y + 91881 * cr + 32768) >> 16);
+			rgb[1] = jpg_clamp((y - 22554 * cb - 46802 * cr
+					    + 32768) >> 16);
+			rgb[2] = jpg_clamp((y + 116130 * cb + 32768) >> 16);
+			rgb += 3;
+		}
+	}
+}
+
+
 /************************************************************************/
 /* Exported functions							*/
 /************************************************************************/
 
-/* Draw JPG image */
+/* Draw JPG image. A JPG image consists of segments, each starting with a
+   marker (0xFF and a marker type) and usually a 16 bit length. The image data
+   itself follows the SOS (start of scan) segment. It is Huffman coded and
+   consists of MCUs (minimum coded units), each holding one or more 8x8
+   blocks of each color component, depending on the chroma subsampling.
+
+   We decode one row of MCUs at a time into small per-component buffers,
+   convert the rows to RGB and hand them to the draw_row function. So memory
+   usage only depends on the image width, not on the image height. Blocks
+   that are not visible are Huffman decoded (to keep the bit stream position)
+   but skip the IDCT and color conversion.
+
+   We only support baseline images with 8 bit precision, gray scale or YCbCr
+   with subsampling factors of 1 or 2 (4:4:4, 4:2:2, 4:2:0) and a single
+   interleaved scan. Progressive and arithmetic coded images must be converted
+   first with an external image program. */
 const char *draw_jpg(imginfo_t *pii, u_long addr)
 {
-	/* TODO: add JPG support; don't forget to trigger the watchdog with
-	   WATCHDOG_RESET() after each row. */
-	return "JPG images not yet supported";
+	struct jpg_dec *pd;
+	const char *errmsg;
+	u_char *rgb = NULL;
+	draw_row_func_t draw_row;	  /* Draw bitmap row */
+	u_int mcuw, mcuh;		  /* MCU size in pixels */
+	u_int mcusx, mcusy;		  /* Number of MCUs */
+	u_int x0, x1;			  /* Visible columns */
+	u_int mx, my, i;
+	u_int todo;			  /* MCUs until next restart */
+
+	static const draw_row_func_t draw_row_tab[] = {
+#ifdef CONFIG_CMD_DRAW
+		draw_ll_row_RGB,	  /* ATTR_ALPHA = 0 */
+#endif
+#ifdef CONFIG_CMD_ADRAW
+		adraw_ll_row_RGB,	  /* ATTR_ALPHA = 1 */
+#endif
+	};
+
+#if defined(CONFIG_CMD_DRAW) && defined(CONFIG_CMD_ADRAW)
+	draw_row = draw_row_tab[pii->applyalpha];
+#else
+	draw_row = draw_row_tab[0];
+#endif
+
+	pd = malloc(sizeof(struct jpg_dec));
+	if (!pd)
+		return "Can't allocate JPG decoder\n";
+	memset(pd, 0, sizeof(struct jpg_dec));
+
+	errmsg = jpg_parse_header(pd, (const u_char *)addr);
+	if (errmsg)
+		goto DONE;
+
+	mcuw = pd->hmax * 8;
+	mcuh = pd->vmax * 8;
+	mcusx = (pd->hres + mcuw - 1) / mcuw;
+	mcusy = (pd->vres + mcuh - 1) / mcuh;
+
+	/* Allocate sample buffers for one MCU row per component */
+	errmsg = "Can't allocate decode buffer for JPG data\n";
+	for (i = 0; i < pd->ncomps; i++) {
+		struct jpg_comp *pc = &pd->comp[i];
+
+		pc->stride = mcusx * pc->h * 8;
+		pc->pix = malloc(pc->stride * pc->v * 8);
+		if (!pc->pix)
+			goto DONE;
+	}
+
+	/* We only need to decode and convert the visible columns */
+	x0 = pii->xpix / pii->multiwidth;
+	x1 = (pii->xend - 1) / pii->multiwidth;
+	if (x1 >= pd->hres)
+		x1 = pd->hres - 1;
+	rgb = malloc((x1 - x0 + 1) * 3);
+	if (!rgb)
+		goto DONE;
+	errmsg = NULL;
+
+	todo = pd->restart;
+	for (my = 0; my < mcusy; my++) {
+		XYPOS ylast;
+		int visible;
+
+		/* Is any row of this MCU row visible? */
+		ylast = pii->y + pii->ypix + mcuh * pii->multiheight - 1;
+		visible = (ylast >= 0);
+
+		for (mx = 0; mx < mcusx; mx++) {
+			int mcuvis;
+
+			if (pd->restart && !todo--) {
+				jpg_restart(pd);
+				todo = pd->restart - 1;
+			}
+			mcuvis = visible && ((mx + 1) * mcuw > x0)
+				&& (mx * mcuw <= x1);
+
+			for (i = 0; i < pd->ncomps; i++) {
+				struct jpg_comp *pc = &pd->comp[i];
+				u_int bx, by;
+
+				for (by = 0; by < pc->v; by++) {
+					for (bx = 0; bx < pc->h; bx++) {
+						u_char *out;
+
+						if (jpg_decode_block(pd, pc)) {
+							errmsg = "Corrupt JPG data\n";
+							goto DONE;
+						}
+						if (!mcuvis)
+							continue;
+						out = pc->pix + (mx * pc->h + bx) * 8
+							+ by * 8 * pc->stride;
+						jpg_idct(pd->block, out,
+							 pc->stride);
+					}
+				}
+			}
+		}
+
+		/* Output the rows of this MCU row */
+		for (i = 0; i < mcuh; i++) {
+			if (my * mcuh + i >= pd->vres)
+				break;
+			if (visible)
+				jpg_convert_row(pd, rgb, i, x0, x1);
+
+			/* If row is in framebuffer range, draw it */
+			do {
+				XYPOS y = pii->y + pii->ypix;
+				if (y >= 0) {
+					u_long fbuf;
+
+					fbuf = y*pii->pwi->linelen + pii->fbuf;
+					pii->prow = rgb;
+					draw_row(pii, (COLOR32 *)fbuf);
+				}
+				if (++pii->ypix >= pii->yend)
+					goto DONE;
+			} while (pii->ypix % pii->multiheight);
+		}
+		WATCHDOG_RESET();
+	}
+
+DONE:
+	/* Free buffers */
+	free(rgb);
+	for (i = 0; i < pd->ncomps; i++)
+		free(pd->comp[i].pix);
+	free(pd);
+
+	/* We're done */
+	return errmsg;
 }
 
 
 /* Get a bminfo structure with JPG bitmap information */
 int get_bminfo_jpg(bminfo_t *pbi, u_long addr)
 {
-	if (1)
+	u_char *p = (u_char *)addr;
+	u_char marker;
+
+	/* Check for JPG image; it starts with an SOI marker */
+	if ((p[0] != 0xFF) || (p[1] != M_SOI))
 		return 0;
+	p += 2;
+
+	/* Look for the SOF segment, it has the image information:
+	     Offset 0: segment length (2 bytes)
+	     Offset 2: sample precision (1 byte)
+	     Offset 3: height (2 bytes)
+	     Offset 5: width (2 bytes)
+	     Offset 7: number of components (1 byte)
+	   The type of SOF marker tells baseline, progressive, etc. */
+	do {
+		if (p[0] != 0xFF)
+			return 0;
+		marker = p[1];
+		p += 2;
+		if ((marker == M_EOI) || (marker == M_SOS))
+			return 0;
+		if ((marker == 0xFF) || IS_RST(marker) || (marker == M_TEM)) {
+			p -= (marker == 0xFF); /* Fill byte */
+			continue;
+		}
+		if (IS_SOF(marker))
+			break;
+		p += get_be16(p);
+	} while (1);
+
+	pbi->type = BT_JPG;
+	pbi->colortype = (p[7] == 1) ? CT_GRAY : CT_TRUECOL;
+	pbi->bitdepth = p[2];
+	pbi->flags = BF_COMPRESSED;
+	if ((marker != M_SOF0) && (marker != M_SOF1))
+		pbi->flags |= BF_INTERLACED; /* progressive or lossless */
+	pbi->vres = (XYPOS)get_be16(p+3);
+	pbi->hres = (XYPOS)get_be16(p+5);
 
-	/* TODO: add JPG support */
 	return 1;
 }
 
@@ -62,11 +845,44 @@ int get_bminfo_jpg(bminfo_t *pbi, u_long addr)
 /* Scan integrity of a JPG bitmap and return end address */
 u_long scan_jpg(u_long addr)
 {
-	if (1)
+	const u_char *p = (const u_char *)addr;
+
+	/* Check for JPG image; the SOI marker must be followed by another
+	   marker */
+	if ((p[0] != 0xFF) || (p[1] != M_SOI) || (p[2] != 0xFF))
 		return 0;
+	p += 2;
+
+	/* Go through all segments until EOI is encountered */
+	for (;;) {
+		u_char marker;
+
+		if (p[0] != 0xFF)
+			return 0;	  /* Invalid segment */
+		marker = p[1];
+		if (marker == 0xFF) {
+			p++;		  /* Fill byte */
+			continue;
+		}
+		p += 2;
+		if (marker == M_EOI)
+			break;
+		if ((marker == M_SOI) || (marker == 0x00))
+			return 0;	  /* Invalid marker */
+		if (IS_RST(marker) || (marker == M_TEM))
+			continue;	  /* No length */
+		p += get_be16(p);
+
+		/* Skip entropy coded data after SOS up to the next marker
+		   that is neither a stuffed zero nor a restart marker */
+		if (marker == M_SOS) {
+			while ((p[0] != 0xFF) || !p[1] || IS_RST(p[1])
+			       || (p[1] == 0xFF))
+				p++;
+		}
+	}
 
-	/* TODO: Add support for scanning a JPG bitmap */
-	return addr;
+	return (u_long)p;
 }
 
 #endif /* CONFIG_XLCD_DRAW & XLCD_DRAW_BITMAP */
@@ -16,6 +16,11 @@
 #include <u-boot/zlib.h>		  /* z_stream, inflateInit(), ... */
 #include <watchdog.h>			  /* WATCHDOG_RESET() */
 
+#ifdef CONFIG_XLCD_PNG_NEON
+#include <arm_neon.h>			  /* vld1q_u8(), vaddq_u8(), ... */
+#include <asm/barriers.h>		  /* isb() */
+#endif
+
 #ifdef CONFIG_CMD_DRAW
 #include <xlcd_draw_ll.h>		  /* draw_ll_row_*() */
 #endif
@@ -85,7 +90,7 @@ static u_short get_be16(u_char *p)
 }
 
 /* Special so-called paeth predictor for PNG line filtering */
-static u_char paeth(u_char a, u_char b, u_char c)
+static inline u_char paeth(u_char a, u_char b, u_char c)
 {
 	int p = a + b - c;
 	int pa = p - a;
@@ -105,6 +110,212 @@ static u_char paeth(u_char a, u_char b, u_char c)
 	return c;
 }
 
+/* Get a 32 bit word from an address that may be unaligned; the byte order
+   does not matter as long as put_word() uses the same */
+static inline u_int get_word(const u_char *p)
+{
+	u_int x;
+
+	memcpy(&x, p, 4);
+	return x;
+}
+
+/* Store a 32 bit word to an address that may be unaligned */
+static inline void put_word(u_char *p, u_int x)
+{
+	memcpy(p, &x, 4);
+}
+
+/* Add the four bytes of two words in parallel, without carry from one byte to
+   the next */
+static inline u_int add_bytes(u_int x, u_int y)
+{
+	return ((x & 0x7F7F7F7F) + (y & 0x7F7F7F7F)) ^ ((x ^ y) & 0x80808080);
+}
+
+/* Compute (x + y) / 2 for the four bytes of two words in parallel */
+static inline u_int avg_bytes(u_int x, u_int y)
+{
+	return (x & y) + (((x ^ y) & 0xFEFEFEFE) >> 1);
+}
+
+#ifdef CONFIG_XLCD_PNG_NEON
+/* U-Boot does not use the FPU itself, so we have to switch it on before we
+   can execute the first NEON instruction */
+static void png_neon_enable(void)
+{
+	u_int reg;
+
+	/* Allow full access to CP10 and CP11 (VFP/NEON) */
+	asm volatile("mrc p15, 0, %0, c1, c0, 2" : "=r" (reg));
+	reg |= 0xF << 20;
+	asm volatile("mcr p15, 0, %0, c1, c0, 2" : : "r" (reg));
+	isb();
+
+	/* Set FPEXC.EN */
+	reg = 1 << 30;
+	asm volatile("vmsr fpexc, %0" : : "r" (reg));
+}
+
+/* Paeth predictor for all bytes of a pixel at once; because p-a = b-c,
+   p-b = a-c and p-c = a+b-2c, we only need unsigned absolute differences */
+static inline uint8x8_t paeth_neon(uint8x8_t a, uint8x8_t b, uint8x8_t c)
+{
+	uint16x8_t pa, pb, pc, sel;
+	uint8x8_t d;
+
+	pa = vabdl_u8(b, c);
+	pb = vabdl_u8(a, c);
+	pc = vabdq_u16(vaddl_u8(a, b), vaddl_u8(c, c));
+	sel = vandq_u16(vcleq_u16(pa, pb), vcleq_u16(pa, pc));
+	d = vbsl_u8(vmovn_u16(vcleq_u16(pb, pc)), b, c);
+
+	return vbsl_u8(vmovn_u16(sel), a, d);
+}
+
+/* Store lanes 0..3 of four registers as four consecutive pixels */
+static inline void store_pixels_neon(u_char *p, uint8x8_t p0, uint8x8_t p1,
+				     uint8x8_t p2, uint8x8_t p3)
+{
+	uint32x2x2_t lo, hi;
+
+	lo = vzip_u32(vreinterpret_u32_u8(p0), vreinterpret_u32_u8(p1));
+	hi = vzip_u32(vreinterpret_u32_u8(p2), vreinterpret_u32_u8(p3));
+	vst1q_u8(p, vreinterpretq_u8_u32(vcombine_u32(lo.val[0], hi.val[0])));
+}
+
+/* Undo sub, average or paeth filter on a row with 4-byte pixels (RGBA). Each
+   pixel depends on its left neighbour, so we keep one pixel in lanes 0..3 of
+   a register and walk through the four pixels of each 16 byte block. Return
+   the number of bytes done; the caller handles the rest of the row. */
+static u_int png_unfilter4_neon(u_char filtertype, u_char *pc,
+				const u_char *pp, u_int len)
+{
+	uint8x8_t a = vdup_n_u8(0);	  /* Left pixel */
+	uint8x8_t c = vdup_n_u8(0);	  /* Upper left pixel */
+	uint8x8_t x0, x1, x2, x3;
+	uint8x8_t b0, b1, b2, b3;
+	uint8x16_t q;
+	u_int i;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		q = vld1q_u8(pc + i);
+		x0 = vget_low_u8(q);
+		x1 = vext_u8(x0, x0, 4);
+		x2 = vget_high_u8(q);
+		x3 = vext_u8(x2, x2, 4);
+		q = vld1q_u8(pp + i);
+		b0 = vget_low_u8(q);
+		b1 = vext_u8(b0, b0, 4);
+		b2 = vget_high_u8(q);
+		b3 = vext_u8(b2, b2, 4);
+
+		switch (filtertype) {
+		case 1:			  /* sub */
+			x0 = vadd_u8(x0, a);
+			x1 = vadd_u8(x1, x0);
+			x2 = vadd_u8(x2, x1);
+			x3 = vadd_u8(x3, x2);
+			break;
+
+		case 3:			  /* average */
+			x0 = vadd_u8(x0, vhadd_u8(a, b0));
+			x1 = vadd_u8(x1, vhadd_u8(x0, b1));
+			x2 = vadd_u8(x2, vhadd_u8(x1, b2));
+			x3 = vadd_u8(x3, vhadd_u8(x2, b3));
+			break;
+
+		case 4:			  /* paeth */
+			x0 = vadd_u8(x0, paeth_neon(a, b0, c));
+			x1 = vadd_u8(x1, paeth_neon(x0, b1, b0));
+			x2 = vadd_u8(x2, paeth_neon(x1, b2, b1));
+			x3 = vadd_u8(x3, paeth_neon(x2, b3, b2));
+			break;
+		}
+		store_pixels_neon(pc + i, x0, x1, x2, x3);
+		a = x3;
+		c = b3;
+	}
+
+	return i;
+}
+#endif /* CONFIG_XLCD_PNG_NEON */
+
+/* Undo the PNG filter of the current row pc with the previous row pp as
+   reference. Filters only refer to data to the left and above, so only the
+   first len bytes of the row are processed, i.e. the part up to the right
+   edge of the visible region. */
+static void png_unfilter(u_char filtertype, u_char *pc, const u_char *pp,
+			 u_int len, u_int fsize)
+{
+	u_int i = 0;
+
+	switch (filtertype) {
+	case 0:				  /* none */
+		break;
+
+	case 1:				  /* sub */
+#ifdef CONFIG_XLCD_PNG_NEON
+		if (fsize == 4)
+			i = png_unfilter4_neon(filtertype, pc, pp, len);
+#endif
+		if (i < fsize)
+			i = fsize;
+		if (fsize == 4) {
+			for (; i + 4 <= len; i += 4)
+				put_word(pc + i, add_bytes(get_word(pc + i),
+							   get_word(pc + i - 4)));
+		}
+		for (; i < len; i++)
+			pc[i] += pc[i-fsize];
+		break;
+
+	case 2:				  /* up */
+#ifdef CONFIG_XLCD_PNG_NEON
+		for (; i + 16 <= len; i += 16)
+			vst1q_u8(pc + i, vaddq_u8(vld1q_u8(pc + i),
+						  vld1q_u8(pp + i)));
+#endif
+		for (; i + 4 <= len; i += 4)
+			put_word(pc + i, add_bytes(get_word(pc + i),
+						   get_word(pp + i)));
+		for (; i < len; i++)
+			pc[i] += pp[i];
+		break;
+
+	case 3:				  /* average */
+#ifdef CONFIG_XLCD_PNG_NEON
+		if (fsize == 4)
+			i = png_unfilter4_neon(filtertype, pc, pp, len);
+#endif
+		for (; (i < fsize) && (i < len); i++)
+			pc[i] += pp[i]/2;
+		if (fsize == 4) {
+			for (; i + 4 <= len; i += 4) {
+				u_int avg = avg_bytes(get_word(pc + i - 4),
+						      get_word(pp + i));
+
+				put_word(pc + i, add_bytes(get_word(pc + i),
+							   avg));
+			}
+		}
+		for (; i < len; i++)
+			pc[i] += (pc[i-fsize]+pp[i])/2;
+		break;
+
+	case 4:				  /* paeth */
+#ifdef CONFIG_XLCD_PNG_NEON
+		if (fsize == 4)
+			i = png_unfilter4_neon(filtertype, pc, pp, len);
+#endif
+		for (; (i < fsize) && (i < len); i++)
+			pc[i] += pp[i];	  /* paeth(0, pp[i], 0) */
+		for (; i < len; i++)
+			pc[i] += paeth(pc[i-fsize], pp[i], pp[i-fsize]);
+		break;
+	}
+}
+
 
 /************************************************************************/
 /* Exported functions							*/
@@ -145,6 +356,7 @@ const char *draw_png(imginfo_t *pii, u_long addr)
 	u_int pixelsize;		  /* Size of one full pixel (bits) */
 	u_int fsize;			  /* Size of one filter unit */
 	u_int rowlen;
+	u_int fltlen;			  /* Bytes to unfilter per row */
 	int rowpos;
 	int palconverted = 1;
 	char *errmsg = NULL;
@@ -217,6 +429,13 @@ const char *draw_png(imginfo_t *pii, u_long addr)
 	rowpos = (pii->xpix / pii->multiwidth) * pixelsize;
 	pii->palette = palette;
 
+	/* Filters only look left and up, so it is sufficient to unfilter each
+	   row up to the last visible pixel */
+	fltlen = ((pii->xend - 1) / pii->multiwidth + 1) * pixelsize;
+	fltlen = (fltlen + 7) / 8;
+	if (fltlen > rowlen)
+		fltlen = rowlen;
+
 	/* Determine the correct draw_row function */
 	{
 		u_char temp = colortype;
@@ -275,6 +494,10 @@ const char *draw_png(imginfo_t *pii, u_long addr)
 	if (inflateInit(&zs) != Z_OK)
 		return "Can't initialize zlib\n";
 
+#ifdef CONFIG_XLCD_PNG_NEON
+	png_neon_enable();
+#endif
+
 	WATCHDOG_RESET();
 
 	/* Go to first chunk after IHDR */
@@ -392,8 +615,6 @@ const char *draw_png(imginfo_t *pii, u_long addr)
 				break;
 			}
 			if (zs.avail_out == 0) {
-				int i;
-
 				/* Current row */
 				u_char *pc = prow + current;
 				/* Previous row */
@@ -401,37 +622,7 @@ const char *draw_png(imginfo_t *pii, u_long addr)
 				u_char filtertype = *pc++;
 
 				/* Apply the filter on this row */
-				switch (filtertype) {
-				case 0:			  /* none */
-					break;
-
-				case 1:			  /* sub */
-					for (i=fsize; i<rowlen; i++)
-						pc[i] += pc[i-fsize];
-					break;
-
-				case 2:			  /* up */
-					for (i=0; i<rowlen; i++)
-						pc[i] += pp[i];
-					break;
-
-				case 3:			  /* average */
-					for (i=0; i<fsize; i++)
-						pc[i] += pp[i]/2;
-					for (; i<rowlen; i++)
-						pc[i] += (pc[i-fsize]+pp[i])/2;
-					break;
-
-				case 4:			  /* paeth */
-					for (i=0; i<fsize; i++)
-						//pc[i] += paeth(0, pp[i], 0);
-						pc[i] += pp[i];
-					for (; i<rowlen; i++)
-						pc[i] += paeth(pc[i-fsize],
-							       pp[i],
-							       pp[i-fsize]);
-					break;
-				}
+				png_unfilter(filtertype, pc, pp, fltlen, fsize);
 
 				/* If row is in framebuffer range, draw it */
 				do {
@@ -14,6 +14,7 @@
 #include <malloc.h>
 #include <part.h>
 #include <ubifs_uboot.h>
+#include <wildcard.h>
 
 #undef	PART_DEBUG
 
@@ -260,6 +261,9 @@ void part_init(struct blk_desc *dev_desc)
 
 	blkcache_invalidate(dev_desc->if_type, dev_desc->devnum);
 
+	/* The medium may have changed, drop cached directories */
+	wildcard_cache_invalidate();
+
 	dev_desc->part_type = PART_TYPE_UNKNOWN;
 	for (entry = drv; entry != drv + n_ents; entry++) {
 		int ret;
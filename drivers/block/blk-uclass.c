@@ -438,12 +438,16 @@ unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
 	ulong blks_read;
+	int ret;
 
 	if (!ops->read)
 		return -ENOSYS;
 
-	if (blkcache_read(block_dev->if_type, block_dev->devnum,
-			  start, blkcnt, block_dev->blksz, buffer))
+	ret = blkcache_read(block_dev->if_type, block_dev->devnum,
+			    start, blkcnt, block_dev->blksz, buffer);
+	if (ret < 0)
+		return ret;
+	if (ret)
 		return blkcnt;
 	blks_read = ops->read(dev, start, blkcnt, buffer);
 	if (blks_read == blkcnt)
@@ -458,11 +462,19 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
+	int ret;
 
 	if (!ops->write)
 		return -ENOSYS;
 
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	/* Cached directories may be overwritten by a raw write */
+	wildcard_cache_invalidate();
+	ret = blkcache_write(block_dev->if_type, block_dev->devnum,
+			     start, blkcnt, block_dev->blksz, buffer);
+	if (ret < 0)
+		return ret;
+	if (ret)
+		return blkcnt;
 	return ops->write(dev, start, blkcnt, buffer);
 }
 
@@ -471,11 +483,15 @@ unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
+	int ret;
 
 	if (!ops->erase)
 		return -ENOSYS;
 
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	wildcard_cache_invalidate();
+	ret = blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	if (ret)
+		return ret;
 	return ops->erase(dev, start, blkcnt);
 }
 
@@ -656,9 +672,22 @@ static int blk_post_probe(struct udevice *dev)
 	return 0;
 }
 
+static int blk_pre_remove(struct udevice *dev)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+
+	/*
+	 * Write any blocks that are still held back by the block cache. An
+	 * active device can only be unbound after it was removed, so this
+	 * also covers unbinding.
+	 */
+	return blkcache_invalidate(desc->if_type, desc->devnum);
+}
+
 UCLASS_DRIVER(blk) = {
 	.id		= UCLASS_BLK,
 	.name		= "blk",
 	.post_probe	= blk_post_probe,
+	.pre_remove	= blk_pre_remove,
 	.per_device_plat_auto	= sizeof(struct blk_desc),
 };
@@ -3,89 +3,444 @@
  * Copyright (C) Nelson Integration, LLC 2016
  * Author: Eric Nelson<eric@nelint.com>
  *
+ * The cache is organized as a set-associative array of single blocks. Each
+ * block is hashed to a set by device and block number and may be stored in
+ * any of the BLKCACHE_WAYS lines of that set. The least recently used line
+ * of a set is replaced. Consecutive blocks go to consecutive sets, so large
+ * sequential areas spread evenly over the whole cache.
+ *
+ * Memory for the lines is allocated on first use. The line size is taken
+ * from the block size of the device, a device with a bigger block size
+ * causes a reallocation of the cache. Devices with a smaller block size are
+ * not cached.
+ *
+ * When reading small chunks sequentially, some blocks are read ahead. With
+ * write-behind enabled, small writes are kept in the cache and are only
+ * written to the device when the line is evicted, the cache is flushed or
+ * the device is removed. If such a delayed write fails later, the error is
+ * kept and returned by the next write, flush or invalidate.
+ *
+ * SPL and TPL only get a small read cache without read-ahead and without
+ * write-behind.
  */
 #include <common.h>
 #include <blk.h>
+#include <dm.h>
 #include <log.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <part.h>
 #include <asm/global_data.h>
 #include <linux/ctype.h>
-#include <linux/list.h>
+#include <linux/log2.h>
 
-#ifdef CONFIG_NEEDS_MANUAL_RELOC
-DECLARE_GLOBAL_DATA_PTR;
+#define BLKCACHE_WAYS		8	/* Lines per set */
+
+#ifdef CONFIG_SPL_BUILD
+#define BLKCACHE_SIZE		128	/* KiB */
+#define BLKCACHE_READAHEAD	0
+#define BLKCACHE_WRITE_BEHIND	false
+#else
+#define BLKCACHE_SIZE		CONFIG_BLOCK_CACHE_SIZE
+#define BLKCACHE_READAHEAD	CONFIG_BLOCK_CACHE_READAHEAD
+#define BLKCACHE_WRITE_BEHIND	IS_ENABLED(CONFIG_BLOCK_CACHE_WRITE_BEHIND)
 #endif
 
-struct block_cache_node {
-	struct list_head lh;
+#define BLKCACHE_VALID		BIT(0)	/* Line holds data */
+#define BLKCACHE_DIRTY		BIT(1)	/* Line must be written back */
+#define BLKCACHE_AHEAD		BIT(2)	/* Read ahead, not yet used */
+
+struct block_cache_line {
+	lbaint_t blknr;
 	int iftype;
 	int devnum;
-	lbaint_t start;
-	lbaint_t blkcnt;
-	unsigned long blksz;
-	char *cache;
+	unsigned int age;
+	unsigned int flags;
+};
+
+struct block_cache {
+	struct block_cache_line *line;
+	char *data;			/* Data of all lines */
+	char *stage;			/* Buffer for read-ahead/write-back */
+	unsigned long blksz;		/* Size of one line */
+	unsigned int sets;		/* Number of sets, power of two */
+	unsigned int age;		/* Counter for LRU handling */
+	unsigned int dirty;		/* Number of dirty lines */
+	int setup_err;			/* Allocation failed, do not retry */
+	int wb_error;			/* Delayed write failed, not reported */
+	/* Detection of sequential reads */
+	int last_iftype;
+	int last_devnum;
+	lbaint_t last_end;
+	bool sequential;
 };
 
-static LIST_HEAD(block_cache);
+static struct block_cache cache;
 
 static struct block_cache_stats _stats = {
-	.max_blocks_per_entry = 8,
-	.max_entries = 32
+	.size_kb = BLKCACHE_SIZE,
+	.readahead = BLKCACHE_READAHEAD,
+	.write_behind = BLKCACHE_WRITE_BEHIND,
 };
 
 #ifdef CONFIG_NEEDS_MANUAL_RELOC
 int blkcache_init(void)
 {
-	struct list_head *head = &block_cache;
+	/* The cache holds no pointers to static data, nothing to relocate */
+	return 0;
+}
+#endif
+
+/* Number of blocks that may be put into the cache by a single request */
+static lbaint_t cache_max_fill(void)
+{
+	return _stats.max_entries / 4;
+}
+
+static char *cache_data(int idx)
+{
+	return cache.data + (ulong)idx * cache.blksz;
+}
+
+static unsigned int cache_set(int iftype, int devnum, lbaint_t blknr)
+{
+	u32 key = (u32)blknr ^ ((u32)iftype << 24) ^ ((u32)devnum << 16);
+
+	return key & (cache.sets - 1);
+}
+
+static int cache_lookup(int iftype, int devnum, lbaint_t blknr)
+{
+	struct block_cache_line *line;
+	int idx = cache_set(iftype, devnum, blknr) * BLKCACHE_WAYS;
+	int way;
+
+	for (way = 0; way < BLKCACHE_WAYS; way++, idx++) {
+		line = &cache.line[idx];
+		if ((line->flags & BLKCACHE_VALID) && (line->blknr == blknr) &&
+		    (line->devnum == devnum) && (line->iftype == iftype))
+			return idx;
+	}
+
+	return -1;
+}
+
+/* Mark line as used */
+static void cache_touch(int idx)
+{
+	struct block_cache_line *line = &cache.line[idx];
+
+	line->age = ++cache.age;
+	if (line->flags & BLKCACHE_AHEAD) {
+		line->flags &= ~BLKCACHE_AHEAD;
+		_stats.ra_hits++;
+	}
+}
+
+/*
+ * Write back a dirty line. If batch is set, following dirty blocks of the
+ * same device are collected in the stage buffer and are written with the
+ * same request.
+ */
+static int cache_writeback(int idx, bool batch)
+{
+	struct block_cache_line *line = &cache.line[idx];
+	struct udevice *dev;
+	const void *buf;
+	lbaint_t blkcnt = 1;
+	unsigned long written;
+	int next;
+	int ret;
 
-	head->next = (uintptr_t)head->next + gd->reloc_off;
-	head->prev = (uintptr_t)head->prev + gd->reloc_off;
+	ret = blk_get_device(line->iftype, line->devnum, &dev);
+	if (ret)
+		return ret;
+
+	buf = cache_data(idx);
+	if (batch && cache.stage) {
+		memcpy(cache.stage, buf, cache.blksz);
+		while (blkcnt < _stats.readahead) {
+			next = cache_lookup(line->iftype, line->devnum,
+					    line->blknr + blkcnt);
+			if ((next < 0) ||
+			    !(cache.line[next].flags & BLKCACHE_DIRTY))
+				break;
+			memcpy(cache.stage + blkcnt * cache.blksz,
+			       cache_data(next), cache.blksz);
+			blkcnt++;
+		}
+		if (blkcnt > 1)
+			buf = cache.stage;
+	}
+
+	debug("writeback: start " LBAF ", count " LBAFU "\n",
+	      line->blknr, blkcnt);
+	written = blk_get_ops(dev)->write(dev, line->blknr, blkcnt, buf);
+	if (written != blkcnt)
+		return -EIO;
+
+	while (blkcnt--) {
+		next = cache_lookup(line->iftype, line->devnum,
+				    line->blknr + blkcnt);
+		cache.line[next].flags &= ~BLKCACHE_DIRTY;
+		cache.dirty--;
+		_stats.writebacks++;
+	}
 
 	return 0;
 }
-#endif
 
-static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
-{
-	struct block_cache_node *node;
-
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum) &&
-		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
-			if (block_cache.next != &node->lh) {
-				/* maintain MRU ordering */
-				list_del(&node->lh);
-				list_add(&node->lh, &block_cache);
-			}
-			return node;
+/* Write back all dirty lines of a device, or of all devices if iftype < 0 */
+static int cache_flush(int iftype, int devnum)
+{
+	struct block_cache_line *line;
+	int idx;
+	int ret = 0;
+
+	for (idx = 0; cache.dirty && idx < _stats.max_entries; idx++) {
+		line = &cache.line[idx];
+		if (!(line->flags & BLKCACHE_DIRTY))
+			continue;
+		if ((iftype >= 0) &&
+		    ((line->iftype != iftype) || (line->devnum != devnum)))
+			continue;
+		if (cache_writeback(idx, true)) {
+			printf("blkcache: cannot write back block " LBAF "\n",
+			       line->blknr);
+			line->flags &= ~BLKCACHE_DIRTY;
+			cache.dirty--;
+			ret = -EIO;
 		}
+	}
+
+	return ret;
+}
+
+/* Write back all dirty lines within the given range */
+static int cache_flush_range(int iftype, int devnum, lbaint_t start,
+			     lbaint_t blkcnt)
+{
+	int idx;
+	int ret;
+
+	while (cache.dirty && blkcnt--) {
+		idx = cache_lookup(iftype, devnum, start++);
+		if ((idx < 0) || !(cache.line[idx].flags & BLKCACHE_DIRTY))
+			continue;
+		ret = cache_writeback(idx, true);
+		if (ret)
+			return ret;
+	}
+
 	return 0;
 }
 
+/* Return and clear the error of a failed delayed write */
+static int cache_take_error(int ret)
+{
+	if (!ret)
+		ret = cache.wb_error;
+	cache.wb_error = 0;
+
+	return ret;
+}
+
+/* Drop all lines within the given range, even if they are dirty */
+static void cache_drop_range(int iftype, int devnum, lbaint_t start,
+			     lbaint_t blkcnt)
+{
+	int idx;
+
+	while (blkcnt--) {
+		idx = cache_lookup(iftype, devnum, start++);
+		if (idx < 0)
+			continue;
+		if (cache.line[idx].flags & BLKCACHE_DIRTY)
+			cache.dirty--;
+		cache.line[idx].flags = 0;
+		_stats.entries--;
+	}
+}
+
+/* Get a line for the given block, evict the least recently used one */
+static int cache_alloc(int iftype, int devnum, lbaint_t blknr)
+{
+	struct block_cache_line *line;
+	int idx = cache_set(iftype, devnum, blknr) * BLKCACHE_WAYS;
+	int victim = idx;
+	int way;
+
+	for (way = 0; way < BLKCACHE_WAYS; way++, idx++) {
+		line = &cache.line[idx];
+		if (!(line->flags & BLKCACHE_VALID)) {
+			victim = idx;
+			_stats.entries++;
+			goto found;
+		}
+		if ((int)(line->age - cache.line[victim].age) < 0)
+			victim = idx;
+	}
+
+	line = &cache.line[victim];
+	debug("drop: start " LBAF "\n", line->blknr);
+	_stats.evictions++;
+	if ((line->flags & BLKCACHE_DIRTY) && cache_writeback(victim, false)) {
+		printf("blkcache: cannot write back block " LBAF "\n",
+		       line->blknr);
+		cache.wb_error = -EIO;
+	}
+	if (line->flags & BLKCACHE_DIRTY)
+		cache.dirty--;
+
+found:
+	line = &cache.line[victim];
+	line->iftype = iftype;
+	line->devnum = devnum;
+	line->blknr = blknr;
+	line->flags = BLKCACHE_VALID;
+	line->age = ++cache.age;
+
+	return victim;
+}
+
+static void cache_free(void)
+{
+	free(cache.line);
+	free(cache.data);
+	free(cache.stage);
+	cache.line = NULL;
+	cache.data = NULL;
+	cache.stage = NULL;
+	cache.blksz = 0;
+	cache.sets = 0;
+	cache.dirty = 0;
+	_stats.entries = 0;
+	_stats.max_entries = 0;
+}
+
+/* Allocate the cache for lines of at least the given block size */
+static int cache_setup(unsigned long blksz)
+{
+	unsigned int lines;
+
+	if (cache.line && (blksz <= cache.blksz))
+		return 0;
+	if (cache.setup_err)
+		return cache.setup_err;
+
+	if (cache_flush(-1, 0))
+		cache.wb_error = -EIO;
+	cache_free();
+
+	lines = ((ulong)_stats.size_kb << 10) / blksz / BLKCACHE_WAYS;
+	if (!lines) {
+		cache.setup_err = -ENOSPC;
+		return -ENOSPC;
+	}
+	cache.sets = rounddown_pow_of_two(lines);
+	lines = cache.sets * BLKCACHE_WAYS;
+
+	cache.line = calloc(lines, sizeof(struct block_cache_line));
+	cache.data = malloc_cache_aligned((ulong)lines * blksz);
+	if (_stats.readahead > 1)
+		cache.stage = malloc_cache_aligned(_stats.readahead * blksz);
+	if (!cache.line || !cache.data ||
+	    ((_stats.readahead > 1) && !cache.stage)) {
+		cache_free();
+		cache.setup_err = -ENOMEM;
+		return -ENOMEM;
+	}
+
+	cache.blksz = blksz;
+	_stats.max_entries = lines;
+	debug("blkcache: %u sets of %u lines with %lu bytes\n", cache.sets,
+	      BLKCACHE_WAYS, blksz);
+
+	return 0;
+}
+
+/* Read the blocks behind a sequential read into the cache */
+static void cache_read_ahead(int iftype, int devnum, lbaint_t start)
+{
+	struct udevice *dev;
+	struct blk_desc *desc;
+	lbaint_t blkcnt = _stats.readahead;
+	lbaint_t i;
+	int idx;
+
+	if (!cache.stage || blk_get_device(iftype, devnum, &dev))
+		return;
+
+	desc = dev_get_uclass_plat(dev);
+	if (desc->blksz != cache.blksz || start >= desc->lba)
+		return;
+	if (blkcnt > desc->lba - start)
+		blkcnt = desc->lba - start;
+
+	/* Stop at the first block that is already cached */
+	for (i = 0; i < blkcnt; i++) {
+		if (cache_lookup(iftype, devnum, start + i) >= 0)
+			break;
+	}
+	blkcnt = i;
+	if (!blkcnt)
+		return;
+
+	debug("ahead: start " LBAF ", count " LBAFU "\n", start, blkcnt);
+	if (blk_get_ops(dev)->read(dev, start, blkcnt, cache.stage) != blkcnt)
+		return;
+
+	for (i = 0; i < blkcnt; i++) {
+		idx = cache_alloc(iftype, devnum, start + i);
+		memcpy(cache_data(idx), cache.stage + i * cache.blksz,
+		       cache.blksz);
+		cache.line[idx].flags |= BLKCACHE_AHEAD;
+	}
+	_stats.ra_blocks += blkcnt;
+}
+
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
-		debug("hit: start " LBAF ", count " LBAFU "\n",
-		      start, blkcnt);
-		++_stats.hits;
-		return 1;
+	lbaint_t i;
+	int idx;
+	int ret;
+
+	cache.sequential = (iftype == cache.last_iftype) &&
+		(devnum == cache.last_devnum) && (start == cache.last_end);
+	cache.last_iftype = iftype;
+	cache.last_devnum = devnum;
+	cache.last_end = start + blkcnt;
+
+	if (!cache.line || (blksz != cache.blksz))
+		goto miss;
+
+	for (i = 0; i < blkcnt; i++) {
+		idx = cache_lookup(iftype, devnum, start + i);
+		if (idx < 0)
+			goto miss;
+		memcpy(buffer + i * blksz, cache_data(idx), blksz);
+		cache_touch(idx);
 	}
 
+	debug("hit: start " LBAF ", count " LBAFU "\n",
+	      start, blkcnt);
+	++_stats.hits;
+	return 1;
+
+miss:
 	debug("miss: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
 	++_stats.misses;
+
+	/* The device must see the data of dirty lines when reading */
+	if (cache.line && (blksz == cache.blksz)) {
+		ret = cache_flush_range(iftype, devnum, start, blkcnt);
+		if (ret)
+			return ret;
+	}
+
 	return 0;
 }
 
@@ -93,98 +448,133 @@ void blkcache_fill(int iftype, int devnum,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer)
 {
-	lbaint_t bytes;
-	struct block_cache_node *node;
+	lbaint_t i;
+	int idx;
 
-	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
+	if (cache_setup(blksz) || (blksz != cache.blksz))
 		return;
 
-	if (_stats.max_entries == 0)
+	/* don't cache big stuff */
+	if (blkcnt > cache_max_fill())
 		return;
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
-		}
-	} else {
-		node = malloc(sizeof(*node));
-		if (!node)
-			return;
-		node->cache = 0;
-	}
-
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
-			free(node);
-			return;
-		}
-	}
-
 	debug("fill: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
 
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
+	for (i = 0; i < blkcnt; i++) {
+		idx = cache_lookup(iftype, devnum, start + i);
+		if (idx < 0)
+			idx = cache_alloc(iftype, devnum, start + i);
+		else if (cache.line[idx].flags & BLKCACHE_DIRTY)
+			continue;
+		memcpy(cache_data(idx), buffer + i * blksz, blksz);
+	}
+
+	if (cache.sequential && (blkcnt < _stats.readahead))
+		cache_read_ahead(iftype, devnum, start + blkcnt);
 }
 
-void blkcache_invalidate(int iftype, int devnum)
+int blkcache_write(int iftype, int devnum,
+		   lbaint_t start, lbaint_t blkcnt,
+		   unsigned long blksz, void const *buffer)
 {
-	struct list_head *entry, *n;
-	struct block_cache_node *node;
+	lbaint_t i;
+	int idx;
 
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
-			--_stats.entries;
+	if (!_stats.write_behind || cache_setup(blksz) ||
+	    (blksz != cache.blksz) || (blkcnt > cache_max_fill())) {
+		/* Write through, the written data replaces any cached data */
+		if (cache.line && (blksz == cache.blksz))
+			cache_drop_range(iftype, devnum, start, blkcnt);
+		return 0;
+	}
+
+	debug("write: start " LBAF ", count " LBAFU "\n",
+	      start, blkcnt);
+
+	for (i = 0; i < blkcnt; i++) {
+		idx = cache_lookup(iftype, devnum, start + i);
+		if (idx < 0)
+			idx = cache_alloc(iftype, devnum, start + i);
+		else
+			cache_touch(idx);
+		memcpy(cache_data(idx), buffer + i * blksz, blksz);
+		if (!(cache.line[idx].flags & BLKCACHE_DIRTY)) {
+			cache.line[idx].flags |= BLKCACHE_DIRTY;
+			cache.dirty++;
 		}
 	}
+
+	/* Report if evicting an older delayed block failed */
+	return cache_take_error(0) ? : 1;
 }
 
-void blkcache_configure(unsigned blocks, unsigned entries)
+int blkcache_invalidate(int iftype, int devnum)
 {
-	struct block_cache_node *node;
-	if ((blocks != _stats.max_blocks_per_entry) ||
-	    (entries != _stats.max_entries)) {
-		/* invalidate cache */
-		while (!list_empty(&block_cache)) {
-			node = (struct block_cache_node *)block_cache.next;
-			list_del(&node->lh);
-			free(node->cache);
-			free(node);
+	struct block_cache_line *line;
+	int idx;
+	int ret;
+
+	if (!cache.line)
+		return cache_take_error(0);
+
+	ret = cache_flush(iftype, devnum);
+	for (idx = 0; idx < _stats.max_entries; idx++) {
+		line = &cache.line[idx];
+		if ((line->flags & BLKCACHE_VALID) &&
+		    (line->iftype == iftype) && (line->devnum == devnum)) {
+			line->flags = 0;
+			--_stats.entries;
 		}
-		_stats.entries = 0;
 	}
 
-	_stats.max_blocks_per_entry = blocks;
-	_stats.max_entries = entries;
+	return cache_take_error(ret);
+}
+
+int blkcache_flush(void)
+{
+	if (!cache.line)
+		return cache_take_error(0);
+
+	return cache_take_error(cache_flush(-1, 0));
+}
+
+int blkcache_configure(unsigned size_kb, unsigned readahead,
+		       bool write_behind)
+{
+	int ret = 0;
+
+	if (cache.line)
+		ret = cache_flush(-1, 0);
+	ret = cache_take_error(ret);
+
+	cache_free();
+	cache.setup_err = 0;
+	cache.last_iftype = -1;
+	cache.sequential = false;
+
+	_stats.size_kb = size_kb;
+	_stats.readahead = readahead;
+	_stats.write_behind = write_behind;
 
 	_stats.hits = 0;
 	_stats.misses = 0;
+	_stats.ra_blocks = 0;
+	_stats.ra_hits = 0;
+	_stats.evictions = 0;
+	_stats.writebacks = 0;
+
+	return ret;
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
 {
 	memcpy(stats, &_stats, sizeof(*stats));
+	stats->dirty = cache.dirty;
 	_stats.hits = 0;
 	_stats.misses = 0;
+	_stats.ra_blocks = 0;
+	_stats.ra_hits = 0;
+	_stats.evictions = 0;
+	_stats.writebacks = 0;
 }
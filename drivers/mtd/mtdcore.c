@@ -976,6 +976,9 @@ int mtd_read(struct mtd_info *mtd, loff_t from, size_t len, size_t *retlen,
 
 	if (unlikely(ret_code < 0))
 		return ret_code;
+#ifdef CONFIG_NAND_REFRESH
+	mtd->max_bitflips = ret_code;
+#endif
 	if (mtd->ecc_strength == 0)
 		return 0;	/* device lacks ecc */
 	return ret_code >= mtd->bitflip_threshold ? -EUCLEAN : 0;
@@ -37,6 +37,7 @@
 #include <mtd/mxs_nand_fus.h>
 #include <nand.h>			/* nand_info[] */
 #include <cpu_func.h>			/* invalidate_dcache_range(), ... */
+#include <malloc.h>			/* memalign() */
 
 #undef DEBUG
 #ifdef DEBUG
@@ -53,15 +54,34 @@ static uint8_t showdesc;
 
 #define MXS_NAND_METADATA_SIZE		32
 
+/* Number of pages that are read in one DMA chain on sequential reads */
+#ifdef CONFIG_NAND_MXS_FUS_PAGE_CACHE
+#if CONFIG_NAND_MXS_FUS_READ_PAGES < CONFIG_NAND_MXS_FUS_PAGE_CACHE_PAGES
+#define MXS_NAND_CHAIN_PAGES	CONFIG_NAND_MXS_FUS_READ_PAGES
+#else
+#define MXS_NAND_CHAIN_PAGES	CONFIG_NAND_MXS_FUS_PAGE_CACHE_PAGES
+#endif
+#else
+#define MXS_NAND_CHAIN_PAGES	1
+#endif
+
 /* Worst case is mxs_nand_read_oob_raw() with 3 * chunkcount + 1 descriptors;
-   for 512 bytes chunks and 4K pages this is 3 * 8 + 1 = 25 descriptors! */
+   for 512 bytes chunks and 4K pages this is 3 * 8 + 1 = 25 descriptors!
+   A multi-page read in mxs_nand_read_chain() needs 5 descriptors per page
+   plus one final descriptor, which may be even more. */
+#if 5 * MXS_NAND_CHAIN_PAGES + 1 > 25
+#define MXS_NAND_DMA_DESCRIPTOR_COUNT	(5 * MXS_NAND_CHAIN_PAGES + 1)
+#else
 #define MXS_NAND_DMA_DESCRIPTOR_COUNT	25
+#endif
 
 /* When loading ECC data in mxs_nand_do_read_oob(), we need NAND_CMD_READ0 +
    column + row + NAND_CMD_READSTART and one entry with NAND_CMD_RNDOUT +
    column + NAND_CMD_RNDOUTSTART for each chunk. For 4K pages and 512 bytes
    chunks this may be up to 7 + 4*8 = 39 bytes in the command buffer. So use
-   two cache lines to be sure. */
+   two cache lines to be sure. A multi-page read needs NAND_CMD_READ0 +
+   column + row + NAND_CMD_READSTART for each page, i.e. up to 7*8 = 56
+   bytes, which also fits. */
 #define MXS_NAND_COMMAND_BUFFER_SIZE	64
 
 /*
@@ -77,12 +97,29 @@ static uint8_t showdesc;
 /* Timout value for mxs_wait_mask_set(), in us */
 #define MXS_NAND_BCH_TIMEOUT	10000
 
+/* Marker in the status bytes while the BCH has not yet decoded the page;
+   the BCH only writes the number of corrected bitflips (at most the ECC
+   strength, i.e. far below 0xFD), 0xFE (uncorrectable) or 0xFF (erased) */
+#define MXS_NAND_STATUS_BUSY	0xFD
+
 #if defined(CONFIG_MX6)
 #define MXS_NAND_CHUNK_DATA_CHUNK_SIZE_SHIFT	2
 #else
 #define MXS_NAND_CHUNK_DATA_CHUNK_SIZE_SHIFT	0
 #endif
 
+#ifdef CONFIG_NAND_MXS_FUS_PAGE_CACHE
+/* Entry in the page cache; buf holds the page as stored by the BCH, i.e. in
+   the same layout as data_buf[] (main data, BBM, user OOB, status bytes) */
+struct mxs_nand_cpage {
+	uint8_t *buf;			/* Page data, allocated on first use */
+	int chip;			/* NAND chip number, -1: entry unused */
+	int page;			/* Page number within chip */
+	uint32_t age;			/* Time stamp of last access (LRU) */
+	int bitflips;			/* Maximum bitflips in one chunk */
+};
+#endif
+
 struct mxs_nand_priv {
 	struct nand_chip chip;		/* Generic NAND chip info */
 	struct nand_ecclayout layout;	/* Space for ECC layout */
@@ -94,6 +131,15 @@ struct mxs_nand_priv {
 	uint32_t cmd_queue_len;		/* Current command queue length */
 	uint8_t column_cycles;		/* Number of column cycles */
 	uint8_t row_cycles;		/* Number of row cycles */
+#ifdef CONFIG_NAND_MXS_FUS_PAGE_CACHE
+	uint8_t read0_pending;		/* NAND_CMD_READ0 not yet issued */
+	int read0_column;		/* Column of pending NAND_CMD_READ0 */
+	int read0_page;			/* Page of pending NAND_CMD_READ0 */
+	int last_chip;			/* Chip of last page read with ECC */
+	int last_page;			/* Last page read with ECC */
+	uint32_t cache_age;		/* Current LRU time stamp */
+	struct mxs_nand_cpage cpage[CONFIG_NAND_MXS_FUS_PAGE_CACHE_PAGES];
+#endif
 };
 
 /*
@@ -453,6 +499,102 @@ static int mxs_nand_dma_go(struct mxs_nand_priv *priv)
 	return ret;
 }
 
+/* -------------------- PAGE CACHE ----------------------------------------- */
+
+#ifdef CONFIG_NAND_MXS_FUS_PAGE_CACHE
+/*
+ * Issue a NAND_CMD_READ0 that was deferred in mxs_nand_command()
+ */
+static void mxs_nand_flush_read0(struct mxs_nand_priv *priv)
+{
+	if (!priv->read0_pending)
+		return;
+
+	priv->read0_pending = 0;
+	mxs_nand_add_cmd_desc(priv, NAND_CMD_READ0, priv->read0_column,
+			      priv->read0_page, -1);
+}
+
+/*
+ * Drop count pages of the current chip beginning at page from the cache; if
+ * count is negative, drop all pages of all chips.
+ */
+static void mxs_nand_cache_drop(struct mxs_nand_priv *priv, int page,
+				int count)
+{
+	struct mxs_nand_cpage *cp = priv->cpage;
+	int i;
+
+	for (i = 0; i < CONFIG_NAND_MXS_FUS_PAGE_CACHE_PAGES; i++, cp++) {
+		if (cp->chip < 0)
+			continue;
+		if ((count < 0) || ((cp->chip == priv->cur_chip)
+			&& (cp->page >= page) && (cp->page < page + count)))
+			cp->chip = -1;
+	}
+}
+
+/*
+ * Find a page of the current chip in the cache, return NULL if not found
+ */
+static struct mxs_nand_cpage *mxs_nand_cache_find(struct mxs_nand_priv *priv,
+						  int page)
+{
+	struct mxs_nand_cpage *cp = priv->cpage;
+	int i;
+
+	for (i = 0; i < CONFIG_NAND_MXS_FUS_PAGE_CACHE_PAGES; i++, cp++) {
+		if ((cp->chip == priv->cur_chip) && (cp->page == page))
+			return cp;
+	}
+
+	return NULL;
+}
+
+/*
+ * Get a cache entry for a new page; use an unused entry or replace the least
+ * recently used page. The buffer is allocated on first use, so the memory
+ * is only needed if pages are actually read with ECC. Return NULL if there
+ * is not enough memory.
+ */
+static struct mxs_nand_cpage *mxs_nand_cache_get(struct mtd_info *mtd,
+						 struct mxs_nand_priv *priv)
+{
+	struct mxs_nand_cpage *cp = priv->cpage;
+	struct mxs_nand_cpage *lru = NULL;
+	int i;
+
+	for (i = 0; i < CONFIG_NAND_MXS_FUS_PAGE_CACHE_PAGES; i++, cp++) {
+		if (cp->chip < 0) {
+			lru = cp;
+			break;
+		}
+		if (!lru || ((int)(cp->age - lru->age) < 0))
+			lru = cp;
+	}
+
+	cp = lru;
+	if (!cp->buf) {
+		cp->buf = memalign(MXS_DMA_ALIGNMENT,
+				   ALIGN(mtd->writesize + mtd->oobsize,
+					 MXS_DMA_ALIGNMENT));
+		if (!cp->buf)
+			return NULL;
+	}
+
+	/* Reserve entry; the page number is set when the page is valid */
+	cp->chip = priv->cur_chip;
+	cp->page = -1;
+	cp->age = ++priv->cache_age;
+
+	return cp;
+}
+#else
+static inline void mxs_nand_flush_read0(struct mxs_nand_priv *priv)
+{
+}
+#endif /* CONFIG_NAND_MXS_FUS_PAGE_CACHE */
+
 /* -------------------- LOCAL HELPER FUNCTIONS ----------------------------- */
 
 /*
@@ -1047,6 +1189,7 @@ static uint8_t mxs_nand_read_byte(struct mtd_info *mtd)
 	struct nand_chip *chip = mtd_to_nand(mtd);
 	struct mxs_nand_priv *priv = nand_get_controller_data(chip);
 
+	mxs_nand_flush_read0(priv);
 	mxs_nand_read_data_buf(mtd, 0, 1, 1);
 	if (mxs_nand_dma_go(priv))
 		return 0xFF;
@@ -1062,6 +1205,7 @@ static u16 mxs_nand_read_word(struct mtd_info *mtd)
 	struct nand_chip *chip = mtd_to_nand(mtd);
 	struct mxs_nand_priv *priv = nand_get_controller_data(chip);
 
+	mxs_nand_flush_read0(priv);
 	mxs_nand_read_data_buf(mtd, 0, 2, 1);
 	if (mxs_nand_dma_go(priv))
 		return 0xFFFF;
@@ -1077,6 +1221,7 @@ static void mxs_nand_read_buf(struct mtd_info *mtd, uint8_t *buf, int length)
 	struct nand_chip *chip = mtd_to_nand(mtd);
 	struct mxs_nand_priv *priv = nand_get_controller_data(chip);
 
+	mxs_nand_flush_read0(priv);
 	mxs_nand_read_data_buf(mtd, 0, length, 1);
 	if (!mxs_nand_dma_go(priv))
 		memcpy(buf, data_buf, length);
@@ -1128,6 +1273,31 @@ static void mxs_nand_command(struct mtd_info *mtd, uint command, int column,
 	   command that will load the BBM correctly. */
 	if (command == NAND_CMD_READOOB)
 		command = NAND_CMD_READ0;
+
+#ifdef CONFIG_NAND_MXS_FUS_PAGE_CACHE
+	/*
+	 * Defer NAND_CMD_READ0, the page may already be in the page cache;
+	 * mxs_nand_read_page() will decide if it is actually needed. Any
+	 * other command issues a pending NAND_CMD_READ0 first. Pages that
+	 * are written or erased are dropped from the cache.
+	 */
+	if (command == NAND_CMD_READ0) {
+		priv->read0_pending = 1;
+		priv->read0_column = column;
+		priv->read0_page = page;
+		return;
+	}
+	mxs_nand_flush_read0(priv);
+
+	if (command == NAND_CMD_SEQIN)
+		mxs_nand_cache_drop(priv, page, 1);
+	else if (command == NAND_CMD_ERASE1)
+		mxs_nand_cache_drop(priv, page,
+			1 << (chip->phys_erase_shift - chip->page_shift));
+	else if (command == NAND_CMD_RESET)
+		mxs_nand_cache_drop(priv, 0, -1);
+#endif
+
 	/*
 	 * The command sequence should be:
 	 *   NAND_CMD_READ0 Col+Row -> NAND_CMD_READSTART -> Ready -> Read data
@@ -1277,40 +1447,14 @@ static int mxs_nand_write_page_raw(struct mtd_info *mtd, struct nand_chip *chip,
 }
 
 /*
- * Read a page from NAND with ECC
+ * Add DMA descriptor to enable the BCH block and read a page to pbuf
  */
-static int mxs_nand_read_page(struct mtd_info *mtd, struct nand_chip *chip,
-			      uint8_t *buf, int oob_required, int page)
+static void mxs_nand_add_bch_read_desc(struct mtd_info *mtd, uint8_t *pbuf)
 {
+	struct nand_chip *chip = mtd_to_nand(mtd);
 	struct mxs_nand_priv *priv = nand_get_controller_data(chip);
 	struct mxs_dma_desc *d;
-	struct mxs_bch_regs *bch_regs = (struct mxs_bch_regs *)MXS_BCH_BASE;
-	uint32_t corrected = 0;
-	uint8_t *status;
-	uint32_t status_offs;
-	int i, ret;
-
-#ifdef DEBUG
-	/* Show DMA descriptors from now on. */
-	showdesc = 1;
-#endif
-
-	/* Select the desired flash layout */
-	writel(priv->bch_layout, &bch_regs->hw_bch_layoutselect);
 
-	/*
-	 * A DMA descriptor for the first command byte NAND_CMD_READ0 and the
-	 * column/row bytes was already created in nand_do_read_ops(). Now add
-	 * a DMA descriptor for the second command byte NAND_CMD_READSTART and
-	 * a DMA descriptor to wait for ready. Execute this DMA chain and
-	 * check for timeout.
-	 */
-	chip->cmdfunc(mtd, NAND_CMD_READSTART, -1, -1);
-	ret = mxs_nand_wait_ready(mtd, MXS_NAND_TIMEOUT_DATA);
-	if (ret)
-		return ret;
-
-	/* Add DMA descriptor to enable the BCH block and read */
 	d = mxs_nand_get_dma_desc(priv);
 	d->cmd.data =
 		MXS_DMA_DESC_COMMAND_NO_DMAXFER |
@@ -1332,8 +1476,8 @@ static int mxs_nand_read_page(struct mtd_info *mtd, struct nand_chip *chip,
 		GPMI_ECCCTRL_ECC_CMD_DECODE |
 		GPMI_ECCCTRL_BUFFER_MASK_BCH_PAGE;
 	d->cmd.pio_words[3] = mtd->writesize + mtd->oobsize;
-	d->cmd.pio_words[4] = (dma_addr_t)data_buf;
-	d->cmd.pio_words[5] = (dma_addr_t)(data_buf + mtd->writesize);
+	d->cmd.pio_words[4] = (dma_addr_t)pbuf;
+	d->cmd.pio_words[5] = (dma_addr_t)(pbuf + mtd->writesize);
 
 	mxs_nand_dma_desc_append(priv, d);
 
@@ -1358,8 +1502,15 @@ static int mxs_nand_read_page(struct mtd_info *mtd, struct nand_chip *chip,
 	d->cmd.pio_words[2] = 0;
 
 	mxs_nand_dma_desc_append(priv, d);
+}
+
+/*
+ * Add DMA descriptor to deassert the NAND lock and issue interrupt
+ */
+static void mxs_nand_add_end_desc(struct mxs_nand_priv *priv)
+{
+	struct mxs_dma_desc *d;
 
-	/* Add DMA descriptor to deassert the NAND lock and issue interrupt */
 	d = mxs_nand_get_dma_desc(priv);
 	d->cmd.data =
 		MXS_DMA_DESC_COMMAND_NO_DMAXFER | MXS_DMA_DESC_IRQ |
@@ -1368,6 +1519,47 @@ static int mxs_nand_read_page(struct mtd_info *mtd, struct nand_chip *chip,
 	d->cmd.address = 0;
 
 	mxs_nand_dma_desc_append(priv, d);
+}
+
+/*
+ * Return offset of the BCH status bytes in a page buffer. The status bytes
+ * are located at the first 32 bit boundary behind the auxiliary data.
+ */
+static uint32_t mxs_nand_get_status_offs(struct mtd_info *mtd)
+{
+	uint32_t status_offs;
+
+	status_offs = mtd->writesize + mtd->oobavail + 4;
+
+	return (status_offs + 3) & ~3;
+}
+
+/*
+ * Read a page with ECC to pbuf; the NAND_CMD_READ0 for this page was already
+ * issued by the caller.
+ */
+static int mxs_nand_do_read_page(struct mtd_info *mtd, uint8_t *pbuf)
+{
+	struct nand_chip *chip = mtd_to_nand(mtd);
+	struct mxs_nand_priv *priv = nand_get_controller_data(chip);
+	struct mxs_bch_regs *bch_regs = (struct mxs_bch_regs *)MXS_BCH_BASE;
+	int ret;
+
+	/*
+	 * A DMA descriptor for the first command byte NAND_CMD_READ0 and the
+	 * column/row bytes was already created in nand_do_read_ops(). Now add
+	 * a DMA descriptor for the second command byte NAND_CMD_READSTART and
+	 * a DMA descriptor to wait for ready. Execute this DMA chain and
+	 * check for timeout.
+	 */
+	chip->cmdfunc(mtd, NAND_CMD_READSTART, -1, -1);
+	ret = mxs_nand_wait_ready(mtd, MXS_NAND_TIMEOUT_DATA);
+	if (ret)
+		return ret;
+
+	/* Add DMA descriptors to read the page with BCH and to finish */
+	mxs_nand_add_bch_read_desc(mtd, pbuf);
+	mxs_nand_add_end_desc(priv);
 
 	/* Remove any COMPLETE_IRQ states from previous writes (we only check
 	   COMPLETE_IRQ when reading); BCH has a pending state, too, so we may
@@ -1388,9 +1580,24 @@ static int mxs_nand_read_page(struct mtd_info *mtd, struct nand_chip *chip,
 		return ret;
 	}
 
+	return 0;
+}
+
+/*
+ * Check the BCH status bytes of a page that was read to pbuf. Return the
+ * maximum number of bitflips of all chunks and the sum of all bitflips in
+ * corrected, or -EBADMSG if the page is not correctable.
+ */
+static int mxs_nand_check_page(struct mtd_info *mtd, uint8_t *pbuf,
+			       uint32_t *corrected)
+{
+	struct nand_chip *chip = mtd_to_nand(mtd);
+	uint8_t *status;
+	uint32_t status_offs;
+	int i, ret;
+
 	/*
-	 * Loop over status bytes, accumulating ECC status. The status bytes
-	 * are located at the first 32 bit boundary behind the auxiliary data.
+	 * Loop over status bytes, accumulating ECC status.
 	 *   0x00:  no errors
 	 *   0xFF:  empty (all bytes 0xFF)
 	 *   0xFE:  uncorrectable
@@ -1404,39 +1611,281 @@ static int mxs_nand_read_page(struct mtd_info *mtd, struct nand_chip *chip,
 	 * would miss bitflips in the last main chunk. Hence the +1 in the
 	 * loop below.
 	 */
-	status_offs = mtd->writesize + mtd->oobavail + 4;
-	status_offs = (status_offs + 3) & ~3;
-	status = data_buf + status_offs;
+	status_offs = mxs_nand_get_status_offs(mtd);
+	status = pbuf + status_offs;
 
-	/* Invalidate cache for data_buf[] */
-	mxs_nand_inval_buf(data_buf,
-			   mtd->writesize + status_offs + chip->ecc.steps + 1);
+	/* Invalidate cache for the page buffer */
+	mxs_nand_inval_buf(pbuf, status_offs + chip->ecc.steps + 1);
 	ret = 0;
+	*corrected = 0;
 	for (i = 0; i < chip->ecc.steps + 1; i++) {
-		if (status[i] == 0xfe) {
-			mtd->ecc_stats.failed++;
-			printf("Non-correctable error in page at 0x%08llx\n",
-			       (loff_t)page << chip->page_shift);
-
-			/* Note: buf and chip->oob_poi are unchanged here! */
-			return 0;
-		}
+		if (status[i] == 0xfe)
+			return -EBADMSG;
 		if ((status[i] != 0x00) && (status[i] != 0xff)) {
-			corrected += status[i];
+			*corrected += status[i];
 			if (status[i] > ret)
 				ret = status[i];
 		}
 	}
 
+	return ret;
+}
+
+#ifdef CONFIG_NAND_MXS_FUS_PAGE_CACHE
+/*
+ * Read count pages beginning at page to the given cache entries in a single
+ * DMA chain. Each page gets its own NAND_CMD_READ0 and NAND_CMD_READSTART
+ * commands, waits for ready and is decoded by the BCH. Only the final
+ * descriptor decrements the DMA semaphore and issues the interrupt, so the
+ * whole sequence runs without any CPU interaction. The NAND_CMD_READ0 for
+ * the first page is still pending from mxs_nand_command().
+ */
+static int mxs_nand_read_chain(struct mtd_info *mtd, int page, int count,
+			       struct mxs_nand_cpage **cps)
+{
+	struct nand_chip *chip = mtd_to_nand(mtd);
+	struct mxs_nand_priv *priv = nand_get_controller_data(chip);
+	struct mxs_gpmi_regs *gpmi_regs =
+		(struct mxs_gpmi_regs *)MXS_GPMI_BASE;
+	struct mxs_bch_regs *bch_regs = (struct mxs_bch_regs *)MXS_BCH_BASE;
+	struct mxs_dma_desc *d;
+	uint32_t status_offs;
+	uint32_t tmp;
+	uint32_t channel;
+	uint8_t *status;
+	ulong start;
+	int i, ret;
+
+	/* We watch the last status byte of each page */
+	status_offs = mxs_nand_get_status_offs(mtd) + chip->ecc.steps;
+
+	for (i = 0; i < count; i++) {
+		if (i)
+			mxs_nand_add_cmd_desc(priv, NAND_CMD_READ0, 0,
+					      page + i, -1);
+		else
+			mxs_nand_flush_read0(priv);
+		mxs_nand_add_cmd_desc(priv, NAND_CMD_READSTART, -1, -1, -1);
+
+		/* Add DMA descriptor to wait for ready; unlike in
+		   mxs_nand_wait_ready(), the DMA chain goes on after that */
+		d = mxs_nand_get_dma_desc(priv);
+		d->cmd.data =
+			MXS_DMA_DESC_COMMAND_NO_DMAXFER |
+			MXS_DMA_DESC_NAND_WAIT_4_READY |
+			MXS_DMA_DESC_WAIT4END |
+			(1 << MXS_DMA_DESC_PIO_WORDS_OFFSET);
+
+		d->cmd.address = 0;
+
+		d->cmd.pio_words[0] =
+			GPMI_CTRL0_COMMAND_MODE_WAIT_FOR_READY |
+			GPMI_CTRL0_WORD_LENGTH |
+			(priv->cur_chip << GPMI_CTRL0_CS_OFFSET) |
+			GPMI_CTRL0_ADDRESS_NAND_DATA;
+
+		mxs_nand_dma_desc_append(priv, d);
+
+		mxs_nand_add_bch_read_desc(mtd, cps[i]->buf);
+
+		/* Mark page as busy, the BCH overwrites this status byte */
+		status = cps[i]->buf + status_offs;
+		*status = MXS_NAND_STATUS_BUSY;
+		mxs_nand_flush_buf(status, 1);
+	}
+	mxs_nand_add_end_desc(priv);
+
+	/* Remove any COMPLETE_IRQ states from previous operations */
+	while (readl(&bch_regs->hw_bch_ctrl_reg) & BCH_CTRL_COMPLETE_IRQ)
+		writel(BCH_CTRL_COMPLETE_IRQ, &bch_regs->hw_bch_ctrl_clr);
+
+	/* Execute the DMA chain */
+	ret = mxs_nand_dma_go(priv);
+	if (ret) {
+		printf("MXS NAND: DMA read error\n");
+		return ret;
+	}
+
+	/* Check for NAND timeout */
+	tmp = readl(&gpmi_regs->hw_gpmi_stat);
+	channel = MXS_DMA_CHANNEL_AHB_APBH_GPMI0 + priv->cur_chip;
+	if (tmp & (1 << (channel + GPMI_STAT_RDY_TIMEOUT_OFFSET))) {
+		printf("NAND timeout waiting for Ready\n");
+		return -ETIMEDOUT;
+	}
+
+	/*
+	 * COMPLETE_IRQ is already set after the first page, so it can not
+	 * tell us when the BCH has finished the last page. Instead wait until
+	 * the BCH has replaced the busy marker of each page.
+	 */
+	start = get_timer(0);
+	for (i = 0; i < count; i++) {
+		status = cps[i]->buf + status_offs;
+		for (;;) {
+			mxs_nand_inval_buf(status, 1);
+			if (*status != MXS_NAND_STATUS_BUSY)
+				break;
+			if (get_timer(start) > MXS_NAND_TIMEOUT_DATA) {
+				printf("MXS NAND: BCH read timeout\n");
+				return -ETIMEDOUT;
+			}
+		}
+	}
+
+	while (readl(&bch_regs->hw_bch_ctrl_reg) & BCH_CTRL_COMPLETE_IRQ)
+		writel(BCH_CTRL_COMPLETE_IRQ, &bch_regs->hw_bch_ctrl_clr);
+
+	return 0;
+}
+
+/*
+ * Get a page from the page cache or read it from NAND. On sequential reads,
+ * the following pages of the same block are read in the same DMA chain and
+ * are stored in the cache, too. Set pbuf to the buffer with the page data.
+ * The return value is the same as in mxs_nand_check_page(). Bitflips are
+ * only counted when the page is read from NAND, so corrected is 0 for a
+ * cached page; the bitflips of read-ahead pages go to the ECC statistics
+ * right away.
+ */
+static int mxs_nand_cache_read(struct mtd_info *mtd, int page,
+			       uint8_t **pbuf, uint32_t *corrected)
+{
+	struct nand_chip *chip = mtd_to_nand(mtd);
+	struct mxs_nand_priv *priv = nand_get_controller_data(chip);
+	struct mxs_nand_cpage *cps[MXS_NAND_CHAIN_PAGES];
+	struct mxs_nand_cpage *cp;
+	int sequential;
+	int count, pages_per_block;
+	int i, ret;
+
+	sequential = (priv->cur_chip == priv->last_chip)
+		&& (page == priv->last_page + 1);
+	priv->last_chip = priv->cur_chip;
+	priv->last_page = page;
+
+	cp = mxs_nand_cache_find(priv, page);
+	if (cp) {
+		/* Page is cached, the NAND_CMD_READ0 is not needed */
+		priv->read0_pending = 0;
+		cp->age = ++priv->cache_age;
+		*pbuf = cp->buf;
+		*corrected = 0;
+
+		return cp->bitflips;
+	}
+
+	/* Read ahead on sequential reads, but not beyond the end of the
+	   block and not beyond the next page that is already cached */
+	count = 1;
+	if (sequential) {
+		pages_per_block =
+			1 << (chip->phys_erase_shift - chip->page_shift);
+		count = pages_per_block - (page & (pages_per_block - 1));
+		if (count > MXS_NAND_CHAIN_PAGES)
+			count = MXS_NAND_CHAIN_PAGES;
+		for (i = 1; i < count; i++) {
+			if (mxs_nand_cache_find(priv, page + i))
+				break;
+		}
+		count = i;
+	}
+
+	for (i = 0; i < count; i++) {
+		cps[i] = mxs_nand_cache_get(mtd, priv);
+		if (!cps[i])
+			break;
+	}
+	count = i;
+
+	if (!count) {
+		/* No memory for the cache, read page to data_buf[] */
+		ret = mxs_nand_do_read_page(mtd, data_buf);
+		if (ret)
+			return ret;
+
+		return mxs_nand_check_page(mtd, data_buf, corrected);
+	}
+
+	if (count > 1)
+		ret = mxs_nand_read_chain(mtd, page, count, cps);
+	else
+		ret = mxs_nand_do_read_page(mtd, cps[0]->buf);
+	if (ret)
+		return ret;
+
+	/* Only add pages to the cache that could be corrected */
+	for (i = count - 1; i >= 0; i--) {
+		cp = cps[i];
+		ret = mxs_nand_check_page(mtd, cp->buf, corrected);
+		if (ret < 0) {
+			cp->chip = -1;
+			continue;
+		}
+		cp->bitflips = ret;
+		cp->page = page + i;
+		if (i)
+			mtd->ecc_stats.corrected += *corrected;
+	}
+
+	/* ret and corrected are now the result of the first page */
+	*pbuf = cps[0]->buf;
+
+	return ret;
+}
+#endif /* CONFIG_NAND_MXS_FUS_PAGE_CACHE */
+
+/*
+ * Read a page from NAND with ECC
+ */
+static int mxs_nand_read_page(struct mtd_info *mtd, struct nand_chip *chip,
+			      uint8_t *buf, int oob_required, int page)
+{
+	struct mxs_nand_priv *priv = nand_get_controller_data(chip);
+	struct mxs_bch_regs *bch_regs = (struct mxs_bch_regs *)MXS_BCH_BASE;
+	uint8_t *pbuf = data_buf;
+	uint32_t corrected;
+	int ret;
+
+#ifdef DEBUG
+	/* Show DMA descriptors from now on. */
+	showdesc = 1;
+#endif
+
+	/* Select the desired flash layout */
+	writel(priv->bch_layout, &bch_regs->hw_bch_layoutselect);
+
+#ifdef CONFIG_NAND_MXS_FUS_PAGE_CACHE
+	ret = mxs_nand_cache_read(mtd, page, &pbuf, &corrected);
+#else
+	ret = mxs_nand_do_read_page(mtd, pbuf);
+	if (ret)
+		return ret;
+	ret = mxs_nand_check_page(mtd, pbuf, &corrected);
+#endif
+	if (ret == -EBADMSG) {
+		mtd->ecc_stats.failed++;
+		printf("Non-correctable error in page at 0x%08llx\n",
+		       (loff_t)page << chip->page_shift);
+
+		/* Note: buf and chip->oob_poi are unchanged here! */
+		return 0;
+	}
+	if (ret < 0)
+		return ret;
+
+	/* Only count bitflips that were corrected on this read from NAND;
+	   nand_do_read_ops() takes the bitflips of cached pages from the
+	   return value */
 	mtd->ecc_stats.corrected += corrected;
 
 	/* Copy the main data */
-	memcpy(buf, data_buf, mtd->writesize);
+	memcpy(buf, pbuf, mtd->writesize);
 
 	/* Copy the user OOB data if requested */
 	if (oob_required) {
 		memset(chip->oob_poi, 0xff, mtd->oobsize);
-		memcpy(chip->oob_poi + 4, data_buf + mtd->writesize + 4,
+		memcpy(chip->oob_poi + 4, pbuf + mtd->writesize + 4,
 		       mtd->oobavail);
 	}
 
@@ -1449,7 +1898,7 @@ static int mxs_nand_read_page(struct mtd_info *mtd, struct nand_chip *chip,
 	if (mtd->extraflags & MTD_EXTRA_REFRESHOFFS) {
 		u32 refresh;
 
-		memcpy(&refresh, data_buf + mtd->writesize, 4);
+		memcpy(&refresh, pbuf + mtd->writesize, 4);
 		if (refresh == 0xFFFFFFFF)
 			refresh = 0;
 		mtd->extradata = refresh << chip->phys_erase_shift;
@@ -1729,6 +2178,12 @@ void mxs_nand_register(int nfc_hw_id,
 	priv->cmd_queue_len = 0;
 	priv->desc_index = 0;
 	priv->timing0 = pdata ? pdata->timing0 : 0;
+#ifdef CONFIG_NAND_MXS_FUS_PAGE_CACHE
+	priv->read0_pending = 0;
+	priv->last_chip = -1;
+	for (i = 0; i < CONFIG_NAND_MXS_FUS_PAGE_CACHE_PAGES; i++)
+		priv->cpage[i].chip = -1;
+#endif
 
 	/* Setup all things required to detect the chip */
 	chip->IO_ADDR_R = (void __iomem *)nfc_base_addresses[nfc_hw_id];
@@ -2383,6 +2383,7 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 		/* Is the current page in the buffer? */
 		if (realpage != chip->pagebuf || oobbuf) {
 			unsigned int prev_corrected = mtd->ecc_stats.corrected;
+			int page_bitflips;
 
 			bufpoi = aligned ? buf : chip->buffers->databuf;
 
@@ -2409,6 +2410,8 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 							  oob_required, page);
 			if (ret < 0)
 				break;
+			/* Drivers may also return the bitflips of the page */
+			page_bitflips = ret;
 			ret = 0;
 
 			/* Transfer not aligned data */
@@ -2443,6 +2446,7 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 			max_bitflips = max((unsigned int)max_bitflips,
 					   mtd->ecc_stats.corrected -
 					   prev_corrected);
+			max_bitflips = max(max_bitflips, page_bitflips);
 				} else {
 //###			printk("+");//###
 			memcpy(buf, chip->buffers->databuf + col, bytes);
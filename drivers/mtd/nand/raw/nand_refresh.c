@@ -116,6 +116,17 @@
  *       block could be restored (somewhere between steps 2 and 4). Some data
  *       was actually lost. This is very very unlikely to happen.
  *
+ * Deferred refresh:
+ * A refresh takes several erase and write cycles and would stall the boot
+ * process if done right in the read that detected the bitflips. So
+ * nand_read_skip_bad() only queues the block with nand_refresh_queue() and
+ * all queued blocks are refreshed in one pass by nand_refresh_drain(), e.g.
+ * before the OS is started. Each block is refreshed only once per pass, no
+ * matter how many reads saw the bitflips. As the backup block is erased at
+ * the end of each refresh (step 6), step 1 can be skipped for all further
+ * blocks of the same pass. If the queue is full, the block is refreshed
+ * immediately as before.
+ *
  * Remark:
  * The following code uses 0 for invalid offsets. This silently assumes that
  * block 0 (at offset 0) is always required for booting and can neither be
@@ -123,6 +134,7 @@
  */
 
 #include <common.h>
+#include <watchdog.h>
 #include <linux/errno.h>
 #include <linux/mtd/mtd.h>
 #include <nand.h>
@@ -134,6 +146,28 @@ typedef struct mtd_info	  mtd_info_t;
 static u_char pagebuf[NAND_MAX_PAGESIZE];
 static u_char oobbuf[NAND_MAX_OOBSIZE];
 
+/* Blocks with bitflips; queued for refresh if NR_FLAGS_PENDING is set */
+#define NR_FLAGS_PENDING 0x01
+
+struct nr_entry {
+	struct mtd_info *mtd;		/* Device, NULL if entry is unused */
+	loff_t offs;			/* Offset of the block */
+	unsigned int max_bitflips;	/* Max. bitflips seen in a page */
+	unsigned int refreshs;		/* Number of successful refreshs */
+	unsigned int flags;		/* NR_FLAGS_* */
+};
+
+static struct nr_entry nr_entries[CONFIG_NAND_REFRESH_ENTRIES];
+
+/* Backup block usage */
+static unsigned int nr_backup_cycles;	/* Number of copies to backup block */
+static unsigned int nr_backup_erases;	/* Number of backup block erases */
+static unsigned int nr_backup_skipped;	/* Number of saved erases */
+
+/* Backup block that is known to be erased (within one refresh pass) */
+static struct mtd_info *nr_clean_mtd;
+static loff_t nr_clean_offs;
+
 
 /* Erase block at given offset; mark as bad if it fails */
 static int erase_block(struct mtd_info *mtd, loff_t offset)
@@ -183,16 +217,28 @@ static int erase_copy_block(struct mtd_info *mtd, loff_t refreshoffs,
 		to = refreshoffs;
 	}
 
-	/* Erase the destination block */
-	rval = erase_block(mtd, to);
-	if (rval) {
-		if (rval != -EROFS)
-			rval = -EIO;
-		return rval;
-	}
+	/* Erase the destination block; this can be skipped if the backup block
+	   was already erased at the end of the previous refresh */
+	if (to_backup && (mtd == nr_clean_mtd) && (to == nr_clean_offs)) {
+		nr_backup_skipped++;
+		nr_debug("Backup block at 0x%08llx already erased\n", to);
+	} else {
+		rval = erase_block(mtd, to);
+		if (to_backup)
+			nr_backup_erases++;
+		if (rval) {
+			if (rval != -EROFS)
+				rval = -EIO;
+			return rval;
+		}
 
-	nr_debug("%s block at 0x%08llx erased\n",
-		 to_backup ? "Backup" : "Original", to);
+		nr_debug("%s block at 0x%08llx erased\n",
+			 to_backup ? "Backup" : "Original", to);
+	}
+	if (to_backup) {
+		nr_clean_mtd = NULL;
+		nr_backup_cycles++;
+	}
 
 	ops.len = mtd->writesize;
 	ops.ooboffs = 0;
@@ -393,7 +439,11 @@ void nand_refresh_free_backup(struct mtd_info *mtd)
 	nr_debug("Refresh offset in backup block invalidated\n");
 
 	/* Step 6: Erase backup block */
-	erase_block(mtd, mtd->backupoffs);
+	nr_backup_erases++;
+	if (!erase_block(mtd, mtd->backupoffs)) {
+		nr_clean_mtd = mtd;
+		nr_clean_offs = mtd->backupoffs;
+	}
 
 	nr_debug("Backup block erased\n");
 }
@@ -426,8 +476,21 @@ static int finish_refresh(struct mtd_info *mtd, loff_t refreshoffs)
 	return rval;
 }
 
-/* Refresh the block with given offset */
-int nand_refresh(struct mtd_info *mtd, loff_t refreshoffs)
+/* Find the statistics entry of the block at the given offset */
+static struct nr_entry *nr_find_entry(struct mtd_info *mtd, loff_t offs)
+{
+	int i;
+
+	for (i = 0; i < CONFIG_NAND_REFRESH_ENTRIES; i++) {
+		if ((nr_entries[i].mtd == mtd) && (nr_entries[i].offs == offs))
+			return &nr_entries[i];
+	}
+
+	return NULL;
+}
+
+/* Refresh the block with given offset; the offset must be block aligned */
+static int refresh_block(struct mtd_info *mtd, loff_t refreshoffs)
 {
 	int rval;
 
@@ -436,8 +499,6 @@ int nand_refresh(struct mtd_info *mtd, loff_t refreshoffs)
 	if (mtd->replaceoffs)
 		return -EUCLEAN;
 
-	/* Find start of block */
-	refreshoffs &= ~(mtd->erasesize - 1);
 	printf("%s: Refreshing block with many bitflips at 0x%08llx...\n",
 	       mtd->name, refreshoffs);
 
@@ -487,6 +548,156 @@ int nand_refresh(struct mtd_info *mtd, loff_t refreshoffs)
 	return 0;
 }
 
+/* Refresh the block with given offset */
+int nand_refresh(struct mtd_info *mtd, loff_t refreshoffs)
+{
+	struct nr_entry *entry;
+	int rval;
+
+	/* Find start of block */
+	refreshoffs &= ~(mtd->erasesize - 1);
+
+	nr_clean_mtd = NULL;
+	rval = refresh_block(mtd, refreshoffs);
+	nr_clean_mtd = NULL;
+
+	entry = nr_find_entry(mtd, refreshoffs);
+	if (entry) {
+		entry->flags &= ~NR_FLAGS_PENDING;
+		if (!rval)
+			entry->refreshs++;
+	}
+
+	return rval;
+}
+
+/*
+ * Record the bitflips of a read from the block at the given offset. If
+ * refresh is set, queue the block for refreshing by nand_refresh_drain().
+ *
+ * Return value: 0:       Recorded, block queued if requested
+ *               -ENOSPC: Refresh requested, but queue is full; the caller
+ *                        should refresh the block immediately
+ */
+int nand_refresh_queue(struct mtd_info *mtd, loff_t offs,
+		       unsigned int bitflips, int refresh)
+{
+	struct nr_entry *entry;
+	struct nr_entry *victim = NULL;
+	int i;
+
+	offs &= ~(mtd->erasesize - 1);
+	entry = nr_find_entry(mtd, offs);
+	if (!entry) {
+		if (!bitflips && !refresh)
+			return 0;
+
+		/* Use a free entry or replace the entry with the fewest
+		   bitflips that is not queued */
+		for (i = 0; i < CONFIG_NAND_REFRESH_ENTRIES; i++) {
+			entry = &nr_entries[i];
+			if (!entry->mtd) {
+				victim = entry;
+				break;
+			}
+			if (entry->flags & NR_FLAGS_PENDING)
+				continue;
+			if (!victim || (entry->max_bitflips
+					< victim->max_bitflips))
+				victim = entry;
+		}
+		entry = victim;
+		if (!entry || (!refresh && entry->mtd
+			       && (entry->max_bitflips >= bitflips)))
+			return refresh ? -ENOSPC : 0;
+
+		memset(entry, 0, sizeof(*entry));
+		entry->mtd = mtd;
+		entry->offs = offs;
+	}
+
+	if (entry->max_bitflips < bitflips)
+		entry->max_bitflips = bitflips;
+	if (refresh && !(entry->flags & NR_FLAGS_PENDING)) {
+		entry->flags |= NR_FLAGS_PENDING;
+		nr_debug("Block at 0x%08llx queued for refresh\n", offs);
+	}
+
+	return 0;
+}
+
+/*
+ * Refresh all queued blocks in one pass, in ascending order of their offsets.
+ *
+ * Return value: Number of blocks that could not be refreshed
+ */
+int nand_refresh_drain(void)
+{
+	struct nr_entry *entry;
+	struct nr_entry *next;
+	int failed = 0;
+	int i;
+
+	nr_clean_mtd = NULL;
+	for (;;) {
+		next = NULL;
+		for (i = 0; i < CONFIG_NAND_REFRESH_ENTRIES; i++) {
+			entry = &nr_entries[i];
+			if (!(entry->flags & NR_FLAGS_PENDING))
+				continue;
+			if (!next || (entry->mtd < next->mtd)
+			    || ((entry->mtd == next->mtd)
+				&& (entry->offs < next->offs)))
+				next = entry;
+		}
+		if (!next)
+			break;
+
+		WATCHDOG_RESET();
+		next->flags &= ~NR_FLAGS_PENDING;
+		if (refresh_block(next->mtd, next->offs))
+			failed++;
+		else
+			next->refreshs++;
+	}
+
+	/* Do not rely on the erased backup block beyond this pass */
+	nr_clean_mtd = NULL;
+
+	return failed;
+}
+
+/* Show bitflip statistics, refresh counts and backup block usage */
+void nand_refresh_show_stats(struct mtd_info *mtd)
+{
+	struct nr_entry *entry;
+	int found = 0;
+	int i;
+
+	for (i = 0; i < CONFIG_NAND_REFRESH_ENTRIES; i++) {
+		entry = &nr_entries[i];
+		if (entry->mtd != mtd)
+			continue;
+		if (!found) {
+			printf("Block         Max. bitflips  Refreshs\n");
+			found = 1;
+		}
+		printf("0x%08llx  %13u  %8u%s\n", entry->offs,
+		       entry->max_bitflips, entry->refreshs,
+		       (entry->flags & NR_FLAGS_PENDING) ? "  (queued)" : "");
+	}
+	if (!found)
+		puts("No blocks with bitflips seen\n");
+
+	printf("Refresh threshold: %u bitflips per ECC step (strength %u)\n",
+	       mtd->bitflip_threshold, mtd->ecc_strength);
+	printf("Backup block: 0x%08llx (region end 0x%08llx)%s\n",
+	       mtd->backupoffs, mtd->backupend,
+	       mtd->replaceoffs ? " in use for EMERGENCY MODE" : "");
+	printf("Backup usage: %u copies, %u erases, %u erases saved\n",
+	       nr_backup_cycles, nr_backup_erases, nr_backup_skipped);
+}
+
 
 /*
  * Returns a different value if in EMERGENCY MODE and the offset is redirected
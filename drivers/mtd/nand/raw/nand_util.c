@@ -800,7 +800,12 @@ int nand_read_skip_bad(struct mtd_info *mtd, loff_t offset, size_t *length,
 
 		rval = nand_read(mtd, offset, &read_length, buffer);
 #ifdef CONFIG_NAND_REFRESH
-	        if (rval == -EUCLEAN)
+		/* Record the bitflips; blocks with too many bitflips are
+		   queued and refreshed later by nand_refresh_drain(). Only
+		   if the queue is full, refresh the block right now. */
+		if (((rval == 0) || (rval == -EUCLEAN))
+		    && nand_refresh_queue(mtd, offset, mtd->max_bitflips,
+					  rval == -EUCLEAN))
 			rval = nand_refresh(mtd, offset);
 #endif
 		if (rval && rval != -EUCLEAN) {
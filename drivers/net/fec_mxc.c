@@ -77,6 +77,11 @@ DECLARE_GLOBAL_DATA_PTR;
 #error "PKTALIGN must be multiple of ARCH_DMA_MINALIGN!"
 #endif
 
+/* The RX descriptors (8 bytes each) are freed per cacheline */
+#if (FEC_RBD_NUM % (ARCH_DMA_MINALIGN / 8) != 0)
+#error "FEC_RBD_NUM must be multiple of the RX descriptors per cacheline!"
+#endif
+
 #undef DEBUG
 
 #ifdef CONFIG_FEC_MXC_SWAP_PACKET
@@ -357,6 +362,7 @@ static void fec_rbd_init(struct fec_priv *fec, int count, int dsize)
 	/* Mark the last RBD to close the ring. */
 	fec->rbd_base[i - 1].status = FEC_RBD_WRAP | FEC_RBD_EMPTY;
 	fec->rbd_index = 0;
+	fec->rbd_ready = 0;
 
 	flush_dcache_range((ulong)fec->rbd_base,
 			   (ulong)fec->rbd_base + size);
@@ -401,6 +407,46 @@ static void fec_rbd_clean(int last, struct fec_bd *prbd)
 	writew(0, &prbd->data_length);
 }
 
+/**
+ * Give the current receive buffer back to the FEC and move to the next one
+ * @param[in] fec all we know about the device yet
+ * @param[in] addr address of the received frame
+ * @param[in] length length of the received frame, <= 0 if there is none
+ *
+ * The frame is invalidated again, because the network stack may have
+ * modified it in place and dirty cachelines must not be written back over
+ * the next frame that the FEC puts into this buffer. The descriptor itself
+ * is only marked free together with the whole cacheline of descriptors, see
+ * fec_recv().
+ */
+static void fec_rbd_release(struct fec_priv *fec, ulong addr, int length)
+{
+	ulong end;
+	int i, mask;
+
+	if (length > 0) {
+		end = roundup(addr + length, ARCH_DMA_MINALIGN);
+		addr &= ~(ARCH_DMA_MINALIGN - 1);
+		invalidate_dcache_range(addr, end);
+	}
+
+	mask = RXDESC_PER_CACHELINE - 1;
+	if ((fec->rbd_index & mask) == mask) {
+		i = fec->rbd_index - mask;
+		addr = (ulong)&fec->rbd_base[i];
+		for (; i <= fec->rbd_index ; i++) {
+			fec_rbd_clean(i == (FEC_RBD_NUM - 1),
+				      &fec->rbd_base[i]);
+		}
+		flush_dcache_range(addr, addr + ARCH_DMA_MINALIGN);
+	}
+
+	fec_rx_task_enable(fec);
+	fec->rbd_index = (fec->rbd_index + 1) % FEC_RBD_NUM;
+	if (fec->rbd_ready)
+		fec->rbd_ready--;
+}
+
 #ifdef CONFIG_FEC_GET_MAC_FROM_FUSES
 static int fec_get_hwaddr(int dev_id, unsigned char *mac)
 {
@@ -485,6 +531,7 @@ static int fec_open(struct eth_device *edev)
 	/* full-duplex, heartbeat disabled */
 	writel(1 << 2, &fec->eth->x_cntrl);
 	fec->rbd_index = 0;
+	fec->rbd_ready = 0;
 
 	/* Invalidate all descriptors */
 	for (i = 0; i < FEC_RBD_NUM - 1; i++)
@@ -708,6 +755,7 @@ static void fec_halt(struct eth_device *dev)
 	writel(readl(&fec->eth->ecntrl) & ~FEC_ECNTRL_ETHER_EN,
 	       &fec->eth->ecntrl);
 	fec->rbd_index = 0;
+	fec->rbd_ready = 0;
 	fec->tbd_index = 0;
 	debug("eth_halt: done\n");
 }
@@ -869,6 +917,9 @@ out:
  * Pull one frame from the card
  * @param[in] dev Our ethernet device to handle
  * @return Length of packet read
+ *
+ * With DM_ETH the frame is passed in its DMA buffer, the descriptor stays
+ * in use until fecmxc_free_pkt() gives it back.
  */
 #ifdef CONFIG_DM_ETH
 static int fecmxc_recv(struct udevice *dev, int flags, uchar **packetp)
@@ -889,13 +940,7 @@ static int fec_recv(struct eth_device *dev)
 	int i;
 
 #ifdef CONFIG_DM_ETH
-	*packetp = memalign(ARCH_DMA_MINALIGN, FEC_MAX_PKT_SIZE);
-	if (*packetp == 0) {
-		printf("%s: error allocating packetp\n", __func__);
-		return -ENOMEM;
-	}
-#else
-	ALLOC_CACHE_ALIGN_BUFFER(uchar, buff, FEC_MAX_PKT_SIZE);
+	*packetp = NULL;
 #endif
 
 	/* Check if any critical events have happened */
@@ -948,36 +993,53 @@ static int fec_recv(struct eth_device *dev)
 	 * that in order to mark the descriptor as processed, we need to change
 	 * the descriptor. The solution is to mark the whole cache line when all
 	 * descriptors in the cache line are processed.
+	 *
+	 * The FEC fills the descriptors in order and does not touch a filled
+	 * one again before it is marked free. So all descriptors of the cache
+	 * line that were found filled can be processed without invalidating
+	 * the cache line again.
 	 */
-	addr = (ulong)rbd;
-	addr &= ~(ARCH_DMA_MINALIGN - 1);
-	size = roundup(sizeof(struct fec_bd), ARCH_DMA_MINALIGN);
-	invalidate_dcache_range(addr, addr + size);
+	if (!fec->rbd_ready) {
+		addr = (ulong)rbd;
+		addr &= ~(ARCH_DMA_MINALIGN - 1);
+		size = roundup(sizeof(struct fec_bd), ARCH_DMA_MINALIGN);
+		invalidate_dcache_range(addr, addr + size);
+
+		end = fec->rbd_index | (RXDESC_PER_CACHELINE - 1);
+		for (i = fec->rbd_index; i <= end; i++) {
+			if (readw(&fec->rbd_base[i].status) & FEC_RBD_EMPTY)
+				break;
+		}
+		fec->rbd_ready = i - fec->rbd_index;
+	}
 
 	bd_status = readw(&rbd->status);
 	debug("fec_recv: status 0x%x\n", bd_status);
 
-	if (!(bd_status & FEC_RBD_EMPTY)) {
+	if (fec->rbd_ready) {
+		addr = readl(&rbd->data_pointer);
 		if ((bd_status & FEC_RBD_LAST) && !(bd_status & FEC_RBD_ERR) &&
 		    ((readw(&rbd->data_length) - 4) > 14)) {
-			/* Get buffer address and size */
-			addr = readl(&rbd->data_pointer);
+			/* Get buffer size */
 			frame_length = readw(&rbd->data_length) - 4;
 			/* Invalidate data cache over the buffer */
 			end = roundup(addr + frame_length, ARCH_DMA_MINALIGN);
-			addr &= ~(ARCH_DMA_MINALIGN - 1);
-			invalidate_dcache_range(addr, end);
+			invalidate_dcache_range(addr & ~(ARCH_DMA_MINALIGN - 1),
+						end);
 
-			/* Fill the buffer and pass it to upper layers */
+			/* Pass the buffer to upper layers */
 #ifdef CONFIG_FEC_MXC_SWAP_PACKET
 			swap_packet((uint32_t *)addr, frame_length);
 #endif
 
 #ifdef CONFIG_DM_ETH
-			memcpy(*packetp, (char *)addr, frame_length);
+			*packetp = (uchar *)addr;
+			debug("fec_recv: stop\n");
+
+			return frame_length;
 #else
-			memcpy(buff, (char *)addr, frame_length);
-			net_process_received_packet(buff, frame_length);
+			net_process_received_packet((uchar *)addr,
+						    frame_length);
 #endif
 			len = frame_length;
 		} else {
@@ -994,24 +1056,10 @@ static int fec_recv(struct eth_device *dev)
 
 		/*
 		 * Free the current buffer, restart the engine and move forward
-		 * to the next buffer. Here we check if the whole cacheline of
-		 * descriptors was already processed and if so, we mark it free
-		 * as whole.
+		 * to the next buffer, unless the ring was reset meanwhile.
 		 */
-		size = RXDESC_PER_CACHELINE - 1;
-		if ((fec->rbd_index & size) == size) {
-			i = fec->rbd_index - size;
-			addr = (ulong)&fec->rbd_base[i];
-			for (; i <= fec->rbd_index ; i++) {
-				fec_rbd_clean(i == (FEC_RBD_NUM - 1),
-					      &fec->rbd_base[i]);
-			}
-			flush_dcache_range(addr,
-					   addr + ARCH_DMA_MINALIGN);
-		}
-
-		fec_rx_task_enable(fec);
-		fec->rbd_index = (fec->rbd_index + 1) % FEC_RBD_NUM;
+		if (fec->rbd_ready)
+			fec_rbd_release(fec, addr, len);
 	}
 	debug("fec_recv: stop\n");
 
@@ -1334,8 +1382,13 @@ static int fecmxc_read_rom_hwaddr(struct udevice *dev)
 
 static int fecmxc_free_pkt(struct udevice *dev, uchar *packet, int length)
 {
-	if (packet)
-		free(packet);
+	struct fec_priv *fec = dev_get_priv(dev);
+	struct fec_bd *rbd = &fec->rbd_base[fec->rbd_index];
+
+	/* Ignore the frame if the ring was reset while it was processed */
+	if (packet && fec->rbd_ready &&
+	    (ulong)packet == (ulong)readl(&rbd->data_pointer))
+		fec_rbd_release(fec, (ulong)packet, length);
 
 	return 0;
 }
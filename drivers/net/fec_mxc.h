@@ -234,6 +234,7 @@ struct fec_priv {
 	enum xceiver_type xcv_type;	/* transceiver type */
 	struct fec_bd *rbd_base;	/* RBD ring */
 	int rbd_index;			/* next receive BD to read */
+	int rbd_ready;			/* filled BDs known from last read */
 	struct fec_bd *tbd_base;	/* TBD ring */
 	int tbd_index;			/* next transmit BD to write */
 	struct bd_info *bd;
@@ -270,9 +271,14 @@ struct fec_priv {
  * @brief Numbers of buffer descriptors for receiving
  *
  * The number defines the stocked memory buffers for the receiving task.
- * Larger values makes no sense in this limited environment.
+ * Received frames are passed to the network stack in place, so a larger
+ * ring only costs memory and buffers bursts, e.g. TFTP with a window size.
  */
+#ifdef CONFIG_FEC_MXC_RX_RING_SIZE
+#define FEC_RBD_NUM		CONFIG_FEC_MXC_RX_RING_SIZE
+#else
 #define FEC_RBD_NUM		64
+#endif
 
 /**
  * @brief Define the ethernet packet size limit in memory
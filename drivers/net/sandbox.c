@@ -300,6 +300,29 @@ void sandbox_eth_set_tx_handler(int index, sandbox_eth_tx_hand_f *handler)
 		priv->tx_handler = sb_default_handler;
 }
 
+/*
+ * sandbox_eth_set_rx_handler()
+ *
+ * Set a function that injects received packets on its own, e.g. to mock a
+ *	server that sends a stream of packets
+ *
+ * index - interface to set the handler for
+ * handler - The func ptr to call when no packet is waiting; NULL for none
+ */
+void sandbox_eth_set_rx_handler(int index, sandbox_eth_rx_hand_f *handler)
+{
+	struct udevice *dev;
+	struct eth_sandbox_priv *priv;
+	int ret;
+
+	ret = uclass_get_device(UCLASS_ETH, index, &dev);
+	if (ret)
+		return;
+
+	priv = dev_get_priv(dev);
+	priv->rx_handler = handler;
+}
+
 /*
  * Set priv ptr
  *
@@ -356,6 +379,9 @@ static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 		skip_timeout = false;
 	}
 
+	if (!priv->recv_packets && priv->rx_handler)
+		priv->rx_handler(dev);
+
 	if (priv->recv_packets) {
 		int lcl_recv_packet_length = priv->recv_packet_length[0];
 
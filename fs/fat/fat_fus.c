@@ -38,6 +38,15 @@
 #define CONFIG_SYS_FAT_PRELOAD_FAT 3072
 #endif
 
+/* FAT preload size when building the extent map of a large file, same
+   restrictions as above; falls back to fat_buffer if not available */
+#ifndef CONFIG_SYS_FAT_PRELOAD_MAP
+#define CONFIG_SYS_FAT_PRELOAD_MAP 0x30000
+#endif
+
+/* Number of entries to grow the extent map by when it is full */
+#define FAT_EXTENTS_GROW	32
+
 #define DOS_BOOT_MAGIC_OFFSET	0x1fe
 
 #define TO_FAT_DIRINFO(wdi)	((struct fat_dirinfo *)wdi)
@@ -57,10 +66,23 @@ struct fat_dirinfo {
 	__u32 preload_count;		/* Number of preloaded sectors */
 };
 
+/* Contiguous run of clusters of a file */
+struct fat_extent {
+	__u32 cluster;			/* First cluster of the run */
+	__u32 count;			/* Number of clusters in the run */
+};
+
 static struct blk_desc *cur_dev;
 static unsigned int cur_part_nr;
 static struct disk_partition cur_part_info;
 
+/* Medium that the wildcard directory cache refers to; the blk_desc pointer
+   may be reused for another device, so use interface type and number */
+static enum if_type cache_if_type = IF_TYPE_UNKNOWN;
+static int cache_devnum;
+static lbaint_t cache_start;
+static __u8 cache_volume_id[4];
+
 /* Device specific data; if we allow parallel access to more than one FAT
    device in the future, we must allocate this dynamically. The following
    dir_buffer and fat_buffer are also part of the device data */
@@ -292,6 +314,137 @@ static __u32 get_fatent(struct fsdata *mydata, __u32 cluster)
 	return ret;
 }
 
+/**
+ * fat_set_fatbuf() - Set the buffer used by get_fatent()
+ * @mydata: Pointer to device specific information
+ * @buf:    FAT buffer, must be DMA aligned
+ * @size:   Size of the buffer, must be a multiple of 3 and the sector size
+ *
+ * Set the FAT buffer and compute how many sectors and FAT entries fit into
+ * it. In case of FAT12, the sector count must be a multiple of 3 so that no
+ * FAT entry crosses the buffer boundary. The buffer content is invalidated.
+ */
+static void fat_set_fatbuf(struct fsdata *mydata, __u8 *buf, __u32 size)
+{
+	mydata->fatbuf = buf;
+	mydata->fatbuf_sectors = size / mydata->sect_size;
+	mydata->fatbuf_entries = mydata->sect_size;
+	switch (mydata->fatsize) {
+	case 12:
+		mydata->fatbuf_sectors /= 3;
+		mydata->fatbuf_entries *= mydata->fatbuf_sectors * 2;
+		mydata->fatbuf_sectors *= 3;
+		break;
+	case 16:
+		mydata->fatbuf_entries *= mydata->fatbuf_sectors;
+		mydata->fatbuf_entries /= 2;
+		break;
+	case 32:
+		mydata->fatbuf_entries *= mydata->fatbuf_sectors;
+		mydata->fatbuf_entries /= 4;
+		break;
+	}
+	mydata->fatbufnum = (__u32)-1;
+}
+
+/**
+ * fat_add_extent() - Append a cluster run to the extent map
+ * @pext:    Pointer to the extent map, may be reallocated
+ * @count:   Number of extents already in the map
+ * @cluster: First cluster of the run
+ * @len:     Number of clusters in the run
+ *
+ * Return:
+ * 0 for success, -ENOMEM if the map could not be enlarged (map is freed)
+ */
+static int fat_add_extent(struct fat_extent **pext, unsigned int count,
+			  __u32 cluster, __u32 len)
+{
+	struct fat_extent *ext = *pext;
+
+	if (!(count % FAT_EXTENTS_GROW)) {
+		ext = realloc(ext, (count + FAT_EXTENTS_GROW) * sizeof(*ext));
+		if (!ext) {
+			free(*pext);
+			*pext = NULL;
+			return -ENOMEM;
+		}
+		*pext = ext;
+	}
+	ext[count].cluster = cluster;
+	ext[count].count = len;
+
+	return 0;
+}
+
+/**
+ * fat_get_extents() - Build the extent map of a cluster chain
+ * @mydata:   Pointer to device specific information
+ * @cluster:  First cluster of the file
+ * @clusters: Number of clusters to follow
+ * @pext:     Pointer where to store the allocated extent map (NULL: only
+ *            count the extents)
+ *
+ * Follow the cluster chain and combine clusters that are in sequence to runs.
+ * If the chain is longer than what fits into the regular FAT buffer, a larger
+ * temporary buffer is used to reduce the number of FAT sector reads. The
+ * chain ends early on an unexpected EOF or an invalid cluster; then the map
+ * only covers the valid part. The caller has to free the map.
+ *
+ * Return:
+ * Number of extents (>=0) or -ENOMEM
+ */
+static int fat_get_extents(struct fsdata *mydata, __u32 cluster,
+			   __u32 clusters, struct fat_extent **pext)
+{
+	unsigned int count = 0;
+	__u8 *mapbuf = NULL;
+	__u32 start = cluster;
+	__u32 len = 0;
+	int ret = 0;
+
+	if (pext)
+		*pext = NULL;
+
+	if (clusters > mydata->fatbuf_entries) {
+		mapbuf = malloc_cache_aligned(CONFIG_SYS_FAT_PRELOAD_MAP);
+		if (mapbuf)
+			fat_set_fatbuf(mydata, mapbuf,
+				       CONFIG_SYS_FAT_PRELOAD_MAP);
+	}
+
+	while (clusters) {
+		/* Stop on unexpected EOF or invalid cluster */
+		if ((cluster < 2) || (cluster >= mydata->max_cluster))
+			break;
+		if (len && (cluster != start + len)) {
+			if (pext)
+				ret = fat_add_extent(pext, count, start, len);
+			if (ret)
+				break;
+			count++;
+			start = cluster;
+			len = 0;
+		}
+		len++;
+		if (!--clusters)
+			break;
+		cluster = get_fatent(mydata, cluster);
+	}
+	if (len && !ret) {
+		if (pext)
+			ret = fat_add_extent(pext, count, start, len);
+		count++;
+	}
+
+	if (mapbuf) {
+		fat_set_fatbuf(mydata, fat_buffer, CONFIG_SYS_FAT_PRELOAD_FAT);
+		free(mapbuf);
+	}
+
+	return ret ? ret : count;
+}
+
 
 /**
  * fat_dir_preload() - Load the next chunk of the directory
@@ -519,7 +672,9 @@ static int fat_get_fileinfo(struct wc_dirinfo *wdi, struct wc_fileinfo *wfi)
  * @len:     Maximum number of bytes to read (0: whole/remaining file)
  * @actread: Number of actually read bytes
  *
- * Read the file given in wfistarting at cluster wfi->reference.
+ * Read the file given in wfistarting at cluster wfi->reference. The cluster
+ * chain is resolved to an extent map first, then each run of consecutive
+ * clusters is loaded with one multi-sector read directly into the buffer.
  *
  * ATTENTION: We are re-using the directory preload buffer here. This should
  * be no problem as long as we don't require the directory content anymore.
@@ -537,8 +692,9 @@ static int fat_read_at(struct wc_dirinfo *wdi, struct wc_fileinfo *wfi,
 	unsigned long bytes_per_cluster;
 	unsigned long sect_size;
 	int warning = 0;
-	__u32 cluster;
-	__u32 tmp;
+	struct fat_extent *ext = NULL;
+	int extents;
+	int i;
 	__u32 sector_count;
 	__u32 sector;
 
@@ -554,28 +710,22 @@ static int fat_read_at(struct wc_dirinfo *wdi, struct wc_fileinfo *wfi,
 
 	sect_size = mydata->sect_size;
 	bytes_per_cluster = mydata->clust_size * sect_size;
-	cluster = wfi->reference;
 
-	do {
-		/* Combine sectors to a long chunk if they are in sequence */
-		sector = clust2sect(mydata, cluster);
-		bytes_next_chunk = 0;
-		do {
-			if (remaining <= bytes_per_cluster) {
-				bytes_next_chunk += remaining;
-				remaining = 0;
-				break;
-			}
-			bytes_next_chunk += bytes_per_cluster;
-			remaining -= bytes_per_cluster;
-
-			tmp = cluster;
-			cluster = get_fatent(mydata, cluster);
-
-			/* Return on unexpected EOF or invalid cluster */
-			if ((cluster < 2) || (cluster >= mydata->max_cluster))
-				goto out;
-		} while (cluster == tmp + 1);
+	/* Resolve the cluster chain to runs of consecutive clusters first, so
+	   that each run can be loaded with one large read */
+	extents = fat_get_extents(mydata, wfi->reference,
+				  DIV_ROUND_UP(remaining, bytes_per_cluster),
+				  &ext);
+	if (extents < 0)
+		return extents;
+	mydata->extents = extents;
+
+	for (i = 0; (i < extents) && remaining; i++) {
+		sector = clust2sect(mydata, ext[i].cluster);
+		bytes_next_chunk = ext[i].count * bytes_per_cluster;
+		if (bytes_next_chunk > remaining)
+			bytes_next_chunk = remaining;
+		remaining -= bytes_next_chunk;
 
 		debug("Next chunk: 0x%lx bytes at sector 0x%x\n",
 		      bytes_next_chunk, sector);
@@ -676,15 +826,36 @@ static int fat_read_at(struct wc_dirinfo *wdi, struct wc_fileinfo *wfi,
 			buffer += bytes_next_chunk;
 			bytes_next_chunk = 0;
 		}
-	} while (remaining);
+	}
 
 out:
+	free(ext);
 	if (actread)
 		*actread = total_bytes_loaded;
 
 	return 0;
 }
 
+/**
+ * fat_count_extents() - Get the number of extents of a file
+ * @wdi:     Pointer to current directory entry
+ * @wfi:     Information of file; wfi->reference is start cluster
+ *
+ * Return:
+ * Number of runs of consecutive clusters of the file or error code (<0)
+ */
+static int fat_count_extents(struct wc_dirinfo *wdi, struct wc_fileinfo *wfi)
+{
+	struct fsdata *mydata = &myfsdata;
+	unsigned long size = (unsigned long)wfi->file_size;
+	unsigned long bytes_per_cluster;
+
+	bytes_per_cluster = mydata->clust_size * mydata->sect_size;
+
+	return fat_get_extents(mydata, wfi->reference,
+			       DIV_ROUND_UP(size, bytes_per_cluster), NULL);
+}
+
 /* Function to write a file, see fat_write.c ### TODO ### */
 extern unsigned long fat_write(struct wc_dirinfo *wdi, struct wc_fileinfo *wfi,
 			       void *buffer, loff_t offset, loff_t len,
@@ -702,12 +873,14 @@ const struct wc_fsops fat_ops = {
 #else
 	NULL,
 #endif
-	NULL
+	NULL,
+	fat_count_extents
 };
 
 /**
- * file_fat_ls() - List directory contents
+ * file_fat_ls_verbose() - List directory contents
  * @pattern: File or path name to list; may contain wildcards * and ?
+ * @verbose: Also show the number of extents (fragments) of each file
  *
  * List directory contents. This may actually be a sequence of lists as the
  * pattern may refer to several directories.
@@ -716,7 +889,7 @@ const struct wc_fsops fat_ops = {
  *  0 - OK;
  * -1 - Error, e.g. while reading data from device
  */
-int file_fat_ls(const char *pattern)
+int file_fat_ls_verbose(const char *pattern, int verbose)
 {
 	struct wc_fileinfo wfi;
 
@@ -727,7 +900,20 @@ int file_fat_ls(const char *pattern)
 	wfi.pattern = pattern;
 	wfi.file_name[0] = '\0';
 
-	return wildcard_ls(&wfi, &fat_ops);
+	return wildcard_ls(&wfi, &fat_ops, verbose);
+}
+
+/**
+ * file_fat_ls() - List directory contents
+ * @pattern: File or path name to list; may contain wildcards * and ?
+ *
+ * Return:
+ *  0 - OK;
+ * -1 - Error, e.g. while reading data from device
+ */
+int file_fat_ls(const char *pattern)
+{
+	return file_fat_ls_verbose(pattern, 0);
 }
 
 /**
@@ -871,30 +1057,20 @@ int fat_set_blk_dev(struct blk_desc *dev_desc, struct disk_partition *info)
 	   system with up to 4084 clusters is FAT12, 4085 to 65525 clusters is
 	   FAT16 and (despite the name) FAT32 only uses 28 bit FAT entries and
 	   therefore 65526 to 268435445 clusters is a FAT32 file system. */
-	mydata->fatbuf_sectors = CONFIG_SYS_FAT_PRELOAD_FAT/mydata->sect_size;
-	mydata->fatbuf_entries = mydata->sect_size;
 	if (clusters <= 4084) {
 		mydata->fatsize = 12;
 		mydata->eof = 0xFF8;
-		mydata->fatbuf_sectors /= 3;
-		mydata->fatbuf_entries *= mydata->fatbuf_sectors * 2;
-		mydata->fatbuf_sectors *= 3;
 	} else if (clusters <= 65525) {
 		mydata->fatsize = 16;
 		mydata->eof = 0xFFF8;
-		mydata->fatbuf_entries *= mydata->fatbuf_sectors;
-		mydata->fatbuf_entries /= 2;
 	} else if (clusters <= 268435445) {
 		mydata->fatsize = 32;
 		mydata->eof = 0x0FFFFFF8;
-		mydata->fatbuf_entries *= mydata->fatbuf_sectors;
-		mydata->fatbuf_entries /= 4;
 	} else {
 		cur_dev = NULL;		  /* Unknown FAT type (exFAT?) */
 		return -1;
 	}
-	mydata->fatbufnum = (__u32)-1;
-	mydata->fatbuf = fat_buffer;
+	fat_set_fatbuf(mydata, fat_buffer, CONFIG_SYS_FAT_PRELOAD_FAT);
 	mydata->dirbuf = dir_buffer;
 	mydata->max_cluster = clusters + 2;
 
@@ -905,6 +1081,23 @@ int fat_set_blk_dev(struct blk_desc *dev_desc, struct disk_partition *info)
 	if (mydata->volume_name[0] == '\0')
 		strcpy(mydata->volume_name, FAT_DEF_VOLUME);
 
+	/* Drop cached directories if this is another medium or partition */
+	if ((vistart->ext_boot_sign != 0x28)
+	    && (vistart->ext_boot_sign != 0x29))
+		memset(vistart->volume_id, 0, sizeof(cache_volume_id));
+	if ((cache_if_type != dev_desc->if_type)
+	    || (cache_devnum != dev_desc->devnum)
+	    || (cache_start != info->start)
+	    || memcmp(cache_volume_id, vistart->volume_id,
+		      sizeof(cache_volume_id))) {
+		wildcard_cache_invalidate();
+		cache_if_type = dev_desc->if_type;
+		cache_devnum = dev_desc->devnum;
+		cache_start = info->start;
+		memcpy(cache_volume_id, vistart->volume_id,
+		       sizeof(cache_volume_id));
+	}
+
 	return 0;
 }
 
@@ -930,6 +1123,8 @@ int file_fat_detectfs(void)
 	printf("Partition %d:\n", cur_part_nr);
 	printf("  Filesystem: FAT%u\n", myfsdata.fatsize);
 	printf("  Volume name: %s\n", myfsdata.volume_name);
+	if (myfsdata.extents)
+		printf("  Extents of last file read: %u\n", myfsdata.extents);
 
 	/* We could additionally search the root directory for the volume
 	   name, and show both if they differ, but is it worth it? */
@@ -75,21 +75,179 @@ static int sqfs_count_tokens(const char *filename)
 	return token_count;
 }
 
+/* Drop all cached metadata, e.g. because a different image was probed */
+static void sqfs_flush_cache(void)
+{
+	int i;
+
+	for (i = 0; i < CONFIG_SQFS_METADATA_CACHE; i++) {
+		free(ctxt.meta[i].data);
+		ctxt.meta[i].data = NULL;
+		ctxt.meta[i].block = 0;
+	}
+	free(ctxt.meta_buf);
+	ctxt.meta_buf = NULL;
+	free(ctxt.frag_index);
+	ctxt.frag_index = NULL;
+	free(ctxt.frag_data);
+	ctxt.frag_data = NULL;
+	ctxt.frag_pos = 0;
+	ctxt.meta_stamp = 0;
+}
+
+/*
+ * Keep the cache if the image is the same as before, i.e. same device,
+ * partition and super block. Otherwise start with an empty cache.
+ */
+static void sqfs_check_cache(void)
+{
+	if (ctxt.meta_dev == ctxt.cur_dev &&
+	    ctxt.meta_part_start == ctxt.cur_part_info.start &&
+	    ctxt.meta_blksz == ctxt.cur_dev->blksz &&
+	    !memcmp(&ctxt.meta_sblk, ctxt.sblk, sizeof(ctxt.meta_sblk)))
+		return;
+
+	sqfs_flush_cache();
+	ctxt.meta_dev = ctxt.cur_dev;
+	ctxt.meta_part_start = ctxt.cur_part_info.start;
+	ctxt.meta_blksz = ctxt.cur_dev->blksz;
+	memcpy(&ctxt.meta_sblk, ctxt.sblk, sizeof(ctxt.meta_sblk));
+}
+
+/*
+ * Load the metadata block starting at the given disk position into the cache
+ * and decompress it. The least recently used cache slot is replaced.
+ */
+static int sqfs_load_metablock(u64 block, struct squashfs_metablock *mb)
+{
+	u64 bytes_used = get_unaligned_le64(&ctxt.sblk->bytes_used);
+	unsigned long blksz = ctxt.cur_dev->blksz;
+	unsigned long dest_len;
+	u32 start, offset, n_blks, total, src_len;
+	bool compressed;
+	int ret;
+
+	if (!ctxt.meta_buf) {
+		/* Largest block with header at the end of a disk block */
+		n_blks = DIV_ROUND_UP(blksz - 1 + SQFS_HEADER_SIZE +
+				      SQFS_METADATA_BLOCK_SIZE, blksz);
+		ctxt.meta_buf = malloc_cache_aligned(n_blks * blksz);
+		if (!ctxt.meta_buf)
+			return -ENOMEM;
+	}
+
+	if (!mb->data) {
+		mb->data = malloc(SQFS_METADATA_BLOCK_SIZE);
+		if (!mb->data)
+			return -ENOMEM;
+	}
+
+	if (block + SQFS_HEADER_SIZE > bytes_used)
+		return -EINVAL;
+
+	/* Read the header first, then the rest of the block if necessary */
+	start = block / blksz;
+	offset = block - (u64)start * blksz;
+	n_blks = DIV_ROUND_UP(offset + SQFS_HEADER_SIZE, blksz);
+	if (sqfs_disk_read(start, n_blks, ctxt.meta_buf) < 0)
+		return -EINVAL;
+
+	ret = sqfs_read_metablock(ctxt.meta_buf, offset, &compressed, &src_len);
+	if (ret)
+		return -EINVAL;
+
+	if (block + SQFS_HEADER_SIZE + src_len > bytes_used)
+		return -EINVAL;
+
+	total = DIV_ROUND_UP(offset + SQFS_HEADER_SIZE + src_len, blksz);
+	if (total > n_blks &&
+	    sqfs_disk_read(start + n_blks, total - n_blks,
+			   ctxt.meta_buf + n_blks * blksz) < 0)
+		return -EINVAL;
+
+	if (compressed) {
+		dest_len = SQFS_METADATA_BLOCK_SIZE;
+		ret = sqfs_decompress(&ctxt, mb->data, &dest_len,
+				      ctxt.meta_buf + offset + SQFS_HEADER_SIZE,
+				      src_len);
+		if (ret)
+			return -EINVAL;
+	} else {
+		memcpy(mb->data, ctxt.meta_buf + offset + SQFS_HEADER_SIZE,
+		       src_len);
+		dest_len = src_len;
+	}
+
+	mb->block = block;
+	mb->next = block + SQFS_HEADER_SIZE + src_len;
+	mb->len = dest_len;
+
+	return 0;
+}
+
+/* Get a metadata block from the cache, load it if it is not there yet */
+static int sqfs_get_metablock(u64 block, struct squashfs_metablock **mbp)
+{
+	struct squashfs_metablock *mb, *victim = &ctxt.meta[0];
+	int i, ret;
+
+	for (i = 0; i < CONFIG_SQFS_METADATA_CACHE; i++) {
+		mb = &ctxt.meta[i];
+		if (mb->block == block)
+			goto found;
+		if (victim->block && (!mb->block || mb->stamp < victim->stamp))
+			victim = mb;
+	}
+
+	mb = victim;
+	mb->block = 0;
+	ret = sqfs_load_metablock(block, mb);
+	if (ret)
+		return ret;
+
+found:
+	mb->stamp = ++ctxt.meta_stamp;
+	*mbp = mb;
+
+	return 0;
+}
+
 /*
- * Calculates how many blocks are needed for the buffer used in sqfs_disk_read.
- * The memory section (e.g. inode table) start offset and its end (i.e. the next
- * table start) must be specified. It also calculates the offset from which to
- * start reading the buffer.
+ * Read 'len' bytes of metadata at the given position, which is the disk
+ * position of a metadata block and an offset into its uncompressed data. The
+ * data may span several metadata blocks. The position is advanced by 'len'
+ * bytes. If 'buf' is NULL, the data is skipped.
  */
-static int sqfs_calc_n_blks(__le64 start, __le64 end, u64 *offset)
+static int sqfs_read_metadata(void *buf, u64 *block, u32 *offset, u32 len)
 {
-	u64 start_, table_size;
+	struct squashfs_metablock *mb;
+	u32 n;
+	int ret;
+
+	while (len) {
+		ret = sqfs_get_metablock(*block, &mb);
+		if (ret)
+			return ret;
+
+		if (!mb->len)
+			return -EINVAL;
+
+		if (*offset >= mb->len) {
+			*offset -= mb->len;
+			*block = mb->next;
+			continue;
+		}
 
-	table_size = le64_to_cpu(end) - le64_to_cpu(start);
-	start_ = le64_to_cpu(start) / ctxt.cur_dev->blksz;
-	*offset = le64_to_cpu(start) - (start_ * ctxt.cur_dev->blksz);
+		n = min(len, mb->len - *offset);
+		if (buf) {
+			memcpy(buf, mb->data + *offset, n);
+			buf += n;
+		}
+		*offset += n;
+		len -= n;
+	}
 
-	return DIV_ROUND_UP(table_size + *offset, ctxt.cur_dev->blksz);
+	return 0;
 }
 
 /*
@@ -99,126 +257,169 @@ static int sqfs_calc_n_blks(__le64 start, __le64 end, u64 *offset)
 static int sqfs_frag_lookup(u32 inode_fragment_index,
 			    struct squashfs_fragment_block_entry *e)
 {
-	u64 start, n_blks, src_len, table_offset, start_block;
-	unsigned char *metadata_buffer, *metadata, *table;
-	struct squashfs_fragment_block_entry *entries;
 	struct squashfs_super_block *sblk = ctxt.sblk;
-	unsigned long dest_len;
-	int block, offset, ret;
-	u16 header;
-
-	metadata_buffer = NULL;
-	entries = NULL;
-	table = NULL;
+	unsigned long blksz = ctxt.cur_dev->blksz;
+	u32 count, start, offset, n_blks;
+	unsigned char *table;
+	u64 block;
+	int ret;
 
-	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
+	count = get_unaligned_le32(&sblk->fragments);
+	if (inode_fragment_index >= count)
 		return -EINVAL;
 
-	start = get_unaligned_le64(&sblk->fragment_table_start) /
-		ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(sblk->fragment_table_start,
-				  sblk->export_table_start,
-				  &table_offset);
+	/* The fragment index is small, keep it together with the cache */
+	if (!ctxt.frag_index) {
+		count = DIV_ROUND_UP(count, SQFS_MAX_ENTRIES);
+		block = get_unaligned_le64(&sblk->fragment_table_start);
+		start = block / blksz;
+		offset = block - (u64)start * blksz;
+		n_blks = DIV_ROUND_UP(offset + count * sizeof(u64), blksz);
 
-	/* Allocate a proper sized buffer to store the fragment index table */
-	table = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!table) {
-		ret = -ENOMEM;
-		goto out;
-	}
+		table = malloc_cache_aligned(n_blks * blksz);
+		if (!table)
+			return -ENOMEM;
 
-	if (sqfs_disk_read(start, n_blks, table) < 0) {
-		ret = -EINVAL;
-		goto out;
-	}
+		if (sqfs_disk_read(start, n_blks, table) < 0) {
+			free(table);
+			return -EINVAL;
+		}
 
-	block = SQFS_FRAGMENT_INDEX(inode_fragment_index);
-	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index);
+		ctxt.frag_index = malloc(count * sizeof(u64));
+		if (!ctxt.frag_index) {
+			free(table);
+			return -ENOMEM;
+		}
+		memcpy(ctxt.frag_index, table + offset, count * sizeof(u64));
+		free(table);
+	}
 
 	/*
 	 * Get the start offset of the metadata block that contains the right
 	 * fragment block entry
 	 */
-	start_block = get_unaligned_le64(table + table_offset + block *
-					 sizeof(u64));
+	block = get_unaligned_le64(&ctxt.frag_index[
+				   SQFS_FRAGMENT_INDEX(inode_fragment_index)]);
+	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index) * sizeof(*e);
 
-	start = start_block / ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(cpu_to_le64(start_block),
-				  sblk->fragment_table_start, &table_offset);
+	ret = sqfs_read_metadata(e, &block, &offset, sizeof(*e));
+	if (ret)
+		return ret;
 
-	metadata_buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!metadata_buffer) {
-		ret = -ENOMEM;
-		goto out;
-	}
+	return SQFS_COMPRESSED_BLOCK(e->size);
+}
 
-	if (sqfs_disk_read(start, n_blks, metadata_buffer) < 0) {
-		ret = -EINVAL;
-		goto out;
-	}
+/* Get the position of an inode in the inode table from its reference */
+static void sqfs_inode_pos(u64 ref, u64 *block, u32 *offset)
+{
+	*block = get_unaligned_le64(&ctxt.sblk->inode_table_start) + (ref >> 16);
+	*offset = ref & 0xffff;
+}
 
-	/* Every metadata block starts with a 16-bit header */
-	header = get_unaligned_le16(metadata_buffer + table_offset);
-	metadata = metadata_buffer + table_offset + SQFS_HEADER_SIZE;
+/*
+ * Read the fixed part of the inode at the given position to 'head', which must
+ * be large enough for any inode type. The position is advanced to the
+ * variable part of the inode. Returns the size of the fixed part.
+ */
+static int sqfs_read_inode_head(u64 *block, u32 *offset,
+				struct squashfs_lreg_inode *head)
+{
+	struct squashfs_base_inode base;
+	u32 base_offset = *offset;
+	u64 base_block = *block;
+	int ret, size;
 
-	if (!metadata || !header) {
-		ret = -ENOMEM;
-		goto out;
-	}
+	ret = sqfs_read_metadata(&base, &base_block, &base_offset,
+				 sizeof(base));
+	if (ret)
+		return ret;
 
-	entries = malloc(SQFS_METADATA_BLOCK_SIZE);
-	if (!entries) {
-		ret = -ENOMEM;
-		goto out;
-	}
+	size = sqfs_inode_fixed_size(get_unaligned_le16(&base.inode_type));
+	if (size < 0)
+		return size;
 
-	if (SQFS_COMPRESSED_METADATA(header)) {
-		src_len = SQFS_METADATA_SIZE(header);
-		dest_len = SQFS_METADATA_BLOCK_SIZE;
-		ret = sqfs_decompress(&ctxt, entries, &dest_len, metadata,
-				      src_len);
-		if (ret) {
-			ret = -EINVAL;
-			goto out;
-		}
-	} else {
-		memcpy(entries, metadata, SQFS_METADATA_SIZE(header));
-	}
+	ret = sqfs_read_metadata(head, block, offset, size);
+	if (ret)
+		return ret;
 
-	*e = entries[offset];
-	ret = SQFS_COMPRESSED_BLOCK(e->size);
+	return size;
+}
 
-out:
-	free(entries);
-	free(metadata_buffer);
-	free(table);
+/*
+ * Read the complete inode with the given reference to a newly allocated
+ * buffer. The index of extended directories is not needed and skipped.
+ */
+static int sqfs_read_inode(u64 ref, void **inode)
+{
+	struct squashfs_lreg_inode head;
+	int size, fixed;
+	u32 offset;
+	u64 block;
+	int ret;
+
+	*inode = NULL;
+	sqfs_inode_pos(ref, &block, &offset);
+	fixed = sqfs_read_inode_head(&block, &offset, &head);
+	if (fixed < 0)
+		return fixed;
+
+	if (get_unaligned_le16(&head.inode_type) == SQFS_LDIR_TYPE)
+		size = fixed;
+	else
+		size = sqfs_inode_size((struct squashfs_base_inode *)&head,
+				       get_unaligned_le32(&ctxt.sblk->block_size));
+	if (size < fixed)
+		return -EINVAL;
+
+	*inode = malloc(size);
+	if (!*inode)
+		return -ENOMEM;
+
+	memcpy(*inode, &head, fixed);
+	ret = sqfs_read_metadata(*inode + fixed, &block, &offset, size - fixed);
+	if (ret) {
+		free(*inode);
+		*inode = NULL;
+	}
 
 	return ret;
 }
 
 /*
  * The entry name is a flexible array member, and we don't know its size before
- * actually reading the entry. So we need a first copy to retrieve this size so
- * we can finally copy the whole struct.
+ * actually reading the entry. So we need to read the fixed part first to
+ * retrieve this size so we can finally read the whole struct.
  */
-static int sqfs_read_entry(struct squashfs_directory_entry **dest, void *src)
+static int sqfs_read_entry(struct squashfs_directory_entry **dest,
+			   struct squashfs_dir_stream *dirs)
 {
-	struct squashfs_directory_entry *tmp;
+	struct squashfs_directory_entry tmp;
 	u16 sz;
+	int ret;
+
+	ret = sqfs_read_metadata(&tmp, &dirs->block, &dirs->offset,
+				 SQFS_ENTRY_BASE_LENGTH);
+	if (ret)
+		return ret;
 
-	tmp = src;
-	sz = get_unaligned_le16(src + sizeof(*tmp) - sizeof(u16));
 	/*
-	 * 'src' points to the begin of a directory entry, and 'sz' gets its
-	 * 'name_size' member's value. name_size is actually the string
-	 * length - 1, so adding 2 compensates this difference and adds space
-	 * for the trailling null byte.
+	 * 'sz' gets the 'name_size' member's value. name_size is actually the
+	 * string length - 1, so adding 2 compensates this difference and adds
+	 * space for the trailling null byte.
 	 */
-	*dest = malloc(sizeof(*tmp) + sz + 2);
+	sz = get_unaligned_le16(&tmp.name_size);
+	*dest = malloc(sizeof(tmp) + sz + 2);
 	if (!*dest)
 		return -ENOMEM;
 
-	memcpy(*dest, src, sizeof(*tmp) + sz + 1);
+	memcpy(*dest, &tmp, sizeof(tmp));
+	ret = sqfs_read_metadata((*dest)->name, &dirs->block, &dirs->offset,
+				 sz + 1);
+	if (ret) {
+		free(*dest);
+		*dest = NULL;
+		return ret;
+	}
 	(*dest)->name[sz + 1] = '\0';
 
 	return 0;
@@ -437,22 +638,59 @@ static char *sqfs_resolve_symlink(struct squashfs_symlink_inode *sym,
 }
 
 /*
- * m_list contains each metadata block's position, and m_count is the number of
- * elements of m_list. Those metadata blocks come from the compressed directory
- * table.
+ * Set up the directory stream to read the listing of the given directory
+ * inode from the start.
  */
-static int sqfs_search_dir(struct squashfs_dir_stream *dirs, char **token_list,
-			   int token_count, u32 *m_list, int m_count)
+static int sqfs_dir_setup(struct squashfs_dir_stream *dirs, void *dir_i)
 {
-	struct squashfs_super_block *sblk = ctxt.sblk;
-	char *path, *target, **sym_tokens, *res, *rem;
-	int j, ret = 0, new_inode_number, offset;
-	struct squashfs_symlink_inode *sym;
+	struct squashfs_base_inode *base = dir_i;
 	struct squashfs_ldir_inode *ldir;
 	struct squashfs_dir_inode *dir;
+	u32 start_block;
+
+	switch (get_unaligned_le16(&base->inode_type)) {
+	case SQFS_DIR_TYPE:
+		dir = (struct squashfs_dir_inode *)base;
+		start_block = get_unaligned_le32(&dir->start_block);
+		dirs->offset = get_unaligned_le16(&dir->offset);
+		dirs->size = get_unaligned_le16(&dir->file_size);
+		break;
+	case SQFS_LDIR_TYPE:
+		ldir = (struct squashfs_ldir_inode *)base;
+		start_block = get_unaligned_le32(&ldir->start_block);
+		dirs->offset = get_unaligned_le16(&ldir->offset);
+		dirs->size = get_unaligned_le32(&ldir->file_size);
+		break;
+	default:
+		printf("Error: this is not a directory.\n");
+		return -EINVAL;
+	}
+
+	dirs->block = get_unaligned_le64(&ctxt.sblk->directory_table_start) +
+		start_block;
+	/* sqfs_readdir() starts by reading the first directory header */
+	dirs->entry_count = 0;
+
+	return 0;
+}
+
+/* Get the reference of the inode of the current directory entry */
+static u64 sqfs_entry_inode_ref(struct squashfs_dir_stream *dirs)
+{
+	return ((u64)get_unaligned_le32(&dirs->dir_header.start) << 16) |
+		get_unaligned_le16(&dirs->entry->offset);
+}
+
+static int sqfs_search_dir(struct squashfs_dir_stream *dirs, char **token_list,
+			   int token_count)
+{
+	char *path, *target, **sym_tokens, *res, *rem;
+	int i, j, ret = 0, sym_count = 0;
+	struct squashfs_base_inode *base;
 	struct fs_dir_stream *dirsp;
 	struct fs_dirent *dent;
-	unsigned char *table;
+	void *inode;
+	u16 type;
 
 	res = NULL;
 	rem = NULL;
@@ -463,48 +701,25 @@ static int sqfs_search_dir(struct squashfs_dir_stream *dirs, char **token_list,
 	dirsp = (struct fs_dir_stream *)dirs;
 
 	/* Start by root inode */
-	table = sqfs_find_inode(dirs->inode_table, le32_to_cpu(sblk->inodes),
-				sblk->inodes, sblk->block_size);
-
-	dir = (struct squashfs_dir_inode *)table;
-	ldir = (struct squashfs_ldir_inode *)table;
-
-	/* get directory offset in directory table */
-	offset = sqfs_dir_offset(table, m_list, m_count);
-	dirs->table = &dirs->dir_table[offset];
-
-	/* Setup directory header */
-	dirs->dir_header = malloc(SQFS_DIR_HEADER_SIZE);
-	if (!dirs->dir_header)
-		return -ENOMEM;
-
-	memcpy(dirs->dir_header, dirs->table, SQFS_DIR_HEADER_SIZE);
+	ret = sqfs_read_inode(get_unaligned_le64(&ctxt.sblk->root_inode),
+			      &inode);
+	if (ret)
+		return ret;
 
-	/* Initialize squashfs_dir_stream members */
-	dirs->table += SQFS_DIR_HEADER_SIZE;
-	dirs->size = get_unaligned_le16(&dir->file_size) - SQFS_DIR_HEADER_SIZE;
-	dirs->entry_count = dirs->dir_header->count + 1;
+	ret = sqfs_dir_setup(dirs, inode);
+	if (ret)
+		goto out;
 
 	/* No path given -> root directory */
-	if (!strcmp(token_list[0], "/")) {
-		dirs->table = &dirs->dir_table[offset];
-		memcpy(&dirs->i_dir, dir, sizeof(*dir));
-		return 0;
-	}
+	if (!strcmp(token_list[0], "/"))
+		goto out;
 
 	for (j = 0; j < token_count; j++) {
-		if (!sqfs_is_dir(get_unaligned_le16(&dir->inode_type))) {
-			printf("** Cannot find directory. **\n");
-			ret = -EINVAL;
-			goto out;
-		}
-
+		ret = -ENOENT;
 		while (!sqfs_readdir(dirsp, &dent)) {
 			ret = strcmp(dent->name, token_list[j]);
 			if (!ret)
 				break;
-			free(dirs->entry);
-			dirs->entry = NULL;
 		}
 
 		if (ret) {
@@ -514,17 +729,16 @@ static int sqfs_search_dir(struct squashfs_dir_stream *dirs, char **token_list,
 		}
 
 		/* Redefine inode as the found token */
-		new_inode_number = dirs->entry->inode_offset +
-			dirs->dir_header->inode_number;
+		free(inode);
+		ret = sqfs_read_inode(sqfs_entry_inode_ref(dirs), &inode);
+		if (ret)
+			goto out;
 
-		/* Get reference to inode in the inode table */
-		table = sqfs_find_inode(dirs->inode_table, new_inode_number,
-					sblk->inodes, sblk->block_size);
-		dir = (struct squashfs_dir_inode *)table;
+		base = inode;
+		type = get_unaligned_le16(&base->inode_type);
 
 		/* Check for symbolic link and inode type sanity */
-		if (get_unaligned_le16(&dir->inode_type) == SQFS_SYMLINK_TYPE) {
-			sym = (struct squashfs_symlink_inode *)table;
+		if (type == SQFS_SYMLINK_TYPE || type == SQFS_LSYMLINK_TYPE) {
 			/* Get first j + 1 tokens */
 			path = sqfs_concat_tokens(token_list, j + 1);
 			if (!path) {
@@ -532,7 +746,7 @@ static int sqfs_search_dir(struct squashfs_dir_stream *dirs, char **token_list,
 				goto out;
 			}
 			/* Resolve for these tokens */
-			target = sqfs_resolve_symlink(sym, path);
+			target = sqfs_resolve_symlink(inode, path);
 			if (!target) {
 				ret = -ENOMEM;
 				goto out;
@@ -545,7 +759,7 @@ static int sqfs_search_dir(struct squashfs_dir_stream *dirs, char **token_list,
 				goto out;
 			}
 			/* Concatenate remaining tokens and symlink's target */
-			res = malloc(strlen(rem) + strlen(target) + 1);
+			res = malloc(strlen(rem) + strlen(target) + 2);
 			if (!res) {
 				ret = -ENOMEM;
 				goto out;
@@ -572,332 +786,57 @@ static int sqfs_search_dir(struct squashfs_dir_stream *dirs, char **token_list,
 				ret = -EINVAL;
 				goto out;
 			}
+			sym_count = token_count;
 			free(dirs->entry);
 			dirs->entry = NULL;
 
-			ret = sqfs_search_dir(dirs, sym_tokens, token_count,
-					      m_list, m_count);
+			ret = sqfs_search_dir(dirs, sym_tokens, token_count);
 			goto out;
-		} else if (!sqfs_is_dir(get_unaligned_le16(&dir->inode_type))) {
+		} else if (!sqfs_is_dir(type)) {
 			printf("** Cannot find directory. **\n");
-			free(dirs->entry);
-			dirs->entry = NULL;
 			ret = -EINVAL;
 			goto out;
 		}
 
-		/* Check if it is an extended dir. */
-		if (get_unaligned_le16(&dir->inode_type) == SQFS_LDIR_TYPE)
-			ldir = (struct squashfs_ldir_inode *)table;
-
-		/* Get dir. offset into the directory table */
-		offset = sqfs_dir_offset(table, m_list, m_count);
-		dirs->table = &dirs->dir_table[offset];
-
-		/* Copy directory header */
-		memcpy(dirs->dir_header, &dirs->dir_table[offset],
-		       SQFS_DIR_HEADER_SIZE);
-
 		/* Check for empty directory */
-		if (sqfs_is_empty_dir(table)) {
+		if (sqfs_is_empty_dir(inode)) {
 			printf("Empty directory.\n");
-			free(dirs->entry);
-			dirs->entry = NULL;
 			ret = SQFS_EMPTY_DIR;
 			goto out;
 		}
 
-		dirs->table += SQFS_DIR_HEADER_SIZE;
-		dirs->size = get_unaligned_le16(&dir->file_size);
-		dirs->entry_count = dirs->dir_header->count + 1;
-		dirs->size -= SQFS_DIR_HEADER_SIZE;
-		free(dirs->entry);
-		dirs->entry = NULL;
+		/* Continue with the listing of the found directory */
+		ret = sqfs_dir_setup(dirs, inode);
+		if (ret)
+			goto out;
 	}
 
-	offset = sqfs_dir_offset(table, m_list, m_count);
-	dirs->table = &dirs->dir_table[offset];
-
-	if (get_unaligned_le16(&dir->inode_type) == SQFS_DIR_TYPE)
-		memcpy(&dirs->i_dir, dir, sizeof(*dir));
-	else
-		memcpy(&dirs->i_ldir, ldir, sizeof(*ldir));
-
 out:
+	free(dirs->entry);
+	dirs->entry = NULL;
+	free(inode);
 	free(res);
 	free(rem);
 	free(path);
 	free(target);
+	for (i = 0; i < sym_count; i++)
+		free(sym_tokens[i]);
 	free(sym_tokens);
 	return ret;
 }
 
-/*
- * Inode and directory tables are stored as a series of metadata blocks, and
- * given the compressed size of this table, we can calculate how much metadata
- * blocks are needed to store the result of the decompression, since a
- * decompressed metadata block should have a size of 8KiB.
- */
-static int sqfs_count_metablks(void *table, u32 offset, int table_size)
-{
-	int count = 0, cur_size = 0, ret;
-	u32 data_size;
-	bool comp;
-
-	do {
-		ret = sqfs_read_metablock(table, offset + cur_size, &comp,
-					  &data_size);
-		if (ret)
-			return -EINVAL;
-		cur_size += data_size + SQFS_HEADER_SIZE;
-		count++;
-	} while (cur_size < table_size);
-
-	return count;
-}
-
-/*
- * Storing the metadata blocks header's positions will be useful while looking
- * for an entry in the directory table, using the reference (index and offset)
- * given by its inode.
- */
-static int sqfs_get_metablk_pos(u32 *pos_list, void *table, u32 offset,
-				int metablks_count)
-{
-	u32 data_size, cur_size = 0;
-	int j, ret = 0;
-	bool comp;
-
-	if (!metablks_count)
-		return -EINVAL;
-
-	for (j = 0; j < metablks_count; j++) {
-		ret = sqfs_read_metablock(table, offset + cur_size, &comp,
-					  &data_size);
-		if (ret)
-			return -EINVAL;
-
-		cur_size += data_size + SQFS_HEADER_SIZE;
-		pos_list[j] = cur_size;
-	}
-
-	return ret;
-}
-
-static int sqfs_read_inode_table(unsigned char **inode_table)
-{
-	struct squashfs_super_block *sblk = ctxt.sblk;
-	u64 start, n_blks, table_offset, table_size;
-	int j, ret = 0, metablks_count;
-	unsigned char *src_table, *itb;
-	u32 src_len, dest_offset = 0;
-	unsigned long dest_len = 0;
-	bool compressed;
-
-	table_size = get_unaligned_le64(&sblk->directory_table_start) -
-		get_unaligned_le64(&sblk->inode_table_start);
-	start = get_unaligned_le64(&sblk->inode_table_start) /
-		ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(sblk->inode_table_start,
-				  sblk->directory_table_start, &table_offset);
-
-	/* Allocate a proper sized buffer (itb) to store the inode table */
-	itb = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!itb)
-		return -ENOMEM;
-
-	if (sqfs_disk_read(start, n_blks, itb) < 0) {
-		ret = -EINVAL;
-		goto free_itb;
-	}
-
-	/* Parse inode table (metadata block) header */
-	ret = sqfs_read_metablock(itb, table_offset, &compressed, &src_len);
-	if (ret) {
-		ret = -EINVAL;
-		goto free_itb;
-	}
-
-	/* Calculate size to store the whole decompressed table */
-	metablks_count = sqfs_count_metablks(itb, table_offset, table_size);
-	if (metablks_count < 1) {
-		ret = -EINVAL;
-		goto free_itb;
-	}
-
-	*inode_table = malloc(metablks_count * SQFS_METADATA_BLOCK_SIZE);
-	if (!*inode_table) {
-		ret = -ENOMEM;
-		goto free_itb;
-	}
-
-	src_table = itb + table_offset + SQFS_HEADER_SIZE;
-
-	/* Extract compressed Inode table */
-	for (j = 0; j < metablks_count; j++) {
-		sqfs_read_metablock(itb, table_offset, &compressed, &src_len);
-		if (compressed) {
-			dest_len = SQFS_METADATA_BLOCK_SIZE;
-			ret = sqfs_decompress(&ctxt, *inode_table +
-					      dest_offset, &dest_len,
-					      src_table, src_len);
-			if (ret) {
-				free(*inode_table);
-				*inode_table = NULL;
-				goto free_itb;
-			}
-
-			dest_offset += dest_len;
-		} else {
-			memcpy(*inode_table + (j * SQFS_METADATA_BLOCK_SIZE),
-			       src_table, src_len);
-		}
-
-		/*
-		 * Offsets to the decompression destination, to the metadata
-		 * buffer 'itb' and to the decompression source, respectively.
-		 */
-
-		table_offset += src_len + SQFS_HEADER_SIZE;
-		src_table += src_len + SQFS_HEADER_SIZE;
-	}
-
-free_itb:
-	free(itb);
-
-	return ret;
-}
-
-static int sqfs_read_directory_table(unsigned char **dir_table, u32 **pos_list)
-{
-	u64 start, n_blks, table_offset, table_size;
-	struct squashfs_super_block *sblk = ctxt.sblk;
-	int j, ret = 0, metablks_count = -1;
-	unsigned char *src_table, *dtb;
-	u32 src_len, dest_offset = 0;
-	unsigned long dest_len = 0;
-	bool compressed;
-
-	*dir_table = NULL;
-	*pos_list = NULL;
-	/* DIRECTORY TABLE */
-	table_size = get_unaligned_le64(&sblk->fragment_table_start) -
-		get_unaligned_le64(&sblk->directory_table_start);
-	start = get_unaligned_le64(&sblk->directory_table_start) /
-		ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(sblk->directory_table_start,
-				  sblk->fragment_table_start, &table_offset);
-
-	/* Allocate a proper sized buffer (dtb) to store the directory table */
-	dtb = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!dtb)
-		return -ENOMEM;
-
-	if (sqfs_disk_read(start, n_blks, dtb) < 0)
-		goto out;
-
-	/* Parse directory table (metadata block) header */
-	ret = sqfs_read_metablock(dtb, table_offset, &compressed, &src_len);
-	if (ret)
-		goto out;
-
-	/* Calculate total size to store the whole decompressed table */
-	metablks_count = sqfs_count_metablks(dtb, table_offset, table_size);
-	if (metablks_count < 1)
-		goto out;
-
-	*dir_table = malloc(metablks_count * SQFS_METADATA_BLOCK_SIZE);
-	if (!*dir_table)
-		goto out;
-
-	*pos_list = malloc(metablks_count * sizeof(u32));
-	if (!*pos_list)
-		goto out;
-
-	ret = sqfs_get_metablk_pos(*pos_list, dtb, table_offset,
-				   metablks_count);
-	if (ret) {
-		metablks_count = -1;
-		goto out;
-	}
-
-	src_table = dtb + table_offset + SQFS_HEADER_SIZE;
-
-	/* Extract compressed Directory table */
-	dest_offset = 0;
-	for (j = 0; j < metablks_count; j++) {
-		sqfs_read_metablock(dtb, table_offset, &compressed, &src_len);
-		if (compressed) {
-			dest_len = SQFS_METADATA_BLOCK_SIZE;
-			ret = sqfs_decompress(&ctxt, *dir_table +
-					      (j * SQFS_METADATA_BLOCK_SIZE),
-					      &dest_len, src_table, src_len);
-			if (ret) {
-				metablks_count = -1;
-				goto out;
-			}
-
-			if (dest_len < SQFS_METADATA_BLOCK_SIZE) {
-				dest_offset += dest_len;
-				break;
-			}
-
-			dest_offset += dest_len;
-		} else {
-			memcpy(*dir_table + (j * SQFS_METADATA_BLOCK_SIZE),
-			       src_table, src_len);
-		}
-
-		/*
-		 * Offsets to the decompression destination, to the metadata
-		 * buffer 'dtb' and to the decompression source, respectively.
-		 */
-		table_offset += src_len + SQFS_HEADER_SIZE;
-		src_table += src_len + SQFS_HEADER_SIZE;
-	}
-
-out:
-	if (metablks_count < 1) {
-		free(*dir_table);
-		free(*pos_list);
-		*dir_table = NULL;
-		*pos_list = NULL;
-	}
-	free(dtb);
-
-	return metablks_count;
-}
-
 int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
 {
-	unsigned char *inode_table = NULL, *dir_table = NULL;
-	int j, token_count = 0, ret = 0, metablks_count;
+	int j, token_count = 0, ret = 0;
 	struct squashfs_dir_stream *dirs;
 	char **token_list = NULL, *path = NULL;
-	u32 *pos_list = NULL;
 
 	dirs = malloc(sizeof(*dirs));
 	if (!dirs)
 		return -EINVAL;
 
-	/* these should be set to NULL to prevent dangling pointers */
-	dirs->dir_header = NULL;
+	/* this should be set to NULL to prevent a dangling pointer */
 	dirs->entry = NULL;
-	dirs->table = NULL;
-	dirs->inode_table = NULL;
-	dirs->dir_table = NULL;
-
-	ret = sqfs_read_inode_table(&inode_table);
-	if (ret) {
-		ret = -EINVAL;
-		goto out;
-	}
-
-	metablks_count = sqfs_read_directory_table(&dir_table, &pos_list);
-	if (metablks_count < 1) {
-		ret = -EINVAL;
-		goto out;
-	}
 
 	/* Tokenize filename */
 	token_count = sqfs_count_tokens(filename);
@@ -922,59 +861,42 @@ int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
 	ret = sqfs_tokenize(token_list, token_count, path);
 	if (ret)
 		goto out;
+
 	/*
-	 * ldir's (extended directory) size is greater than dir, so it works as
-	 * a general solution for the malloc size, since 'i' is a union.
+	 * Look up the directory; this leaves the stream at the beginning of
+	 * its listing. Inodes and directory entries are read on demand through
+	 * the metadata cache.
 	 */
-	dirs->inode_table = inode_table;
-	dirs->dir_table = dir_table;
-	ret = sqfs_search_dir(dirs, token_list, token_count, pos_list,
-			      metablks_count);
+	ret = sqfs_search_dir(dirs, token_list, token_count);
 	if (ret)
 		goto out;
 
-	if (le16_to_cpu(dirs->i_dir.inode_type) == SQFS_DIR_TYPE)
-		dirs->size = le16_to_cpu(dirs->i_dir.file_size);
-	else
-		dirs->size = le32_to_cpu(dirs->i_ldir.file_size);
-
-	/* Setup directory header */
-	memcpy(dirs->dir_header, dirs->table, SQFS_DIR_HEADER_SIZE);
-	dirs->entry_count = dirs->dir_header->count + 1;
-	dirs->size -= SQFS_DIR_HEADER_SIZE;
-
-	/* Setup entry */
-	dirs->entry = NULL;
-	dirs->table += SQFS_DIR_HEADER_SIZE;
-
 	*dirsp = (struct fs_dir_stream *)dirs;
 
 out:
 	for (j = 0; j < token_count; j++)
 		free(token_list[j]);
 	free(token_list);
-	free(pos_list);
 	free(path);
-	if (ret) {
-		free(inode_table);
+	if (ret)
 		free(dirs);
-	}
 
 	return ret;
 }
 
 int sqfs_readdir(struct fs_dir_stream *fs_dirs, struct fs_dirent **dentp)
 {
-	struct squashfs_super_block *sblk = ctxt.sblk;
 	struct squashfs_dir_stream *dirs;
-	struct squashfs_lreg_inode *lreg;
-	struct squashfs_base_inode *base;
+	struct squashfs_lreg_inode head;
 	struct squashfs_reg_inode *reg;
-	int i_number, offset = 0, ret;
+	int offset = 0, ret;
 	struct fs_dirent *dent;
-	unsigned char *ipos;
+	u32 i_offset;
+	u64 i_block;
 
 	dirs = (struct squashfs_dir_stream *)fs_dirs;
+	free(dirs->entry);
+	dirs->entry = NULL;
 	if (!dirs->size) {
 		*dentp = NULL;
 		return -SQFS_STOP_READDIR;
@@ -991,29 +913,23 @@ int sqfs_readdir(struct fs_dir_stream *fs_dirs, struct fs_dirent **dentp)
 			return -SQFS_STOP_READDIR;
 		}
 
-		if (dirs->size > SQFS_EMPTY_FILE_SIZE) {
-			/* Read follow-up (emitted) dir. header */
-			memcpy(dirs->dir_header, dirs->table,
-			       SQFS_DIR_HEADER_SIZE);
-			dirs->entry_count = dirs->dir_header->count + 1;
-			ret = sqfs_read_entry(&dirs->entry, dirs->table +
-					      SQFS_DIR_HEADER_SIZE);
-			if (ret)
-				return -SQFS_STOP_READDIR;
-
-			dirs->table += SQFS_DIR_HEADER_SIZE;
+		if (dirs->size <= SQFS_EMPTY_FILE_SIZE) {
+			*dentp = NULL;
+			dirs->size = 0;
+			return -SQFS_STOP_READDIR;
 		}
-	} else {
-		ret = sqfs_read_entry(&dirs->entry, dirs->table);
+
+		/* Read follow-up (emitted) dir. header */
+		ret = sqfs_read_metadata(&dirs->dir_header, &dirs->block,
+					 &dirs->offset, SQFS_DIR_HEADER_SIZE);
 		if (ret)
 			return -SQFS_STOP_READDIR;
+		dirs->entry_count = dirs->dir_header.count + 1;
 	}
 
-	i_number = dirs->dir_header->inode_number + dirs->entry->inode_offset;
-	ipos = sqfs_find_inode(dirs->inode_table, i_number, sblk->inodes,
-			       sblk->block_size);
-
-	base = (struct squashfs_base_inode *)ipos;
+	ret = sqfs_read_entry(&dirs->entry, dirs);
+	if (ret)
+		return -SQFS_STOP_READDIR;
 
 	/* Set entry type and size */
 	switch (dirs->entry->type) {
@@ -1025,13 +941,18 @@ int sqfs_readdir(struct fs_dir_stream *fs_dirs, struct fs_dirent **dentp)
 	case SQFS_LREG_TYPE:
 		/*
 		 * Entries do not differentiate extended from regular types, so
-		 * it needs to be verified manually.
+		 * it needs to be verified manually. Only the fixed part of the
+		 * inode is needed here.
 		 */
-		if (get_unaligned_le16(&base->inode_type) == SQFS_LREG_TYPE) {
-			lreg = (struct squashfs_lreg_inode *)ipos;
-			dent->size = get_unaligned_le64(&lreg->file_size);
+		sqfs_inode_pos(sqfs_entry_inode_ref(dirs), &i_block, &i_offset);
+		ret = sqfs_read_inode_head(&i_block, &i_offset, &head);
+		if (ret < 0)
+			return -SQFS_STOP_READDIR;
+
+		if (get_unaligned_le16(&head.inode_type) == SQFS_LREG_TYPE) {
+			dent->size = get_unaligned_le64(&head.file_size);
 		} else {
-			reg = (struct squashfs_reg_inode *)ipos;
+			reg = (struct squashfs_reg_inode *)&head;
 			dent->size = get_unaligned_le32(&reg->file_size);
 		}
 
@@ -1068,9 +989,6 @@ int sqfs_readdir(struct fs_dir_stream *fs_dirs, struct fs_dirent **dentp)
 	else
 		dirs->size = 0;
 
-	/* Keep a reference to the current entry before incrementing it */
-	dirs->table += offset;
-
 	*dentp = dent;
 
 	return 0;
@@ -1102,6 +1020,8 @@ int sqfs_probe(struct blk_desc *fs_dev_desc, struct disk_partition *fs_partition
 		goto error;
 	}
 
+	sqfs_check_cache();
+
 	return 0;
 error:
 	ctxt.cur_dev = NULL;
@@ -1253,7 +1173,7 @@ static int sqfs_get_regfile_info(struct squashfs_reg_inode *reg,
 				       fentry);
 		if (ret < 0)
 			return -EINVAL;
-		finfo->comp = true;
+		finfo->comp = ret;
 		if (fentry->size < 1 || fentry->start == 0x7FFFFFFF)
 			return -EINVAL;
 	} else {
@@ -1291,7 +1211,7 @@ static int sqfs_get_lregfile_info(struct squashfs_lreg_inode *lreg,
 				       fentry);
 		if (ret < 0)
 			return -EINVAL;
-		finfo->comp = true;
+		finfo->comp = ret;
 		if (fentry->size < 1 || fentry->start == 0x7FFFFFFF)
 			return -EINVAL;
 	} else {
@@ -1305,13 +1225,116 @@ static int sqfs_get_lregfile_info(struct squashfs_lreg_inode *lreg,
 	return datablk_count;
 }
 
+/*
+ * Read the disk blocks containing 'size' bytes at position 'pos' of the image
+ * to 'buf' and return a pointer to the data within 'buf'.
+ */
+static void *sqfs_read_raw(u64 pos, u32 size, void *buf)
+{
+	unsigned long blksz = ctxt.cur_dev->blksz;
+	u32 start, offset;
+
+	start = pos / blksz;
+	offset = pos - (u64)start * blksz;
+	if (sqfs_disk_read(start, DIV_ROUND_UP(offset + size, blksz), buf) < 0)
+		return NULL;
+
+	return buf + offset;
+}
+
+/*
+ * Read 'size' bytes at position 'pos' of the image to 'dest'. Whole disk
+ * blocks are read directly to 'dest' if it is suitably aligned for DMA, the
+ * rest goes through 'bounce', which can hold 'bounce_blks' disk blocks.
+ */
+static int sqfs_read_data(u64 pos, u64 size, void *dest, void *bounce,
+			  u32 bounce_blks)
+{
+	unsigned long blksz = ctxt.cur_dev->blksz;
+	u32 start, offset, n_blks;
+	u64 chunk;
+
+	while (size) {
+		start = pos / blksz;
+		offset = pos - (u64)start * blksz;
+		if (!offset && size >= blksz &&
+		    IS_ALIGNED((ulong)dest, ARCH_DMA_MINALIGN)) {
+			n_blks = size / blksz;
+			if (sqfs_disk_read(start, n_blks, dest) < 0)
+				return -EIO;
+			chunk = (u64)n_blks * blksz;
+		} else {
+			n_blks = min_t(u64, DIV_ROUND_UP(offset + size, blksz),
+				       bounce_blks);
+			if (sqfs_disk_read(start, n_blks, bounce) < 0)
+				return -EIO;
+			chunk = min_t(u64, n_blks * blksz - offset, size);
+			memcpy(dest, bounce + offset, chunk);
+		}
+		pos += chunk;
+		dest += chunk;
+		size -= chunk;
+	}
+
+	return 0;
+}
+
+/*
+ * Make the given fragment block available in ctxt.frag_data. The last fragment
+ * block is kept, so that small files sharing a fragment block only need one
+ * decompression. 'buf' is used for reading the (compressed) block.
+ */
+static int sqfs_get_fragment(struct squashfs_fragment_block_entry *fentry,
+			     bool comp, void *buf)
+{
+	u32 block_size = get_unaligned_le32(&ctxt.sblk->block_size);
+	u32 size = SQFS_BLOCK_SIZE(fentry->size);
+	unsigned long dest_len;
+	void *data;
+	int ret;
+
+	if (ctxt.frag_data && ctxt.frag_pos == fentry->start)
+		return 0;
+
+	if (size > block_size)
+		return -EINVAL;
+
+	if (!ctxt.frag_data) {
+		ctxt.frag_data = malloc(block_size);
+		if (!ctxt.frag_data)
+			return -ENOMEM;
+	}
+	ctxt.frag_pos = 0;
+
+	data = sqfs_read_raw(fentry->start, size, buf);
+	if (!data)
+		return -EIO;
+
+	if (comp) {
+		dest_len = block_size;
+		ret = sqfs_decompress(&ctxt, ctxt.frag_data, &dest_len, data,
+				      size);
+		if (ret)
+			return ret;
+	} else {
+		memcpy(ctxt.frag_data, data, size);
+		dest_len = size;
+	}
+
+	ctxt.frag_pos = fentry->start;
+	ctxt.frag_len = dest_len;
+
+	return 0;
+}
+
 int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 	      loff_t *actread)
 {
-	char *dir = NULL, *fragment_block, *datablock = NULL, *data_buffer = NULL;
-	char *fragment = NULL, *file = NULL, *resolved, *data;
-	u64 start, n_blks, table_size, data_offset, table_offset, sparse_size;
-	int ret, j, i_number, datablk_count = 0;
+	char *dir = NULL, *datablock = NULL, *data_buffer = NULL;
+	char *file = NULL, *resolved, *data;
+	u64 data_offset, file_size, run, run_size;
+	u32 size, block_size, n_blks = 0;
+	int ret, j, k, datablk_count = 0;
 	struct squashfs_super_block *sblk = ctxt.sblk;
 	struct squashfs_fragment_block_entry frag_entry;
 	struct squashfs_file_info finfo = {0};
@@ -1322,8 +1345,8 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 	struct squashfs_base_inode *base;
 	struct squashfs_reg_inode *reg;
 	unsigned long dest_len;
+	unsigned char *ipos = NULL;
 	struct fs_dirent *dent;
-	unsigned char *ipos;
 
 	*actread = 0;
 
@@ -1336,8 +1359,8 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 	}
 
 	/*
-	 * sqfs_opendir will uncompress inode and directory tables, and will
-	 * return a pointer to the directory that contains the requested file.
+	 * sqfs_opendir will return a pointer to the directory that contains
+	 * the requested file.
 	 */
 	sqfs_split_path(&file, &dir, filename);
 	ret = sqfs_opendir(dir, &dirsp);
@@ -1348,13 +1371,11 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 	dirs = (struct squashfs_dir_stream *)dirsp;
 
 	/* For now, only regular files are able to be loaded */
+	ret = -ENOENT;
 	while (!sqfs_readdir(dirsp, &dent)) {
 		ret = strcmp(dent->name, file);
 		if (!ret)
 			break;
-
-		free(dirs->entry);
-		dirs->entry = NULL;
 	}
 
 	if (ret) {
@@ -1364,9 +1385,9 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 		goto out;
 	}
 
-	i_number = dirs->dir_header->inode_number + dirs->entry->inode_offset;
-	ipos = sqfs_find_inode(dirs->inode_table, i_number, sblk->inodes,
-			       sblk->block_size);
+	ret = sqfs_read_inode(sqfs_entry_inode_ref(dirs), (void **)&ipos);
+	if (ret)
+		goto out;
 
 	base = (struct squashfs_base_inode *)ipos;
 	switch (get_unaligned_le16(&base->inode_type)) {
@@ -1417,6 +1438,7 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 	}
 
 	/* If the user specifies a length, check its sanity */
+	file_size = finfo.size;
 	if (len) {
 		if (len > finfo.size) {
 			ret = -EINVAL;
@@ -1428,150 +1450,122 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 		len = finfo.size;
 	}
 
-	if (datablk_count) {
-		data_offset = finfo.start;
-		datablock = malloc(get_unaligned_le32(&sblk->block_size));
-		if (!datablock) {
+	block_size = get_unaligned_le32(&sblk->block_size);
+
+	/* Buffer for compressed blocks, also used as bounce buffer */
+	if (datablk_count || finfo.frag) {
+		n_blks = DIV_ROUND_UP(ctxt.cur_dev->blksz - 1 + block_size,
+				      ctxt.cur_dev->blksz);
+		data_buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
+		if (!data_buffer) {
 			ret = -ENOMEM;
 			goto out;
 		}
 	}
 
-	for (j = 0; j < datablk_count; j++) {
-		start = data_offset / ctxt.cur_dev->blksz;
-		table_size = SQFS_BLOCK_SIZE(finfo.blk_sizes[j]);
-		table_offset = data_offset - (start * ctxt.cur_dev->blksz);
-		n_blks = DIV_ROUND_UP(table_size + table_offset,
-				      ctxt.cur_dev->blksz);
+	data_offset = finfo.start;
+	for (j = 0; j < datablk_count && *actread < len; j++) {
+		size = SQFS_BLOCK_SIZE(finfo.blk_sizes[j]);
+		/* Uncompressed size of this block */
+		run = min_t(u64, block_size, file_size - (u64)j * block_size);
 
-		/* Don't load any data for sparse blocks */
 		if (finfo.blk_sizes[j] == 0) {
-			n_blks = 0;
-			table_offset = 0;
-			data_buffer = NULL;
-			data = NULL;
-		} else {
-			data_buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
+			/* This is a sparse block, don't load any data */
+			run = min_t(u64, run, len - *actread);
+			memset(buf + *actread, 0, run);
+			*actread += run;
+			continue;
+		}
 
-			if (!data_buffer) {
-				ret = -ENOMEM;
-				goto out;
+		if (!SQFS_COMPRESSED_BLOCK(finfo.blk_sizes[j])) {
+			/* Read a run of uncompressed blocks in one go */
+			run_size = 0;
+			for (k = j; k < datablk_count; k++) {
+				if (finfo.blk_sizes[k] == 0 ||
+				    SQFS_COMPRESSED_BLOCK(finfo.blk_sizes[k]))
+					break;
+				run_size += SQFS_BLOCK_SIZE(finfo.blk_sizes[k]);
 			}
-
-			ret = sqfs_disk_read(start, n_blks, data_buffer);
-			if (ret < 0) {
-				/*
-				 * Possible causes: too many data blocks or too large
-				 * SquashFS block size. Tip: re-compile the SquashFS
-				 * image with mksquashfs's -b <block_size> option.
-				 */
-				printf("Error: too many data blocks to be read.\n");
+			run = min_t(u64, run_size, len - *actread);
+			ret = sqfs_read_data(data_offset, run, buf + *actread,
+					     data_buffer, n_blks);
+			if (ret)
 				goto out;
-			}
 
-			data = data_buffer + table_offset;
+			*actread += run;
+			data_offset += run_size;
+			j = k - 1;
+			continue;
 		}
 
-		/* Load the data */
-		if (finfo.blk_sizes[j] == 0) {
-			/* This is a sparse block */
-			sparse_size = get_unaligned_le32(&sblk->block_size);
-			if ((*actread + sparse_size) > len)
-				sparse_size = len - *actread;
-			memset(buf + *actread, 0, sparse_size);
-			*actread += sparse_size;
-		} else if (SQFS_COMPRESSED_BLOCK(finfo.blk_sizes[j])) {
-			dest_len = get_unaligned_le32(&sblk->block_size);
-			ret = sqfs_decompress(&ctxt, datablock, &dest_len,
-					      data, table_size);
-			if (ret)
-				goto out;
+		if (size > block_size) {
+			ret = -EINVAL;
+			goto out;
+		}
 
-			if ((*actread + dest_len) > len)
-				dest_len = len - *actread;
-			memcpy(buf + *actread, datablock, dest_len);
-			*actread += dest_len;
+		data = sqfs_read_raw(data_offset, size, data_buffer);
+		if (!data) {
+			ret = -EIO;
+			goto out;
+		}
+
+		if (len - *actread >= run) {
+			/* Decompress straight to the destination */
+			dest_len = run;
+			ret = sqfs_decompress(&ctxt, buf + *actread, &dest_len,
+					      data, size);
+			if (!ret && dest_len != run)
+				ret = -EINVAL;
 		} else {
-			if ((*actread + table_size) > len)
-				table_size = len - *actread;
-			memcpy(buf + *actread, data, table_size);
-			*actread += table_size;
+			/* Only a part of the block is wanted */
+			if (!datablock) {
+				datablock = malloc(block_size);
+				if (!datablock) {
+					ret = -ENOMEM;
+					goto out;
+				}
+			}
+			dest_len = block_size;
+			ret = sqfs_decompress(&ctxt, datablock, &dest_len,
+					      data, size);
+			dest_len = min_t(u64, dest_len, len - *actread);
+			memcpy(buf + *actread, datablock, dest_len);
 		}
+		if (ret)
+			goto out;
 
-		data_offset += table_size;
-		if (data_buffer)
-			free(data_buffer);
-		data_buffer = NULL;
-		if (*actread >= len)
-			break;
+		*actread += dest_len;
+		data_offset += size;
 	}
 
 	/*
 	 * There is no need to continue if the file is not fragmented.
 	 */
-	if (!finfo.frag) {
+	if (!finfo.frag || *actread >= len) {
 		ret = 0;
 		goto out;
 	}
 
-	start = frag_entry.start / ctxt.cur_dev->blksz;
-	table_size = SQFS_BLOCK_SIZE(frag_entry.size);
-	table_offset = frag_entry.start - (start * ctxt.cur_dev->blksz);
-	n_blks = DIV_ROUND_UP(table_size + table_offset, ctxt.cur_dev->blksz);
-
-	fragment = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-
-	if (!fragment) {
-		ret = -ENOMEM;
+	ret = sqfs_get_fragment(&frag_entry, finfo.comp, data_buffer);
+	if (ret)
 		goto out;
-	}
 
-	ret = sqfs_disk_read(start, n_blks, fragment);
-	if (ret < 0)
+	run = len - *actread;
+	if (finfo.offset + run > ctxt.frag_len) {
+		ret = -EINVAL;
 		goto out;
-
-	/* File compressed and fragmented */
-	if (finfo.frag && finfo.comp) {
-		dest_len = get_unaligned_le32(&sblk->block_size);
-		fragment_block = malloc(dest_len);
-		if (!fragment_block) {
-			ret = -ENOMEM;
-			goto out;
-		}
-
-		ret = sqfs_decompress(&ctxt, fragment_block, &dest_len,
-				      (void *)fragment  + table_offset,
-				      frag_entry.size);
-		if (ret) {
-			free(fragment_block);
-			goto out;
-		}
-
-		for (j = *actread; j < finfo.size; j++) {
-			memcpy(buf + j, &fragment_block[finfo.offset + j], 1);
-			(*actread)++;
-		}
-
-		free(fragment_block);
-
-	} else if (finfo.frag && !finfo.comp) {
-		fragment_block = (void *)fragment + table_offset;
-
-		for (j = *actread; j < finfo.size; j++) {
-			memcpy(buf + j, &fragment_block[finfo.offset + j], 1);
-			(*actread)++;
-		}
 	}
 
+	memcpy(buf + *actread, ctxt.frag_data + finfo.offset, run);
+	*actread += run;
+
 out:
-	free(fragment);
-	if (datablk_count) {
-		free(data_buffer);
-		free(datablock);
-	}
+	free(data_buffer);
+	free(datablock);
 	free(file);
 	free(dir);
 	free(finfo.blk_sizes);
+	free(ipos);
 	sqfs_closedir(dirsp);
 
 	return ret;
@@ -1579,7 +1573,6 @@ out:
 
 int sqfs_size(const char *filename, loff_t *size)
 {
-	struct squashfs_super_block *sblk = ctxt.sblk;
 	struct squashfs_symlink_inode *symlink;
 	struct fs_dir_stream *dirsp = NULL;
 	struct squashfs_base_inode *base;
@@ -1587,14 +1580,14 @@ int sqfs_size(const char *filename, loff_t *size)
 	struct squashfs_lreg_inode *lreg;
 	struct squashfs_reg_inode *reg;
 	char *dir, *file, *resolved;
+	unsigned char *ipos = NULL;
 	struct fs_dirent *dent;
-	unsigned char *ipos;
-	int ret, i_number;
+	int ret;
 
 	sqfs_split_path(&file, &dir, filename);
 	/*
-	 * sqfs_opendir will uncompress inode and directory tables, and will
-	 * return a pointer to the directory that contains the requested file.
+	 * sqfs_opendir will return a pointer to the directory that contains
+	 * the requested file.
 	 */
 	ret = sqfs_opendir(dir, &dirsp);
 	if (ret) {
@@ -1604,12 +1597,11 @@ int sqfs_size(const char *filename, loff_t *size)
 
 	dirs = (struct squashfs_dir_stream *)dirsp;
 
+	ret = -ENOENT;
 	while (!sqfs_readdir(dirsp, &dent)) {
 		ret = strcmp(dent->name, file);
 		if (!ret)
 			break;
-		free(dirs->entry);
-		dirs->entry = NULL;
 	}
 
 	if (ret) {
@@ -1619,11 +1611,11 @@ int sqfs_size(const char *filename, loff_t *size)
 		goto free_strings;
 	}
 
-	i_number = dirs->dir_header->inode_number + dirs->entry->inode_offset;
-	ipos = sqfs_find_inode(dirs->inode_table, i_number, sblk->inodes,
-			       sblk->block_size);
-	free(dirs->entry);
-	dirs->entry = NULL;
+	ret = sqfs_read_inode(sqfs_entry_inode_ref(dirs), (void **)&ipos);
+	if (ret) {
+		*size = 0;
+		goto free_strings;
+	}
 
 	base = (struct squashfs_base_inode *)ipos;
 	switch (get_unaligned_le16(&base->inode_type)) {
@@ -1660,6 +1652,7 @@ int sqfs_size(const char *filename, loff_t *size)
 free_strings:
 	free(dir);
 	free(file);
+	free(ipos);
 
 	sqfs_closedir(dirsp);
 
@@ -1669,15 +1662,14 @@ free_strings:
 int sqfs_exists(const char *filename)
 {
 	struct fs_dir_stream *dirsp = NULL;
-	struct squashfs_dir_stream *dirs;
 	char *dir, *file;
 	struct fs_dirent *dent;
 	int ret;
 
 	sqfs_split_path(&file, &dir, filename);
 	/*
-	 * sqfs_opendir will uncompress inode and directory tables, and will
-	 * return a pointer to the directory that contains the requested file.
+	 * sqfs_opendir will return a pointer to the directory that contains
+	 * the requested file.
 	 */
 	ret = sqfs_opendir(dir, &dirsp);
 	if (ret) {
@@ -1685,14 +1677,11 @@ int sqfs_exists(const char *filename)
 		goto free_strings;
 	}
 
-	dirs = (struct squashfs_dir_stream *)dirsp;
-
+	ret = -ENOENT;
 	while (!sqfs_readdir(dirsp, &dent)) {
 		ret = strcmp(dent->name, file);
 		if (!ret)
 			break;
-		free(dirs->entry);
-		dirs->entry = NULL;
 	}
 
 	sqfs_closedir(dirsp);
@@ -1706,6 +1695,7 @@ free_strings:
 
 void sqfs_close(void)
 {
+	/* The metadata cache is kept for the next sqfs_probe() */
 	sqfs_decompressor_cleanup(&ctxt);
 	free(ctxt.sblk);
 	ctxt.sblk = NULL;
@@ -1720,8 +1710,6 @@ void sqfs_closedir(struct fs_dir_stream *dirs)
 		return;
 
 	sqfs_dirs = (struct squashfs_dir_stream *)dirs;
-	free(sqfs_dirs->inode_table);
-	free(sqfs_dirs->dir_table);
-	free(sqfs_dirs->dir_header);
+	free(sqfs_dirs->entry);
 	free(sqfs_dirs);
 }
@@ -73,6 +73,21 @@ struct squashfs_super_block {
 	__le64 export_table_start;
 };
 
+/*
+ * A decompressed metadata block (inode, directory or fragment table). 'block'
+ * is the position of its header on disk and is 0 for an unused slot, as the
+ * super block is always at the start of the image. 'next' is the position of
+ * the following metadata block and 'stamp' the time of the last access for the
+ * LRU replacement.
+ */
+struct squashfs_metablock {
+	u64 block;
+	u64 next;
+	u32 len;
+	u32 stamp;
+	unsigned char *data;
+};
+
 struct squashfs_ctxt {
 	struct disk_partition cur_part_info;
 	struct blk_desc *cur_dev;
@@ -80,6 +95,25 @@ struct squashfs_ctxt {
 #if IS_ENABLED(CONFIG_ZSTD)
 	void *zstd_workspace;
 #endif
+	/*
+	 * Metadata cache. It is kept after sqfs_close() and only dropped when
+	 * sqfs_probe() finds a different image, so that subsequent commands
+	 * on the same file system do not start from scratch. 'meta_sblk',
+	 * 'meta_dev' and 'meta_part_start' identify the image it belongs to.
+	 */
+	struct squashfs_metablock meta[CONFIG_SQFS_METADATA_CACHE];
+	u32 meta_stamp;
+	unsigned char *meta_buf;
+	unsigned long meta_blksz;
+	struct squashfs_super_block meta_sblk;
+	struct blk_desc *meta_dev;
+	lbaint_t meta_part_start;
+	/* Fragment index: positions of the fragment table's metadata blocks */
+	u64 *frag_index;
+	/* Last used fragment block (uncompressed) and its position on disk */
+	unsigned char *frag_data;
+	u64 frag_pos;
+	u32 frag_len;
 };
 
 struct squashfs_directory_index {
@@ -261,23 +295,15 @@ struct squashfs_dir_stream {
 	size_t size;
 	int entry_count;
 	/* SquashFS structures */
-	struct squashfs_directory_header *dir_header;
+	struct squashfs_directory_header dir_header;
 	struct squashfs_directory_entry *entry;
 	/*
-	 * 'table' points to a position into the directory table. Both 'table'
-	 * and 'inode' are defined for the first time in sqfs_opendir().
-	 * 'table's value changes in sqfs_readdir().
-	 */
-	unsigned char *table;
-	union squashfs_inode i;
-	struct squashfs_dir_inode i_dir;
-	struct squashfs_ldir_inode i_ldir;
-	/*
-	 * References to the tables' beginnings. They are assigned in
-	 * sqfs_opendir() and freed in sqfs_closedir().
+	 * Position of the next header or entry in the directory table, given
+	 * as metadata block on disk and offset in the uncompressed block. It is
+	 * set in sqfs_opendir() and advanced in sqfs_readdir().
 	 */
-	unsigned char *inode_table;
-	unsigned char *dir_table;
+	u64 block;
+	u32 offset;
 };
 
 struct squashfs_file_info {
@@ -295,10 +321,9 @@ struct squashfs_file_info {
 	bool comp;
 };
 
-void *sqfs_find_inode(void *inode_table, int inode_number, __le32 inode_count,
-		      __le32 block_size);
+int sqfs_inode_fixed_size(u16 type);
 
-int sqfs_dir_offset(void *dir_i, u32 *m_list, int m_count);
+int sqfs_inode_size(struct squashfs_base_inode *inode, u32 blk_size);
 
 int sqfs_read_metablock(unsigned char *file_mapping, int offset,
 			bool *compressed, u32 *data_size);
@@ -14,10 +14,387 @@
 #include <wildcard.h>
 #include <fat.h>
 #include <errno.h>
+#include <malloc.h>
 
 /* Pointer to file system calls for data access */
 static const struct wc_fsops *fs_ops;
 
+#ifdef CONFIG_FS_WILDCARD_CACHE
+/*
+ * Directory cache. Each cached directory holds all its entries in directory
+ * order (for pattern matching) and in a hash table by name (for exact file
+ * names). Directories are identified by their reference (e.g. FAT cluster)
+ * and replaced in LRU order. A directory is only used from the cache if it
+ * was read completely. The cache is dropped on writes or if the filesystem
+ * or the medium changes.
+ */
+#define WC_CACHE_BUCKETS	64	/* Hash buckets per directory */
+#define WC_CACHE_GROW		32	/* Grow entry array by this count */
+#define WC_CACHE_NAMES_GROW	1024	/* Grow name buffer by this size */
+
+struct wc_cache_entry {
+	unsigned long reference;	/* File reference, e.g. FAT cluster */
+	loff_t file_size;		/* File size */
+	enum wc_file_type file_type;	/* File type */
+	unsigned int name;		/* Offset of file name in names[] */
+	int next;			/* Next entry in hash chain, -1: end */
+};
+
+struct wc_cache_dir {
+	unsigned long reference;	/* Dir reference, e.g. FAT cluster */
+	unsigned int users;		/* Number of wc_dirinfo using it */
+	unsigned int age;		/* Time of last use for LRU */
+	bool complete;			/* All entries are cached */
+	bool stale;			/* Invalidated, free after last use */
+	unsigned int count;		/* Number of entries */
+	unsigned int names_used;	/* Used bytes in names[] */
+	unsigned int names_size;	/* Allocated bytes in names[] */
+	struct wc_cache_entry *entries;	/* Entries in directory order */
+	char *names;			/* File names, 0-terminated */
+	int buckets[WC_CACHE_BUCKETS];	/* Hash chains by name, -1: empty */
+};
+
+static struct wc_cache_dir *wc_cache[CONFIG_FS_WILDCARD_CACHE_DIRS];
+static const struct wc_fsops *wc_cache_ops;
+static unsigned int wc_cache_age;
+
+/**
+ * wildcard_cache_hash() - Compute hash bucket for a file name
+ * @name: File name (not necessarily 0-terminated)
+ * @len:  Length of the name
+ *
+ * Return:
+ * Index of the hash bucket.
+ */
+static unsigned int wildcard_cache_hash(const char *name, size_t len)
+{
+	unsigned int hash = 0;
+
+	while (len--)
+		hash = hash * 31 + (unsigned char)*name++;
+
+	return hash % WC_CACHE_BUCKETS;
+}
+
+/**
+ * wildcard_cache_free() - Free a cached directory
+ * @wcd: Cached directory
+ */
+static void wildcard_cache_free(struct wc_cache_dir *wcd)
+{
+	free(wcd->entries);
+	free(wcd->names);
+	free(wcd);
+}
+
+/**
+ * wildcard_cache_invalidate() - Drop all cached directories
+ *
+ * Directories that are still in use by a directory path are only detached
+ * from the cache and freed when the path releases them.
+ */
+void wildcard_cache_invalidate(void)
+{
+	struct wc_cache_dir *wcd;
+	int i;
+
+	for (i = 0; i < CONFIG_FS_WILDCARD_CACHE_DIRS; i++) {
+		wcd = wc_cache[i];
+		if (!wcd)
+			continue;
+		wc_cache[i] = NULL;
+		if (wcd->users)
+			wcd->stale = true;
+		else
+			wildcard_cache_free(wcd);
+	}
+}
+
+/**
+ * wildcard_cache_release() - Stop using the cached directory
+ * @wdi: Directory entry
+ *
+ * If the directory was not read completely, the partial content is dropped.
+ */
+static void wildcard_cache_release(struct wc_dirinfo *wdi)
+{
+	struct wc_cache_dir *wcd = wdi->cache;
+	int i;
+
+	if (!wcd)
+		return;
+	wdi->cache = NULL;
+	if (--wcd->users)
+		return;
+
+	if (!wcd->complete && !wcd->stale) {
+		for (i = 0; i < CONFIG_FS_WILDCARD_CACHE_DIRS; i++) {
+			if (wc_cache[i] == wcd)
+				wc_cache[i] = NULL;
+		}
+		wcd->stale = true;
+	}
+	if (wcd->stale)
+		wildcard_cache_free(wcd);
+}
+
+/**
+ * wildcard_cache_get() - Get cached directory or start a new one
+ * @reference: Directory reference
+ *
+ * Look up the directory in the cache. If it is not cached, allocate a new
+ * empty entry that is filled while reading the directory from the medium.
+ * This replaces the least recently used directory that is not in use.
+ *
+ * Return:
+ * Pointer to cached directory, NULL if the directory can not be cached.
+ */
+static struct wc_cache_dir *wildcard_cache_get(unsigned long reference)
+{
+	struct wc_cache_dir *wcd;
+	int slot = -1;
+	int i;
+
+	for (i = 0; i < CONFIG_FS_WILDCARD_CACHE_DIRS; i++) {
+		wcd = wc_cache[i];
+		if (!wcd) {
+			if ((slot < 0) || wc_cache[slot])
+				slot = i;
+			continue;
+		}
+		if (wcd->reference == reference) {
+			if (!wcd->complete)
+				return NULL;	/* Still being filled */
+			wcd->users++;
+			wcd->age = ++wc_cache_age;
+			return wcd;
+		}
+		if (!wcd->users && ((slot < 0)
+		    || (wc_cache[slot] && (wcd->age < wc_cache[slot]->age))))
+			slot = i;
+	}
+	if (slot < 0)
+		return NULL;			/* All entries in use */
+
+	wcd = calloc(1, sizeof(*wcd));
+	if (!wcd)
+		return NULL;
+	if (wc_cache[slot])
+		wildcard_cache_free(wc_cache[slot]);
+	wcd->reference = reference;
+	wcd->users = 1;
+	wcd->age = ++wc_cache_age;
+	memset(wcd->buckets, 0xff, sizeof(wcd->buckets));
+	wc_cache[slot] = wcd;
+
+	return wcd;
+}
+
+/**
+ * wildcard_cache_add() - Add a directory entry to the cached directory
+ * @wcd: Cached directory
+ * @wfi: File information to add
+ *
+ * Return:
+ * 0 for success, -ENOMEM if out of memory.
+ */
+static int wildcard_cache_add(struct wc_cache_dir *wcd,
+			      struct wc_fileinfo *wfi)
+{
+	struct wc_cache_entry *entry;
+	size_t len = strlen(wfi->file_name) + 1;
+	unsigned int hash;
+
+	if (!(wcd->count % WC_CACHE_GROW)) {
+		entry = realloc(wcd->entries,
+				(wcd->count + WC_CACHE_GROW) * sizeof(*entry));
+		if (!entry)
+			return -ENOMEM;
+		wcd->entries = entry;
+	}
+	if (wcd->names_used + len > wcd->names_size) {
+		unsigned int size = wcd->names_size + WC_CACHE_NAMES_GROW;
+		char *names;
+
+		if (size < wcd->names_used + len)
+			size = wcd->names_used + len;
+		names = realloc(wcd->names, size);
+		if (!names)
+			return -ENOMEM;
+		wcd->names = names;
+		wcd->names_size = size;
+	}
+
+	entry = &wcd->entries[wcd->count];
+	entry->reference = wfi->reference;
+	entry->file_size = wfi->file_size;
+	entry->file_type = wfi->file_type;
+	entry->name = wcd->names_used;
+	memcpy(wcd->names + wcd->names_used, wfi->file_name, len);
+	wcd->names_used += len;
+
+	hash = wildcard_cache_hash(wfi->file_name, len - 1);
+	entry->next = wcd->buckets[hash];
+	wcd->buckets[hash] = wcd->count++;
+
+	return 0;
+}
+
+/**
+ * wildcard_cache_entry() - Return a cached directory entry
+ * @wcd:   Cached directory
+ * @index: Index of entry
+ * @wfi:   Structure where to store the file information
+ */
+static void wildcard_cache_entry(struct wc_cache_dir *wcd, unsigned int index,
+				 struct wc_fileinfo *wfi)
+{
+	struct wc_cache_entry *entry = &wcd->entries[index];
+
+	wfi->reference = entry->reference;
+	wfi->file_size = entry->file_size;
+	wfi->file_type = entry->file_type;
+	strcpy(wfi->file_name, wcd->names + entry->name);
+}
+
+/**
+ * wildcard_cache_rewind() - Handle a rewind request of a directory
+ * @wdi: Directory entry
+ *
+ * If the directory is (re)started, use the cached directory if available.
+ * Otherwise prepare to fill the cache while the file system reads the
+ * directory. The rewind flag is only passed on to the file system in the
+ * latter case.
+ */
+static void wildcard_cache_rewind(struct wc_dirinfo *wdi)
+{
+	if (!(wdi->flags & WC_FLAGS_REWIND))
+		return;
+
+	/* Cache content belongs to one file system only */
+	if (wc_cache_ops != fs_ops) {
+		wildcard_cache_invalidate();
+		wc_cache_ops = fs_ops;
+	}
+
+	wildcard_cache_release(wdi);
+	wdi->cache = wildcard_cache_get(wdi->reference);
+	wdi->cache_pos = 0;
+	if (wdi->cache && wdi->cache->complete)
+		wdi->flags &= ~WC_FLAGS_REWIND;
+}
+
+/**
+ * wildcard_get_fileinfo() - Get next directory entry
+ * @wdi: Directory entry
+ * @wfi: Structure where to store file information
+ *
+ * Return the next directory entry, either from the cache or by calling the
+ * file system. In the latter case, add the entry to the cache.
+ *
+ * Return:
+ *  1 - Found another entry;
+ *  0 - No more entries;
+ * -1 - Error, e.g. while reading data from the device
+ */
+static int wildcard_get_fileinfo(struct wc_dirinfo *wdi,
+				 struct wc_fileinfo *wfi)
+{
+	struct wc_cache_dir *wcd;
+	int ret;
+
+	wildcard_cache_rewind(wdi);
+	wcd = wdi->cache;
+	if (wcd && wcd->complete) {
+		if (wdi->cache_pos >= wcd->count)
+			return 0;
+		wildcard_cache_entry(wcd, wdi->cache_pos++, wfi);
+		return 1;
+	}
+
+	ret = fs_ops->get_fileinfo(wdi, wfi);
+	if (wcd) {
+		if ((ret > 0) && !wildcard_cache_add(wcd, wfi))
+			wdi->cache_pos++;
+		else if (!ret)
+			wcd->complete = true;
+		else
+			wildcard_cache_release(wdi);
+	}
+
+	return ret;
+}
+
+/**
+ * wildcard_cache_find() - Look up an exact file name in the cache
+ * @wdi: Directory entry; wdi->dir_pattern is the name to search for
+ * @wfi: Structure where to store file information if a file is found
+ *
+ * If the directory is cached and the name part of the pattern contains no
+ * wildcards, get the next match directly from the hash table.
+ *
+ * Return:
+ *  1 - Found a file match;
+ *  0 - No more matches;
+ * -1 - Not possible, search the directory sequentially
+ */
+static int wildcard_cache_find(struct wc_dirinfo *wdi, struct wc_fileinfo *wfi)
+{
+	struct wc_cache_dir *wcd;
+	const char *pattern = wdi->dir_pattern;
+	const char *name;
+	size_t len;
+	int index;
+	int found = -1;
+
+	wildcard_cache_rewind(wdi);
+	wcd = wdi->cache;
+	if (!wcd || !wcd->complete)
+		return -1;
+	len = strcspn(pattern, "/");
+	if (strcspn(pattern, "*?") < len)
+		return -1;
+
+	/* Dummy directories . and .. should never match */
+	if (strncmp(pattern, ".", len) && strncmp(pattern, "..", len)) {
+		index = wcd->buckets[wildcard_cache_hash(pattern, len)];
+		while (index >= 0) {
+			name = wcd->names + wcd->entries[index].name;
+			if ((index >= wdi->cache_pos)
+			    && ((found < 0) || (index < found))
+			    && !strncmp(name, pattern, len) && !name[len])
+				found = index;
+			index = wcd->entries[index].next;
+		}
+	}
+	if (found < 0) {
+		wdi->cache_pos = wcd->count;
+		return 0;
+	}
+
+	wildcard_cache_entry(wcd, found, wfi);
+	wdi->cache_pos = found + 1;
+	wfi->pattern = pattern + len;
+
+	return 1;
+}
+#else /* !CONFIG_FS_WILDCARD_CACHE */
+static void wildcard_cache_release(struct wc_dirinfo *wdi)
+{
+}
+
+static int wildcard_get_fileinfo(struct wc_dirinfo *wdi,
+				 struct wc_fileinfo *wfi)
+{
+	return fs_ops->get_fileinfo(wdi, wfi);
+}
+
+static int wildcard_cache_find(struct wc_dirinfo *wdi, struct wc_fileinfo *wfi)
+{
+	return -1;
+}
+#endif /* CONFIG_FS_WILDCARD_CACHE */
+
 /**
  * skip_dir_delim() - Remove all leading directory delimiters
  * @pattern: String to check
@@ -102,7 +479,12 @@ static int wildcard_find_file(struct wc_dirinfo *wdi, struct wc_fileinfo *wfi)
 	int ret;
 	const char *pattern;
 
-	while ((ret = fs_ops->get_fileinfo(wdi, wfi)) > 0) {
+	/* Exact names can be found in the directory cache without a scan */
+	ret = wildcard_cache_find(wdi, wfi);
+	if (ret >= 0)
+		return ret;
+
+	while ((ret = wildcard_get_fileinfo(wdi, wfi)) > 0) {
 		/* Dummy directories . and .. should never match */
 		if (!strcmp(wfi->file_name, ".")
 		    || !strcmp(wfi->file_name, ".."))
@@ -265,6 +647,7 @@ static struct wc_dirinfo *wildcard_free_dir(struct wc_dirinfo *wdi)
 {
 	struct wc_dirinfo *parent_wdi = wdi->parent;
 
+	wildcard_cache_release(wdi);
 	fs_ops->free_dir(wdi);
 
 	return parent_wdi;
@@ -310,6 +693,8 @@ static struct wc_dirinfo *wildcard_alloc_dir(struct wc_dirinfo *parent_wdi,
 		wdi->parent = parent_wdi;
 		wdi->reference = wfi->reference;
 		wdi->flags = WC_FLAGS_REWIND | WC_FLAGS_RELOAD;
+		wdi->cache = NULL;
+		wdi->cache_pos = 0;
 		wdi->dir_pattern = skip_dir_delim(wfi->pattern);
 		strcpy(wdi->dir_name, wfi->file_name);
 	} else {
@@ -348,8 +733,10 @@ static struct wc_dirinfo *wildcard_path_error(struct wc_dirinfo *wdi,
 
 /**
  * wildcard_list_dir() - List the given directory in ls style
- * @wdi:    Directory path to list; wdi->dir_pattern is the pattern to show
- * @wfi:    Structure to store temporary information; ignore after return
+ * @wdi:     Directory path to list; wdi->dir_pattern is the pattern to show
+ * @wfi:     Structure to store temporary information; ignore after return
+ * @verbose: Also show the number of extents of regular files if the
+ *           filesystem supports this
  *
  * List the files of the given directory. If the wdi->dir_pattern is empty,
  * list all files (including "." and ".."), otherwise only list matching files.
@@ -360,7 +747,8 @@ static struct wc_dirinfo *wildcard_path_error(struct wc_dirinfo *wdi,
  * Return:
  * -1 on error, 0 for success.
  */
-static int wildcard_list_dir(struct wc_dirinfo *wdi, struct wc_fileinfo *wfi)
+static int wildcard_list_dir(struct wc_dirinfo *wdi, struct wc_fileinfo *wfi,
+			     int verbose)
 {
 	int ret;
 	int (*get_fileinfo)(struct wc_dirinfo *wdi, struct wc_fileinfo *wfi);
@@ -373,7 +761,7 @@ static int wildcard_list_dir(struct wc_dirinfo *wdi, struct wc_fileinfo *wfi)
 	if (wdi->dir_pattern[0])
 		get_fileinfo = wildcard_find_file;
 	else
-		get_fileinfo = fs_ops->get_fileinfo;
+		get_fileinfo = wildcard_get_fileinfo;
 
 
 	while ((ret = get_fileinfo(wdi, wfi)) > 0) {
@@ -396,8 +784,16 @@ static int wildcard_list_dir(struct wc_dirinfo *wdi, struct wc_fileinfo *wfi)
 				 symlink);
 			  break;
 		  case WC_TYPE_REGULAR:
-			  printf("%11llu  %s\n", wfi->file_size,
+			  printf("%11llu  %s", wfi->file_size,
 				 wfi->file_name);
+			  if (verbose && fs_ops->get_extents) {
+				  int extents = fs_ops->get_extents(wdi, wfi);
+
+				  if (extents >= 0)
+					  printf("  (%d extent%s)", extents,
+						 (extents == 1) ? "" : "s");
+			  }
+			  putc('\n');
 			  break;
 		}
 	}
@@ -497,6 +893,7 @@ static struct wc_dirinfo *wildcard_find_unique(struct wc_fileinfo *wfi)
  * wildcard_ls() - List files
  * @wfi:      Info for root directory and pattern for files to list
  * @ops:      Pointer to the filesystem functions doing the data access
+ * @verbose:  Also show the number of extents of each regular file
  *
  * Recursively list the files in the given root directory and all
  * subdirectories that match the pattern in wfi->pattern.
@@ -504,7 +901,8 @@ static struct wc_dirinfo *wildcard_find_unique(struct wc_fileinfo *wfi)
  * Return:
  * -1 on errors, 0 for success.
  */
-int wildcard_ls(struct wc_fileinfo *wfi, const struct wc_fsops *ops)
+int wildcard_ls(struct wc_fileinfo *wfi, const struct wc_fsops *ops,
+		int verbose)
 {
 	struct wc_dirinfo *wdi = NULL;
 	int ret;
@@ -522,7 +920,7 @@ int wildcard_ls(struct wc_fileinfo *wfi, const struct wc_fsops *ops)
 			   listing of this directory */
 			if (wdi->dir_pattern[0] == '\0') {
 				ret = 0;
-				wildcard_list_dir(wdi, wfi);
+				wildcard_list_dir(wdi, wfi, verbose);
 				break;
 			}
 
@@ -540,7 +938,7 @@ int wildcard_ls(struct wc_fileinfo *wfi, const struct wc_fsops *ops)
 				if ((ret == 0) || (ret > 1)) {
 					/* Zero matches or more than one
 					   match or no directory */
-					wildcard_list_dir(wdi, wfi);
+					wildcard_list_dir(wdi, wfi, verbose);
 					break;
 				}
 			} else {
@@ -699,6 +1097,9 @@ int wildcard_write(struct wc_fileinfo *wfi, const struct wc_fsops *ops,
 
 	wildcard_path_done(wdi);
 
+	/* Directories may have changed */
+	wildcard_cache_invalidate();
+
 	return err;
 }
 
@@ -720,8 +1121,9 @@ int wildcard_exists(struct wc_fileinfo *wfi, const struct wc_fsops *ops)
 
 	/* Find path and file */
 	wdi = wildcard_find_unique(wfi);
-	if (wdi && (wfi->file_type != WC_TYPE_NONE))
-		return 1;
+	if (!wdi)
+		return 0;
+	wildcard_path_done(wdi);
 
-	return 0;
+	return (wfi->file_type != WC_TYPE_NONE);
 }
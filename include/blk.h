@@ -8,6 +8,7 @@
 #define BLK_H
 
 #include <efi.h>
+#include <wildcard.h>
 
 #ifdef CONFIG_SYS_64BIT_LBA
 typedef uint64_t lbaint_t;
@@ -130,7 +131,8 @@ int blkcache_init(void);
  * @param blksz - size in bytes of each block
  * @param buf - buffer to contain cached data
  *
- * @return - 1 if block returned from cache, 0 otherwise.
+ * @return - 1 if block returned from cache, 0 otherwise, negative error
+ * if delayed blocks in this range could not be written to the device.
  */
 int blkcache_read(int iftype, int dev,
 		  lbaint_t start, lbaint_t blkcnt,
@@ -152,22 +154,59 @@ void blkcache_fill(int iftype, int dev,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer);
 
+/**
+ * blkcache_write() - pass data written to a block device to the cache
+ *
+ * With write-behind enabled, small writes are kept in the cache and are
+ * written to the device later. Otherwise any cached copy of the blocks is
+ * dropped and the caller has to write the data to the device.
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks to write
+ * @param blksz - size in bytes of each block
+ * @param buf - buffer containing data to write
+ *
+ * @return - 1 if the data was taken by the cache, 0 otherwise, negative
+ * error if an earlier delayed write failed.
+ */
+int blkcache_write(int iftype, int dev,
+		   lbaint_t start, lbaint_t blkcnt,
+		   unsigned long blksz, void const *buffer);
+
 /**
  * blkcache_invalidate() - discard the cache for a set of blocks
- * because of a write or device (re)initialization.
+ * because of a write or device (re)initialization. Blocks that are
+ * still waiting to be written are written to the device first.
  *
  * @param iftype - IF_TYPE_x for type of device
  * @param dev - device index of particular type
+ *
+ * @return - 0 on success, -EIO if a delayed block could not be written
  */
-void blkcache_invalidate(int iftype, int dev);
+int blkcache_invalidate(int iftype, int dev);
+
+/**
+ * blkcache_flush() - write all delayed blocks to their devices
+ *
+ * @return - 0 on success, -EIO if a block could not be written
+ */
+int blkcache_flush(void);
 
 /**
  * blkcache_configure() - configure block cache
  *
- * @param blocks - maximum blocks per entry
- * @param entries - maximum entries in cache
+ * Any delayed blocks are written and the cache is emptied.
+ *
+ * @param size_kb - cache size in KiB, 0 to disable the cache
+ * @param readahead - blocks to read ahead on sequential access
+ * @param write_behind - true to delay writes until flush or eviction
+ *
+ * @return - 0 on success, -EIO if a block could not be written
  */
-void blkcache_configure(unsigned blocks, unsigned entries);
+int blkcache_configure(unsigned size_kb, unsigned readahead,
+		       bool write_behind);
 
 /*
  * statistics of the block cache
@@ -175,9 +214,16 @@ void blkcache_configure(unsigned blocks, unsigned entries);
 struct block_cache_stats {
 	unsigned hits;
 	unsigned misses;
-	unsigned entries; /* current entry count */
-	unsigned max_blocks_per_entry;
-	unsigned max_entries;
+	unsigned entries; /* current number of cached blocks */
+	unsigned max_entries; /* number of blocks that fit into the cache */
+	unsigned dirty; /* blocks waiting to be written */
+	unsigned ra_blocks; /* blocks loaded by read-ahead */
+	unsigned ra_hits; /* read-ahead blocks that were used later */
+	unsigned evictions;
+	unsigned writebacks; /* delayed blocks written to the device */
+	unsigned size_kb;
+	unsigned readahead;
+	bool write_behind;
 };
 
 /**
@@ -200,7 +246,22 @@ static inline void blkcache_fill(int iftype, int dev,
 				 lbaint_t start, lbaint_t blkcnt,
 				 unsigned long blksz, void const *buffer) {}
 
-static inline void blkcache_invalidate(int iftype, int dev) {}
+static inline int blkcache_write(int iftype, int dev,
+				 lbaint_t start, lbaint_t blkcnt,
+				 unsigned long blksz, void const *buffer)
+{
+	return 0;
+}
+
+static inline int blkcache_invalidate(int iftype, int dev)
+{
+	return 0;
+}
+
+static inline int blkcache_flush(void)
+{
+	return 0;
+}
 
 #endif
 
@@ -457,6 +518,7 @@ static inline ulong blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt, const void *buffer)
 {
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	wildcard_cache_invalidate();
 	return block_dev->block_write(block_dev, start, blkcnt, buffer);
 }
 
@@ -464,6 +526,7 @@ static inline ulong blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt)
 {
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	wildcard_cache_invalidate();
 	return block_dev->block_erase(block_dev, start, blkcnt);
 }
 
@@ -89,6 +89,9 @@ typedef int XYPOS;
 #define lcd_set_fg(pwi, rgba) lcd_set_col(pwi, rgba, &pwi->fg)
 #define lcd_set_bg(pwi, rgba) lcd_set_col(pwi, rgba, &pwi->bg)
 
+/* Mark the dirty region of a window as empty */
+#define lcd_clear_dirty(pwi) ((pwi)->dirty_left = 1, (pwi)->dirty_right = 0)
+
 
 /************************************************************************/
 /* TYPES AND STRUCTURES							*/
@@ -164,6 +167,7 @@ typedef struct pbinfo {
 	u_int attr;			  /* Attribute of percentage text */
 	/* prog info */
 	u_int prog;			  /* Percentage */
+	XYPOS xlast;			  /* End of bar at last prog, -1: none */
 } pbinfo_t;
 
 
@@ -242,10 +246,15 @@ struct wininfo
 	u_char fbmaxcount;		  /* Maximum active buffer count */
 	u_char fbdraw;			  /* Index of buffer to draw to */
 	u_char fbshow;			  /* Index of buffer to show */
+	u_char fbflush;			  /* Copy dirty region after drawing */
 	XYPOS fbhres;			  /* Virtual size of framebuffer */
 	XYPOS fbvres;
 	XYPOS hoffs;			  /* Offset within framebuffer (>=0) */
 	XYPOS voffs;
+	XYPOS dirty_left;		  /* Region drawn since last flush, */
+	XYPOS dirty_top;		  /* empty if dirty_left > dirty_right */
+	XYPOS dirty_right;
+	XYPOS dirty_bottom;
 
 	/* Drawing information, only accessed by draw commands */
 	colinfo_t fg;			  /* Foreground color info */
@@ -324,6 +333,12 @@ extern void fix_offset(wininfo_t *wi);
 extern int setfbuf(wininfo_t *pwi, XYPOS hres, XYPOS vres,
 		   XYPOS fbhres, XYPOS fbvres, PIX pix, u_char fbcount);
 
+/* Add rectangle to the region that has to be copied on the next flush */
+extern void lcd_dirty(wininfo_t *pwi, XYPOS x1, XYPOS y1, XYPOS x2, XYPOS y2);
+
+/* Copy the dirty region from the draw buffer to the shown buffer */
+extern void lcd_flush(wininfo_t *pwi);
+
 /* If not locked, update window hardware and set environment variable */
 extern void set_wininfo(const wininfo_t *pwi);
 
@@ -313,6 +313,7 @@
 #define CONFIG_CMD_ADRAW		/* Support alpha draw commands */
 #define CONFIG_CMD_BMINFO		/* Provide bminfo command */
 #define CONFIG_XLCD_PNG			/* Support for PNG bitmaps */
+/*#define CONFIG_XLCD_PNG_NEON*/		/* Use NEON to decode PNG rows */
 #define CONFIG_XLCD_BMP			/* Support for BMP bitmaps */
 #define CONFIG_XLCD_JPG			/* Support for JPG bitmaps */
 #define CONFIG_XLCD_EXPR		/* Allow expressions in coordinates */
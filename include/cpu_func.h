@@ -86,4 +86,57 @@ int cleanup_before_linux_select(int flags);
 
 void reset_cpu(ulong addr);
 ;
+
+/**
+ * typedef cpu_parallel_fn - function to run on several CPUs in parallel
+ *
+ * @cpu:	Index of the CPU (0 is the boot CPU, 1..count-1 the others)
+ * @count:	Number of CPUs that take part
+ * @arg:	Argument as given to cpu_parallel_run()
+ *
+ * On the secondary CPUs, the function runs with a small private stack and
+ * must not use the console, malloc() or any driver. Only the boot CPU may
+ * call printf(), ctrlc() or WATCHDOG_RESET().
+ */
+typedef void (*cpu_parallel_fn)(int cpu, int count, void *arg);
+
+#if CONFIG_IS_ENABLED(CPU_PARALLEL)
+/**
+ * cpu_parallel_count() - get the number of CPUs for cpu_parallel_run()
+ *
+ * @return number of CPUs including the boot CPU, at least 1
+ */
+int cpu_parallel_count(void);
+
+/**
+ * cpu_parallel_run() - run a function on several CPUs in parallel
+ *
+ * Call @func on the boot CPU and on count-1 secondary CPUs and wait until
+ * all of them have returned. If a secondary CPU can not be started, the
+ * boot CPU calls @func for this CPU index afterwards, so that all the work
+ * is done in any case.
+ *
+ * @count:	Number of CPUs, as returned by cpu_parallel_count() or less
+ * @func:	Function to call
+ * @arg:	Argument for @func
+ * @return number of CPUs that actually ran in parallel
+ */
+int cpu_parallel_run(int count, cpu_parallel_fn func, void *arg);
+#else
+static inline int cpu_parallel_count(void)
+{
+	return 1;
+}
+
+static inline int cpu_parallel_run(int count, cpu_parallel_fn func, void *arg)
+{
+	int cpu;
+
+	for (cpu = 0; cpu < count; cpu++)
+		func(cpu, count, arg);
+
+	return 1;
+}
+#endif
+
 #endif
@@ -219,6 +219,7 @@ void *fat_next_cluster(fat_itr *itr, unsigned int *nbytes);
 #endif /* !CONFIG_FAT_FUS */
 
 int file_fat_ls(const char *pattern); /* F&S */
+int file_fat_ls_verbose(const char *pattern, int verbose); /* F&S */
 int file_fat_detectfs(void);
 int fat_exists(const char *filename);
 int fat_size(const char *filename, loff_t *size);
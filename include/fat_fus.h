@@ -45,6 +45,7 @@ struct fsdata {
 	__u32   data_length;	/* Length of data region (in sectors) */
 	__u32   max_cluster;	/* First cluster outside of file system */
 	__u32   eof;		/* First cluster number accepted as EOF */
+	__u32	extents;	/* Extent count of the last file read */
 	char    volume_name[13];/* Volume name read from boot sector */
 };
 
@@ -18,6 +18,9 @@ struct cmd_tbl;
 #define HASH_MAX_DIGEST_SIZE	32
 #endif
 
+/* Maximum number of algorithms that hash_multi_block() handles at once */
+#define HASH_MULTI_MAX		4
+
 enum {
 	HASH_FLAG_VERIFY	= 1 << 0,	/* Enable verify mode */
 	HASH_FLAG_ENV		= 1 << 1,	/* Allow env vars */
@@ -145,6 +148,43 @@ int hash_lookup_algo(const char *algo_name, struct hash_algo **algop);
 int hash_progressive_lookup_algo(const char *algo_name,
 				 struct hash_algo **algop);
 
+/**
+ * hash_finish_block() - Finish progressive hashing like hash_block()
+ *
+ * Call hash_finish() of the algorithm and convert CRCs to big endian, so
+ * that the result has the same format as the output of hash_block().
+ *
+ * @algo:	Algorithm as returned by hash_progressive_lookup_algo()
+ * @ctx:	Context from hash_init(); it is freed by this function
+ * @output:	Buffer for the digest, at least algo->digest_size bytes
+ *
+ * @return 0 if ok, -ve on error
+ */
+int hash_finish_block(struct hash_algo *algo, void *ctx, uint8_t *output);
+
+/**
+ * hash_multi_block() - Hash a block with several algorithms in one pass
+ *
+ * The data is processed in small blocks and each block is passed to all
+ * algorithms while it is still in the data cache. So the data is only read
+ * once from memory, no matter how many algorithms are used. The results have
+ * the same format as those of hash_block().
+ *
+ * @algos:	Algorithms to use; they must support progressive hashing, see
+ *		hash_progressive_lookup_algo()
+ * @count:	Number of algorithms (1..HASH_MULTI_MAX)
+ * @data:	Data to hash
+ * @len:	Length of data to hash in bytes
+ * @outputs:	Output buffers, one for each algorithm; each buffer must be
+ *		large enough for the digest of its algorithm
+ *
+ * @return 0 if ok, -EINVAL for a bad number of algorithms, other -ve value
+ * if one of the algorithms failed.
+ */
+int hash_multi_block(struct hash_algo *const algos[], int count,
+		     const void *data, unsigned int len,
+		     uint8_t *const outputs[]);
+
 /**
  * hash_parse_string() - Parse hash string into a binary array
  *
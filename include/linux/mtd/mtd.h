@@ -190,6 +190,7 @@ struct mtd_info {
 	loff_t backupoffs;   /* Offset of block to be used as backup */
 	loff_t backupend;    /* Offset of last possible block for backup */
 	loff_t replaceoffs;  /* Offset of bad block replaced by backup */
+	unsigned int max_bitflips; /* Max. bitflips in a page of last read */
 #endif
 
 #ifdef CONFIG_CMD_NAND_CONVERT
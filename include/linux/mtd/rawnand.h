@@ -1306,6 +1306,10 @@ extern loff_t nand_refresh_final_offset(struct mtd_info *mtd, loff_t offset);
 extern void nand_refresh_free_backup(struct mtd_info *mtd);
 extern int nand_refresh(struct mtd_info *mtd, loff_t refreshoffs);
 extern void nand_refresh_init(struct mtd_info *mtd);
+extern int nand_refresh_queue(struct mtd_info *mtd, loff_t offs,
+			      unsigned int bitflips, int refresh);
+extern int nand_refresh_drain(void);
+extern void nand_refresh_show_stats(struct mtd_info *mtd);
 #endif /* CONFIG_NAND_REFRESH */
 
 /* Standard NAND functions from nand_base.c */
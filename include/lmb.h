@@ -5,6 +5,7 @@
 
 #include <asm/types.h>
 #include <asm/u-boot.h>
+#include <linux/rbtree.h>
 
 /*
  * Logical memory blocks.
@@ -12,22 +13,58 @@
  * Copyright (C) 2001 Peter Bergner, IBM Corp.
  */
 
-#define MAX_LMB_REGIONS 8
+/* Number of regions that struct lmb holds without calling malloc() */
+#define LMB_NODES	16
 
+/**
+ * struct lmb_property - A region of memory
+ *
+ * @base:	Start address
+ * @size:	Size in bytes
+ * @gap:	Free space between the end of the previous region (or address 0
+ *		for the first region) and @base
+ * @max_gap:	Largest @gap in the subtree of this node
+ * @node:	Node in the tree of the region list, sorted by @base
+ */
 struct lmb_property {
 	phys_addr_t base;
 	phys_size_t size;
+	phys_size_t gap;
+	phys_size_t max_gap;
+	struct rb_node node;
 };
 
+/**
+ * struct lmb_region - A list of non-overlapping regions
+ *
+ * @cnt:	Number of regions
+ * @size:	Unused
+ * @root:	Tree of struct lmb_property, sorted by address
+ */
 struct lmb_region {
 	unsigned long cnt;
 	phys_size_t size;
-	struct lmb_property region[MAX_LMB_REGIONS+1];
+	struct rb_root root;
 };
 
+/**
+ * struct lmb - Available memory and reserved regions
+ *
+ * The regions are kept in red-black trees, so that adding, finding and
+ * allocating a region takes O(log n) time. The first LMB_NODES regions use
+ * the nodes in this struct, any further regions are allocated with malloc().
+ * Call lmb_release() when done to free them again.
+ *
+ * @memory:	Available memory
+ * @reserved:	Reserved regions
+ * @free_nodes:	Unused nodes, chained through node.rb_right
+ * @nodes:	Nodes that are part of the struct
+ */
 struct lmb {
 	struct lmb_region memory;
 	struct lmb_region reserved;
+	struct lmb_property *free_nodes;
+	struct lmb_property nodes[LMB_NODES];
 };
 
 extern void lmb_init(struct lmb *lmb);
@@ -52,10 +89,32 @@ extern long lmb_free(struct lmb *lmb, phys_addr_t base, phys_size_t size);
 extern void lmb_dump_all(struct lmb *lmb);
 extern void lmb_dump_all_force(struct lmb *lmb);
 
+/**
+ * lmb_release() - Free the memory allocated for the region lists
+ *
+ * Afterwards, @lmb is empty again, as after lmb_init(). This may also be
+ * called for a struct that is all zeroes.
+ *
+ * @lmb:	LMB to release
+ */
+void lmb_release(struct lmb *lmb);
+
+/**
+ * lmb_region_get() - Get a region by its index
+ *
+ * This walks the list, so it is meant for tests and diagnostics only.
+ *
+ * @type:	Region list, e.g. &lmb->reserved
+ * @region_nr:	Index of the region, counted from the lowest address
+ * @return pointer to the region, or NULL if there is no such region
+ */
+struct lmb_property *lmb_region_get(struct lmb_region *type,
+				    unsigned long region_nr);
+
 static inline phys_size_t
 lmb_size_bytes(struct lmb_region *type, unsigned long region_nr)
 {
-	return type->region[region_nr].size;
+	return lmb_region_get(type, region_nr)->size;
 }
 
 void board_lmb_reserve(struct lmb *lmb);
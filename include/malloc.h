@@ -981,6 +981,52 @@ extern ulong mem_malloc_brk;
 
 void mem_malloc_init(ulong start, ulong size);
 
+/**
+ * struct malloc_info - Statistics of the malloc() heap
+ *
+ * All sizes are in bytes and include the management overhead of malloc().
+ * The counters include the calls that malloc() makes internally, e.g. from
+ * calloc() and memalign().
+ *
+ * @heap_size:		Size of the malloc() area (CONFIG_SYS_MALLOC_LEN)
+ * @sys_bytes:		Part of the area that is currently used for the heap
+ * @max_sys_bytes:	Largest part of the area ever used for the heap; this
+ *			is the minimum for CONFIG_SYS_MALLOC_LEN
+ * @in_use:		Bytes in allocated blocks
+ * @free:		Bytes in free blocks, including @cached
+ * @cached:		Bytes in freed blocks held for quick reuse
+ * @malloc_count:	Number of malloc() calls
+ * @free_count:		Number of free() calls, not counting free(NULL)
+ * @realloc_count:	Number of realloc() calls with an existing block
+ * @memalign_count:	Number of memalign() calls with an alignment larger
+ *			than the one that malloc() provides anyway
+ * @cache_hits:		malloc() calls served from the size classes
+ * @pool_hits:		memalign() calls served from the DMA buffer pool
+ * @fail_count:		Number of failed allocations
+ */
+struct malloc_info {
+	ulong heap_size;
+	ulong sys_bytes;
+	ulong max_sys_bytes;
+	ulong in_use;
+	ulong free;
+	ulong cached;
+	ulong malloc_count;
+	ulong free_count;
+	ulong realloc_count;
+	ulong memalign_count;
+	ulong cache_hits;
+	ulong pool_hits;
+	ulong fail_count;
+};
+
+/**
+ * malloc_get_info() - Get statistics of the malloc() heap
+ *
+ * @info:	Returns the statistics
+ */
+void malloc_get_info(struct malloc_info *info);
+
 #ifdef __cplusplus
 };  /* end of extern "C" */
 #endif
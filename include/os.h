@@ -442,4 +442,19 @@ long os_get_time_offset(void);
  */
 void os_set_time_offset(long offset);
 
+/**
+ * os_run_threads() - call a function in several host threads in parallel
+ *
+ * Call @func with cpu = 1..count-1 in new threads and with cpu = 0 in the
+ * calling thread, then wait for all threads to finish. If a thread can not
+ * be created, its call is done in the calling thread afterwards.
+ *
+ * @count:	Number of calls
+ * @func:	Function to call
+ * @arg:	Argument for @func
+ * Return:	number of threads that ran in parallel, including the caller
+ */
+int os_run_threads(int count, void (*func)(int cpu, int count, void *arg),
+		   void *arg);
+
 #endif
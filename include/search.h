@@ -42,11 +42,15 @@ struct env_entry {
  * functions all work on a single internal hash table.
  */
 
+struct env_arena;
+
 /* Data type for reentrant functions.  */
 struct hsearch_data {
 	struct env_entry_node *table;
 	unsigned int size;
 	unsigned int filled;
+	unsigned int deleted;		/* Number of deleted slots */
+	struct env_arena *arena;	/* Import buffers holding strings */
 /*
  * Callback function which will check whether the given change for variable
  * "item" to "newval" may be applied or not, and possibly apply such change.
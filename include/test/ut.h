@@ -338,6 +338,37 @@ ulong ut_check_free(void);
  */
 long ut_check_delta(ulong last);
 
+/**
+ * ut_fill_pattern() - Fill a buffer with data for checksum and speed tests
+ *
+ * The data is a simple byte pattern that also changes with the block
+ * number, so that different blocks of the buffer give different checksums.
+ *
+ * @buf: Buffer to fill
+ * @size: Size of the buffer in bytes
+ */
+void ut_fill_pattern(void *buf, ulong size);
+
+/**
+ * ut_rate() - Return the throughput of a benchmark
+ *
+ * @count: Number of bytes (or other items) processed
+ * @us: Time taken in microseconds, 0 is treated as 1
+ * @return @count per microsecond
+ */
+ulong ut_rate(ulong count, ulong us);
+
+/**
+ * ut_show_speed() - Show time and throughput of a benchmark
+ *
+ * This prints a line "  <name> <us> us, <rate> bytes/us".
+ *
+ * @name: Name of the measured function, e.g. "crc32():"
+ * @size: Number of bytes processed
+ * @us: Time taken in microseconds
+ */
+void ut_show_speed(const char *name, ulong size, ulong us);
+
 /**
  * ut_silence_console() - Silence the console if requested by the user
  *
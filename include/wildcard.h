@@ -49,6 +49,8 @@ struct wc_dirinfo {
 	unsigned long reference;	/* Dir reference, e.g. FAT cluster */
 	const char *dir_pattern;	/* Pattern to search this directory */
 	unsigned int flags;		/* WC_FLAGS_* */
+	struct wc_cache_dir *cache;	/* Cached directory content or NULL */
+	unsigned int cache_pos;		/* Read position in cached content */
 	char dir_name[WC_NAME_MAX];	/* Name of this directory */
 };
 
@@ -76,13 +78,15 @@ struct wc_fsops {
 			  loff_t *actwrite);
 	int (*get_symlink)(struct wc_dirinfo *wdi, struct wc_fileinfo *wfi,
 			   char *symlink);
+	int (*get_extents)(struct wc_dirinfo *wdi, struct wc_fileinfo *wfi);
 };
 
 
 /* ------ Exported functions ------ */
 
-/* List directory contents */
-int wildcard_ls(struct wc_fileinfo *wfi, const struct wc_fsops *ops);
+/* List directory contents (verbose: also show fragmentation of files) */
+int wildcard_ls(struct wc_fileinfo *wfi, const struct wc_fsops *ops,
+		int verbose);
 
 /* Read a file */
 int wildcard_read_at(struct wc_fileinfo *wfi, const struct wc_fsops *ops,
@@ -95,4 +99,13 @@ int wildcard_write(struct wc_fileinfo *wfi, const struct wc_fsops *ops,
 
 /* Check for existence of a file */
 int wildcard_exists(struct wc_fileinfo *wfi, const struct wc_fsops *ops);
+
+/* Drop cached directories, e.g. if the medium was changed or written to */
+#ifdef CONFIG_FS_WILDCARD_CACHE
+void wildcard_cache_invalidate(void);
+#else
+static inline void wildcard_cache_invalidate(void)
+{
+}
+#endif
 #endif /*!_WILDCARD_H_*/
@@ -30,6 +30,25 @@
 
 #define tole(x) cpu_to_le32(x)
 
+/*
+ * Choose the CRC32 implementation at build time:
+ *
+ * - ARMv8 has CRC32 instructions for the same (bit-reflected) polynomial
+ *   that process eight bytes per instruction.
+ * - Slice-by-8 uses eight tables of 256 entries to process eight bytes in
+ *   one step. The additional seven tables (7 KiB) are computed on first use.
+ *   This is only done on little endian CPUs and not in SPL/TPL, where size
+ *   matters more than speed.
+ * - Otherwise the original byte-wise table lookup is used.
+ */
+#if defined(CONFIG_CRC32_ARM64_CRC) && !defined(USE_HOSTCC)
+#define CRC32_ARM64
+#elif defined(CONFIG_CRC32_SLICE_BY_8) && !defined(USE_HOSTCC) \
+	&& !defined(CONFIG_SPL_BUILD) && (__BYTE_ORDER == __LITTLE_ENDIAN)
+#define CRC32_SLICE_BY_8
+#endif
+
+#ifndef CRC32_ARM64
 #ifdef CONFIG_DYNAMIC_CRC_TABLE
 
 static int __efi_runtime_data crc_table_empty = 1;
@@ -86,9 +105,16 @@ static void __efi_runtime make_crc_table(void)
 #else
 /* ========================================================================
  * Table of CRC-32's of all single-byte values (made by make_crc_table)
+ *
+ * With slice-by-8 the table shares .data.efi_runtime with the writable
+ * crc_slice[] tables, so it must not be const there.
  */
 
+#ifdef CRC32_SLICE_BY_8
+static uint32_t __efi_runtime_data crc_table[256] = {
+#else
 static const uint32_t __efi_runtime_data crc_table[256] = {
+#endif
 tole(0x00000000L), tole(0x77073096L), tole(0xee0e612cL), tole(0x990951baL),
 tole(0x076dc419L), tole(0x706af48fL), tole(0xe963a535L), tole(0x9e6495a3L),
 tole(0x0edb8832L), tole(0x79dcb8a4L), tole(0xe0d5e91eL), tole(0x97d2d988L),
@@ -168,6 +194,63 @@ const uint32_t * ZEXPORT get_crc_table()
   return (const uint32_t *)crc_table;
 }
 #endif
+#endif /* !CRC32_ARM64 */
+
+#ifdef CRC32_ARM64
+/* No ones complement version, see below */
+uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
+{
+	/* Align to 64 bits */
+	while (len && ((ulong)buf & 7)) {
+		asm("crc32b %w0, %w0, %w1" : "+r" (crc) : "r" (*buf));
+		buf++;
+		len--;
+	}
+
+	while (len >= 8) {
+		asm("crc32x %w0, %w0, %x1" : "+r" (crc)
+		    : "r" (*(const uint64_t *)buf));
+		buf += 8;
+		len -= 8;
+	}
+
+	while (len) {
+		asm("crc32b %w0, %w0, %w1" : "+r" (crc) : "r" (*buf));
+		buf++;
+		len--;
+	}
+
+	return crc;
+}
+#else /* !CRC32_ARM64 */
+
+#ifdef CRC32_SLICE_BY_8
+/*
+ * crc_slice[k][n] is the CRC of byte n followed by k + 1 zero bytes, i.e.
+ * crc_table[] is the missing crc_slice[-1].
+ */
+static int __efi_runtime_data crc_slice_empty = 1;
+static uint32_t __efi_runtime_data crc_slice[7][256];
+
+static void __efi_runtime make_crc_slice_table(void)
+{
+	uint32_t c;
+	int n, k;
+
+#ifdef CONFIG_DYNAMIC_CRC_TABLE
+	if (crc_table_empty)
+		make_crc_table();
+#endif
+	for (n = 0; n < 256; n++) {
+		c = crc_table[n];
+		for (k = 0; k < 7; k++) {
+			c = crc_table[c & 255] ^ (c >> 8);
+			crc_slice[k][n] = c;
+		}
+	}
+	crc_slice_empty = 0;
+}
+#endif /* CRC32_SLICE_BY_8 */
 
 /* ========================================================================= */
 # if __BYTE_ORDER == __LITTLE_ENDIAN
@@ -200,6 +283,26 @@ uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 	 b = (uint32_t *)p;
     }
 
+#ifdef CRC32_SLICE_BY_8
+    if (crc_slice_empty)
+      make_crc_slice_table();
+
+    /* Process eight bytes per step */
+    for (; len >= 8; len -= 8) {
+	 uint32_t one = *b++ ^ crc;
+	 uint32_t two = *b++;
+
+	 crc = crc_slice[6][one & 255] ^
+	       crc_slice[5][(one >> 8) & 255] ^
+	       crc_slice[4][(one >> 16) & 255] ^
+	       crc_slice[3][one >> 24] ^
+	       crc_slice[2][two & 255] ^
+	       crc_slice[1][(two >> 8) & 255] ^
+	       crc_slice[0][(two >> 16) & 255] ^
+	       tab[two >> 24];
+    }
+#endif
+
     rem_len = len & 3;
     len = len >> 2;
     for (--b; len; --len) {
@@ -222,6 +325,7 @@ uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
     return le32_to_cpu(crc);
 }
 #undef DO_CRC
+#endif /* !CRC32_ARM64 */
 
 uint32_t __efi_runtime crc32(uint32_t crc, const Bytef *p, uInt len)
 {
@@ -44,6 +44,7 @@
 
 #define USED_FREE 0
 #define USED_DELETED -1
+#define USED_ENTRY 1
 
 #include <env_callback.h>
 #include <env_flags.h>
@@ -63,13 +64,69 @@
 
 struct env_entry_node {
 	int used;
+	unsigned int hash;		/* Hash value of entry.key */
 	struct env_entry entry;
 };
 
+/*
+ * The keys and values of imported variables are not copied one by one.
+ * Instead the import buffer is kept and the entries point into it. The
+ * buffer is freed when none of its strings is in use anymore.
+ */
+struct env_arena {
+	struct env_arena *next;
+	unsigned int users;		/* Number of strings in use */
+	size_t size;
+	char data[];
+};
+
 
 static void _hdelete(const char *key, struct hsearch_data *htab,
 		     struct env_entry *ep, int idx);
 
+/* Use a string from the import buffer or make a copy on the heap */
+static char *hstrdup(const char *s, struct env_arena *arena)
+{
+	if (arena) {
+		arena->users++;
+		return (char *)s;
+	}
+
+	return strdup(s);
+}
+
+/* Free an import buffer if none of its strings is used anymore */
+static void harena_release(struct hsearch_data *htab, struct env_arena *arena)
+{
+	struct env_arena **pa;
+
+	if (arena->users)
+		return;
+
+	for (pa = &htab->arena; *pa; pa = &(*pa)->next) {
+		if (*pa == arena) {
+			*pa = arena->next;
+			break;
+		}
+	}
+	free(arena);
+}
+
+/* Free a key or value, either on the heap or in an import buffer */
+static void hstrfree(struct hsearch_data *htab, const char *s)
+{
+	struct env_arena *arena;
+
+	for (arena = htab->arena; arena; arena = arena->next) {
+		if ((s >= arena->data) && (s < arena->data + arena->size)) {
+			arena->users--;
+			harena_release(htab, arena);
+			return;
+		}
+	}
+	free((void *)s);
+}
+
 /*
  * hcreate()
  */
@@ -122,6 +179,7 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 
 	htab->size = nel;
 	htab->filled = 0;
+	htab->deleted = 0;
 
 	/* allocate memory and zero out */
 	htab->table = (struct env_entry_node *)calloc(htab->size + 1,
@@ -140,6 +198,33 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
  * hdestroy()
  */
 
+/* Remove all entries, but keep the table itself */
+static void hclear(struct hsearch_data *htab)
+{
+	struct env_arena *arena;
+	int i;
+
+	/* free used memory */
+	for (i = 1; i <= htab->size; ++i) {
+		if (htab->table[i].used > 0) {
+			struct env_entry *ep = &htab->table[i].entry;
+
+			hstrfree(htab, ep->key);
+			hstrfree(htab, ep->data);
+		}
+	}
+	memset(htab->table, 0, (htab->size + 1) * sizeof(htab->table[0]));
+	htab->filled = 0;
+	htab->deleted = 0;
+
+	/* All import buffers should be gone by now, but be sure */
+	while (htab->arena) {
+		arena = htab->arena;
+		htab->arena = arena->next;
+		free(arena);
+	}
+}
+
 /*
  * After using the hash table it has to be destroyed. The used memory can
  * be freed and the local static variable can be marked as not used.
@@ -147,23 +232,14 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 
 void hdestroy_r(struct hsearch_data *htab)
 {
-	int i;
-
 	/* Test for correct arguments.  */
 	if (htab == NULL) {
 		__set_errno(EINVAL);
 		return;
 	}
 
-	/* free used memory */
-	for (i = 1; i <= htab->size; ++i) {
-		if (htab->table[i].used > 0) {
-			struct env_entry *ep = &htab->table[i].entry;
-
-			free((void *)ep->key);
-			free(ep->data);
-		}
-	}
+	if (htab->table)
+		hclear(htab);
 	free(htab->table);
 
 	/* the sign for an existing table is an value != NULL in htable */
@@ -183,11 +259,12 @@ void hdestroy_r(struct hsearch_data *htab)
  *
  * We use an trick to speed up the lookup. The table is created by hcreate
  * with one more element available. This enables us to use the index zero
- * special. This index will never be used because we store the first hash
- * index in the field used where zero means not used. Every other value
- * means used. The used field can be used as a first fast comparison for
- * equality of the stored and the parameter value. This helps to prevent
- * unnecessary expensive calls of strcmp.
+ * special. This index will never be used because a hash index of zero is
+ * mapped to one. The full hash value of each key is stored with the entry,
+ * so it is the first fast comparison for equality of the stored and the
+ * parameter value. This helps to prevent unnecessary expensive calls of
+ * strcmp. It also allows moving all entries to a bigger table without
+ * looking at the keys again when the table fills up.
  *
  * This implementation differs from the standard library version of
  * this function in a number of ways:
@@ -238,23 +315,136 @@ do_callback(const struct env_entry *e, const char *name, const char *value,
 	return 0;
 }
 
+/* FNV-1a hash; unlike simple shifting, all characters of long keys count */
+static unsigned int hhash(const char *key)
+{
+	unsigned int hash = 2166136261U;
+
+	while (*key) {
+		hash ^= (unsigned char)*key++;
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+/*
+ * Search the key with the given hash value. Return the index of the entry or
+ * 0 if not found. Then *newidx is set to the slot where a new entry with this
+ * key should go, or 0 if the table is full. If key is NULL, only look for a
+ * free slot.
+ */
+static unsigned int hlookup(struct hsearch_data *htab, const char *key,
+			    unsigned int hash, unsigned int *newidx)
+{
+	struct env_entry_node *node;
+	unsigned int hval, hval2, idx;
+	unsigned int first_deleted = 0;
+
+	/*
+	 * First hash function:
+	 * simply take the modul but prevent zero.
+	 */
+	hval = hash % htab->size;
+	if (hval == 0)
+		++hval;
+
+	/*
+	 * Second hash function:
+	 * as suggested in [Knuth]
+	 */
+	hval2 = 1 + hval % (htab->size - 2);
+
+	idx = hval;
+	do {
+		node = &htab->table[idx];
+		if (node->used == USED_FREE) {
+			*newidx = first_deleted ? first_deleted : idx;
+			return 0;
+		}
+		if (node->used == USED_DELETED) {
+			if (!first_deleted)
+				first_deleted = idx;
+		} else if (key && (node->hash == hash)
+			   && !strcmp(key, node->entry.key)) {
+			return idx;
+		}
+
+		/*
+		 * Because SIZE is prime this guarantees to
+		 * step through all available indices.
+		 */
+		if (idx <= hval2)
+			idx = htab->size + idx - hval2;
+		else
+			idx -= hval2;
+	} while (idx != hval);
+
+	*newidx = first_deleted;
+	return 0;
+}
+
+/*
+ * Move all entries to a new table with (at least) nel slots. This also drops
+ * the deleted slots, which would slow down the search for unknown keys.
+ */
+static int hresize(struct hsearch_data *htab, unsigned int nel)
+{
+	struct env_entry_node *old = htab->table;
+	unsigned int oldsize = htab->size;
+	unsigned int filled = htab->filled;
+	unsigned int deleted = htab->deleted;
+	unsigned int i, idx;
+
+	htab->table = NULL;
+	if (!hcreate_r(nel, htab)) {
+		/* Keep using the old table */
+		htab->table = old;
+		htab->size = oldsize;
+		htab->filled = filled;
+		htab->deleted = deleted;
+		return 0;
+	}
+
+	for (i = 1; i <= oldsize; i++) {
+		if (old[i].used <= 0)
+			continue;
+		hlookup(htab, NULL, old[i].hash, &idx);
+		htab->table[idx] = old[i];
+	}
+	htab->filled = filled;
+	free(old);
+
+	debug("Resize Hash Table: %p table = %p, N=%u\n", htab, htab->table,
+	      htab->size);
+
+	return 1;
+}
+
 /*
- * Compare an existing entry with the desired key, and overwrite if the action
- * is ENV_ENTER.  This is simply a helper function for hsearch_r().
+ * Search or enter the item. If arena is not NULL, item.key and item.data are
+ * strings in this import buffer and do not need to be copied.
  */
-static inline int _compare_and_overwrite_entry(struct env_entry item,
-		enum env_action action, struct env_entry **retval,
-		struct hsearch_data *htab, int flag, unsigned int hval,
-		unsigned int idx)
+static int _hsearch_r(struct env_entry item, enum env_action action,
+		      struct env_entry **retval, struct hsearch_data *htab,
+		      int flag, struct env_arena *arena)
 {
-	if (htab->table[idx].used == hval
-	    && strcmp(item.key, htab->table[idx].entry.key) == 0) {
+	unsigned int hash = hhash(item.key);
+	unsigned int idx, newidx, nel;
+	struct env_entry_node *table;
+	struct env_entry *ep;
+	char *data;
+	int ret;
+
+	idx = hlookup(htab, item.key, hash, &newidx);
+	if (idx) {
+		ep = &htab->table[idx].entry;
+
 		/* Overwrite existing value? */
 		if (action == ENV_ENTER && item.data) {
 			/* check for permission */
 			if (htab->change_ok != NULL && htab->change_ok(
-			    &htab->table[idx].entry, item.data,
-			    env_op_overwrite, flag)) {
+			    ep, item.data, env_op_overwrite, flag)) {
 				debug("change_ok() rejected setting variable "
 					"%s, skipping it!\n", item.key);
 				__set_errno(EPERM);
@@ -263,8 +453,9 @@ static inline int _compare_and_overwrite_entry(struct env_entry item,
 			}
 
 			/* If there is a callback, call it */
-			if (do_callback(&htab->table[idx].entry, item.key,
-					item.data, env_op_overwrite, flag)) {
+			table = htab->table;
+			if (do_callback(ep, item.key, item.data,
+					env_op_overwrite, flag)) {
 				debug("callback() rejected setting variable "
 					"%s, skipping it!\n", item.key);
 				__set_errno(EINVAL);
@@ -272,168 +463,121 @@ static inline int _compare_and_overwrite_entry(struct env_entry item,
 				return 0;
 			}
 
-			free(htab->table[idx].entry.data);
-			htab->table[idx].entry.data = strdup(item.data);
-			if (!htab->table[idx].entry.data) {
+			/*
+			 * The callback may have entered other variables
+			 * and thus moved the table
+			 */
+			if (htab->table != table) {
+				idx = hlookup(htab, item.key, hash, &newidx);
+				ep = &htab->table[idx].entry;
+			}
+
+			data = hstrdup(item.data, arena);
+			if (!data) {
 				__set_errno(ENOMEM);
 				*retval = NULL;
 				return 0;
 			}
+			hstrfree(htab, ep->data);
+			ep->data = data;
 		}
+
 		/* return found entry */
-		*retval = &htab->table[idx].entry;
+		*retval = ep;
 		return idx;
 	}
-	/* keep searching */
-	return -1;
-}
 
-int hsearch_r(struct env_entry item, enum env_action action,
-	      struct env_entry **retval, struct hsearch_data *htab, int flag)
-{
-	unsigned int hval;
-	unsigned int count;
-	unsigned int len = strlen(item.key);
-	unsigned int idx;
-	unsigned int first_deleted = 0;
-	int ret;
-
-	/* Compute an value for the given string. Perhaps use a better method. */
-	hval = len;
-	count = len;
-	while (count-- > 0) {
-		hval <<= 4;
-		hval += item.key[count];
+	if (action != ENV_ENTER) {
+		__set_errno(ESRCH);
+		*retval = NULL;
+		return 0;
 	}
 
 	/*
-	 * First hash function:
-	 * simply take the modul but prevent zero.
+	 * Keep the table at most 3/4 full, including deleted slots. Double
+	 * its size if more than half of it is really used, otherwise only
+	 * get rid of the deleted slots.
 	 */
-	hval %= htab->size;
-	if (hval == 0)
-		++hval;
-
-	/* The first index tried. */
-	idx = hval;
-
-	if (htab->table[idx].used) {
-		/*
-		 * Further action might be required according to the
-		 * action value.
-		 */
-		unsigned hval2;
-
-		if (htab->table[idx].used == USED_DELETED)
-			first_deleted = idx;
-
-		ret = _compare_and_overwrite_entry(item, action, retval, htab,
-			flag, hval, idx);
-		if (ret != -1)
-			return ret;
-
-		/*
-		 * Second hash function:
-		 * as suggested in [Knuth]
-		 */
-		hval2 = 1 + hval % (htab->size - 2);
-
-		do {
-			/*
-			 * Because SIZE is prime this guarantees to
-			 * step through all available indices.
-			 */
-			if (idx <= hval2)
-				idx = htab->size + idx - hval2;
-			else
-				idx -= hval2;
-
-			/*
-			 * If we visited all entries leave the loop
-			 * unsuccessfully.
-			 */
-			if (idx == hval)
-				break;
-
-			if (htab->table[idx].used == USED_DELETED
-			    && !first_deleted)
-				first_deleted = idx;
-
-			/* If entry is found use it. */
-			ret = _compare_and_overwrite_entry(item, action, retval,
-				htab, flag, hval, idx);
-			if (ret != -1)
-				return ret;
-		}
-		while (htab->table[idx].used != USED_FREE);
+	if ((htab->filled + htab->deleted + 1) * 4 > htab->size * 3) {
+		nel = htab->size;
+		if ((htab->filled + 1) * 2 > htab->size)
+			nel *= 2;
+		if (hresize(htab, nel))
+			hlookup(htab, NULL, hash, &newidx);
 	}
 
-	/* An empty bucket has been found. */
-	if (action == ENV_ENTER) {
-		/*
-		 * If table is full and another entry should be
-		 * entered return with error.
-		 */
-		if (htab->filled == htab->size) {
-			__set_errno(ENOMEM);
-			*retval = NULL;
-			return 0;
-		}
-
-		/*
-		 * Create new entry;
-		 * create copies of item.key and item.data
-		 */
-		if (first_deleted)
-			idx = first_deleted;
-
-		htab->table[idx].used = hval;
-		htab->table[idx].entry.key = strdup(item.key);
-		htab->table[idx].entry.data = strdup(item.data);
-		if (!htab->table[idx].entry.key ||
-		    !htab->table[idx].entry.data) {
-			__set_errno(ENOMEM);
-			*retval = NULL;
-			return 0;
-		}
+	/*
+	 * If table is full and another entry should be
+	 * entered return with error.
+	 */
+	if (!newidx) {
+		__set_errno(ENOMEM);
+		*retval = NULL;
+		return 0;
+	}
 
-		++htab->filled;
-
-		/* This is a new entry, so look up a possible callback */
-		env_callback_init(&htab->table[idx].entry);
-		/* Also look for flags */
-		env_flags_init(&htab->table[idx].entry);
-
-		/* check for permission */
-		if (htab->change_ok != NULL && htab->change_ok(
-		    &htab->table[idx].entry, item.data, env_op_create, flag)) {
-			debug("change_ok() rejected setting variable "
-				"%s, skipping it!\n", item.key);
-			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
-			__set_errno(EPERM);
-			*retval = NULL;
-			return 0;
-		}
+	/*
+	 * Create new entry;
+	 * create copies of item.key and item.data if necessary
+	 */
+	ep = &htab->table[newidx].entry;
+	ep->key = hstrdup(item.key, arena);
+	ep->data = hstrdup(item.data, arena);
+	if (!ep->key || !ep->data) {
+		free((void *)ep->key);
+		free(ep->data);
+		__set_errno(ENOMEM);
+		*retval = NULL;
+		return 0;
+	}
 
-		/* If there is a callback, call it */
-		if (do_callback(&htab->table[idx].entry, item.key, item.data,
-				env_op_create, flag)) {
-			debug("callback() rejected setting variable "
-				"%s, skipping it!\n", item.key);
-			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
-			__set_errno(EINVAL);
-			*retval = NULL;
-			return 0;
-		}
+	if (htab->table[newidx].used == USED_DELETED)
+		--htab->deleted;
+	htab->table[newidx].used = USED_ENTRY;
+	htab->table[newidx].hash = hash;
+	++htab->filled;
+
+	/* This is a new entry, so look up a possible callback */
+	env_callback_init(ep);
+	/* Also look for flags */
+	env_flags_init(ep);
+
+	/* check for permission */
+	if (htab->change_ok != NULL && htab->change_ok(
+	    ep, item.data, env_op_create, flag)) {
+		debug("change_ok() rejected setting variable "
+			"%s, skipping it!\n", item.key);
+		_hdelete(item.key, htab, ep, newidx);
+		__set_errno(EPERM);
+		*retval = NULL;
+		return 0;
+	}
 
-		/* return new entry */
-		*retval = &htab->table[idx].entry;
-		return 1;
+	/* If there is a callback, call it */
+	table = htab->table;
+	ret = do_callback(ep, item.key, item.data, env_op_create, flag);
+	if (htab->table != table) {
+		newidx = hlookup(htab, item.key, hash, &idx);
+		ep = &htab->table[newidx].entry;
+	}
+	if (ret) {
+		debug("callback() rejected setting variable "
+			"%s, skipping it!\n", item.key);
+		_hdelete(item.key, htab, ep, newidx);
+		__set_errno(EINVAL);
+		*retval = NULL;
+		return 0;
 	}
 
-	__set_errno(ESRCH);
-	*retval = NULL;
-	return 0;
+	/* return new entry */
+	*retval = ep;
+	return 1;
+}
+
+int hsearch_r(struct env_entry item, enum env_action action,
+	      struct env_entry **retval, struct hsearch_data *htab, int flag)
+{
+	return _hsearch_r(item, action, retval, htab, flag, NULL);
 }
 
 
@@ -452,17 +596,19 @@ static void _hdelete(const char *key, struct hsearch_data *htab,
 {
 	/* free used entry */
 	debug("hdelete: DELETING key \"%s\"\n", key);
-	free((void *)ep->key);
-	free(ep->data);
+	hstrfree(htab, ep->key);
+	hstrfree(htab, ep->data);
 	ep->flags = 0;
 	htab->table[idx].used = USED_DELETED;
 
 	--htab->filled;
+	++htab->deleted;
 }
 
 int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 {
 	struct env_entry e, *ep;
+	unsigned int newidx;
 	int idx;
 
 	debug("hdelete: DELETE key \"%s\"\n", key);
@@ -493,6 +639,15 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 		return -EINVAL;
 	}
 
+	/*
+	 * The callback may have entered or deleted other variables and thus
+	 * moved the table, or may even have deleted this variable itself
+	 */
+	idx = hlookup(htab, key, hhash(key), &newidx);
+	if (!idx)
+		return 0;
+	ep = &htab->table[idx].entry;
+
 	_hdelete(key, htab, ep, idx);
 
 	return 0;
@@ -759,6 +914,17 @@ static int drop_var_from_set(const char *name, int nvars, char * vars[])
 	return res;
 }
 
+/*
+ * Drop the reference that himport_r() holds while parsing the import
+ * buffer. Without it, deleting or overwriting the only variable imported so
+ * far would free the buffer in the middle of parsing it.
+ */
+static void himport_done(struct hsearch_data *htab, struct env_arena *arena)
+{
+	arena->users--;
+	harena_release(htab, arena);
+}
+
 /*
  * Import linearized data into hash table.
  *
@@ -801,6 +967,7 @@ int himport_r(struct hsearch_data *htab,
 		const char *env, size_t size, const char sep, int flag,
 		int crlf_is_lf, int nvars, char * const vars[])
 {
+	struct env_arena *arena;
 	char *data, *sp, *dp, *name, *value;
 	char *localvars[nvars];
 	int i;
@@ -811,12 +978,20 @@ int himport_r(struct hsearch_data *htab,
 		return 0;
 	}
 
-	/* we allocate new space to make sure we can write to the array */
-	if ((data = malloc(size + 1)) == NULL) {
+	/*
+	 * We allocate new space to make sure we can write to the array. The
+	 * variables are parsed in place and the entries point directly to
+	 * the keys and values in this buffer.
+	 */
+	arena = malloc(sizeof(*arena) + size + 1);
+	if (!arena) {
 		debug("himport_r: can't malloc %lu bytes\n", (ulong)size + 1);
 		__set_errno(ENOMEM);
 		return 0;
 	}
+	arena->users = 1;		/* Keep it while parsing */
+	arena->size = size + 1;
+	data = arena->data;
 	memcpy(data, env, size);
 	data[size] = '\0';
 	dp = data;
@@ -830,11 +1005,11 @@ int himport_r(struct hsearch_data *htab,
 #endif
 
 	if ((flag & H_NOCLEAR) == 0 && !nvars) {
-		/* Destroy old hash table if one exists */
-		debug("Destroy Hash Table: %p table = %p\n", htab,
+		/* Drop all old entries, but keep the table if one exists */
+		debug("Clear Hash Table: %p table = %p\n", htab,
 		       htab->table);
 		if (htab->table)
-			hdestroy_r(htab);
+			hclear(htab);
 	}
 
 	/*
@@ -864,13 +1039,17 @@ int himport_r(struct hsearch_data *htab,
 		debug("Create Hash Table: N=%d\n", nent);
 
 		if (hcreate_r(nent, htab) == 0) {
-			free(data);
+			free(arena);
 			return 0;
 		}
 	}
 
+	/* Strings of the buffer are found when they are freed again */
+	arena->next = htab->arena;
+	htab->arena = arena;
+
 	if (!size) {
-		free(data);
+		himport_done(htab, arena);
 		return 1;		/* everything OK */
 	}
 	if(crlf_is_lf) {
@@ -936,7 +1115,7 @@ int himport_r(struct hsearch_data *htab,
 		if (*name == 0) {
 			debug("INSERT: unable to use an empty key\n");
 			__set_errno(EINVAL);
-			free(data);
+			himport_done(htab, arena);
 			return 0;
 		}
 
@@ -948,7 +1127,7 @@ int himport_r(struct hsearch_data *htab,
 		e.key = name;
 		e.data = value;
 
-		hsearch_r(e, ENV_ENTER, &rv, htab, flag);
+		_hsearch_r(e, ENV_ENTER, &rv, htab, flag, arena);
 #if !CONFIG_IS_ENABLED(ENV_WRITEABLE_LIST)
 		if (rv == NULL) {
 			printf("himport_r: can't insert \"%s=%s\" into hash table\n",
@@ -961,8 +1140,8 @@ int himport_r(struct hsearch_data *htab,
 			rv, name, value);
 	} while ((dp < data + size) && *dp);	/* size check needed for text */
 						/* without '\0' termination */
-	debug("INSERT: free(data = %p)\n", data);
-	free(data);
+	debug("INSERT: release(data = %p)\n", data);
+	himport_done(htab, arena);
 
 	if (flag & H_NOCLEAR)
 		goto end;
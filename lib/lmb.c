@@ -11,32 +11,41 @@
 #include <lmb.h>
 #include <log.h>
 #include <malloc.h>
+#include <linux/rbtree_augmented.h>
 
 #define LMB_ALLOC_ANYWHERE	0
 
+#define lmb_entry(n)	rb_entry(n, struct lmb_property, node)
+
 void lmb_dump_all_force(struct lmb *lmb)
 {
+	struct lmb_property *p;
+	struct rb_node *n;
 	unsigned long i;
 
 	printf("lmb_dump_all:\n");
 	printf("    memory.cnt		   = 0x%lx\n", lmb->memory.cnt);
 	printf("    memory.size		   = 0x%llx\n",
 	       (unsigned long long)lmb->memory.size);
-	for (i = 0; i < lmb->memory.cnt; i++) {
+	n = rb_first(&lmb->memory.root);
+	for (i = 0; n; i++, n = rb_next(n)) {
+		p = lmb_entry(n);
 		printf("    memory.reg[0x%lx].base   = 0x%llx\n", i,
-		       (unsigned long long)lmb->memory.region[i].base);
+		       (unsigned long long)p->base);
 		printf("		   .size   = 0x%llx\n",
-		       (unsigned long long)lmb->memory.region[i].size);
+		       (unsigned long long)p->size);
 	}
 
 	printf("\n    reserved.cnt	   = 0x%lx\n", lmb->reserved.cnt);
 	printf("    reserved.size	   = 0x%llx\n",
 	       (unsigned long long)lmb->reserved.size);
-	for (i = 0; i < lmb->reserved.cnt; i++) {
+	n = rb_first(&lmb->reserved.root);
+	for (i = 0; n; i++, n = rb_next(n)) {
+		p = lmb_entry(n);
 		printf("    reserved.reg[0x%lx].base = 0x%llx\n", i,
-		       (unsigned long long)lmb->reserved.region[i].base);
+		       (unsigned long long)p->base);
 		printf("		     .size = 0x%llx\n",
-		       (unsigned long long)lmb->reserved.region[i].size);
+		       (unsigned long long)p->size);
 	}
 }
 
@@ -67,42 +76,267 @@ static long lmb_addrs_adjacent(phys_addr_t base1, phys_size_t size1,
 	return 0;
 }
 
-static long lmb_regions_adjacent(struct lmb_region *rgn, unsigned long r1,
-				 unsigned long r2)
+/*
+ * Each region knows the free space between its predecessor and itself, and
+ * each node of the tree the largest such gap in its subtree. This lets
+ * __lmb_alloc_base() skip all regions with too small gaps in O(log n).
+ */
+static phys_size_t lmb_gap(struct lmb_property *p)
 {
-	phys_addr_t base1 = rgn->region[r1].base;
-	phys_size_t size1 = rgn->region[r1].size;
-	phys_addr_t base2 = rgn->region[r2].base;
-	phys_size_t size2 = rgn->region[r2].size;
+	struct rb_node *prev = rb_prev(&p->node);
 
-	return lmb_addrs_adjacent(base1, size1, base2, size2);
+	if (!prev)
+		return p->base;
+
+	return p->base - (lmb_entry(prev)->base + lmb_entry(prev)->size);
 }
 
-static void lmb_remove_region(struct lmb_region *rgn, unsigned long r)
+static phys_size_t lmb_compute_max_gap(struct lmb_property *p)
 {
-	unsigned long i;
+	phys_size_t max_gap = p->gap;
+	struct rb_node *child;
 
-	for (i = r; i < rgn->cnt - 1; i++) {
-		rgn->region[i].base = rgn->region[i + 1].base;
-		rgn->region[i].size = rgn->region[i + 1].size;
-	}
+	child = p->node.rb_left;
+	if (child && lmb_entry(child)->max_gap > max_gap)
+		max_gap = lmb_entry(child)->max_gap;
+	child = p->node.rb_right;
+	if (child && lmb_entry(child)->max_gap > max_gap)
+		max_gap = lmb_entry(child)->max_gap;
+
+	return max_gap;
+}
+
+RB_DECLARE_CALLBACKS(static, lmb_gap_callbacks, struct lmb_property, node,
+		     phys_size_t, max_gap, lmb_compute_max_gap)
+
+static void lmb_update_gap(struct lmb_property *p)
+{
+	p->gap = lmb_gap(p);
+	lmb_gap_callbacks_propagate(&p->node, NULL);
+}
+
+/* Update the gaps after base or size of a region have changed */
+static void lmb_region_changed(struct lmb_property *p)
+{
+	struct rb_node *next = rb_next(&p->node);
+
+	lmb_update_gap(p);
+	if (next)
+		lmb_update_gap(lmb_entry(next));
+}
+
+static bool lmb_is_builtin_node(struct lmb *lmb, struct lmb_property *p)
+{
+	return (p >= lmb->nodes) && (p < lmb->nodes + LMB_NODES);
+}
+
+static struct lmb_property *lmb_get_node(struct lmb *lmb)
+{
+	struct lmb_property *p = lmb->free_nodes;
+
+	if (!p)
+		return malloc(sizeof(*p));
+
+	lmb->free_nodes = rb_entry_safe(p->node.rb_right, struct lmb_property,
+					node);
+
+	return p;
+}
+
+static void lmb_put_node(struct lmb *lmb, struct lmb_property *p)
+{
+	p->node.rb_right = lmb->free_nodes ? &lmb->free_nodes->node : NULL;
+	lmb->free_nodes = p;
+}
+
+static void lmb_remove_region(struct lmb *lmb, struct lmb_region *rgn,
+			      struct lmb_property *p)
+{
+	struct rb_node *next = rb_next(&p->node);
+
+	rb_erase_augmented(&p->node, &rgn->root, &lmb_gap_callbacks);
 	rgn->cnt--;
+	lmb_put_node(lmb, p);
+	if (next)
+		lmb_update_gap(lmb_entry(next));
+}
+
+static long lmb_insert_region(struct lmb *lmb, struct lmb_region *rgn,
+			      phys_addr_t base, phys_size_t size)
+{
+	struct rb_node **link = &rgn->root.rb_node;
+	struct rb_node *parent = NULL;
+	struct rb_node *next;
+	struct lmb_property *p;
+
+	p = lmb_get_node(lmb);
+	if (!p)
+		return -1;
+
+	while (*link) {
+		parent = *link;
+		if (base < lmb_entry(parent)->base)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+
+	p->base = base;
+	p->size = size;
+	rb_link_node(&p->node, parent, link);
+	p->gap = lmb_gap(p);
+	p->max_gap = p->gap;
+	lmb_gap_callbacks_propagate(parent, NULL);
+	rb_insert_augmented(&p->node, &rgn->root, &lmb_gap_callbacks);
+	rgn->cnt++;
+
+	next = rb_next(&p->node);
+	if (next)
+		lmb_update_gap(lmb_entry(next));
+
+	return 0;
+}
+
+/* Find the last region that starts at or below addr */
+static struct lmb_property *lmb_find_below(struct lmb_region *rgn,
+					   phys_addr_t addr)
+{
+	struct rb_node *n = rgn->root.rb_node;
+	struct lmb_property *found = NULL;
+
+	while (n) {
+		if (lmb_entry(n)->base <= addr) {
+			found = lmb_entry(n);
+			n = n->rb_right;
+		} else {
+			n = n->rb_left;
+		}
+	}
+
+	return found;
+}
+
+/*
+ * Find the first region that ends at or above addr. As the regions do not
+ * overlap, their ends are sorted in the same order as their start addresses.
+ */
+static struct lmb_property *lmb_find_above(struct lmb_region *rgn,
+					   phys_addr_t addr)
+{
+	struct rb_node *n = rgn->root.rb_node;
+	struct lmb_property *found = NULL;
+
+	while (n) {
+		struct lmb_property *p = lmb_entry(n);
+
+		if (p->base + p->size - 1 >= addr) {
+			found = p;
+			n = n->rb_left;
+		} else {
+			n = n->rb_right;
+		}
+	}
+
+	return found;
+}
+
+/* Return the lowest region that overlaps (base, size), or NULL if none */
+static struct lmb_property *lmb_overlaps_region(struct lmb_region *rgn,
+						phys_addr_t base,
+						phys_size_t size)
+{
+	struct lmb_property *p = lmb_find_above(rgn, base);
+
+	if (p && lmb_addrs_overlap(base, size, p->base, p->size))
+		return p;
+
+	return NULL;
 }
 
-/* Assumption: base addr of region 1 < base addr of region 2 */
-static void lmb_coalesce_regions(struct lmb_region *rgn, unsigned long r1,
-				 unsigned long r2)
+/* Find the last region in the subtree with a gap of at least size */
+static struct lmb_property *lmb_find_last_gap(struct rb_node *n,
+					      phys_size_t size)
 {
-	rgn->region[r1].size += rgn->region[r2].size;
-	lmb_remove_region(rgn, r2);
+	for (;;) {
+		if (n->rb_right && lmb_entry(n->rb_right)->max_gap >= size)
+			n = n->rb_right;
+		else if (lmb_entry(n)->gap >= size)
+			return lmb_entry(n);
+		else
+			n = n->rb_left;
+	}
+}
+
+/* Find the last region at or below p with a gap of at least size */
+static struct lmb_property *lmb_find_gap(struct lmb_property *p,
+					 phys_size_t size)
+{
+	struct rb_node *n = &p->node;
+	struct rb_node *parent;
+
+	for (;;) {
+		if (lmb_entry(n)->gap >= size)
+			return lmb_entry(n);
+		if (n->rb_left && lmb_entry(n->rb_left)->max_gap >= size)
+			return lmb_find_last_gap(n->rb_left, size);
+
+		/* Go up to the next ancestor with a lower address */
+		while ((parent = rb_parent(n)) && (n == parent->rb_left))
+			n = parent;
+		if (!parent)
+			return NULL;
+		n = parent;
+	}
 }
 
 void lmb_init(struct lmb *lmb)
 {
+	int i;
+
 	lmb->memory.cnt = 0;
 	lmb->memory.size = 0;
+	lmb->memory.root = RB_ROOT;
 	lmb->reserved.cnt = 0;
 	lmb->reserved.size = 0;
+	lmb->reserved.root = RB_ROOT;
+	lmb->free_nodes = NULL;
+	for (i = LMB_NODES - 1; i >= 0; i--)
+		lmb_put_node(lmb, &lmb->nodes[i]);
+}
+
+static void lmb_release_region(struct lmb *lmb, struct lmb_region *rgn)
+{
+	struct lmb_property *p, *tmp;
+
+	rbtree_postorder_for_each_entry_safe(p, tmp, &rgn->root, node) {
+		if (!lmb_is_builtin_node(lmb, p))
+			free(p);
+	}
+}
+
+void lmb_release(struct lmb *lmb)
+{
+	struct lmb_property *p;
+
+	lmb_release_region(lmb, &lmb->memory);
+	lmb_release_region(lmb, &lmb->reserved);
+	while (lmb->free_nodes) {
+		p = lmb_get_node(lmb);
+		if (!lmb_is_builtin_node(lmb, p))
+			free(p);
+	}
+	lmb_init(lmb);
+}
+
+struct lmb_property *lmb_region_get(struct lmb_region *type,
+				    unsigned long region_nr)
+{
+	struct rb_node *n = rb_first(&type->root);
+
+	while (n && region_nr--)
+		n = rb_next(n);
+
+	return rb_entry_safe(n, struct lmb_property, node);
 }
 
 static void lmb_reserve_common(struct lmb *lmb, void *fdt_blob)
@@ -141,121 +375,96 @@ void lmb_init_and_reserve_range(struct lmb *lmb, phys_addr_t base,
 }
 
 /* This routine called with relocation disabled. */
-static long lmb_add_region(struct lmb_region *rgn, phys_addr_t base, phys_size_t size)
+static long lmb_add_region(struct lmb *lmb, struct lmb_region *rgn,
+			   phys_addr_t base, phys_size_t size)
 {
-	unsigned long coalesced = 0;
-	long adjacent, i;
-
-	if (rgn->cnt == 0) {
-		rgn->region[0].base = base;
-		rgn->region[0].size = size;
-		rgn->cnt = 1;
-		return 0;
-	}
-
-	/* First try and coalesce this LMB with another. */
-	for (i = 0; i < rgn->cnt; i++) {
-		phys_addr_t rgnbase = rgn->region[i].base;
-		phys_size_t rgnsize = rgn->region[i].size;
+	struct lmb_property *prev, *next, *p;
+	struct rb_node *n;
 
-		if ((rgnbase == base) && (rgnsize == size))
+	p = lmb_overlaps_region(rgn, base, size);
+	if (p) {
+		if ((p->base == base) && (p->size == size))
 			/* Already have this region, so we're done */
 			return 0;
 
-		adjacent = lmb_addrs_adjacent(base, size, rgnbase, rgnsize);
-		if (adjacent > 0) {
-			rgn->region[i].base -= size;
-			rgn->region[i].size += size;
-			coalesced++;
-			break;
-		} else if (adjacent < 0) {
-			rgn->region[i].size += size;
-			coalesced++;
-			break;
-		} else if (lmb_addrs_overlap(base, size, rgnbase, rgnsize)) {
-			/* regions overlap */
-			return -2;
-		}
-	}
-
-	if ((i < rgn->cnt - 1) && lmb_regions_adjacent(rgn, i, i + 1)) {
-		lmb_coalesce_regions(rgn, i, i + 1);
-		coalesced++;
+		/* regions overlap */
+		return -2;
 	}
 
-	if (coalesced)
-		return coalesced;
-	if (rgn->cnt >= MAX_LMB_REGIONS)
-		return -1;
-
-	/* Couldn't coalesce the LMB, so add it to the sorted table. */
-	for (i = rgn->cnt-1; i >= 0; i--) {
-		if (base < rgn->region[i].base) {
-			rgn->region[i + 1].base = rgn->region[i].base;
-			rgn->region[i + 1].size = rgn->region[i].size;
-		} else {
-			rgn->region[i + 1].base = base;
-			rgn->region[i + 1].size = size;
-			break;
+	/* First try and coalesce this LMB with its neighbours. */
+	prev = lmb_find_below(rgn, base);
+	n = prev ? rb_next(&prev->node) : rb_first(&rgn->root);
+	next = rb_entry_safe(n, struct lmb_property, node);
+
+	if (prev && (lmb_addrs_adjacent(prev->base, prev->size,
+					base, size) > 0)) {
+		prev->size += size;
+		if (next && (lmb_addrs_adjacent(prev->base, prev->size,
+						next->base, next->size) > 0)) {
+			prev->size += next->size;
+			lmb_remove_region(lmb, rgn, next);
+			lmb_region_changed(prev);
+			return 2;
 		}
+		lmb_region_changed(prev);
+		return 1;
 	}
 
-	if (base < rgn->region[0].base) {
-		rgn->region[0].base = base;
-		rgn->region[0].size = size;
+	if (next && (lmb_addrs_adjacent(base, size,
+					next->base, next->size) > 0)) {
+		next->base = base;
+		next->size += size;
+		lmb_region_changed(next);
+		return 1;
 	}
 
-	rgn->cnt++;
-
-	return 0;
+	/* Couldn't coalesce the LMB, so add it to the tree. */
+	return lmb_insert_region(lmb, rgn, base, size);
 }
 
 /* This routine may be called with relocation disabled. */
 long lmb_add(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 {
-	struct lmb_region *_rgn = &(lmb->memory);
-
-	return lmb_add_region(_rgn, base, size);
+	return lmb_add_region(lmb, &lmb->memory, base, size);
 }
 
 long lmb_free(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 {
 	struct lmb_region *rgn = &(lmb->reserved);
+	struct lmb_property *p;
 	phys_addr_t rgnbegin, rgnend;
 	phys_addr_t end = base + size - 1;
-	int i;
-
-	rgnbegin = rgnend = 0; /* supress gcc warnings */
 
 	/* Find the region where (base, size) belongs to */
-	for (i = 0; i < rgn->cnt; i++) {
-		rgnbegin = rgn->region[i].base;
-		rgnend = rgnbegin + rgn->region[i].size - 1;
+	p = lmb_find_below(rgn, base);
+	if (!p)
+		return -1;
 
-		if ((rgnbegin <= base) && (end <= rgnend))
-			break;
-	}
+	rgnbegin = p->base;
+	rgnend = rgnbegin + p->size - 1;
 
 	/* Didn't find the region */
-	if (i == rgn->cnt)
+	if (end > rgnend)
 		return -1;
 
 	/* Check to see if we are removing entire region */
 	if ((rgnbegin == base) && (rgnend == end)) {
-		lmb_remove_region(rgn, i);
+		lmb_remove_region(lmb, rgn, p);
 		return 0;
 	}
 
 	/* Check to see if region is matching at the front */
 	if (rgnbegin == base) {
-		rgn->region[i].base = end + 1;
-		rgn->region[i].size -= size;
+		p->base = end + 1;
+		p->size -= size;
+		lmb_region_changed(p);
 		return 0;
 	}
 
 	/* Check to see if the region is matching at the end */
 	if (rgnend == end) {
-		rgn->region[i].size -= size;
+		p->size -= size;
+		lmb_region_changed(p);
 		return 0;
 	}
 
@@ -263,65 +472,41 @@ long lmb_free(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 	 * We need to split the entry -  adjust the current one to the
 	 * beginging of the hole and add the region after hole.
 	 */
-	rgn->region[i].size = base - rgn->region[i].base;
-	return lmb_add_region(rgn, end + 1, rgnend - end);
+	p->size = base - p->base;
+	lmb_region_changed(p);
+	return lmb_add_region(lmb, rgn, end + 1, rgnend - end);
 }
 
 long lmb_reserve(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 {
-	struct lmb_region *_rgn = &(lmb->reserved);
-
-	return lmb_add_region(_rgn, base, size);
-}
-
-static long lmb_overlaps_region(struct lmb_region *rgn, phys_addr_t base,
-				phys_size_t size)
-{
-	unsigned long i;
-
-	for (i = 0; i < rgn->cnt; i++) {
-		phys_addr_t rgnbase = rgn->region[i].base;
-		phys_size_t rgnsize = rgn->region[i].size;
-		if (lmb_addrs_overlap(base, size, rgnbase, rgnsize))
-			break;
-	}
-
-	return (i < rgn->cnt) ? i : -1;
+	return lmb_add_region(lmb, &lmb->reserved, base, size);
 }
 
 long lmb_reserve_overlap(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 {
-	struct lmb_region *_rgn = &(lmb->reserved);
-	long ret = lmb_add_region(_rgn, base, size);
-	long overlap_rgn;
-	phys_addr_t res_base;
-	phys_size_t res_size;
-
-	/* Handle the overlap */
-	if (ret == -2) {
-		overlap_rgn = lmb_overlaps_region(_rgn, base, size);
-		res_base = lmb->reserved.region[overlap_rgn].base;
-		res_size = lmb->reserved.region[overlap_rgn].size;
-
-		if ((base >= res_base) && ((base + size) <= (res_base + res_size))) {
-			/* new region is inside reserved region, so it is already reserved */
-			return 0;
-		} else {
-			if (base < res_base) {
-				ret = lmb_reserve(lmb, base, res_base - base);
-				if (ret < 0)
-					return ret;
-			}
+	struct lmb_property *overlap_rgn;
+	phys_addr_t end = base + size - 1;
+	phys_addr_t res_end;
+	long ret = 0;
+
+	/* Reserve the parts that are not reserved yet */
+	while ((overlap_rgn = lmb_overlaps_region(&lmb->reserved, base,
+						  end - base + 1))) {
+		res_end = overlap_rgn->base + overlap_rgn->size - 1;
+		if (base < overlap_rgn->base) {
+			ret = lmb_reserve(lmb, base, overlap_rgn->base - base);
+			if (ret < 0)
+				return ret;
+		}
 
-			if ((base + size) > (res_base + res_size)) {
-				ret = lmb_reserve(lmb, res_base + res_size, (base + size) - (res_base + res_size));
-				if (ret < 0)
-					return ret;
-			}
+		if (res_end >= end) {
+			/* the rest is inside reserved region, so it is already reserved */
+			return ret;
 		}
+		base = res_end + 1;
 	}
 
-	return ret;
+	return lmb_reserve(lmb, base, end - base + 1);
 }
 
 phys_addr_t lmb_alloc(struct lmb *lmb, phys_size_t size, ulong align)
@@ -349,13 +534,13 @@ static phys_addr_t lmb_align_down(phys_addr_t addr, phys_size_t size)
 
 phys_addr_t __lmb_alloc_base(struct lmb *lmb, phys_size_t size, ulong align, phys_addr_t max_addr)
 {
-	long i, rgn;
+	struct lmb_property *rgn;
+	struct rb_node *n;
 	phys_addr_t base = 0;
-	phys_addr_t res_base;
 
-	for (i = lmb->memory.cnt - 1; i >= 0; i--) {
-		phys_addr_t lmbbase = lmb->memory.region[i].base;
-		phys_size_t lmbsize = lmb->memory.region[i].size;
+	for (n = rb_last(&lmb->memory.root); n; n = rb_prev(n)) {
+		phys_addr_t lmbbase = lmb_entry(n)->base;
+		phys_size_t lmbsize = lmb_entry(n)->size;
 
 		if (lmbsize < size)
 			continue;
@@ -372,17 +557,18 @@ phys_addr_t __lmb_alloc_base(struct lmb *lmb, phys_size_t size, ulong align, phy
 
 		while (base && lmbbase <= base) {
 			rgn = lmb_overlaps_region(&lmb->reserved, base, size);
-			if (rgn < 0) {
+			if (!rgn) {
 				/* This area isn't reserved, take it */
-				if (lmb_add_region(&lmb->reserved, base,
+				if (lmb_add_region(lmb, &lmb->reserved, base,
 						   size) < 0)
 					return 0;
 				return base;
 			}
-			res_base = lmb->reserved.region[rgn].base;
-			if (res_base < size)
+			/* Skip all regions with too little space below */
+			rgn = lmb_find_gap(rgn, size);
+			if (!rgn || rgn->base < size)
 				break;
-			base = lmb_align_down(res_base - size, align);
+			base = lmb_align_down(rgn->base - size, align);
 		}
 	}
 	return 0;
@@ -394,17 +580,16 @@ phys_addr_t __lmb_alloc_base(struct lmb *lmb, phys_size_t size, ulong align, phy
  */
 phys_addr_t lmb_alloc_addr(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 {
-	long rgn;
+	struct lmb_property *rgn;
 
 	/* Check if the requested address is in one of the memory regions */
 	rgn = lmb_overlaps_region(&lmb->memory, base, size);
-	if (rgn >= 0) {
+	if (rgn) {
 		/*
 		 * Check if the requested end address is in the same memory
 		 * region we found.
 		 */
-		if (lmb_addrs_overlap(lmb->memory.region[rgn].base,
-				      lmb->memory.region[rgn].size,
+		if (lmb_addrs_overlap(rgn->base, rgn->size,
 				      base + size - 1, 1)) {
 			/* ok, reserve the memory */
 			if (lmb_reserve(lmb, base, size) >= 0)
@@ -417,41 +602,29 @@ phys_addr_t lmb_alloc_addr(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 /* Return number of bytes from a given address that are free */
 phys_size_t lmb_get_free_size(struct lmb *lmb, phys_addr_t addr)
 {
-	int i;
-	long rgn;
+	struct lmb_property *rgn;
 
 	/* check if the requested address is in the memory regions */
-	rgn = lmb_overlaps_region(&lmb->memory, addr, 1);
-	if (rgn >= 0) {
-		for (i = 0; i < lmb->reserved.cnt; i++) {
-			if (addr < lmb->reserved.region[i].base) {
+	if (lmb_overlaps_region(&lmb->memory, addr, 1)) {
+		rgn = lmb_find_above(&lmb->reserved, addr);
+		if (rgn) {
+			if (addr < rgn->base) {
 				/* first reserved range > requested address */
-				return lmb->reserved.region[i].base - addr;
-			}
-			if (lmb->reserved.region[i].base +
-			    lmb->reserved.region[i].size > addr) {
-				/* requested addr is in this reserved range */
-				return 0;
+				return rgn->base - addr;
 			}
+			/* requested addr is in this reserved range */
+			return 0;
 		}
 		/* if we come here: no reserved ranges above requested addr */
-		return lmb->memory.region[lmb->memory.cnt - 1].base +
-		       lmb->memory.region[lmb->memory.cnt - 1].size - addr;
+		rgn = lmb_entry(rb_last(&lmb->memory.root));
+		return rgn->base + rgn->size - addr;
 	}
 	return 0;
 }
 
 int lmb_is_reserved(struct lmb *lmb, phys_addr_t addr)
 {
-	int i;
-
-	for (i = 0; i < lmb->reserved.cnt; i++) {
-		phys_addr_t upper = lmb->reserved.region[i].base +
-			lmb->reserved.region[i].size - 1;
-		if ((addr >= lmb->reserved.region[i].base) && (addr <= upper))
-			return 1;
-	}
-	return 0;
+	return lmb_overlaps_region(&lmb->reserved, addr, 1) != NULL;
 }
 
 __weak void board_lmb_reserve(struct lmb *lmb)
@@ -28,6 +28,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <env.h>
 #include <flash.h>
 #include <image.h>
 #include <log.h>
@@ -50,10 +51,27 @@
 
 static int fs_mounted;
 static unsigned long rpc_id;
-static int nfs_offset = -1;
-static int nfs_len;
+static int nfs_offset = -1;	/* next file offset to request */
+static int nfs_len;		/* size of READ requests */
 static ulong nfs_timeout = NFS_TIMEOUT;
 
+/*
+ * READ requests in flight. The replies may arrive in any order, each one is
+ * stored at the offset of its request. A request is sent again on its own
+ * if the replies to a whole window of later requests arrived before its own
+ * one, so a lost packet does not stall the download until the timeout.
+ */
+#define NFS_WINDOW_MAX	32
+struct nfs_read_slot {
+	unsigned long id;	/* RPC id of the request, 0 if slot is free */
+	int offset;		/* file offset of the requested part */
+	int len;		/* length of the requested part */
+};
+static struct nfs_read_slot nfs_window[NFS_WINDOW_MAX];
+static int nfs_window_size;
+static int nfs_file_end;	/* end of file once known, else -1 */
+static ulong nfs_received;	/* number of bytes stored */
+
 static char dirfh[NFS_FHSIZE];	/* NFSv2 / NFSv3 file handle of directory */
 static char filefh[NFS3_FHSIZE]; /* NFSv2 / NFSv3 file handle */
 static int filefh3_length;	/* (variable) length of filefh when NFSv3 */
@@ -391,6 +409,123 @@ static void nfs_read_req(int offset, int readlen)
 	rpc_req(PROG_NFS, NFS_READ, data, len);
 }
 
+static void nfs_read_slot_send(struct nfs_read_slot *slot)
+{
+	nfs_read_req(slot->offset, slot->len);
+	slot->id = rpc_id;
+}
+
+static struct nfs_read_slot *nfs_read_slot_find(unsigned long id)
+{
+	int i;
+
+	for (i = 0; i < nfs_window_size; i++) {
+		if (nfs_window[i].id && nfs_window[i].id == id)
+			return &nfs_window[i];
+	}
+
+	return NULL;
+}
+
+/* Send the requests again that were overtaken by a whole window */
+static void nfs_read_overtaken(unsigned long id)
+{
+	int i;
+
+	for (i = 0; i < nfs_window_size; i++) {
+		if (nfs_window[i].id && nfs_window[i].id + nfs_window_size <= id)
+			nfs_read_slot_send(&nfs_window[i]);
+	}
+}
+
+/* Request the next parts of the file until the window is full */
+static void nfs_read_fill(void)
+{
+	struct nfs_read_slot *slot;
+	int i;
+
+	for (i = 0; i < nfs_window_size; i++) {
+		slot = &nfs_window[i];
+		if (slot->id)
+			continue;
+		if (nfs_file_end >= 0 && nfs_offset >= nfs_file_end)
+			continue;
+		slot->offset = nfs_offset;
+		slot->len = nfs_len;
+		nfs_offset += nfs_len;
+		nfs_read_slot_send(slot);
+	}
+}
+
+/* Send all outstanding requests again after a timeout */
+static void nfs_read_resend(void)
+{
+	int i;
+
+	for (i = 0; i < nfs_window_size; i++) {
+		if (nfs_window[i].id)
+			nfs_read_slot_send(&nfs_window[i]);
+	}
+}
+
+/* The end of the file is known and all data before it was received */
+static bool nfs_read_done(void)
+{
+	int i;
+
+	if (nfs_file_end < 0)
+		return false;
+
+	for (i = 0; i < nfs_window_size; i++) {
+		if (nfs_window[i].id)
+			return false;
+	}
+
+	return true;
+}
+
+/* Set the end of the file and forget the requests beyond it */
+static void nfs_read_set_end(int end)
+{
+	int i;
+
+	if (nfs_file_end >= 0 && nfs_file_end <= end)
+		return;
+
+	nfs_file_end = end;
+	for (i = 0; i < nfs_window_size; i++) {
+		if (nfs_window[i].offset >= end)
+			nfs_window[i].id = 0;
+	}
+}
+
+/*
+ * Start reading the file, fill the window with requests. NFSv3 allows
+ * bigger blocks than fit into one Ethernet frame if the IP fragments are
+ * reassembled.
+ */
+static void nfs_read_start(void)
+{
+	nfs_state = STATE_READ_REQ;
+	nfs_offset = 0;
+	nfs_len = NFS_READ_SIZE;
+#ifdef CONFIG_IP_DEFRAG
+	if (!(supported_nfs_versions & NFSV2_FLAG)) {
+		while (nfs_len < NFS3_READ_SIZE &&
+		       IP_UDP_HDR_SIZE + NFS_READ_HDR_SIZE + 2 * nfs_len <=
+		       CONFIG_NET_MAXDEFRAG)
+			nfs_len *= 2;
+	}
+#endif
+	nfs_file_end = -1;
+	nfs_received = 0;
+	memset(nfs_window, 0, sizeof(nfs_window));
+	debug("NFS read size %d, %d requests in flight\n", nfs_len,
+	      nfs_window_size);
+
+	nfs_read_fill();
+}
+
 /**************************************************************************
 RPC request dispatcher
 **************************************************************************/
@@ -421,7 +556,7 @@ static void nfs_send(void)
 		nfs_lookup_req(nfs_filename);
 		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		nfs_read_resend();
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
@@ -667,16 +802,25 @@ static int nfs_readlink_reply(uchar *pkt, unsigned len)
 static int nfs_read_reply(uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
+	struct nfs_read_slot *slot;
+	unsigned long id;
 	int rlen;
-	uchar *data_ptr;
+	int data_offset;
+	bool eof;
+	ulong old;
 
 	debug("%s\n", __func__);
 
-	memcpy(&rpc_pkt.u.data[0], pkt, sizeof(rpc_pkt.u.reply));
+	/* Only copy the header, the data is stored right from the packet */
+	memset(&rpc_pkt.u.data[0], 0, NFS_READ_HDR_SIZE);
+	memcpy(&rpc_pkt.u.data[0], pkt,
+	       min_t(unsigned int, len, NFS_READ_HDR_SIZE));
 
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
+	id = ntohl(rpc_pkt.u.reply.id);
+	if (id > rpc_id)
 		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
+	slot = nfs_read_slot_find(id);
+	if (!slot)
 		return -NFS_RPC_DROP;
 
 	if (rpc_pkt.u.reply.rstatus  ||
@@ -690,34 +834,54 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);
 	}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
-			(NFS_READ_SIZE * 16 * 64)))
-		printf("  %u KiB\n  ", net_boot_file_size >> 10);
-	if (!(nfs_offset % (NFS_READ_SIZE * 16)))
-		putc('#');
-
 	if (supported_nfs_versions & NFSV2_FLAG) {
 		rlen = ntohl(rpc_pkt.u.reply.data[18]);
-		data_ptr = (uchar *)&(rpc_pkt.u.reply.data[19]);
+		data_offset = 19;
+		/* A short read can only be detected by an empty reply */
+		eof = !rlen;
 	} else {  /* NFSV3_FLAG */
 		int nfsv3_data_offset =
 			nfs3_get_attributes_offset(rpc_pkt.u.reply.data);
 
 		/* count value */
 		rlen = ntohl(rpc_pkt.u.reply.data[1 + nfsv3_data_offset]);
+		eof = !rlen || rpc_pkt.u.reply.data[2 + nfsv3_data_offset];
 		/* Skip unused values :
-			EOF:		32 bits value,
 			data_size:	32 bits value,
 		*/
-		data_ptr = (uchar *)
-			&(rpc_pkt.u.reply.data[4 + nfsv3_data_offset]);
+		data_offset = 4 + nfsv3_data_offset;
 	}
+	data_offset = (uchar *)&rpc_pkt.u.reply.data[data_offset] -
+		      (uchar *)&rpc_pkt;
 
-	if (((uchar *)&(rpc_pkt.u.reply.data[0]) - (uchar *)(&rpc_pkt) + rlen) > len)
-			return -9999;
+	if (rlen < 0 || rlen > slot->len || data_offset + rlen > len)
+		return -9999;
 
-	if (store_block(data_ptr, nfs_offset, rlen))
-			return -9999;
+	/* Empty replies beyond the end of the file must not change its size */
+	if (rlen && store_block(pkt + data_offset, slot->offset, rlen))
+		return -9999;
+
+	old = nfs_received;
+	nfs_received += rlen;
+	if ((old / (NFS_READ_SIZE * 16 * 64)) !=
+	    (nfs_received / (NFS_READ_SIZE * 16 * 64)))
+		printf("  %u KiB\n  ", net_boot_file_size >> 10);
+	if ((old / (NFS_READ_SIZE * 16)) !=
+	    (nfs_received / (NFS_READ_SIZE * 16)))
+		putc('#');
+
+	if (eof) {
+		slot->id = 0;
+		nfs_read_set_end(slot->offset + rlen);
+	} else if (rlen < slot->len) {
+		/* The server sent less than requested, ask for the rest */
+		slot->offset += rlen;
+		slot->len -= rlen;
+		nfs_read_slot_send(slot);
+	} else {
+		slot->id = 0;
+	}
+	nfs_read_overtaken(id);
 
 	return rlen;
 }
@@ -742,12 +906,22 @@ static void nfs_timeout_handler(void)
 static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			unsigned src, unsigned len)
 {
+	unsigned int max_len = sizeof(struct rpc_t);
 	int rlen;
 	int reply;
 
 	debug("%s\n", __func__);
 
-	if (len > sizeof(struct rpc_t))
+#ifdef CONFIG_IP_DEFRAG
+	/*
+	 * NFSv3 READ replies may be bigger than struct rpc_t, only their
+	 * header is copied into it
+	 */
+	if (nfs_state == STATE_READ_REQ &&
+	    !(supported_nfs_versions & NFSV2_FLAG))
+		max_len = CONFIG_NET_MAXDEFRAG;
+#endif
+	if (len > max_len)
 		return;
 
 	if (dest != nfs_our_port)
@@ -816,10 +990,7 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			nfs_state = STATE_PRCLOOKUP_PROG_MOUNT_REQ;
 			nfs_send();
 		} else {
-			nfs_state = STATE_READ_REQ;
-			nfs_offset = 0;
-			nfs_len = NFS_READ_SIZE;
-			nfs_send();
+			nfs_read_start();
 		}
 		break;
 
@@ -846,15 +1017,14 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		if (rlen == -NFS_RPC_DROP)
 			break;
 		net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
-		if (rlen > 0) {
-			nfs_offset += rlen;
-			nfs_send();
+		if (rlen >= 0 && !nfs_read_done()) {
+			nfs_read_fill();
 		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
 			/* symbolic link */
 			nfs_state = STATE_READLINK_REQ;
 			nfs_send();
 		} else {
-			if (!rlen)
+			if (rlen >= 0)
 				nfs_download_state = NETLOOP_SUCCESS;
 			if (rlen < 0)
 				debug("NFS READ error (%d)\n", rlen);
@@ -874,6 +1044,13 @@ void nfs_start(void)
 	nfs_server_ip = net_server_ip;
 	nfs_path = (char *)nfs_path_buff;
 
+	nfs_window_size = env_get_ulong("nfswindowsize", 10,
+					CONFIG_NFS_WINDOWSIZE);
+	if (nfs_window_size < 1)
+		nfs_window_size = 1;
+	if (nfs_window_size > NFS_WINDOW_MAX)
+		nfs_window_size = NFS_WINDOW_MAX;
+
 	if (nfs_path == NULL) {
 		net_set_state(NETLOOP_FAIL);
 		printf("*** ERROR: Fail allocate memory\n");
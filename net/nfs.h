@@ -42,8 +42,12 @@
  * case, most NFS servers are optimized for a power of 2.
  */
 #define NFS_READ_SIZE	1024	/* biggest power of two that fits Ether frame */
+#define NFS3_READ_SIZE	32768	/* biggest with IP_DEFRAG and NFSv3 */
 #define NFS_MAX_ATTRS	26
 
+/* Size of the header of a READ reply in front of the data */
+#define NFS_READ_HDR_SIZE	((6 + NFS_MAX_ATTRS) * sizeof(uint32_t))
+
 /* Values for Accept State flag on RPC answers (See: rfc1831) */
 enum rpc_accept_stat {
 	NFS_RPC_SUCCESS = 0,	/* RPC executed successfully */
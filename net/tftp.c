@@ -9,6 +9,7 @@
 #include <command.h>
 #include <efi_loader.h>
 #include <env.h>
+#include <hash.h>
 #include <image.h>
 #include <lmb.h>
 #include <log.h>
@@ -102,6 +103,31 @@ static ushort	tftp_windowsize;
 static ushort	tftp_next_ack;
 /* Last nack block we send */
 static ushort	tftp_last_nack;
+/*
+ * Blocks that arrive before their predecessors are stored at their final
+ * address right away, so no reorder buffer is needed, only this bitmap.
+ * Bit (block % TFTP_REORDER_MAX) is set for each block stored ahead of
+ * tftp_cur_block + 1. TFTP_REORDER_MAX divides the sequence size, so the
+ * bits stay valid when the block number wraps.
+ */
+#define TFTP_REORDER_MAX	1024
+static ulong	tftp_reorder_map[TFTP_REORDER_MAX / BITS_PER_LONG];
+/*
+ * A block this far ahead of the missing one lets us assume that it is lost
+ * and not only reordered, so we ask for a retransmission
+ */
+#define TFTP_REORDER_NACK	3
+/* Final (short) block if it was received out of order, length or -1 */
+static ushort	tftp_final_block;
+static int	tftp_final_len;
+/* Number of old blocks received again since the last new block */
+static ushort	tftp_dup_count;
+/* Number of blocks received out of order and of retransmission requests */
+static ulong	tftp_reorder_count;
+static ulong	tftp_nack_count;
+/* Algorithm and context for a checksum computed while receiving */
+static struct hash_algo *tftp_hash_algo;
+static void	*tftp_hash_ctx;
 #ifdef CONFIG_CMD_TFTPPUT
 /* 1 if writing, else 0 */
 static int	tftp_put_active;
@@ -210,12 +236,75 @@ static inline int store_block(int block, uchar *src, unsigned int len)
 	return 0;
 }
 
+/* Check and optionally clear the bit of a block received out of order */
+static bool tftp_reorder_bit(ushort block, bool clear)
+{
+	ulong *map = &tftp_reorder_map[(block % TFTP_REORDER_MAX) /
+				       BITS_PER_LONG];
+	ulong mask = 1UL << (block % BITS_PER_LONG);
+	bool set = (*map & mask) != 0;
+
+	if (clear)
+		*map &= ~mask;
+
+	return set;
+}
+
+static void tftp_reorder_set(ushort block)
+{
+	tftp_reorder_map[(block % TFTP_REORDER_MAX) / BITS_PER_LONG] |=
+		1UL << (block % BITS_PER_LONG);
+}
+
+/* Stop computing the checksum; store the result if output is not NULL */
+static void tftp_hash_stop(uint8_t *output)
+{
+	uint8_t dummy[HASH_MAX_DIGEST_SIZE];
+
+	if (!IS_ENABLED(CONFIG_HASH) || !tftp_hash_ctx)
+		return;
+
+	if (hash_finish_block(tftp_hash_algo, tftp_hash_ctx,
+			      output ? output : dummy))
+		printf("\nTFTP: %s failed\n", tftp_hash_algo->name);
+	tftp_hash_ctx = NULL;
+}
+
+static void tftp_hash_start(void)
+{
+	tftp_hash_stop(NULL);
+	if (IS_ENABLED(CONFIG_HASH) && tftp_hash_algo &&
+	    tftp_hash_algo->hash_init(tftp_hash_algo, &tftp_hash_ctx)) {
+		printf("\nTFTP: %s failed\n", tftp_hash_algo->name);
+		tftp_hash_ctx = NULL;
+	}
+}
+
+/* Add the next bytes of the file to the checksum */
+static void tftp_hash_update(const void *buf, unsigned int len, int is_last)
+{
+	if (!tftp_hash_ctx)
+		return;
+
+	/* The context is already freed if hash_update() fails */
+	if (tftp_hash_algo->hash_update(tftp_hash_algo, tftp_hash_ctx, buf,
+					len, is_last)) {
+		printf("\nTFTP: %s failed\n", tftp_hash_algo->name);
+		tftp_hash_ctx = NULL;
+	}
+}
+
 /* Clear our state ready for a new transfer */
 static void new_transfer(void)
 {
 	tftp_prev_block = 0;
 	tftp_block_wrap = 0;
 	tftp_block_wrap_offset = 0;
+	memset(tftp_reorder_map, 0, sizeof(tftp_reorder_map));
+	tftp_final_len = -1;
+	tftp_dup_count = 0;
+	tftp_reorder_count = 0;
+	tftp_nack_count = 0;
 #ifdef CONFIG_CMD_TFTPPUT
 	tftp_put_final_block_sent = 0;
 #endif
@@ -283,6 +372,7 @@ static void show_block_marker(void)
 static void restart(const char *msg)
 {
 	printf("\n%s; starting again\n", msg);
+	tftp_hash_stop(NULL);
 	net_start_again();
 }
 
@@ -325,6 +415,21 @@ static void tftp_complete(void)
 		print_size(net_boot_file_size /
 			time_start * 1000, "/s");
 	}
+	if (tftp_reorder_count || tftp_nack_count)
+		printf("\n  %lu blocks out of order, %lu retransmit requests",
+		       tftp_reorder_count, tftp_nack_count);
+	if (tftp_hash_ctx) {
+		uint8_t sum[HASH_MAX_DIGEST_SIZE];
+		char str[HASH_MAX_DIGEST_SIZE * 2 + 1];
+		int i;
+
+		tftp_hash_stop(sum);
+		for (i = 0; i < tftp_hash_algo->digest_size; i++)
+			sprintf(str + 2 * i, "%02x", sum[i]);
+		str[2 * i] = '\0';
+		printf("\n  %s: %s", tftp_hash_algo->name, str);
+		env_set("filehash", str);
+	}
 	puts("\ndone\n");
 	if (IS_ENABLED(CONFIG_CMD_BOOTEFI)) {
 		if (!tftp_put_active)
@@ -452,8 +557,10 @@ static void tftp_send(void)
 	net_send_udp_packet(net_server_ethaddr, tftp_remote_ip,
 			    tftp_remote_port, tftp_our_port, len);
 
-	if (err_pkt)
+	if (err_pkt) {
+		tftp_hash_stop(NULL);
 		net_set_state(NETLOOP_FAIL);
+	}
 }
 
 #ifdef CONFIG_CMD_TFTPPUT
@@ -468,6 +575,120 @@ static void icmp_handler(unsigned type, unsigned code, unsigned dest,
 }
 #endif
 
+/*
+ * Ask the server to send the window again from the block after
+ * tftp_cur_block. Do this only once for each block, because all other
+ * blocks of the current window would cause the same request again and
+ * this just overwhelms the server. Only at the end of a window we have to
+ * ask again, as the server then waits for our ACK.
+ */
+static void tftp_send_nack(bool window_end)
+{
+	if (window_end || tftp_last_nack != tftp_cur_block) {
+		tftp_send();
+		tftp_last_nack = tftp_cur_block;
+		tftp_next_ack = (ushort)(tftp_cur_block + tftp_windowsize);
+		tftp_nack_count++;
+	}
+}
+
+/*
+ * Store a block that arrived before one or more of its predecessors. It is
+ * @ahead blocks after the next expected block tftp_cur_block + 1.
+ */
+static void tftp_store_ahead(ushort block, ushort ahead, uchar *src,
+			     unsigned int len)
+{
+	bool window_end = (block == tftp_next_ack || len < tftp_block_size);
+
+	/* Same block again, i.e. the window is repeated; do not store it */
+	if (!tftp_reorder_bit(block, false)) {
+		/* The number may have wrapped, so use tftp_cur_block as base */
+		if (store_block(tftp_cur_block + 1 + ahead, src, len)) {
+			tftp_hash_stop(NULL);
+			eth_halt();
+			net_set_state(NETLOOP_FAIL);
+			return;
+		}
+		tftp_reorder_set(block);
+		tftp_reorder_count++;
+		tftp_dup_count = 0;
+		if (len < tftp_block_size) {
+			tftp_final_block = block;
+			tftp_final_len = len;
+		}
+	}
+	timeout_count_max = tftp_timeout_count_max;
+	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+
+	/*
+	 * Only request a retransmission if the missing block is most likely
+	 * lost, or if the server will not send anything else before it gets
+	 * our ACK. TFTP has no way to name single blocks, so the server sends
+	 * the blocks after the gap again, but we do not store them twice.
+	 */
+	if (window_end || ahead >= TFTP_REORDER_NACK)
+		tftp_send_nack(window_end);
+}
+
+/*
+ * A block before tftp_cur_block + 1 was received again. If a whole window
+ * of them arrives, the server did not get our last ACK and repeats the
+ * window after a timeout, so send the ACK again. Fewer of them are just
+ * still on the way from before the server got an ACK; answering each of
+ * them would make the server start the window over and over again.
+ */
+static void tftp_old_block(void)
+{
+	if (++tftp_dup_count >= tftp_windowsize) {
+		tftp_send();
+		tftp_dup_count = 0;
+		tftp_next_ack = (ushort)(tftp_cur_block + tftp_windowsize);
+	}
+}
+
+/*
+ * Move tftp_cur_block over all blocks that were received out of order and
+ * now follow without a gap. Their data is already stored, only the
+ * checksum is computed here. Return the number of blocks or -1 if the
+ * transfer is complete.
+ */
+static int tftp_advance(void)
+{
+	int count = 0;
+
+	while (tftp_reorder_bit((ushort)(tftp_cur_block + 1), true)) {
+		unsigned int len = tftp_block_size;
+		int is_last;
+
+		tftp_cur_block++;
+		tftp_cur_block %= TFTP_SEQUENCE_SIZE;
+		update_block_number();
+		tftp_prev_block = tftp_cur_block;
+		count++;
+
+		is_last = (tftp_final_len >= 0 &&
+			   tftp_cur_block == tftp_final_block);
+		if (is_last)
+			len = tftp_final_len;
+		if (tftp_hash_ctx) {
+			ulong offset = tftp_cur_block * tftp_block_size +
+				tftp_block_wrap_offset - tftp_block_size;
+			void *ptr = map_sysmem(tftp_load_addr + offset, len);
+
+			tftp_hash_update(ptr, len, is_last);
+			unmap_sysmem(ptr);
+		}
+		if (is_last) {
+			tftp_send();
+			tftp_complete();
+			return -1;
+		}
+	}
+
+	return count;
+}
+
 static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			 unsigned src, unsigned len)
 {
@@ -475,6 +696,8 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 	__be16 *s;
 	int i;
 	u16 timeout_val_rcvd;
+	ushort block, ahead, window_left;
+	int advanced;
 
 	if (dest != tftp_our_port) {
 			return;
@@ -609,22 +832,23 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			return;
 		len -= 2;
 
-		if (ntohs(*(__be16 *)pkt) != (ushort)(tftp_cur_block + 1)) {
+		block = ntohs(*(__be16 *)pkt);
+		ahead = (ushort)(block - tftp_cur_block - 1);
+		if (ahead) {
 			debug("Received unexpected block: %d, expected: %d\n",
-			      ntohs(*(__be16 *)pkt),
-			      (ushort)(tftp_cur_block + 1));
+			      block, (ushort)(tftp_cur_block + 1));
 			/*
-			 * If one packet is dropped most likely
-			 * all other buffers in the window
-			 * that will arrive will cause a sending NACK.
-			 * This just overwellms the server, let's just send one.
+			 * Keep blocks from the current window, even if one of
+			 * their predecessors is missing. Anything else is
+			 * a retransmission of an old block.
 			 */
-			if (tftp_last_nack != tftp_cur_block) {
-				tftp_send();
-				tftp_last_nack = tftp_cur_block;
-				tftp_next_ack = (ushort)(tftp_cur_block +
-							 tftp_windowsize);
-			}
+			if (tftp_state != STATE_DATA || tftp_put_active)
+				tftp_send_nack(false);
+			else if (ahead < tftp_windowsize &&
+				 ahead < TFTP_REORDER_MAX)
+				tftp_store_ahead(block, ahead, pkt + 2, len);
+			else
+				tftp_old_block();
 			break;
 		}
 
@@ -642,12 +866,14 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			tftp_state = STATE_DATA;
 			tftp_remote_port = src;
 			new_transfer();
+			tftp_hash_start();
 
 			if (tftp_cur_block != 1) {	/* Assertion */
 				puts("\nTFTP error: ");
 				printf("First block is not block 1 (%ld)\n",
 				       tftp_cur_block);
 				puts("Starting again\n\n");
+				tftp_hash_stop(NULL);
 				net_start_again();
 				break;
 			}
@@ -660,28 +886,41 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 		update_block_number();
 		tftp_prev_block = tftp_cur_block;
+		tftp_dup_count = 0;
 		timeout_count_max = tftp_timeout_count_max;
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
 		if (store_block(tftp_cur_block, pkt + 2, len)) {
+			tftp_hash_stop(NULL);
 			eth_halt();
 			net_set_state(NETLOOP_FAIL);
 			break;
 		}
 
+		/* Update the checksum while the data is still in the cache */
+		tftp_hash_update(pkt + 2, len, len < tftp_block_size);
+
 		if (len < tftp_block_size) {
 			tftp_send();
 			tftp_complete();
 			break;
 		}
 
+		/* Blocks that were received before may follow now */
+		window_left = (ushort)(tftp_next_ack - tftp_cur_block);
+		advanced = tftp_advance();
+		if (advanced < 0)
+			break;
+
 		/*
 		 *	Acknowledge the block just received, which will prompt
-		 *	the remote for the next one.
+		 *	the remote for the next one. This may also be one of
+		 *	the blocks that were received before.
 		 */
-		if (tftp_cur_block == tftp_next_ack) {
+		if (window_left <= advanced) {
 			tftp_send();
-			tftp_next_ack += tftp_windowsize;
+			tftp_next_ack = (ushort)(tftp_cur_block +
+						 tftp_windowsize);
 		}
 		break;
 
@@ -693,6 +932,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		case TFTP_ERR_FILE_NOT_FOUND:
 		case TFTP_ERR_ACCESS_DENIED:
 			puts("Not retrying...\n");
+			tftp_hash_stop(NULL);
 			eth_halt();
 			net_set_state(NETLOOP_FAIL);
 			break;
@@ -703,6 +943,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		case TFTP_ERR_FILE_ALREADY_EXISTS:
 		default:
 			puts("Starting again\n\n");
+			tftp_hash_stop(NULL);
 			net_start_again();
 			break;
 		}
@@ -723,6 +964,25 @@ static void tftp_timeout_handler(void)
 	}
 }
 
+/* Look up the checksum algorithm given in env variable tftphash, if any */
+static void tftp_init_hash(void)
+{
+	const char *name = env_get("tftphash");
+
+	tftp_hash_stop(NULL);
+	tftp_hash_algo = NULL;
+	if (!IS_ENABLED(CONFIG_HASH) || !name || !*name)
+		return;
+
+	/* Do not leave the result of an earlier transfer */
+	env_set("filehash", NULL);
+
+	if (hash_progressive_lookup_algo(name, &tftp_hash_algo)) {
+		printf("TFTP: checksum '%s' not supported\n", name);
+		tftp_hash_algo = NULL;
+	}
+}
+
 /* Initialize tftp_load_addr and tftp_load_size from image_load_addr and lmb */
 static int tftp_init_load_addr(void)
 {
@@ -733,6 +993,7 @@ static int tftp_init_load_addr(void)
 	lmb_init_and_reserve(&lmb, gd->bd, (void *)gd->fdt_blob);
 
 	max_size = lmb_get_free_size(&lmb, get_fileaddr());
+	lmb_release(&lmb);
 	if (!max_size)
 		return -1;
 
@@ -850,6 +1111,7 @@ void tftp_start(enum proto_t protocol)
 		printf("Load address: 0x%lx\n", tftp_load_addr);
 		puts("Loading:\n  *\b");
 		tftp_state = STATE_SEND_RRQ;
+		tftp_init_hash();
 	}
 
 	time_start = get_timer(0);
@@ -920,6 +1182,8 @@ void tftp_start_server(void)
 	tftp_tsize_num_hash = 0;
 #endif
 
+	tftp_windowsize = 1;
+	tftp_init_hash();
 	tftp_state = STATE_RECV_WRQ;
 	net_set_udp_handler(tftp_handler);
 
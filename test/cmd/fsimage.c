@@ -0,0 +1,455 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for loading F&S images (fsimage load)
+ *
+ * The images are loaded from a simulated NAND flash (pages, erase blocks, bad
+ * blocks that are skipped) and a simulated eMMC (blocks of 512 bytes) with
+ * the same code that fsimage load uses for real flash.
+ *
+ * (C) Copyright 2021 F&S Elektronik Systeme GmbH
+ */
+
+#include <common.h>
+#include <command.h>
+#include <image.h>
+#include <malloc.h>
+#include <linux/libfdt.h>
+#include <test/suites.h>
+#include <test/ut.h>
+
+#include "../../board/F+S/common/fs_image_common.h"
+#include "../../cmd/fsimage_load.h"
+
+/* Declare a new fsimage test */
+#define FSIMAGE_TEST(_name, _flags)	UNIT_TEST(_name, _flags, fsimage_test)
+
+#define SIM_NAND_PAGE		2048
+#define SIM_NAND_BLOCK		(64 * SIM_NAND_PAGE)
+#define SIM_NAND_SIZE		(16 * SIM_NAND_BLOCK)
+#define SIM_MMC_BLOCK		512
+#define SIM_MMC_SIZE		0x200000
+
+/* Simulated flash; for NAND erasesize is set, for eMMC it is 0 */
+struct sim_flash {
+	struct flash_info fi;
+	struct flash_ops ops;
+	u8 *data;			/* Flash content */
+	unsigned int size;		/* Flash size */
+	unsigned int erasesize;		/* NAND: erase block size */
+	unsigned long bad;		/* NAND: bit mask of bad blocks */
+	unsigned int reads;		/* Number of read calls */
+	unsigned int bytes;		/* Number of bytes read from flash */
+};
+
+/*
+ * NAND: read full pages from offs + fi->bb_extra_offs, skip bad blocks and
+ * add the skipped size to fi->bb_extra_offs like nand_read_skip_bad() does
+ * in fs_image_read_nand().
+ */
+static int sim_nand_read(struct flash_info *fi, uint offs, uint size,
+			 uint lim, uint flags, u8 *buf)
+{
+	struct sim_flash *sim = container_of(fi, struct sim_flash, fi);
+	unsigned int roffs = offs + fi->bb_extra_offs;
+	unsigned int chunk;
+
+	if ((offs | size) & (fi->temp_size - 1))
+		return -EINVAL;
+
+	sim->reads++;
+	while (size) {
+		if (roffs >= lim)
+			return -EFBIG;
+		chunk = sim->erasesize - (roffs & (sim->erasesize - 1));
+		if (sim->bad & BIT(roffs / sim->erasesize)) {
+			fi->bb_extra_offs += chunk;
+			roffs += chunk;
+			continue;
+		}
+		if (chunk > size)
+			chunk = size;
+		memcpy(buf, sim->data + roffs, chunk);
+		sim->bytes += chunk;
+		buf += chunk;
+		roffs += chunk;
+		size -= chunk;
+	}
+
+	return 0;
+}
+
+/* eMMC: read whole blocks like fs_image_read_mmc() */
+static int sim_mmc_read(struct flash_info *fi, uint offs, uint size,
+			uint lim, uint flags, u8 *buf)
+{
+	struct sim_flash *sim = container_of(fi, struct sim_flash, fi);
+
+	if (offs & (SIM_MMC_BLOCK - 1))
+		return -EINVAL;
+	size = ALIGN(size, SIM_MMC_BLOCK);
+	if (offs + size > sim->size)
+		return -EIO;
+
+	sim->reads++;
+	memcpy(buf, sim->data + offs, size);
+	sim->bytes += size;
+
+	return 0;
+}
+
+static int sim_init(struct sim_flash *sim, bool nand)
+{
+	memset(sim, 0, sizeof(*sim));
+	if (nand) {
+		sim->size = SIM_NAND_SIZE;
+		sim->erasesize = SIM_NAND_BLOCK;
+		sim->fi.temp_size = SIM_NAND_PAGE;
+		sim->fi.temp_fill = 0xff;
+		sim->ops.read = sim_nand_read;
+		strcpy(sim->fi.devname, "NAND");
+	} else {
+		sim->size = SIM_MMC_SIZE;
+		sim->fi.temp_size = SIM_MMC_BLOCK;
+		sim->ops.read = sim_mmc_read;
+		strcpy(sim->fi.devname, "mmc0");
+	}
+	sim->fi.ops = &sim->ops;
+	sim->data = malloc(sim->size);
+	sim->fi.temp = malloc(sim->fi.temp_size);
+	if (!sim->data || !sim->fi.temp)
+		return -ENOMEM;
+	memset(sim->data, sim->fi.temp_fill, sim->size);
+
+	return 0;
+}
+
+static void sim_free(struct sim_flash *sim)
+{
+	free(sim->fi.temp);
+	free(sim->data);
+}
+
+/* Store an image in flash at offs, skipping bad NAND blocks */
+static void sim_store(struct sim_flash *sim, uint offs, const u8 *img,
+		      uint size)
+{
+	unsigned int chunk;
+
+	while (size) {
+		chunk = size;
+		if (sim->erasesize) {
+			if (sim->bad & BIT(offs / sim->erasesize)) {
+				offs += sim->erasesize;
+				continue;
+			}
+			chunk = sim->erasesize - (offs & (sim->erasesize - 1));
+			if (chunk > size)
+				chunk = size;
+		}
+		memcpy(sim->data + offs, img, chunk);
+		img += chunk;
+		offs += chunk;
+		size -= chunk;
+	}
+}
+
+/* Load an image at offs the way fs_image_load_image_nand/mmc() do */
+static int sim_load(struct sim_flash *sim, uint offs, struct sub_info *sub,
+		    uint *size)
+{
+	struct flash_info *fi = &sim->fi;
+	int loaded;
+
+	fs_image_drop_temp(fi);
+	fs_image_clear_stats(fi);
+	sim->reads = 0;
+	sim->bytes = 0;
+
+	loaded = fs_image_load_header(fi, offs, sim->size, sub, size);
+	if (loaded < 0)
+		return loaded;
+	if (*size > loaded)
+		return fs_image_load_sub(fi, offs + loaded, *size - loaded,
+					 sim->size, sub->flags,
+					 sub->img + loaded);
+
+	return 0;
+}
+
+/* Create an image with F&S header and a payload of given size */
+static u8 *make_fsh_image(const char *type, const char *descr, uint size)
+{
+	struct fs_header_v1_0 *fsh;
+	u8 *img;
+	int i;
+
+	img = malloc(FSH_SIZE + size);
+	if (!img)
+		return NULL;
+	fsh = (struct fs_header_v1_0 *)img;
+	memset(fsh, 0, FSH_SIZE);
+	memcpy(fsh->info.magic, "FSLX", 4);
+	fsh->info.file_size_low = size;
+	fsh->info.flags = FSH_FLAGS_DESCR;
+	fsh->info.version = 0x10;
+	strncpy(fsh->type, type, sizeof(fsh->type));
+	strncpy(fsh->param.descr, descr, sizeof(fsh->param.descr));
+	for (i = 0; i < size; i++)
+		img[FSH_SIZE + i] = i % 251;
+
+	return img;
+}
+
+/*
+ * Create a FIT image with two images with external data behind the FDT part,
+ * return the total size in *size
+ */
+static u8 *make_fit_image(uint size1, uint size2, uint *size)
+{
+	unsigned int fit_size;
+	u8 *img;
+	int images, node;
+	int i;
+
+	img = malloc(0x1000 + size1 + size2 + 8);
+	if (!img)
+		return NULL;
+	if (fdt_create_empty_tree(img, 0x1000))
+		goto err;
+	images = fdt_add_subnode(img, 0, "images");
+	node = fdt_add_subnode(img, images, "firmware-1");
+	if (node < 0 ||
+	    fdt_setprop_u32(img, node, FIT_DATA_OFFSET_PROP, 0) ||
+	    fdt_setprop_u32(img, node, FIT_DATA_SIZE_PROP, size1))
+		goto err;
+	node = fdt_add_subnode(img, images, "firmware-2");
+	if (node < 0 ||
+	    fdt_setprop_u32(img, node, FIT_DATA_OFFSET_PROP,
+			    ALIGN(size1, 4)) ||
+	    fdt_setprop_u32(img, node, FIT_DATA_SIZE_PROP, size2))
+		goto err;
+	if (fdt_pack(img))
+		goto err;
+
+	fit_size = ALIGN(fdt_totalsize(img), 4);
+	*size = fit_size + ALIGN(size1, 4) + ALIGN(size2, 4);
+	for (i = fdt_totalsize(img); i < *size; i++)
+		img[i] = i % 251;
+
+	return img;
+
+err:
+	free(img);
+	return NULL;
+}
+
+/* Test loading an image with F&S header from NAND */
+static int fsimage_test_load_fsh_nand(struct unit_test_state *uts)
+{
+	struct sim_flash sim;
+	struct sub_info sub = { .type = "FIRMWARE", .descr = "fsimx8mm" };
+	unsigned int offs = 2 * SIM_NAND_BLOCK + 3 * SIM_NAND_PAGE;
+	unsigned int img_size = FSH_SIZE + 5 * SIM_NAND_PAGE + 100;
+	unsigned int size;
+	u8 *img;
+
+	ut_assertok(sim_init(&sim, true));
+	img = make_fsh_image("FIRMWARE", "fsimx8mm", img_size - FSH_SIZE);
+	ut_assertnonnull(img);
+	sim_store(&sim, offs, img, img_size);
+	sub.img = malloc(img_size);
+	ut_assertnonnull(sub.img);
+
+	ut_assertok(sim_load(&sim, offs, &sub, &size));
+	ut_asserteq(img_size, size);
+	ut_asserteq_mem(img, sub.img, img_size);
+
+	/* Every page is read once, the header page is taken from temp */
+	ut_asserteq(ALIGN(img_size, SIM_NAND_PAGE), sim.bytes);
+	ut_asserteq(sim.bytes, sim.fi.stat_read);
+	ut_asserteq(2, sim.fi.stat_fills);
+	ut_asserteq(3, sim.reads);
+	ut_asserteq(SIM_NAND_PAGE + FSH_SIZE + 100, sim.fi.stat_copied);
+
+	free(sub.img);
+	free(img);
+	sim_free(&sim);
+
+	return 0;
+}
+FSIMAGE_TEST(fsimage_test_load_fsh_nand, 0);
+
+/* Test that an F&S image of wrong type is rejected */
+static int fsimage_test_load_wrong_type(struct unit_test_state *uts)
+{
+	struct sim_flash sim;
+	struct sub_info sub = { .type = "BOARD-CFG", .descr = "fsimx8mm" };
+	unsigned int size;
+	u8 *img;
+
+	ut_assertok(sim_init(&sim, true));
+	img = make_fsh_image("FIRMWARE", "fsimx8mm", 1000);
+	ut_assertnonnull(img);
+	sim_store(&sim, 0, img, FSH_SIZE + 1000);
+	sub.img = malloc(FSH_SIZE + 1000);
+	ut_assertnonnull(sub.img);
+
+	ut_asserteq(-ENOENT, sim_load(&sim, 0, &sub, &size));
+
+	/* Empty (erased) flash is no image either */
+	ut_asserteq(-ENOENT, sim_load(&sim, SIM_NAND_BLOCK, &sub, &size));
+
+	free(sub.img);
+	free(img);
+	sim_free(&sim);
+
+	return 0;
+}
+FSIMAGE_TEST(fsimage_test_load_wrong_type, 0);
+
+/* Test loading a FIT image with external data from NAND */
+static int fsimage_test_load_fit_nand(struct unit_test_state *uts)
+{
+	struct sim_flash sim;
+	struct sub_info sub = { .type = "FIRMWARE" };
+	unsigned int img_size;
+	unsigned int size;
+	u8 *img;
+
+	ut_assertok(sim_init(&sim, true));
+	img = make_fit_image(3 * SIM_NAND_PAGE + 17, 999, &img_size);
+	ut_assertnonnull(img);
+	sim_store(&sim, SIM_NAND_BLOCK, img, img_size);
+	sub.img = malloc(img_size);
+	ut_assertnonnull(sub.img);
+
+	ut_assertok(sim_load(&sim, SIM_NAND_BLOCK, &sub, &size));
+	ut_asserteq(img_size, size);
+	ut_asserteq_mem(img, sub.img, img_size);
+	ut_asserteq(ALIGN(img_size, SIM_NAND_PAGE), sim.bytes);
+	ut_asserteq(sim.bytes, sim.fi.stat_read);
+
+	free(sub.img);
+	free(img);
+	sim_free(&sim);
+
+	return 0;
+}
+FSIMAGE_TEST(fsimage_test_load_fit_nand, 0);
+
+/* Test that a FIT image smaller than the loaded header is rejected */
+static int fsimage_test_load_short_fit(struct unit_test_state *uts)
+{
+	struct sim_flash sim;
+	struct sub_info sub = { .type = "FIRMWARE" };
+	struct fdt_header *fdt;
+	unsigned int img_size;
+	unsigned int size;
+	u8 *img;
+
+	ut_assertok(sim_init(&sim, true));
+	img = make_fit_image(100, 100, &img_size);
+	ut_assertnonnull(img);
+	fdt = (struct fdt_header *)img;
+	fdt->totalsize = cpu_to_fdt32(sizeof(*fdt));
+	sim_store(&sim, 0, img, img_size);
+	sub.img = malloc(img_size);
+	ut_assertnonnull(sub.img);
+
+	ut_asserteq(-EINVAL, sim_load(&sim, 0, &sub, &size));
+
+	free(sub.img);
+	free(img);
+	sim_free(&sim);
+
+	return 0;
+}
+FSIMAGE_TEST(fsimage_test_load_short_fit, 0);
+
+/* Test loading an image across a bad NAND block */
+static int fsimage_test_load_bad_block(struct unit_test_state *uts)
+{
+	struct sim_flash sim;
+	struct sub_info sub = { .type = "FIRMWARE", .descr = "fsimx8mm" };
+	unsigned int offs = 4 * SIM_NAND_BLOCK + SIM_NAND_BLOCK / 2;
+	unsigned int img_size = FSH_SIZE + 2 * SIM_NAND_BLOCK;
+	unsigned int size;
+	u8 *img;
+
+	ut_assertok(sim_init(&sim, true));
+	sim.bad = BIT(5) | BIT(6);
+	img = make_fsh_image("FIRMWARE", "fsimx8mm", img_size - FSH_SIZE);
+	ut_assertnonnull(img);
+	sim_store(&sim, offs, img, img_size);
+	sub.img = malloc(img_size);
+	ut_assertnonnull(sub.img);
+
+	ut_assertok(sim_load(&sim, offs, &sub, &size));
+	ut_asserteq(img_size, size);
+	ut_asserteq_mem(img, sub.img, img_size);
+	ut_asserteq(2 * SIM_NAND_BLOCK, sim.fi.bb_extra_offs);
+
+	free(sub.img);
+	free(img);
+	sim_free(&sim);
+
+	return 0;
+}
+FSIMAGE_TEST(fsimage_test_load_bad_block, 0);
+
+/* Test loading images from eMMC at an offset that is not block aligned */
+static int fsimage_test_load_mmc(struct unit_test_state *uts)
+{
+	struct sim_flash sim;
+	struct sub_info sub = { .type = "FIRMWARE", .descr = "fsimx8mm" };
+	unsigned int offs = 0x8000 + 0x40;
+	unsigned int img_size = FSH_SIZE + 0x3000 + 7;
+	unsigned int size;
+	u8 *img;
+
+	ut_assertok(sim_init(&sim, false));
+	img = make_fsh_image("FIRMWARE", "fsimx8mm", img_size - FSH_SIZE);
+	ut_assertnonnull(img);
+	sim_store(&sim, offs, img, img_size);
+	sub.img = malloc(img_size);
+	ut_assertnonnull(sub.img);
+
+	ut_assertok(sim_load(&sim, offs, &sub, &size));
+	ut_asserteq(img_size, size);
+	ut_asserteq_mem(img, sub.img, img_size);
+	ut_asserteq(ALIGN(0x40 + img_size, SIM_MMC_BLOCK), sim.bytes);
+	ut_asserteq(sim.bytes, sim.fi.stat_read);
+	ut_asserteq(2, sim.fi.stat_fills);
+	free(sub.img);
+	free(img);
+
+	/* Same with a FIT image */
+	img = make_fit_image(0x2000, 0x123, &img_size);
+	ut_assertnonnull(img);
+	sim_store(&sim, offs, img, img_size);
+	sub.img = malloc(img_size);
+	ut_assertnonnull(sub.img);
+
+	ut_assertok(sim_load(&sim, offs, &sub, &size));
+	ut_asserteq(img_size, size);
+	ut_asserteq_mem(img, sub.img, img_size);
+	ut_asserteq(ALIGN(0x40 + img_size, SIM_MMC_BLOCK), sim.bytes);
+
+	free(sub.img);
+	free(img);
+	sim_free(&sim);
+
+	return 0;
+}
+FSIMAGE_TEST(fsimage_test_load_mmc, 0);
+
+int do_ut_fsimage(struct cmd_tbl *cmdtp, int flag, int argc,
+		  char *const argv[])
+{
+	struct unit_test *tests = ll_entry_start(struct unit_test,
+						 fsimage_test);
+	const int n_ents = ll_entry_count(struct unit_test, fsimage_test);
+
+	return cmd_ut_category("fsimage", "fsimage_test_", tests, n_ents,
+			       argc, argv);
+}
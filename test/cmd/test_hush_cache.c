@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the hush parse cache: scripts that are run again must give the
+ * same result as a fresh parse
+ *
+ * Copyright (C) 2021 F&S Elektronik Systeme GmbH
+ */
+
+#include <common.h>
+#include <command.h>
+#include <env.h>
+#include <asm/global_data.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+struct test_data {
+	char *cmd;
+	char *expected;
+};
+
+/* hQ is not used by any other variable; each command cleans up its own */
+static struct test_data hush_cache_data[] = {
+	/* The same script run several times */
+	{"setenv hQa 'echo -n a'; run hQa; run hQa; run hQa; echo; "
+	 "setenv hQa",
+	 "aaa"},
+	/* setenv changes a cached script */
+	{"setenv hQa 'echo -n a'; run hQa; setenv hQa 'echo -n b'; "
+	 "run hQa; run hQa; echo; setenv hQa",
+	 "abb"},
+	/* A script that runs itself while it is running */
+	{"setenv hQn 1; setenv hQa 'echo -n ${hQn}; "
+	 "if test ${hQn} -lt 4; then setexpr hQn ${hQn} + 1; run hQa; fi'; "
+	 "run hQa; setenv hQn 1; run hQa; echo; setenv hQa; setenv hQn",
+	 "12341234"},
+	/* exit leaves the loop, the next run starts the loop again */
+	{"setenv hQa 'for hQi in 1 2 3; do echo -n ${hQi}; "
+	 "if test ${hQi} = 2; then exit; fi; done'; "
+	 "run hQa; run hQa; echo; setenv hQa",
+	 "1212"},
+	/* All branches of an if/elif/else from the same cached script */
+	{"setenv hQa 'if test ${hQi} = 1; then echo -n one; "
+	 "elif test ${hQi} = 2; then echo -n two; else echo -n other; fi'; "
+	 "for hQi in 1 2 3 2 1; do run hQa; done; echo; setenv hQa",
+	 "onetwoothertwoone"},
+};
+
+static int lib_test_hush_cache(struct unit_test_state *uts)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(hush_cache_data); ++i) {
+		console_record_reset_enable();
+		ut_assertok(run_command(hush_cache_data[i].cmd, 0));
+		gd->flags &= ~GD_FLG_RECORD;
+		console_record_readline(uts->actual_str,
+					sizeof(uts->actual_str));
+		ut_asserteq_str(hush_cache_data[i].expected, uts->actual_str);
+		ut_assertok(ut_check_console_end(uts));
+	}
+
+	/* IFS splits the words differently, the cache must not be used */
+	console_record_reset_enable();
+	ut_assertok(run_command("setenv hQa 'for hQi in a,b c; do "
+				"echo -n \"[${hQi}]\"; done'; run hQa", 0));
+	ut_assertok(env_set("IFS", " ,\t\n"));
+	ut_assertok(run_command("run hQa", 0));
+	ut_assertok(env_set("IFS", NULL));
+	ut_assertok(run_command("run hQa; echo; setenv hQa", 0));
+	gd->flags &= ~GD_FLG_RECORD;
+	console_record_readline(uts->actual_str, sizeof(uts->actual_str));
+	ut_asserteq_str("[a,b][c][a][b][c][a,b][c]", uts->actual_str);
+	ut_assertok(ut_check_console_end(uts));
+
+	return 0;
+}
+
+LIB_TEST(lib_test_hush_cache, 0);
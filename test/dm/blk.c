@@ -9,6 +9,7 @@
 #include <usb.h>
 #include <asm/global_data.h>
 #include <asm/state.h>
+#include <dm/device-internal.h>
 #include <dm/test.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -162,3 +163,85 @@ static int dm_test_blk_get_from_parent(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_get_from_parent, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#ifdef CONFIG_BLOCK_CACHE
+/* Test the block cache with read-ahead and write-behind */
+static int dm_test_blk_cache(struct unit_test_state *uts)
+{
+	struct block_cache_stats stats;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	char buf[512], data[512];
+	int i;
+
+	ut_assertok(blk_get_device(IF_TYPE_MMC, 0, &dev));
+	desc = dev_get_uclass_plat(dev);
+
+	/* A sequential read fills the cache with the following blocks */
+	ut_assertok(blkcache_configure(128, 4, false));
+	ut_asserteq(1, blk_dread(desc, 10, 1, buf));
+	ut_asserteq(1, blk_dread(desc, 11, 1, buf));
+	for (i = 12; i < 16; i++)
+		ut_asserteq(1, blk_dread(desc, i, 1, buf));
+	ut_asserteq(1, blk_dread(desc, 10, 1, buf));
+	blkcache_stats(&stats);
+	ut_asserteq(5, stats.hits);
+	ut_asserteq(2, stats.misses);
+	ut_asserteq(4, stats.ra_blocks);
+	ut_asserteq(4, stats.ra_hits);
+
+	/* With write-behind, data is only written when flushing */
+	ut_assertok(blkcache_configure(128, 4, true));
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i;
+	ut_asserteq(1, blk_dwrite(desc, 20, 1, data));
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.dirty);
+	ut_asserteq(1, blk_dread(desc, 20, 1, buf));
+	ut_asserteq_mem(data, buf, sizeof(data));
+	ut_assertok(blkcache_flush());
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.dirty);
+	ut_asserteq(1, stats.writebacks);
+
+	/* Removing the device writes delayed blocks */
+	ut_asserteq(1, blk_dwrite(desc, 21, 1, data));
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.dirty);
+	ut_asserteq(1, stats.writebacks);
+	ut_assertok(device_probe(dev));
+
+	/* A delayed block that cannot be written is reported */
+	ut_asserteq(1, blkcache_write(IF_TYPE_MMC, 99, 0, 1, 512, data));
+	ut_asserteq(-EIO, blkcache_flush());
+	ut_assertok(blkcache_flush());
+
+	/* Read back from the device with an empty cache */
+	ut_assertok(blkcache_configure(128, 0, false));
+	memset(buf, '\0', sizeof(buf));
+	ut_asserteq(1, blk_dread(desc, 20, 1, buf));
+	ut_asserteq_mem(data, buf, sizeof(data));
+	ut_asserteq(1, blk_dread(desc, 21, 1, buf));
+	ut_asserteq_mem(data, buf, sizeof(data));
+	blkcache_stats(&stats);
+	ut_asserteq(2, stats.misses);
+
+	/* If the cache cannot be allocated, it stays disabled */
+	ut_assertok(blkcache_configure(1024 * 1024, 0, true));
+	ut_asserteq(1, blk_dread(desc, 20, 1, buf));
+	ut_asserteq(1, blk_dwrite(desc, 20, 1, data));
+	ut_asserteq(1, blk_dread(desc, 20, 1, buf));
+	ut_asserteq_mem(data, buf, sizeof(data));
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.max_entries);
+	ut_asserteq(0, stats.dirty);
+
+	ut_assertok(blkcache_configure(CONFIG_BLOCK_CACHE_SIZE,
+				       CONFIG_BLOCK_CACHE_READAHEAD,
+				       IS_ENABLED(CONFIG_BLOCK_CACHE_WRITE_BEHIND)));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
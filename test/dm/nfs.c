@@ -0,0 +1,495 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Copyright (C) 2021 F&S Elektronik Systeme GmbH
+ *
+ * NFS download with several READ requests in flight. The sandbox Ethernet
+ * driver acts as portmapper, mount and NFS server that answers the READ
+ * requests out of order, drops a reply or sends less than requested. Replies
+ * that do not fit into one Ethernet frame are sent as IP fragments.
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <env.h>
+#include <image.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <net.h>
+#include <time.h>
+#include <asm/eth.h>
+#include <dm/test.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define SB_RPC_REPLY		1
+#define SB_RPC_PROG_MISMATCH	2
+
+#define SB_PROG_MOUNT		100005
+#define SB_MOUNT_MNT		1
+#define SB_MOUNT_UMOUNTALL	4
+#define SB_NFS_LOOKUP		4
+#define SB_NFS3_LOOKUP		3
+#define SB_NFS_READ		6
+
+/* UDP ports of the mocked servers and load address in sandbox RAM */
+#define SB_PORTMAP_PORT		111
+#define SB_MOUNT_PORT		1635
+#define SB_NFS_PORT		2049
+#define SB_NFS_ADDR		0x1000000
+
+/* Words of the RPC reply header and of the AUTH_UNIX credentials */
+#define SB_RPC_HDR_WORDS	6
+#define SB_RPC_CRED_WORDS	9
+
+#define SB_NFS_QUEUE		64
+
+/* Biggest reply: RPC header, NFSv3 READ result and 32 KiB of data */
+#define SB_NFS_DGRAM_SIZE	(IP_UDP_HDR_SIZE + 128 * sizeof(u32) + 32768)
+/* IP payload per fragment for an MTU of 1500 bytes, a multiple of 8 */
+#define SB_NFS_FRAG_SIZE	((1500 - IP_HDR_SIZE) & ~7)
+
+/**
+ * struct sb_nfs_read - READ request waiting for its reply
+ *
+ * @id:		RPC id of the request
+ * @offset:	Requested file offset
+ * @count:	Requested number of bytes
+ */
+struct sb_nfs_read {
+	u32 id;
+	ulong offset;
+	ulong count;
+};
+
+/**
+ * struct sb_nfs_server - state of the mocked NFS server
+ *
+ * @data:	File content
+ * @size:	File size
+ * @windowsize:	Value for 'nfswindowsize'
+ * @v3_only:	Refuse NFSv2 so that the client has to switch to NFSv3
+ * @maxread:	Send at most this many bytes per READ reply, 0 for no limit
+ * @drop_at:	Drop the first reply to a READ at this offset, 0 for none
+ * @reorder:	Replies to send after their successor, per mille
+ * @seed:	State of the pseudo random generator
+ * @client_port: UDP port of the client
+ * @version:	NFS version of the READ requests
+ * @requested:	Flag per file byte, set if a READ started there
+ * @queue:	READ requests waiting for their reply
+ * @queued:	Number of entries in @queue
+ * @dgram:	IP datagram of the current reply
+ * @dgram_len:	Length of @dgram, IP header included
+ * @dgram_sent:	Bytes of the IP payload of @dgram that were sent so far
+ * @reads:	Number of READ requests received
+ * @largest:	Biggest count of a READ request
+ * @fragments:	Number of IP fragments sent
+ * @dropped:	Number of replies dropped
+ * @reordered:	Number of replies sent out of order
+ * @resent:	Number of READ requests for an offset that was requested before
+ * @unmounted:	The client has sent UMOUNTALL
+ */
+struct sb_nfs_server {
+	const u8 *data;
+	ulong size;
+	int windowsize;
+	bool v3_only;
+	ulong maxread;
+	ulong drop_at;
+	int reorder;
+	u32 seed;
+	int client_port;
+	int version;
+	u8 *requested;
+	struct sb_nfs_read queue[SB_NFS_QUEUE];
+	int queued;
+	u8 *dgram;
+	int dgram_len;
+	int dgram_sent;
+	ulong reads;
+	ulong largest;
+	ulong fragments;
+	ulong dropped;
+	ulong reordered;
+	ulong resent;
+	bool unmounted;
+};
+
+/* Return a pseudo random number between 0 and 999 */
+static int sb_nfs_random(struct sb_nfs_server *srv)
+{
+	srv->seed = srv->seed * 1103515245 + 12345;
+
+	return (srv->seed >> 16) % 1000;
+}
+
+/*
+ * Start an RPC reply with the given number of data words and return a
+ * pointer to the data words. sb_nfs_flush() sends it.
+ */
+static __be32 *sb_nfs_reply(struct udevice *dev, struct sb_nfs_server *srv,
+			    int port, u32 id, int words)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ip_udp_hdr *ipr = (void *)srv->dgram;
+	int len = (SB_RPC_HDR_WORDS + words) * sizeof(u32);
+	__be32 *p;
+
+	net_set_ip_header((uchar *)ipr, net_ip, priv->fake_host_ipaddr,
+			  IP_UDP_HDR_SIZE + len, IPPROTO_UDP);
+	ipr->udp_src = htons(port);
+	ipr->udp_dst = htons(srv->client_port);
+	ipr->udp_len = htons(UDP_HDR_SIZE + len);
+	ipr->udp_xsum = 0;
+	srv->dgram_len = IP_UDP_HDR_SIZE + len;
+	srv->dgram_sent = 0;
+
+	p = (void *)ipr + IP_UDP_HDR_SIZE;
+	memset(p, 0, len);
+	p[0] = id;
+	p[1] = htonl(SB_RPC_REPLY);
+
+	return p + SB_RPC_HDR_WORDS;
+}
+
+/*
+ * Add the current reply to the receive queue, split into IP fragments if it
+ * is too big for one frame. Return true when all of it was queued.
+ */
+static bool sb_nfs_flush(struct udevice *dev, struct sb_nfs_server *srv)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ip_udp_hdr *ip = (void *)srv->dgram;
+	int payload = srv->dgram_len - IP_HDR_SIZE;
+	struct ethernet_hdr *eth_recv;
+	struct ip_udp_hdr *ipr;
+	int len;
+
+	while (srv->dgram_sent < payload && priv->recv_packets < PKTBUFSRX) {
+		eth_recv = (void *)priv->recv_packet_buffer[priv->recv_packets];
+		memcpy(eth_recv->et_dest, net_ethaddr, ARP_HLEN);
+		memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+		eth_recv->et_protlen = htons(PROT_IP);
+
+		ipr = (void *)eth_recv + ETHER_HDR_SIZE;
+		len = min_t(int, payload - srv->dgram_sent, SB_NFS_FRAG_SIZE);
+		memcpy(ipr, ip, IP_HDR_SIZE);
+		memcpy((void *)ipr + IP_HDR_SIZE,
+		       srv->dgram + IP_HDR_SIZE + srv->dgram_sent, len);
+		if (len < payload) {
+			ipr->ip_len = htons(IP_HDR_SIZE + len);
+			ipr->ip_off = htons(srv->dgram_sent / 8);
+			if (srv->dgram_sent + len < payload)
+				ipr->ip_off |= htons(IP_FLAGS_MFRAG);
+			ipr->ip_sum = 0;
+			ipr->ip_sum = compute_ip_checksum(ipr, IP_HDR_SIZE);
+			srv->fragments++;
+		}
+
+		priv->recv_packet_length[priv->recv_packets] =
+			ETHER_HDR_SIZE + IP_HDR_SIZE + len;
+		++priv->recv_packets;
+		srv->dgram_sent += len;
+	}
+
+	return srv->dgram_sent >= payload;
+}
+
+static void sb_nfs_send_read(struct udevice *dev, struct sb_nfs_server *srv,
+			     struct sb_nfs_read *rd)
+{
+	ulong len = 0;
+	__be32 *p;
+	u8 *data;
+
+	if (rd->offset < srv->size)
+		len = min(rd->count, srv->size - rd->offset);
+	if (srv->maxread && len > srv->maxread)
+		len = srv->maxread;
+
+	if (srv->version == 2) {
+		/* status, fattr (17 words), count, data */
+		p = sb_nfs_reply(dev, srv, SB_NFS_PORT, rd->id,
+				 19 + DIV_ROUND_UP(len, 4));
+		p[18] = htonl(len);
+		data = (u8 *)(p + 19);
+	} else {
+		/* status, attributes_follow, fattr3 (21 words), count, eof */
+		p = sb_nfs_reply(dev, srv, SB_NFS_PORT, rd->id,
+				 26 + DIV_ROUND_UP(len, 4));
+		p[1] = htonl(1);
+		p[23] = htonl(len);
+		p[24] = htonl(rd->offset + len >= srv->size);
+		p[25] = htonl(len);
+		data = (u8 *)(p + 26);
+	}
+	memcpy(data, srv->data + rd->offset, len);
+}
+
+/* Remember a READ request, the reply is sent by the receive handler */
+static void sb_nfs_queue_read(struct sb_nfs_server *srv, u32 id, int vers,
+			      __be32 *args)
+{
+	struct sb_nfs_read *rd;
+
+	if (srv->queued >= SB_NFS_QUEUE)
+		return;
+
+	rd = &srv->queue[srv->queued++];
+	rd->id = id;
+	srv->version = vers;
+	if (vers == 2) {
+		/* fhandle (8 words), offset, count, totalcount */
+		rd->offset = ntohl(args[8]);
+		rd->count = ntohl(args[9]);
+	} else {
+		/* fhandle length, fhandle, 64 bit offset, count */
+		args += 1 + ntohl(args[0]) / 4;
+		rd->offset = ntohl(args[1]);
+		rd->count = ntohl(args[2]);
+	}
+
+	srv->reads++;
+	srv->largest = max(srv->largest, rd->count);
+	if (rd->offset < srv->size) {
+		if (srv->requested[rd->offset])
+			srv->resent++;
+		srv->requested[rd->offset] = 1;
+	}
+}
+
+/* Handle the packets of the client: ARP and RPC calls */
+static int sb_nfs_tx_handler(struct udevice *dev, void *packet,
+			     unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_nfs_server *srv = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	__be32 *call = packet + ETHER_HDR_SIZE + IP_UDP_HDR_SIZE;
+	__be32 *args = call + SB_RPC_HDR_WORDS + SB_RPC_CRED_WORDS;
+	int port, vers, proc;
+	__be32 *p;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+
+	/* Calls that come while a reply is still being sent are lost */
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP ||
+	    priv->recv_packets >= PKTBUFSRX || !sb_nfs_flush(dev, srv))
+		return 0;
+
+	srv->client_port = ntohs(ip->udp_src);
+	port = ntohs(ip->udp_dst);
+	vers = ntohl(call[4]);
+	proc = ntohl(call[5]);
+
+	switch (port) {
+	case SB_PORTMAP_PORT:
+		/* GETPORT, after an empty credential and verifier */
+		p = sb_nfs_reply(dev, srv, port, call[0], 1);
+		if (ntohl(call[SB_RPC_HDR_WORDS + 4]) == SB_PROG_MOUNT)
+			p[0] = htonl(SB_MOUNT_PORT);
+		else
+			p[0] = htonl(SB_NFS_PORT);
+		break;
+
+	case SB_MOUNT_PORT:
+		if (proc == SB_MOUNT_MNT) {
+			/* status, directory file handle */
+			p = sb_nfs_reply(dev, srv, port, call[0], 9);
+			memset(p + 1, 0x11, 32);
+		} else if (proc == SB_MOUNT_UMOUNTALL) {
+			sb_nfs_reply(dev, srv, port, call[0], 0);
+			srv->unmounted = true;
+		}
+		break;
+
+	case SB_NFS_PORT:
+		if (proc == SB_NFS_READ) {
+			sb_nfs_queue_read(srv, call[0], vers, args);
+		} else if (vers == 2 && proc == SB_NFS_LOOKUP) {
+			if (srv->v3_only) {
+				/* astatus ends the header; versions 3 to 3 */
+				p = sb_nfs_reply(dev, srv, port, call[0], 2);
+				p[-1] = htonl(SB_RPC_PROG_MISMATCH);
+				p[0] = htonl(3);
+				p[1] = htonl(3);
+				break;
+			}
+			/* status, file handle, fattr (17 words) */
+			p = sb_nfs_reply(dev, srv, port, call[0], 26);
+			memset(p + 1, 0x22, 32);
+		} else if (vers == 3 && proc == SB_NFS3_LOOKUP) {
+			/* status, file handle length, file handle, no attrs */
+			p = sb_nfs_reply(dev, srv, port, call[0], 12);
+			p[1] = htonl(32);
+			memset(p + 2, 0x22, 32);
+		}
+		break;
+	}
+	sb_nfs_flush(dev, srv);
+
+	return 0;
+}
+
+/* Answer the READ requests, possibly out of order or not at all */
+static int sb_nfs_rx_handler(struct udevice *dev)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_nfs_server *srv = priv->priv;
+	struct sb_nfs_read rd;
+
+	while (sb_nfs_flush(dev, srv) && srv->queued &&
+	       priv->recv_packets < PKTBUFSRX) {
+		if (srv->queued > 1 && sb_nfs_random(srv) < srv->reorder) {
+			rd = srv->queue[0];
+			srv->queue[0] = srv->queue[1];
+			srv->queue[1] = rd;
+			srv->reordered++;
+		}
+		rd = srv->queue[0];
+		srv->queued--;
+		memmove(&srv->queue[0], &srv->queue[1],
+			srv->queued * sizeof(rd));
+
+		if (srv->drop_at && rd.offset == srv->drop_at &&
+		    !srv->dropped) {
+			srv->dropped++;
+			continue;
+		}
+		sb_nfs_send_read(dev, srv, &rd);
+	}
+
+	return 0;
+}
+
+/* Load the file from the mocked server and check its content */
+static int sb_nfs_run(struct unit_test_state *uts, struct sb_nfs_server *srv,
+		      const char *name)
+{
+	ulong start, us;
+	u8 *data;
+	void *buf;
+	int ret;
+
+	data = malloc(srv->size);
+	ut_assertnonnull(data);
+	ut_fill_pattern(data, srv->size);
+	srv->data = data;
+	srv->requested = calloc(1, srv->size);
+	ut_assertnonnull(srv->requested);
+	srv->dgram = malloc(SB_NFS_DGRAM_SIZE);
+	ut_assertnonnull(srv->dgram);
+	srv->seed = 1;
+
+	net_server_ip = string_to_ip("1.1.2.2");
+	copy_filename(net_boot_file_name, "/export/sb_nfs.bin",
+		      sizeof(net_boot_file_name));
+	set_fileaddr(SB_NFS_ADDR);
+	env_set("ethact", "eth@10002000");
+	env_set_ulong("nfswindowsize", srv->windowsize);
+
+	sandbox_eth_set_tx_handler(0, sb_nfs_tx_handler);
+	sandbox_eth_set_rx_handler(0, sb_nfs_rx_handler);
+	sandbox_eth_set_priv(0, srv);
+
+	start = timer_get_us();
+	ret = net_loop(NFS);
+	us = timer_get_us() - start;
+
+	sandbox_eth_set_tx_handler(0, NULL);
+	sandbox_eth_set_rx_handler(0, NULL);
+	sandbox_eth_set_priv(0, NULL);
+	env_set("nfswindowsize", NULL);
+	free(srv->requested);
+	free(srv->dgram);
+
+	ut_asserteq(srv->size, ret);
+	ut_assert(srv->unmounted);
+	buf = map_sysmem(SB_NFS_ADDR, srv->size);
+	ut_asserteq_mem(data, buf, srv->size);
+	unmap_sysmem(buf);
+	free(data);
+
+	printf("%s: %lu bytes, NFSv%d, windowsize %d, read size %lu:\n", name,
+	       srv->size, srv->version, srv->windowsize, srv->largest);
+	printf("  %lu requests, %lu dropped, %lu reordered, %lu resent\n",
+	       srv->reads, srv->dropped, srv->reordered, srv->resent);
+	printf("  %lu IP fragments\n", srv->fragments);
+	ut_show_speed("net_loop():", srv->size, us);
+
+	return 0;
+}
+
+/* One request at a time like before: nothing is requested twice */
+static int dm_test_eth_nfs(struct unit_test_state *uts)
+{
+	struct sb_nfs_server srv = {
+		.size = 256 * 1024 + 77,
+		.windowsize = 1,
+	};
+
+	ut_assertok(sb_nfs_run(uts, &srv, "clean"));
+	ut_asserteq(0, srv.resent);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_nfs, UT_TESTF_SCAN_FDT);
+
+/*
+ * Replies out of order and one lost reply: only the lost request is sent
+ * again, as soon as a whole window of later requests was answered
+ */
+static int dm_test_eth_nfs_window(struct unit_test_state *uts)
+{
+	struct sb_nfs_server srv = {
+		.size = 1024 * 1024 + 77,
+		.windowsize = 8,
+		.drop_at = 64 * 1024,
+		.reorder = 200,
+	};
+
+	ut_assertok(sb_nfs_run(uts, &srv, "window"));
+	ut_asserteq(1, srv.dropped);
+	ut_assert(srv.reordered > 0);
+	ut_asserteq(1, srv.resent);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_nfs_window, UT_TESTF_SCAN_FDT);
+
+/*
+ * Fall back to NFSv3, the server sends less than requested. With IP_DEFRAG
+ * the client asks for more than fits into one frame.
+ */
+static int dm_test_eth_nfs_v3(struct unit_test_state *uts)
+{
+	struct sb_nfs_server srv = {
+		.size = 256 * 1024 + 77,
+		.windowsize = 8,
+		.v3_only = true,
+		.maxread = 700,
+		.reorder = 200,
+	};
+	struct sb_nfs_server big = {
+		.size = 1024 * 1024 + 77,
+		.windowsize = 8,
+		.v3_only = true,
+		.reorder = 200,
+	};
+
+	ut_assertok(sb_nfs_run(uts, &srv, "v3"));
+	ut_asserteq(3, srv.version);
+
+	ut_assertok(sb_nfs_run(uts, &big, "v3 big"));
+	ut_asserteq(3, big.version);
+	ut_asserteq(0, big.resent);
+	if (IS_ENABLED(CONFIG_IP_DEFRAG)) {
+		/* NFS_READ_SIZE fits into one frame */
+		ut_assert(big.largest > 1024);
+		ut_assert(big.fragments > big.reads);
+	}
+
+	return 0;
+}
+DM_TEST(dm_test_eth_nfs_v3, UT_TESTF_SCAN_FDT);
@@ -0,0 +1,336 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Copyright (C) 2021 F&S Elektronik Systeme GmbH
+ *
+ * TFTP download with window size through a lossy mock network. The sandbox
+ * Ethernet driver acts as a TFTP server that drops and reorders packets.
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <env.h>
+#include <hash.h>
+#include <image.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <net.h>
+#include <time.h>
+#include <u-boot/crc.h>
+#include <asm/eth.h>
+#include <dm/test.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define SB_TFTP_RRQ		1
+#define SB_TFTP_DATA		3
+#define SB_TFTP_ACK		4
+#define SB_TFTP_OACK		6
+
+/* UDP port of the mocked server and load address in sandbox RAM */
+#define SB_TFTP_PORT		1069
+#define SB_TFTP_ADDR		0x1000000
+
+/**
+ * struct sb_tftp_server - state of the mocked TFTP server
+ *
+ * @data:	File content
+ * @size:	File size
+ * @blksize:	Block size
+ * @windowsize:	Window size
+ * @drop:	Packets to drop, per mille
+ * @reorder:	Packets to send after their successor, per mille
+ * @seed:	State of the pseudo random generator
+ * @client_port: UDP port of the client
+ * @blocks:	Number of blocks including the final short one
+ * @started:	The client has acknowledged the OACK
+ * @acked:	Last block acknowledged by the client
+ * @next:	Next block to send
+ * @held:	Block held back to be sent after its successor, or 0
+ * @sent:	Number of data packets sent
+ * @dropped:	Number of data packets dropped
+ * @reordered:	Number of data packets sent out of order
+ * @resent:	Number of data packets sent more than once, dropped or not
+ * @timeouts:	Number of times the client did not acknowledge a window
+ */
+struct sb_tftp_server {
+	const u8 *data;
+	ulong size;
+	int blksize;
+	int windowsize;
+	int drop;
+	int reorder;
+	u32 seed;
+	int client_port;
+	ulong blocks;
+	bool started;
+	ulong acked;
+	ulong next;
+	ulong held;
+	ulong sent;
+	ulong dropped;
+	ulong reordered;
+	ulong resent;
+	ulong timeouts;
+};
+
+/* Return a pseudo random number between 0 and 999 */
+static int sb_tftp_random(struct sb_tftp_server *srv)
+{
+	srv->seed = srv->seed * 1103515245 + 12345;
+
+	return (srv->seed >> 16) % 1000;
+}
+
+/* Add a UDP packet from the server to the receive queue, return payload */
+static __be16 *sb_tftp_packet(struct udevice *dev, struct sb_tftp_server *srv,
+			      int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth_recv;
+	struct ip_udp_hdr *ipr;
+
+	eth_recv = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	memcpy(eth_recv->et_dest, net_ethaddr, ARP_HLEN);
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_recv->et_protlen = htons(PROT_IP);
+
+	ipr = (void *)eth_recv + ETHER_HDR_SIZE;
+	net_set_ip_header((uchar *)ipr, net_ip, priv->fake_host_ipaddr,
+			  IP_UDP_HDR_SIZE + len, IPPROTO_UDP);
+	ipr->udp_src = htons(SB_TFTP_PORT);
+	ipr->udp_dst = htons(srv->client_port);
+	ipr->udp_len = htons(UDP_HDR_SIZE + len);
+	ipr->udp_xsum = 0;
+
+	priv->recv_packet_length[priv->recv_packets] =
+		ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + len;
+	++priv->recv_packets;
+
+	return (void *)ipr + IP_UDP_HDR_SIZE;
+}
+
+static void sb_tftp_send_block(struct udevice *dev, struct sb_tftp_server *srv,
+			       ulong block)
+{
+	ulong offset = (block - 1) * srv->blksize;
+	int len = min_t(ulong, srv->blksize, srv->size - offset);
+	__be16 *s = sb_tftp_packet(dev, srv, 4 + len);
+
+	s[0] = htons(SB_TFTP_DATA);
+	s[1] = htons((u16)block);
+	memcpy(s + 2, srv->data + offset, len);
+
+	srv->sent++;
+}
+
+/* Handle the packets of the client: ARP, RRQ and ACK */
+static int sb_tftp_tx_handler(struct udevice *dev, void *packet,
+			      unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_tftp_server *srv = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	__be16 *s = packet + ETHER_HDR_SIZE + IP_UDP_HDR_SIZE;
+	char *options;
+	u16 diff;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP ||
+	    priv->recv_packets >= PKTBUFSRX)
+		return 0;
+
+	switch (ntohs(s[0])) {
+	case SB_TFTP_RRQ:
+		/* Accept the client's options by sending them back */
+		srv->client_port = ntohs(ip->udp_src);
+		s = sb_tftp_packet(dev, srv, 2 + 32);
+		s[0] = htons(SB_TFTP_OACK);
+		options = (char *)(s + 1);
+		memset(options, 0, 32);
+		sprintf(options, "blksize%c%d%cwindowsize%c%d", 0,
+			srv->blksize, 0, 0, srv->windowsize);
+		break;
+
+	case SB_TFTP_ACK:
+		/* The client may acknowledge blocks ahead of the window start */
+		diff = ntohs(s[1]) - (u16)srv->acked;
+		if (diff > srv->windowsize)
+			break;
+		srv->started = true;
+		srv->acked += diff;
+		srv->next = srv->acked + 1;
+		srv->held = 0;
+		break;
+	}
+
+	return 0;
+}
+
+/* Send the next packets of the window like a server on the network would */
+static int sb_tftp_rx_handler(struct udevice *dev)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_tftp_server *srv = priv->priv;
+	ulong last;
+
+	if (!srv->started || srv->acked >= srv->blocks)
+		return 0;
+
+	/* Nothing else to send: the client did not get the whole window */
+	last = min(srv->acked + srv->windowsize, srv->blocks);
+	if (srv->next > last && !srv->held) {
+		srv->timeouts++;
+		srv->next = srv->acked + 1;
+	}
+
+	while (priv->recv_packets < PKTBUFSRX) {
+		ulong block;
+
+		if (srv->held && srv->next > srv->held + 1) {
+			sb_tftp_send_block(dev, srv, srv->held);
+			srv->held = 0;
+			continue;
+		}
+		if (srv->next > last)
+			break;
+
+		block = srv->next++;
+		if (sb_tftp_random(srv) < srv->drop) {
+			srv->dropped++;
+			continue;
+		}
+
+		/*
+		 * The client only starts with block 1; also never hold back
+		 * the last two blocks of a window
+		 */
+		if (!srv->held && block > 1 && block + 1 < last &&
+		    sb_tftp_random(srv) < srv->reorder) {
+			srv->held = block;
+			srv->reordered++;
+			continue;
+		}
+		sb_tftp_send_block(dev, srv, block);
+	}
+
+	return 0;
+}
+
+/* Load the file from the mocked server and check content and checksum */
+static int sb_tftp_run(struct unit_test_state *uts, struct sb_tftp_server *srv,
+		       const char *name)
+{
+	char crc_str[9];
+	ulong start, us;
+	u8 *data;
+	void *buf;
+	int ret;
+
+	data = malloc(srv->size);
+	ut_assertnonnull(data);
+	ut_fill_pattern(data, srv->size);
+	srv->data = data;
+	srv->blocks = srv->size / srv->blksize + 1;
+	srv->seed = 1;
+
+	net_server_ip = string_to_ip("1.1.2.2");
+	copy_filename(net_boot_file_name, "sb_tftp.bin",
+		      sizeof(net_boot_file_name));
+	set_fileaddr(SB_TFTP_ADDR);
+	env_set("ethact", "eth@10002000");
+	env_set_ulong("tftpblocksize", srv->blksize);
+	env_set_ulong("tftpwindowsize", srv->windowsize);
+	env_set("tftphash", "crc32");
+
+	sandbox_eth_set_tx_handler(0, sb_tftp_tx_handler);
+	sandbox_eth_set_rx_handler(0, sb_tftp_rx_handler);
+	sandbox_eth_set_priv(0, srv);
+
+	start = timer_get_us();
+	ret = net_loop(TFTPGET);
+	us = timer_get_us() - start;
+
+	sandbox_eth_set_tx_handler(0, NULL);
+	sandbox_eth_set_rx_handler(0, NULL);
+	sandbox_eth_set_priv(0, NULL);
+	env_set("tftpblocksize", NULL);
+	env_set("tftpwindowsize", NULL);
+	env_set("tftphash", NULL);
+
+	ut_asserteq(srv->size, ret);
+	srv->resent = srv->sent + srv->dropped - srv->blocks;
+	buf = map_sysmem(SB_TFTP_ADDR, srv->size);
+	ut_asserteq_mem(data, buf, srv->size);
+	unmap_sysmem(buf);
+	if (IS_ENABLED(CONFIG_HASH)) {
+		sprintf(crc_str, "%08x", crc32(0, data, srv->size));
+		ut_asserteq_str(crc_str, env_get("filehash"));
+	}
+	free(data);
+
+	printf("%s: %lu bytes, blksize %d, windowsize %d:\n", name, srv->size,
+	       srv->blksize, srv->windowsize);
+	printf("  %lu packets, %lu dropped, %lu reordered, %lu resent, %lu timeouts\n",
+	       srv->sent, srv->dropped, srv->reordered, srv->resent,
+	       srv->timeouts);
+	ut_show_speed("net_loop():", srv->size, us);
+
+	return 0;
+}
+
+/* No losses: every block must be sent exactly once */
+static int dm_test_eth_tftp(struct unit_test_state *uts)
+{
+	struct sb_tftp_server srv = {
+		.size = 4 * 1024 * 1024 + 123,
+		.blksize = 1468,
+		.windowsize = 16,
+	};
+
+	ut_assertok(sb_tftp_run(uts, &srv, "clean"));
+	ut_asserteq(0, srv.resent);
+	ut_asserteq(0, srv.timeouts);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_tftp, UT_TESTF_SCAN_FDT);
+
+/* Reordered blocks are kept, so nothing has to be sent again */
+static int dm_test_eth_tftp_reorder(struct unit_test_state *uts)
+{
+	struct sb_tftp_server srv = {
+		.size = 4 * 1024 * 1024,
+		.blksize = 1468,
+		.windowsize = 16,
+		.reorder = 50,
+	};
+
+	ut_assertok(sb_tftp_run(uts, &srv, "reorder"));
+	ut_assert(srv.reordered > 0);
+	ut_asserteq(0, srv.resent);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_tftp_reorder, UT_TESTF_SCAN_FDT);
+
+/* Drops and reordering, small blocks so that the block number wraps */
+static int dm_test_eth_tftp_lossy(struct unit_test_state *uts)
+{
+	struct sb_tftp_server srv = {
+		.size = 1024 * 1024 + 77,
+		.blksize = 8,
+		.windowsize = 32,
+		.drop = 20,
+		.reorder = 50,
+	};
+
+	ut_assertok(sb_tftp_run(uts, &srv, "lossy"));
+	ut_assert(srv.dropped > 0);
+	ut_assert(srv.blocks > 0x10000);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_tftp_lossy, UT_TESTF_SCAN_FDT);
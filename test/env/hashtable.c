@@ -7,14 +7,20 @@
 #include <common.h>
 #include <command.h>
 #include <log.h>
+#include <malloc.h>
 #include <search.h>
 #include <stdio.h>
+#include <time.h>
 #include <test/env.h>
 #include <test/ut.h>
 
 #define SIZE 32
 #define ITERATIONS 10000
 
+/* Number of variables and rounds for the import and lookup benchmark */
+#define SPEED_VARS 1000
+#define SPEED_ROUNDS 100
+
 static int htab_fill(struct unit_test_state *uts,
 		     struct hsearch_data *htab, size_t size)
 {
@@ -124,3 +130,115 @@ static int env_test_htab_deletes(struct unit_test_state *uts)
 }
 
 ENV_TEST(env_test_htab_deletes, 0);
+
+/*
+ * Delete a variable in the same import that set it. This drops the last
+ * user of the import buffer while it is still parsed.
+ */
+static int env_test_htab_import_delete(struct unit_test_state *uts)
+{
+	static const char env[] = "x=1\nx\ny=2\n";
+	struct hsearch_data htab;
+	struct env_entry item;
+	struct env_entry *ritem;
+	ulong mem_start;
+
+	mem_start = ut_check_free();
+	memset(&htab, 0, sizeof(htab));
+	ut_asserteq(1, himport_r(&htab, env, sizeof(env) - 1, '\n', 0, 0, 0,
+				 NULL));
+	ut_asserteq(1, htab.filled);
+
+	item.callback = NULL;
+	item.data = NULL;
+	item.flags = 0;
+	item.key = "x";
+	hsearch_r(item, ENV_FIND, &ritem, &htab, 0);
+	ut_assertnull(ritem);
+	item.key = "y";
+	hsearch_r(item, ENV_FIND, &ritem, &htab, 0);
+	ut_assertnonnull(ritem);
+	ut_asserteq_str("2", ritem->data);
+
+	/* Delete the last imported variable, the buffer must go away */
+	ut_asserteq(0, hdelete_r("y", &htab, 0));
+	ut_assertnull(htab.arena);
+
+	hdestroy_r(&htab);
+	ut_asserteq(0, ut_check_delta(mem_start));
+
+	return 0;
+}
+
+ENV_TEST(env_test_htab_import_delete, 0);
+
+/* Import a large text environment repeatedly and look up all variables */
+static int env_test_htab_speed(struct unit_test_state *uts)
+{
+	struct hsearch_data htab;
+	struct env_entry item;
+	struct env_entry *ritem;
+	ulong start, import_us, lookup_us;
+	char key[32], value[48];
+	char *blob, *p;
+	int i, round;
+
+	blob = malloc(SPEED_VARS * 64);
+	ut_assertnonnull(blob);
+	for (i = 0, p = blob; i < SPEED_VARS; i++)
+		p += sprintf(p, "fdt_overlay_%04d=value of variable %d\n", i, i);
+
+	memset(&htab, 0, sizeof(htab));
+	start = timer_get_us();
+	for (round = 0; round < SPEED_ROUNDS; round++)
+		ut_asserteq(1, himport_r(&htab, blob, p - blob, '\n', 0, 0,
+					 0, NULL));
+	import_us = timer_get_us() - start;
+	ut_asserteq(SPEED_VARS, htab.filled);
+
+	item.callback = NULL;
+	item.data = NULL;
+	item.flags = 0;
+	item.key = key;
+	start = timer_get_us();
+	for (round = 0; round < SPEED_ROUNDS; round++) {
+		for (i = 0; i < SPEED_VARS; i++) {
+			sprintf(key, "fdt_overlay_%04d", i);
+			hsearch_r(item, ENV_FIND, &ritem, &htab, 0);
+			ut_assertnonnull(ritem);
+		}
+	}
+	lookup_us = timer_get_us() - start;
+
+	/* Overwrite and delete imported variables, import on top */
+	sprintf(value, "new value");
+	item.data = value;
+	ut_assert(hsearch_r(item, ENV_ENTER, &ritem, &htab, 0));
+	ut_asserteq_str(value, ritem->data);
+	ut_asserteq(0, hdelete_r("fdt_overlay_0000", &htab, 0));
+	ut_asserteq(1, himport_r(&htab, "fdt_overlay_0001=x\nextra=y\n", 27,
+				 '\n', H_NOCLEAR, 0, 0, NULL));
+	item.data = NULL;
+	hsearch_r(item, ENV_FIND, &ritem, &htab, 0);
+	ut_asserteq_str(value, ritem->data);
+	item.key = "fdt_overlay_0001";
+	hsearch_r(item, ENV_FIND, &ritem, &htab, 0);
+	ut_asserteq_str("x", ritem->data);
+	item.key = "fdt_overlay_0000";
+	hsearch_r(item, ENV_FIND, &ritem, &htab, 0);
+	ut_assertnull(ritem);
+	ut_asserteq(SPEED_VARS, htab.filled);
+
+	hdestroy_r(&htab);
+	free(blob);
+
+	printf("%d variables, %d rounds:\n", SPEED_VARS, SPEED_ROUNDS);
+	printf("  himport_r(): %8lu us, %6lu variables/ms\n", import_us,
+	       ut_rate(SPEED_VARS * SPEED_ROUNDS * 1000UL, import_us));
+	printf("  hsearch_r(): %8lu us, %6lu lookups/ms\n", lookup_us,
+	       ut_rate(SPEED_VARS * SPEED_ROUNDS * 1000UL, lookup_us));
+
+	return 0;
+}
+
+ENV_TEST(env_test_htab_speed, 0);
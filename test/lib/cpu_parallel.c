@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for cpu_parallel_run() and the parallel mtest
+ *
+ * (C) Copyright 2022
+ * F&S Elektronik Systeme GmbH
+ */
+
+#include <common.h>
+#include <command.h>
+#include <console.h>
+#include <cpu_func.h>
+#include <asm/global_data.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+struct cpu_parallel_test {
+	int calls[CONFIG_CPU_PARALLEL_MAX];
+	int count[CONFIG_CPU_PARALLEL_MAX];
+};
+
+static void cpu_parallel_test_fn(int cpu, int count, void *arg)
+{
+	struct cpu_parallel_test *t = arg;
+
+	/* Each CPU only touches its own entries */
+	t->calls[cpu]++;
+	t->count[cpu] = count;
+}
+
+/* Each CPU index must be called exactly once, even with fewer CPUs */
+static int lib_test_cpu_parallel_run(struct unit_test_state *uts)
+{
+	struct cpu_parallel_test t;
+	int count, cpu, running;
+
+	count = cpu_parallel_count();
+	ut_assert(count >= 1);
+	ut_assert(count <= CONFIG_CPU_PARALLEL_MAX);
+
+	for (; count >= 1; count--) {
+		memset(&t, 0, sizeof(t));
+		running = cpu_parallel_run(count, cpu_parallel_test_fn, &t);
+		ut_assert(running >= 1);
+		ut_assert(running <= count);
+		for (cpu = 0; cpu < CONFIG_CPU_PARALLEL_MAX; cpu++) {
+			ut_asserteq(cpu < count, t.calls[cpu]);
+			ut_asserteq(cpu < count ? count : 0, t.count[cpu]);
+		}
+	}
+
+	return 0;
+}
+LIB_TEST(lib_test_cpu_parallel_run, 0);
+
+/* The quick mtest splits the RAM between the CPUs and must find no errors */
+static int lib_test_cpu_parallel_mtest(struct unit_test_state *uts)
+{
+	console_record_reset_enable();
+	ut_assertok(run_command("mtest 100000 140000 0 2", 0));
+	gd->flags &= ~GD_FLG_RECORD;
+	if (cpu_parallel_count() > 1) {
+		ut_assert_nextline("Testing 00100000 ... 00140000 on %d CPUs:",
+				   cpu_parallel_count());
+	} else {
+		ut_assert_nextline("Testing 00100000 ... 00140000:");
+	}
+
+	/* Skip the progress output, the record splits it at each \r and \b */
+	do {
+		ut_assert(console_record_readline(uts->actual_str,
+						  sizeof(uts->actual_str)) > 0);
+	} while (strcmp(uts->actual_str,
+			"Reading...Tested 2 iteration(s) with 0 errors."));
+	ut_assert_console_end();
+
+	return 0;
+}
+LIB_TEST(lib_test_cpu_parallel_mtest, 0);
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Copyright (C) 2021 F&S Elektronik Systeme GmbH
+ *
+ * Unit tests and benchmark for crc32()
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <time.h>
+#include <u-boot/crc.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Size of the benchmark data; large enough to exceed the data caches */
+#define TEST_CRC32_SIZE		(8 * 1024 * 1024)
+
+/* Table for the byte-wise reference implementation */
+static uint32_t test_crc32_table[256];
+
+static void test_crc32_make_table(void)
+{
+	uint32_t c;
+	int n, k;
+
+	for (n = 0; n < 256; n++) {
+		c = n;
+		for (k = 0; k < 8; k++)
+			c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		test_crc32_table[n] = c;
+	}
+}
+
+/* Byte-wise table lookup, as lib/crc32.c did before slice-by-8 */
+static uint32_t test_crc32_bytewise(uint32_t crc, const uint8_t *buf,
+				    uint len)
+{
+	crc ^= 0xffffffff;
+	while (len--)
+		crc = test_crc32_table[(crc ^ *buf++) & 255] ^ (crc >> 8);
+
+	return crc ^ 0xffffffff;
+}
+
+/* Check crc32() against the reference for all alignments and short sizes */
+static int lib_test_crc32(struct unit_test_state *uts)
+{
+	uint8_t buf[256 + 8];
+	int offs, len;
+
+	test_crc32_make_table();
+	for (len = 0; len < sizeof(buf); len++)
+		buf[len] = len * 13 + 5;
+
+	ut_asserteq(0xcbf43926, crc32(0, (const uint8_t *)"123456789", 9));
+	ut_asserteq(0, crc32(0, buf, 0));
+
+	for (offs = 0; offs < 8; offs++) {
+		for (len = 0; len <= 256; len++) {
+			ut_asserteq(test_crc32_bytewise(0x12345678,
+							buf + offs, len),
+				    crc32(0x12345678, buf + offs, len));
+		}
+	}
+
+	return 0;
+}
+LIB_TEST(lib_test_crc32, 0);
+
+/* Compare the throughput of crc32() and the byte-wise reference */
+static int lib_test_crc32_speed(struct unit_test_state *uts)
+{
+	ulong start, ref_us, crc_us;
+	uint32_t ref, crc;
+	uint8_t *data;
+
+	test_crc32_make_table();
+	data = malloc(TEST_CRC32_SIZE);
+	ut_assertnonnull(data);
+	ut_fill_pattern(data, TEST_CRC32_SIZE);
+
+	start = timer_get_us();
+	ref = test_crc32_bytewise(0, data, TEST_CRC32_SIZE);
+	ref_us = timer_get_us() - start;
+
+	start = timer_get_us();
+	crc = crc32(0, data, TEST_CRC32_SIZE);
+	crc_us = timer_get_us() - start;
+
+	free(data);
+	ut_asserteq(ref, crc);
+
+	printf("crc32, %u bytes:\n", TEST_CRC32_SIZE);
+	ut_show_speed("byte-wise:", TEST_CRC32_SIZE, ref_us);
+	ut_show_speed("crc32():", TEST_CRC32_SIZE, crc_us);
+
+	return 0;
+}
+LIB_TEST(lib_test_crc32_speed, 0);
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Copyright (C) 2021 F&S Elektronik Systeme GmbH
+ *
+ * Unit tests and benchmark for hash_multi_block()
+ */
+
+#include <common.h>
+#include <hash.h>
+#include <malloc.h>
+#include <time.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Size of the test data; large enough to exceed the data caches */
+#define TEST_HASH_SIZE		(4 * 1024 * 1024)
+
+/* The typical combination of hash nodes in our FIT images */
+static const char *const test_hash_algos[] = { "crc32", "sha256" };
+
+#define TEST_HASH_COUNT		ARRAY_SIZE(test_hash_algos)
+
+/* Compare hash_multi_block() with hash_block() and show the throughput */
+static int lib_test_hash_multi(struct unit_test_state *uts)
+{
+	struct hash_algo *algos[TEST_HASH_COUNT];
+	uint8_t single[TEST_HASH_COUNT][HASH_MAX_DIGEST_SIZE];
+	uint32_t multi[TEST_HASH_COUNT][HASH_MAX_DIGEST_SIZE / 4];
+	uint8_t *outputs[TEST_HASH_COUNT];
+	ulong start, single_us, multi_us;
+	uint8_t *data;
+	int i;
+
+	data = malloc(TEST_HASH_SIZE);
+	ut_assertnonnull(data);
+	ut_fill_pattern(data, TEST_HASH_SIZE);
+
+	for (i = 0; i < TEST_HASH_COUNT; i++) {
+		ut_assertok(hash_progressive_lookup_algo(test_hash_algos[i],
+							 &algos[i]));
+		outputs[i] = (uint8_t *)multi[i];
+	}
+
+	/* One pass over the data for each algorithm */
+	start = timer_get_us();
+	for (i = 0; i < TEST_HASH_COUNT; i++)
+		ut_assertok(hash_block(test_hash_algos[i], data,
+				       TEST_HASH_SIZE, single[i], NULL));
+	single_us = timer_get_us() - start;
+
+	/* One pass over the data for all algorithms */
+	start = timer_get_us();
+	ut_assertok(hash_multi_block(algos, TEST_HASH_COUNT, data,
+				     TEST_HASH_SIZE, outputs));
+	multi_us = timer_get_us() - start;
+
+	for (i = 0; i < TEST_HASH_COUNT; i++)
+		ut_asserteq_mem(single[i], outputs[i], algos[i]->digest_size);
+
+	/* Zero length data and invalid number of algorithms */
+	ut_assertok(hash_multi_block(algos, TEST_HASH_COUNT, data, 0,
+				     outputs));
+	ut_asserteq(-EINVAL, hash_multi_block(algos, 0, data, 16, outputs));
+	ut_asserteq(-EINVAL, hash_multi_block(algos, HASH_MULTI_MAX + 1,
+					      data, 16, outputs));
+
+	free(data);
+
+	printf("crc32+sha256, %u bytes:\n", TEST_HASH_SIZE);
+	ut_show_speed("hash_block():", TEST_HASH_SIZE, single_us);
+	ut_show_speed("hash_multi_block():", TEST_HASH_SIZE, multi_us);
+
+	return 0;
+}
+LIB_TEST(lib_test_hash_multi, 0);
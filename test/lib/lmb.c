@@ -9,6 +9,7 @@
 #include <log.h>
 #include <malloc.h>
 #include <dm/test.h>
+#include <test/lib.h>
 #include <test/test.h>
 #include <test/ut.h>
 
@@ -21,22 +22,22 @@ static int check_lmb(struct unit_test_state *uts, struct lmb *lmb,
 {
 	if (ram_size) {
 		ut_asserteq(lmb->memory.cnt, 1);
-		ut_asserteq(lmb->memory.region[0].base, ram_base);
-		ut_asserteq(lmb->memory.region[0].size, ram_size);
+		ut_asserteq(lmb_region_get(&lmb->memory, 0)->base, ram_base);
+		ut_asserteq(lmb_region_get(&lmb->memory, 0)->size, ram_size);
 	}
 
 	ut_asserteq(lmb->reserved.cnt, num_reserved);
 	if (num_reserved > 0) {
-		ut_asserteq(lmb->reserved.region[0].base, base1);
-		ut_asserteq(lmb->reserved.region[0].size, size1);
+		ut_asserteq(lmb_region_get(&lmb->reserved, 0)->base, base1);
+		ut_asserteq(lmb_region_get(&lmb->reserved, 0)->size, size1);
 	}
 	if (num_reserved > 1) {
-		ut_asserteq(lmb->reserved.region[1].base, base2);
-		ut_asserteq(lmb->reserved.region[1].size, size2);
+		ut_asserteq(lmb_region_get(&lmb->reserved, 1)->base, base2);
+		ut_asserteq(lmb_region_get(&lmb->reserved, 1)->size, size2);
 	}
 	if (num_reserved > 2) {
-		ut_asserteq(lmb->reserved.region[2].base, base3);
-		ut_asserteq(lmb->reserved.region[2].size, size3);
+		ut_asserteq(lmb_region_get(&lmb->reserved, 2)->base, base3);
+		ut_asserteq(lmb_region_get(&lmb->reserved, 2)->size, size3);
 	}
 	return 0;
 }
@@ -82,14 +83,14 @@ static int test_multi_alloc(struct unit_test_state *uts, const phys_addr_t ram,
 
 	if (ram0_size) {
 		ut_asserteq(lmb.memory.cnt, 2);
-		ut_asserteq(lmb.memory.region[0].base, ram0);
-		ut_asserteq(lmb.memory.region[0].size, ram0_size);
-		ut_asserteq(lmb.memory.region[1].base, ram);
-		ut_asserteq(lmb.memory.region[1].size, ram_size);
+		ut_asserteq(lmb_region_get(&lmb.memory, 0)->base, ram0);
+		ut_asserteq(lmb_region_get(&lmb.memory, 0)->size, ram0_size);
+		ut_asserteq(lmb_region_get(&lmb.memory, 1)->base, ram);
+		ut_asserteq(lmb_region_get(&lmb.memory, 1)->size, ram_size);
 	} else {
 		ut_asserteq(lmb.memory.cnt, 1);
-		ut_asserteq(lmb.memory.region[0].base, ram);
-		ut_asserteq(lmb.memory.region[0].size, ram_size);
+		ut_asserteq(lmb_region_get(&lmb.memory, 0)->base, ram);
+		ut_asserteq(lmb_region_get(&lmb.memory, 0)->size, ram_size);
 	}
 
 	/* reserve 64KiB somewhere */
@@ -160,14 +161,14 @@ static int test_multi_alloc(struct unit_test_state *uts, const phys_addr_t ram,
 
 	if (ram0_size) {
 		ut_asserteq(lmb.memory.cnt, 2);
-		ut_asserteq(lmb.memory.region[0].base, ram0);
-		ut_asserteq(lmb.memory.region[0].size, ram0_size);
-		ut_asserteq(lmb.memory.region[1].base, ram);
-		ut_asserteq(lmb.memory.region[1].size, ram_size);
+		ut_asserteq(lmb_region_get(&lmb.memory, 0)->base, ram0);
+		ut_asserteq(lmb_region_get(&lmb.memory, 0)->size, ram0_size);
+		ut_asserteq(lmb_region_get(&lmb.memory, 1)->base, ram);
+		ut_asserteq(lmb_region_get(&lmb.memory, 1)->size, ram_size);
 	} else {
 		ut_asserteq(lmb.memory.cnt, 1);
-		ut_asserteq(lmb.memory.region[0].base, ram);
-		ut_asserteq(lmb.memory.region[0].size, ram_size);
+		ut_asserteq(lmb_region_get(&lmb.memory, 0)->base, ram);
+		ut_asserteq(lmb_region_get(&lmb.memory, 0)->size, ram_size);
 	}
 
 	return 0;
@@ -659,3 +660,109 @@ static int lib_test_lmb_get_free_size(struct unit_test_state *uts)
 
 DM_TEST(lib_test_lmb_get_free_size,
 	UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#define TEST_LMB_REGIONS	2000
+#define TEST_LMB_PAGES		(4 * TEST_LMB_REGIONS)
+#define TEST_LMB_PAGE		0x1000
+
+/* Check every page of the RAM against the map of reserved pages */
+static int test_lmb_check_map(struct unit_test_state *uts, struct lmb *lmb,
+			      phys_addr_t ram, const u8 *map)
+{
+	unsigned long regions = 0;
+	int i;
+
+	for (i = 0; i < TEST_LMB_PAGES; i++) {
+		ut_asserteq(map[i],
+			    lmb_is_reserved(lmb, ram + i * TEST_LMB_PAGE));
+		if (map[i] && (!i || !map[i - 1]))
+			regions++;
+	}
+	ut_asserteq(regions, lmb->reserved.cnt);
+
+	return 0;
+}
+
+/*
+ * Reserve many single pages, as a device tree with lots of reserved-memory
+ * nodes would do, then fill the gaps with allocations and free them again.
+ * Check the result against a map of the reserved pages and show the time
+ * taken for each step.
+ */
+static int lib_test_lmb_stress(struct unit_test_state *uts)
+{
+	const phys_addr_t ram = 0x40000000;
+	const phys_size_t ram_size = TEST_LMB_PAGES * TEST_LMB_PAGE;
+	ulong start, reserve_us, alloc_us, free_us;
+	phys_addr_t *allocs;
+	struct lmb lmb;
+	u32 seed = 1;
+	u8 *map;
+	int i, page;
+
+	map = calloc(TEST_LMB_PAGES, 1);
+	ut_assertnonnull(map);
+	allocs = calloc(TEST_LMB_REGIONS, sizeof(*allocs));
+	ut_assertnonnull(allocs);
+
+	lmb_init(&lmb);
+	ut_asserteq(0, lmb_add(&lmb, ram, ram_size));
+
+	/* One page in every four, so that no two pages are adjacent */
+	start = timer_get_us();
+	for (i = 0; i < TEST_LMB_REGIONS; i++) {
+		seed = seed * 1103515245 + 12345;
+		page = 4 * i + ((seed >> 16) & 1);
+		map[page] = 1;
+		ut_asserteq(0, lmb_reserve(&lmb, ram + page * TEST_LMB_PAGE,
+					   TEST_LMB_PAGE));
+	}
+	reserve_us = timer_get_us() - start;
+	ut_asserteq(TEST_LMB_REGIONS, lmb.reserved.cnt);
+	ut_assertok(test_lmb_check_map(uts, &lmb, ram, map));
+
+	/* Each gap has room for at least one block of two pages */
+	start = timer_get_us();
+	for (i = 0; i < TEST_LMB_REGIONS; i++) {
+		allocs[i] = lmb_alloc(&lmb, 2 * TEST_LMB_PAGE, TEST_LMB_PAGE);
+		if (!allocs[i])
+			break;
+	}
+	alloc_us = timer_get_us() - start;
+	for (i = 0; i < TEST_LMB_REGIONS; i++) {
+		ut_assert(allocs[i] >= ram);
+		page = (allocs[i] - ram) / TEST_LMB_PAGE;
+		ut_assert(page + 2 <= TEST_LMB_PAGES);
+		ut_asserteq(0, map[page]);
+		ut_asserteq(0, map[page + 1]);
+		map[page] = map[page + 1] = 1;
+	}
+	ut_assertok(test_lmb_check_map(uts, &lmb, ram, map));
+
+	start = timer_get_us();
+	for (i = 0; i < TEST_LMB_REGIONS; i++)
+		ut_asserteq(0, lmb_free(&lmb, allocs[i], 2 * TEST_LMB_PAGE));
+	free_us = timer_get_us() - start;
+	for (i = 0; i < TEST_LMB_REGIONS; i++) {
+		page = (allocs[i] - ram) / TEST_LMB_PAGE;
+		map[page] = map[page + 1] = 0;
+	}
+	ut_assertok(test_lmb_check_map(uts, &lmb, ram, map));
+	ut_asserteq(TEST_LMB_REGIONS, lmb.reserved.cnt);
+
+	lmb_release(&lmb);
+	ut_asserteq(0, lmb.reserved.cnt);
+	free(allocs);
+	free(map);
+
+	printf("lmb, %d regions:\n", TEST_LMB_REGIONS);
+	ut_show_speed("lmb_reserve():", TEST_LMB_REGIONS * TEST_LMB_PAGE,
+		      reserve_us);
+	ut_show_speed("lmb_alloc():", TEST_LMB_REGIONS * 2 * TEST_LMB_PAGE,
+		      alloc_us);
+	ut_show_speed("lmb_free():", TEST_LMB_REGIONS * 2 * TEST_LMB_PAGE,
+		      free_us);
+
+	return 0;
+}
+LIB_TEST(lib_test_lmb_stress, 0);
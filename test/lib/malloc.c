@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the malloc() cache of freed blocks (CONFIG_SYS_MALLOC_CACHE)
+ *
+ * (C) Copyright 2022
+ * F&S Elektronik Systeme GmbH
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <linux/sizes.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Limit for the size classes and the memalign() pool together */
+#define CACHE_LIMIT	SZ_64K
+
+/* Alignment for memalign(), more than malloc() gives anyway */
+#define POOL_ALIGN	128
+
+/* Give back all cached blocks, a failing malloc() does this */
+static void malloc_test_flush(void)
+{
+	struct malloc_info info;
+
+	malloc_get_info(&info);
+	free(malloc(info.heap_size));
+}
+
+/* A freed small block is returned by the next malloc() of the same size */
+static int lib_test_malloc_cache(struct unit_test_state *uts)
+{
+	struct malloc_info start, info;
+	void *a, *b, *c, *p;
+	size_t size;
+
+	malloc_test_flush();
+	a = malloc(64);
+	b = malloc(64);
+	c = malloc(64);
+	ut_assertnonnull(a);
+	ut_assertnonnull(b);
+	ut_assertnonnull(c);
+
+	/* A block from the bins may be a little larger than asked for */
+	size = malloc_usable_size(b);
+	malloc_get_info(&start);
+	free(b);
+	malloc_get_info(&info);
+	ut_assert(info.cached > start.cached);
+
+	p = malloc(size);
+	malloc_get_info(&info);
+	ut_asserteq_ptr(b, p);
+	ut_asserteq(start.cache_hits + 1, info.cache_hits);
+	ut_asserteq(start.cached, info.cached);
+
+	free(a);
+	free(b);
+	free(c);
+
+	return 0;
+}
+LIB_TEST(lib_test_malloc_cache, 0);
+
+/* Only blocks from memalign() go to the pool and serve memalign() again */
+static int lib_test_malloc_pool(struct unit_test_state *uts)
+{
+	struct malloc_info start, info;
+	void *guard[64], *buf, *p, *m[8];
+	int i, n, aligned = -1;
+
+	malloc_test_flush();
+	buf = memalign(POOL_ALIGN, SZ_4K);
+	ut_assertnonnull(buf);
+
+	/*
+	 * A block next to the top of the heap is not kept, so allocate small
+	 * blocks until one is placed right behind buf. The first ones may
+	 * still come from free blocks elsewhere.
+	 */
+	for (n = 0; n < ARRAY_SIZE(guard); n++) {
+		guard[n] = malloc(32);
+		ut_assertnonnull(guard[n]);
+		if (guard[n] > buf && guard[n] < buf + SZ_4K + 2 * POOL_ALIGN)
+			break;
+	}
+	ut_assert(n < ARRAY_SIZE(guard));
+
+	malloc_get_info(&start);
+	free(buf);
+	malloc_get_info(&info);
+	ut_assert(info.cached >= start.cached + SZ_4K);
+
+	p = memalign(POOL_ALIGN, SZ_4K);
+	malloc_get_info(&info);
+	ut_asserteq_ptr(buf, p);
+	ut_asserteq(start.pool_hits + 1, info.pool_hits);
+	free(p);
+
+	/*
+	 * Blocks from malloc() are not kept in the pool, even if they happen
+	 * to be aligned. The block size is not a multiple of POOL_ALIGN, so
+	 * one of these blocks is aligned.
+	 */
+	for (i = 0; i < ARRAY_SIZE(m); i++) {
+		m[i] = malloc(SZ_4K);
+		ut_assertnonnull(m[i]);
+		if (aligned < 0 && i > 0 && !((ulong)m[i] % POOL_ALIGN))
+			aligned = i;
+	}
+	ut_assert(aligned > 0 && aligned < ARRAY_SIZE(m) - 1);
+	malloc_get_info(&start);
+	free(m[aligned]);
+	malloc_get_info(&info);
+	ut_asserteq(start.cached, info.cached);
+	m[aligned] = NULL;
+
+	for (i = 0; i < ARRAY_SIZE(m); i++)
+		free(m[i]);
+	for (i = 0; i <= n; i++)
+		free(guard[i]);
+
+	return 0;
+}
+LIB_TEST(lib_test_malloc_pool, 0);
+
+/* The size classes and the pool together keep no more than the limit */
+static int lib_test_malloc_cache_limit(struct unit_test_state *uts)
+{
+	struct malloc_info info;
+	const int count = 2 * CACHE_LIMIT / 200;
+	void **p, *buf;
+	int i;
+
+	/* Free every other block, so that none can be merged */
+	p = calloc(count, sizeof(*p));
+	ut_assertnonnull(p);
+	for (i = 0; i < count; i++) {
+		p[i] = malloc(200);
+		ut_assertnonnull(p[i]);
+	}
+	for (i = 0; i < count; i += 2) {
+		free(p[i]);
+		p[i] = NULL;
+	}
+	malloc_get_info(&info);
+	ut_assert(info.cached > 0);
+	ut_assert(info.cached <= CACHE_LIMIT);
+
+	/* The pool can not get more than what is left */
+	ut_assert(info.cached + SZ_32K > CACHE_LIMIT);
+	buf = memalign(POOL_ALIGN, SZ_32K);
+	ut_assertnonnull(buf);
+	p[0] = malloc(32);
+	free(buf);
+	malloc_get_info(&info);
+	ut_assert(info.cached <= CACHE_LIMIT);
+
+	for (i = 0; i < count; i++)
+		free(p[i]);
+	free(p);
+
+	return 0;
+}
+LIB_TEST(lib_test_malloc_cache_limit, 0);
+
+/* A failing malloc() gives back the cache and is only counted once */
+static int lib_test_malloc_flush(struct unit_test_state *uts)
+{
+	struct malloc_info start, info;
+	void *a, *b, *c;
+
+	a = malloc(64);
+	b = malloc(64);
+	c = malloc(64);
+	free(b);
+
+	malloc_get_info(&start);
+	ut_assert(start.cached > 0);
+	ut_assertnull(malloc(start.heap_size));
+	malloc_get_info(&info);
+	ut_asserteq(start.malloc_count + 1, info.malloc_count);
+	ut_asserteq(start.fail_count + 1, info.fail_count);
+	ut_asserteq(0, info.cached);
+
+	free(a);
+	free(c);
+
+	return 0;
+}
+LIB_TEST(lib_test_malloc_flush, 0);
@@ -4,8 +4,10 @@
 
 import os
 import random
+import shutil
 import string
 import subprocess
+import zlib
 
 def sqfs_get_random_letters(size):
     letters = []
@@ -74,3 +76,53 @@ zstd.add_opt("-always-use-fragments")
 lzo.add_opt("-no-fragments")
 
 comp_opts = [gzip, zstd, lzo]
+
+def sqfs_generate_data(size):
+    """Return size random letters, faster than sqfs_get_random_letters()"""
+    letters = (string.ascii_letters * 5).encode()[:256]
+    return os.urandom(size).translate(letters)
+
+def sqfs_crc32(data):
+    return "%08x" % (zlib.crc32(data) & 0xffffffff)
+
+def sqfs_make_image(build_dir, name, files, opts, links = {}):
+    """Create the gzip image sqfs-<name> and return its path
+
+    files maps paths in the image to their content, links maps paths to the
+    targets of symbolic links. Raises RuntimeError if mksquashfs fails.
+    """
+    src = os.path.join(build_dir, "sqfs_src_" + name)
+    shutil.rmtree(src, ignore_errors = True)
+    for (f, data) in files.items():
+        os.makedirs(os.path.dirname(os.path.join(src, f)), exist_ok = True)
+        with open(os.path.join(src, f), "wb") as file:
+            file.write(data)
+    for (f, target) in links.items():
+        os.makedirs(os.path.dirname(os.path.join(src, f)), exist_ok = True)
+        os.symlink(target, os.path.join(src, f))
+
+    sqfs_img = os.path.join(build_dir, "sqfs-" + name)
+    if os.path.exists(sqfs_img):
+        os.remove(sqfs_img)
+    try:
+        subprocess.run(["mksquashfs " + src + " " + sqfs_img +
+                        " -comp gzip " + opts], shell = True, check = True)
+    except:
+        print("mksquashfs error. Image: " + name)
+        raise RuntimeError
+    finally:
+        shutil.rmtree(src)
+
+    return sqfs_img
+
+def sqfs_check_load(u_boot_console, name, data, size = 0):
+    """Load name (size bytes of it if not 0) and compare it with data"""
+    size = size or len(data)
+    u_boot_console.run_command("mw.b $kernel_addr_r 0 %x" % size)
+    cmd = "sqfsload host 0 $kernel_addr_r " + name
+    if size != len(data):
+        cmd += " %x" % size
+    output = u_boot_console.run_command(cmd)
+    assert "%d bytes read" % size in output
+    output = u_boot_console.run_command("crc32 $kernel_addr_r %x" % size)
+    assert sqfs_crc32(data[:size]) in output
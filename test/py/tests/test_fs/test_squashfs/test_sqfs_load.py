@@ -4,6 +4,7 @@
 
 import os
 import pytest
+import time
 from sqfs_common import *
 
 @pytest.mark.boardspec('sandbox')
@@ -44,3 +45,127 @@ def test_sqfs_load(u_boot_console):
 
         # remove generated files
         opt.cleanup(build_dir)
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_crc32')
+@pytest.mark.buildconfigspec('cmd_fs_generic')
+@pytest.mark.buildconfigspec('cmd_squashfs')
+@pytest.mark.buildconfigspec('fs_squashfs')
+@pytest.mark.requiredtool('mksquashfs')
+def test_sqfs_load_blocks(u_boot_console):
+    build_dir = u_boot_console.config.build_dir
+    bs = 4096
+
+    # the tail of a multi-block file and small files share one fragment
+    files = {
+        "frag_tail": sqfs_generate_data(3 * bs + 1000),
+        "small0": sqfs_generate_data(100),
+        "small1": sqfs_generate_data(333),
+        "small2": sqfs_generate_data(700),
+        "small3": sqfs_generate_data(1),
+    }
+    path = sqfs_make_image(build_dir, "frag", files,
+                           "-b %d -always-use-fragments" % bs)
+    try:
+        u_boot_console.run_command("host bind 0 " + path)
+        # load the small files in an order that differs from the image
+        for f in ["small2", "small0", "frag_tail", "small3", "small1"]:
+            sqfs_check_load(u_boot_console, f, files[f])
+
+        # length-limited loads: part of a block, up to the fragment, into
+        # the fragment
+        data = files["frag_tail"]
+        for size in [1, bs - 1, bs + 1, 3 * bs, 3 * bs + 10]:
+            sqfs_check_load(u_boot_console, "frag_tail", data, size)
+        output = u_boot_console.run_command(
+            "sqfsload host 0 $kernel_addr_r frag_tail %x" % (len(data) + 1))
+        assert "bytes read" not in output
+    finally:
+        os.remove(path)
+
+    # blocks that are stored uncompressed are read in one go
+    files = {
+        "raw": sqfs_generate_data(5 * bs + 300),
+        "raw_aligned": sqfs_generate_data(4 * bs),
+    }
+    path = sqfs_make_image(build_dir, "raw", files,
+                           "-b %d -noD -no-fragments" % bs)
+    try:
+        u_boot_console.run_command("host bind 0 " + path)
+        for (f, data) in files.items():
+            sqfs_check_load(u_boot_console, f, data)
+        for size in [1, bs + 7, 5 * bs + 1]:
+            sqfs_check_load(u_boot_console, "raw", files["raw"], size)
+    finally:
+        os.remove(path)
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_crc32')
+@pytest.mark.buildconfigspec('cmd_fs_generic')
+@pytest.mark.buildconfigspec('cmd_squashfs')
+@pytest.mark.buildconfigspec('fs_squashfs')
+@pytest.mark.requiredtool('mksquashfs')
+def test_sqfs_load_speed(u_boot_console):
+    build_dir = u_boot_console.config.build_dir
+    size = 16 << 20
+    files = {"large": sqfs_generate_data(size)}
+    path = sqfs_make_image(build_dir, "large", files, "-b 131072")
+    try:
+        u_boot_console.run_command("host bind 0 " + path)
+        cmd = "sqfsload host 0 $kernel_addr_r large"
+        tstart = time.time()
+        output = u_boot_console.run_command(cmd)
+        tend = time.time()
+        assert "%d bytes read" % size in output
+        u_boot_console.log.info("Loading %d bytes took %f seconds" %
+                                (size, tend - tstart))
+        output = u_boot_console.run_command("crc32 $kernel_addr_r %x" % size)
+        assert sqfs_crc32(files["large"]) in output
+    finally:
+        os.remove(path)
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_crc32')
+@pytest.mark.buildconfigspec('cmd_fs_generic')
+@pytest.mark.buildconfigspec('cmd_squashfs')
+@pytest.mark.buildconfigspec('fs_squashfs')
+@pytest.mark.requiredtool('mksquashfs')
+def test_sqfs_load_cache(u_boot_console):
+    build_dir = u_boot_console.config.build_dir
+
+    # the metadata cache is kept from one load to the next on the same image
+    files_a = {
+        "kernel": sqfs_generate_data(20000),
+        "dtb": sqfs_generate_data(3000),
+        "overlays/a.dtbo": sqfs_generate_data(500),
+        "overlays/b.dtbo": sqfs_generate_data(700),
+    }
+    # another image with the same paths but other sizes and content
+    files_b = {
+        "kernel": sqfs_generate_data(9000),
+        "dtb": sqfs_generate_data(4000),
+        "extra": sqfs_generate_data(100),
+        "overlays/a.dtbo": sqfs_generate_data(800),
+        "overlays/b.dtbo": sqfs_generate_data(200),
+    }
+    path_a = sqfs_make_image(build_dir, "cache_a", files_a, "-b 4096")
+    path_b = sqfs_make_image(build_dir, "cache_b", files_b, "-b 4096")
+    try:
+        u_boot_console.run_command("host bind 0 " + path_a)
+        for f in ["kernel", "dtb", "overlays/a.dtbo", "overlays/b.dtbo",
+                  "kernel"]:
+            sqfs_check_load(u_boot_console, f, files_a[f])
+
+        # swapping the image must drop the cache
+        u_boot_console.run_command("host bind 0 " + path_b)
+        output = u_boot_console.run_command("sqfsls host 0")
+        assert "3 file(s), 1 dir(s)" in output
+        for f in ["overlays/b.dtbo", "kernel", "dtb", "overlays/a.dtbo"]:
+            sqfs_check_load(u_boot_console, f, files_b[f])
+
+        u_boot_console.run_command("host bind 0 " + path_a)
+        for f in ["overlays/b.dtbo", "kernel"]:
+            sqfs_check_load(u_boot_console, f, files_a[f])
+    finally:
+        os.remove(path_a)
+        os.remove(path_b)
@@ -34,3 +34,44 @@ def test_sqfs_ls(u_boot_console):
             opt.cleanup(build_dir)
             assert False
         opt.cleanup(build_dir)
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_crc32')
+@pytest.mark.buildconfigspec('cmd_fs_generic')
+@pytest.mark.buildconfigspec('cmd_squashfs')
+@pytest.mark.buildconfigspec('fs_squashfs')
+@pytest.mark.requiredtool('mksquashfs')
+def test_sqfs_ls_ldir(u_boot_console):
+    build_dir = u_boot_console.config.build_dir
+
+    # a listing of more than 8 KiB gets an extended directory inode (LDIR),
+    # more than 256 entries need several directory headers
+    names = ["file_%03d_%s" % (i, "x" * 40) for i in range(300)]
+    files = {}
+    for n in names:
+        files["many/" + n] = sqfs_generate_data(50)
+    files["top"] = sqfs_generate_data(3000)
+    links = {
+        "top_link": "many/" + names[299],
+        "many/up_link": "../top",
+    }
+    path = sqfs_make_image(build_dir, "ldir", files, "-b 4096", links)
+    try:
+        u_boot_console.run_command("host bind 0 " + path)
+        output = u_boot_console.run_command("sqfsls host 0 many")
+        assert "301 file(s), 0 dir(s)" in output
+        for n in [names[0], names[255], names[256], names[299]]:
+            assert n in output
+        assert "<SYM>   up_link" in output
+
+        output = u_boot_console.run_command("sqfsls host 0")
+        assert "2 file(s), 1 dir(s)" in output
+        assert "<SYM>   top_link" in output
+
+        for n in [names[0], names[256], names[299]]:
+            sqfs_check_load(u_boot_console, "many/" + n, files["many/" + n])
+        sqfs_check_load(u_boot_console, "top_link",
+                        files["many/" + names[299]])
+        sqfs_check_load(u_boot_console, "many/up_link", files["top"])
+    finally:
+        os.remove(path)
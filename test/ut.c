@@ -51,6 +51,25 @@ long ut_check_delta(ulong last)
 	return ut_check_free() - last;
 }
 
+void ut_fill_pattern(void *buf, ulong size)
+{
+	u8 *data = buf;
+	ulong i;
+
+	for (i = 0; i < size; i++)
+		data[i] = i * 7 + (i >> 8) + (i >> 16);
+}
+
+ulong ut_rate(ulong count, ulong us)
+{
+	return count / (us ? us : 1);
+}
+
+void ut_show_speed(const char *name, ulong size, ulong us)
+{
+	printf("  %-20s %8lu us, %5lu bytes/us\n", name, us, ut_rate(size, us));
+}
+
 int ut_check_console_line(struct unit_test_state *uts, const char *fmt, ...)
 {
 	va_list args;